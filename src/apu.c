@@ -1,9 +1,10 @@
-#include <portaudio.h>
 #include <err.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include "apu.h"
+#include "audio.h"
 
 const char* gradient[] = {
         "\x1b[38;2;255;255;255",
@@ -99,15 +100,15 @@ void dump_apu(apu_memory* apu_mem) {
 }
 
 byte read_apu_status(apu_memory *apu_mem) {
-    byte dmc_interrupt = 0;
-    byte frame_interrupt = 0;
+    byte dmc_interrupt = apu_mem->dmc_interrupt ? (byte)1 : (byte)0;
+    byte frame_interrupt = apu_mem->frame_interrupt ? (byte)1 : (byte)0;
     byte dmc = apu_mem->dmc.sample_length > 0 ? (byte)1 : (byte)0;
     byte noise = apu_mem->noise.length_counter > 0 ? (byte)1 : (byte)0;
     byte triangle = apu_mem->triangle.length_counter > 0 ? (byte)1 : (byte)0;
     byte pulse1 = apu_mem->pulse1.length_counter > 0 ? (byte)1 : (byte)0;
     byte pulse2 = apu_mem->pulse2.length_counter > 0 ? (byte)1 : (byte)0;
 
-    return (dmc_interrupt << 7) |
+    byte status = (dmc_interrupt << 7) |
             (frame_interrupt << 6) |
             (dmc << 4) |
             (noise << 3) |
@@ -115,6 +116,11 @@ byte read_apu_status(apu_memory *apu_mem) {
             (pulse2 << 1) |
             (pulse1);
 
+    // Reading the status acknowledges the frame interrupt
+    apu_mem->frame_interrupt = false;
+    release_irq(apu_mem->scheduler, IRQ_APU_FRAME);
+
+    return status;
 }
 
 byte pulse_duty[4][8] = {
@@ -252,11 +258,88 @@ void write_dmc_register(dmc_oscillator* dmc, int register_num, byte value) {
     }
 }
 
+/*
+ * The NES mixes its channels with resistors rather than adding them up, so two channels together come out quieter
+ * than the sum of each on its own. The pulses share one output and everything else shares another, so it comes down
+ * to a table for each, indexed by a plain sum of the channels that go into it:
+ *
+ *   pulse_table[n] = 95.52 / (8128 / n + 100), n = pulse1 + pulse2
+ *   tnd_table[n] = 163.67 / (24329 / n + 100), n = 3 * triangle + 2 * noise + dmc
+ *
+ * Together they go from 0 up to 1, which apu_step then runs through a high-pass so it swings either side of 0. They're
+ * written out here rather than worked out at start-up, so there's nothing to set up before APUs on different threads
+ * use them.
+ */
+static const float pulse_table[31] = {
+        0.0f, 0.0116091399f, 0.0229394808f, 0.0340009481f, 0.044803001f, 0.0553546585f,
+        0.0656645298f, 0.0757408217f, 0.0855913982f, 0.0952237472f, 0.104645051f, 0.113862157f,
+        0.122881643f, 0.131709799f, 0.140352651f, 0.14881596f, 0.157105267f, 0.165225878f,
+        0.17318292f, 0.180981249f, 0.188625589f, 0.196120456f, 0.203470185f, 0.210678935f,
+        0.217750758f, 0.224689499f, 0.231498882f, 0.238182485f, 0.244743779f, 0.251186073f,
+        0.257512569f
+};
+static const float tnd_table[203] = {
+        0.0f, 0.00669982377f, 0.0133450199f, 0.0199362542f, 0.0264741797f, 0.0329594426f,
+        0.0393926762f, 0.0457745008f, 0.0521055348f, 0.0583863817f, 0.0646176338f, 0.0707998723f,
+        0.076933682f, 0.0830196291f, 0.0890582576f, 0.0950501338f, 0.100995794f, 0.106895767f,
+        0.112750582f, 0.118560754f, 0.124326788f, 0.130049184f, 0.135728449f, 0.141365051f,
+        0.146959484f, 0.152512208f, 0.158023685f, 0.163494393f, 0.168924764f, 0.174315259f,
+        0.179666296f, 0.184978306f, 0.190251738f, 0.195486993f, 0.200684488f, 0.205844626f,
+        0.210967809f, 0.21605444f, 0.221104905f, 0.226119593f, 0.231098875f, 0.236043125f,
+        0.240952715f, 0.245828003f, 0.25066936f, 0.25547713f, 0.260251641f, 0.26499328f,
+        0.269702345f, 0.274379224f, 0.279024184f, 0.283637583f, 0.28821972f, 0.292770922f,
+        0.297291547f, 0.301781833f, 0.306242108f, 0.310672671f, 0.315073848f, 0.319445908f,
+        0.32378912f, 0.328103781f, 0.332390189f, 0.336648613f, 0.340879291f, 0.345082551f,
+        0.349258631f, 0.35340777f, 0.357530266f, 0.361626387f, 0.365696311f, 0.369740367f,
+        0.373758763f, 0.377751738f, 0.381719559f, 0.385662436f, 0.389580637f, 0.39347434f,
+        0.397343844f, 0.401189297f, 0.405010968f, 0.408809096f, 0.412583858f, 0.416335464f,
+        0.420064151f, 0.42377013f, 0.427453607f, 0.431114763f, 0.434753835f, 0.438371003f,
+        0.441966444f, 0.445540398f, 0.449093014f, 0.45262453f, 0.456135064f, 0.459624887f,
+        0.463094115f, 0.466542959f, 0.469971567f, 0.473380178f, 0.476768911f, 0.480137974f,
+        0.483487517f, 0.486817688f, 0.490128726f, 0.49342072f, 0.496693879f, 0.499948323f,
+        0.503184259f, 0.506401837f, 0.509601176f, 0.512782454f, 0.515945852f, 0.519091487f,
+        0.522219479f, 0.525330067f, 0.52842325f, 0.531499326f, 0.534558415f, 0.537600517f,
+        0.54062593f, 0.543634713f, 0.546627045f, 0.549603045f, 0.552562833f, 0.555506527f,
+        0.558434308f, 0.561346233f, 0.564242482f, 0.567123234f, 0.569988489f, 0.572838426f,
+        0.575673223f, 0.578492939f, 0.581297696f, 0.58408761f, 0.586862803f, 0.589623451f,
+        0.592369616f, 0.595101357f, 0.597818911f, 0.60052228f, 0.603211582f, 0.605887055f,
+        0.608548641f, 0.611196518f, 0.613830805f, 0.616451621f, 0.619059026f, 0.62165314f,
+        0.624234021f, 0.626801848f, 0.629356682f, 0.631898582f, 0.634427726f, 0.636944175f,
+        0.639448047f, 0.641939342f, 0.64441824f, 0.646884859f, 0.649339199f, 0.65178138f,
+        0.654211581f, 0.656629741f, 0.65903604f, 0.661430597f, 0.663813412f, 0.666184664f,
+        0.668544352f, 0.670892596f, 0.673229456f, 0.67555505f, 0.677869439f, 0.680172741f,
+        0.682464957f, 0.684746206f, 0.687016606f, 0.689276218f, 0.691525102f, 0.693763316f,
+        0.69599092f, 0.698208094f, 0.700414777f, 0.702611148f, 0.704797208f, 0.706973076f,
+        0.709138811f, 0.711294472f, 0.71344012f, 0.715575874f, 0.717701793f, 0.719817877f,
+        0.721924245f, 0.724020958f, 0.726108074f, 0.728185654f, 0.730253816f, 0.73231256f,
+        0.734362006f, 0.736402154f, 0.738433063f, 0.740454912f, 0.742467582f
+};
+
+/*
+ * The NES takes its DC offset out with a 90 Hz high-pass on the way to the TV, so this does the same:
+ *
+ *   out = in - last in + HIGH_PASS_90HZ * last out, HIGH_PASS_90HZ = exp(-2 pi 90 / AUDIO_SAMPLE_RATE)
+ *
+ * Without it a game that's quiet sits at whatever level its channels were left at, and the int16 samples only ever
+ * use half their range.
+ */
+#define HIGH_PASS_90HZ 0.98726f
+
+static float high_pass(apu_memory* apu_mem, float in) {
+    apu_mem->filter_out = in - apu_mem->filter_in + HIGH_PASS_90HZ * apu_mem->filter_out;
+    apu_mem->filter_in = in;
+    return apu_mem->filter_out;
+}
+
 apu_memory get_apu_mem() {
+
     apu_memory apu_mem;
+    memset(&apu_mem, 0, sizeof(apu_mem));
     apu_mem.cycle = 0;
     apu_mem.buffer_read_index = 0;
     apu_mem.buffer_write_index = 0;
+    apu_mem.muted = false;
+    apu_mem.real_time = false;
 
     apu_mem.pulse1.timer_register = 0;
     apu_mem.pulse2.timer_register = 0;
@@ -266,6 +349,8 @@ apu_memory get_apu_mem() {
 
     apu_mem.interrupt_inhibit = false;
     apu_mem.frame_counter_mode = 0;
+    apu_mem.frame_interrupt = false;
+    apu_mem.dmc_interrupt = false;
 
     apu_mem.noise.enable = 0;
     apu_mem.noise.lfsr = 1; // for pseudorandom
@@ -281,60 +366,47 @@ apu_memory get_apu_mem() {
     return apu_mem;
 }
 
-float get_volume_scale(byte volume) {
-    return volume == 0 ? 0 : (float)volume / 15.0f;
-}
+// What each channel's putting out right now, 0-15 for all but the DMC's 0-127
 
-float get_dmc_sample(dmc_oscillator* dmc) {
-    float level = dmc->level;
-    return (level - 63.5f) / 63.5f;
+byte get_dmc_output(dmc_oscillator* dmc) {
+    return dmc->level;
 }
 
-float get_noise_sample(noise_oscillator* noise) {
+byte get_noise_output(noise_oscillator* noise) {
     int bit = noise->lfsr & 1;
     if (!noise->enable || noise->length_counter == 0 || bit == 0 || noise->timer_register < 1) {
-        return 0.0f;
+        return 0;
+    }
+    else if (noise->cv_or_env) { // 1 is constant volume
+        return noise->vol_and_env_period & 0xF;
     }
     else {
-        float volume_scale;
-        if (noise->cv_or_env) { // 1 is constant volume
-            volume_scale = get_volume_scale(noise->vol_and_env_period);
-        }
-        else {
-            volume_scale = get_volume_scale(noise->envelope_volume);
-        }
-        return 1.0f * volume_scale;
+        return noise->envelope_volume;
     }
 }
 
-float get_triangle_sample(triangle_oscillator* triangle) {
+byte get_triangle_output(triangle_oscillator* triangle) {
     if (triangle->enable && triangle->length_counter > 0 && triangle->linear_counter > 0) {
-        float duty = triangle_duty[triangle->duty_step];
-        return (duty - 7.5f) / 7.5f;
+        return triangle_duty[triangle->duty_step];
     }
     else {
-        return 0.0f;
+        return 0;
     }
 }
 
-float get_pulse_sample(pulse_oscillator* pulse) {
+byte get_pulse_output(pulse_oscillator* pulse) {
     if (pulse->timer_register < 8 || pulse->timer_register > 0x7FF || pulse->enable == false || pulse->length_counter == 0) {
-        return 0.0f;
+        return 0;
     }
 
-    float volume_scale;
-    if (pulse->constant_volume) {
-        volume_scale = get_volume_scale(pulse->vol_and_env_period);
-    }
-    else {
-        volume_scale = get_volume_scale(pulse->envelope_volume);
+    if (pulse_duty[pulse->duty_value][pulse->duty_step] == 0) {
+        return 0;
     }
-
-    if (pulse_duty[pulse->duty_value][pulse->duty_step] == 1) {
-        return 1.0f * volume_scale;
+    else if (pulse->constant_volume) {
+        return pulse->vol_and_env_period & 0xF;
     }
     else {
-        return -1.0f * volume_scale;
+        return pulse->envelope_volume;
     }
 }
 
@@ -509,6 +581,32 @@ void step_frame_counter(apu_memory *apu_mem) {
     }
 }
 
+// Step n is due on the first whole cycle at or after n/240 seconds from the reset
+void schedule_frame_counter(apu_memory* apu_mem) {
+    long step = apu_mem->frame_counter_steps + 1;
+    long cycle = apu_mem->frame_counter_start + (step * CPU_FREQUENCY + FRAME_COUNTER_STEPS_PER_SECOND - 1) / FRAME_COUNTER_STEPS_PER_SECOND;
+    // Scheduled for the start of the cycle before, so it happens as the APU steps into that cycle
+    schedule_event(apu_mem->scheduler, EVENT_APU_FRAME_COUNTER, (cycle - 1) * DOTS_PER_CPU_CYCLE, 0);
+}
+
+void reset_frame_counter(apu_memory* apu_mem) {
+    // Start over so the next step is the first of the sequence
+    apu_mem->frame_counter = apu_mem->frame_counter_mode == FC_5STEP ? 4 : 3;
+    apu_mem->frame_counter_start = apu_mem->cycle;
+    apu_mem->frame_counter_steps = 0;
+    schedule_frame_counter(apu_mem);
+}
+
+void clock_frame_counter(apu_memory* apu_mem) {
+    step_frame_counter(apu_mem);
+    if (apu_mem->frame_counter_mode == FC_4STEP && apu_mem->frame_counter == 3 && !apu_mem->interrupt_inhibit) {
+        apu_mem->frame_interrupt = true;
+        assert_irq(apu_mem->scheduler, IRQ_APU_FRAME);
+    }
+    apu_mem->frame_counter_steps++;
+    schedule_frame_counter(apu_mem);
+}
+
 void step_triangle_timer(triangle_oscillator* triangle) {
     if (triangle->timer_step == 0) {
         triangle->timer_step = triangle->timer_register;
@@ -536,7 +634,16 @@ void step_noise_timer(noise_oscillator* noise) {
     }
 }
 
-void step_dmc_timer(dmc_oscillator* dmc) {
+void schedule_dmc_fetch(apu_memory* apu_mem) {
+    dmc_oscillator* dmc = &apu_mem->dmc;
+    if (dmc->enable && dmc->sample_length > 0 && dmc->sample_bit == 0) {
+        // The memory read happens at the start of the next cycle
+        schedule_event(apu_mem->scheduler, EVENT_DMC_FETCH, apu_mem->cycle * DOTS_PER_CPU_CYCLE, 0);
+    }
+}
+
+void step_dmc_timer(apu_memory* apu_mem) {
+    dmc_oscillator* dmc = &apu_mem->dmc;
     if (!dmc->enable || dmc->sample_bit == 0) {
         return;
     }
@@ -554,6 +661,7 @@ void step_dmc_timer(dmc_oscillator* dmc) {
         }
         dmc->sample_bit--;
         dmc->output_buffer >>= 1;
+        schedule_dmc_fetch(apu_mem);
     }
     else {
         dmc->tick--;
@@ -572,78 +680,29 @@ void apu_step(apu_memory* apu_mem) {
         step_pulse_timer(&apu_mem->pulse1);
         step_pulse_timer(&apu_mem->pulse2);
         step_noise_timer(&apu_mem->noise);
-        step_dmc_timer(&apu_mem->dmc);
+        step_dmc_timer(apu_mem);
     }
     // Triangle clock is as fast as the CPU
     step_triangle_timer(&apu_mem->triangle);
 
-    if ((int)(last_cycle / APU_STEPS_PER_FRAME_COUNTER_STEP) != (int)(this_cycle / APU_STEPS_PER_FRAME_COUNTER_STEP)) {
-        step_frame_counter(apu_mem);
-    }
-
-    if ((int)(last_cycle / APU_STEPS_PER_SAMPLE) != (int)(this_cycle / APU_STEPS_PER_SAMPLE)) {
-        // TODO other oscs, and mix them
-        float pulse1_sample   = get_pulse_sample(&apu_mem->pulse1);
-        float pulse2_sample   = get_pulse_sample(&apu_mem->pulse2);
-        float triangle_sample = get_triangle_sample(&apu_mem->triangle);
-        float noise_sample    = get_noise_sample(&apu_mem->noise);
-        float dmc_sample      = get_dmc_sample(&apu_mem->dmc);
-        //printf("DMC sample: %f\n", dmc_sample);
-
-        float sample = (0.2f * pulse1_sample) +
-                (0.2f * pulse2_sample) +
-                (0.2f * triangle_sample) +
-                (0.2f * noise_sample) +
-                (0.5f * dmc_sample);
-        sample *= 0.10f;
-        apu_mem->buffer[(apu_mem->buffer_write_index++) % APU_RING_BUFFER_SIZE] = sample;
-    }
-
-}
-
-// TODO: Put PortAudio stuff into its own file
-static int paCallback(const void *inputBuffer, void *outputBuffer,
-                      unsigned long framesPerBuffer,
-                      const PaStreamCallbackTimeInfo *timeInfo,
-                      PaStreamCallbackFlags statusFlags,
-                      void *userData) {
-    apu_memory* apu_mem = (apu_memory*)userData;
-    float* out = (float*)outputBuffer;
-    (void) inputBuffer; // Prevent unused variable warning.
-
-    for(uint32_t i = 0; i < framesPerBuffer; i++) {
-        // Read sample from ring buffer. While the ring buffer is empty, push zeroes.
-        if (apu_mem->buffer_read_index >= apu_mem->buffer_write_index) {
-            *out++ = 0;
+    if (!apu_mem->muted && (int)(last_cycle / APU_STEPS_PER_SAMPLE) != (int)(this_cycle / APU_STEPS_PER_SAMPLE)) {
+        int pulse = get_pulse_output(&apu_mem->pulse1) + get_pulse_output(&apu_mem->pulse2);
+        int tnd = 3 * get_triangle_output(&apu_mem->triangle)
+                + 2 * get_noise_output(&apu_mem->noise)
+                + get_dmc_output(&apu_mem->dmc);
+        long index = (apu_mem->buffer_write_index++) % APU_RING_BUFFER_SIZE;
+        float sample = high_pass(apu_mem, pulse_table[pulse] + tnd_table[tnd]);
+        if (apu_mem->sample_format == SAMPLE_INT16) {
+            // The high-pass can overshoot a little when a channel jumps all the way from one end to the other
+            float scaled = sample * INT16_MAX;
+            apu_mem->buffer.int16[index] = scaled > INT16_MAX ? INT16_MAX : scaled < INT16_MIN ? INT16_MIN : scaled;
         }
         else {
-            *out++ = apu_mem->buffer[(apu_mem->buffer_read_index++) % APU_RING_BUFFER_SIZE];
+            apu_mem->buffer.f32[index] = sample;
+        }
+        if (apu_mem->sink != NULL && apu_mem->buffer_write_index - apu_mem->sink->pushed >= AUDIO_PUSH_SAMPLES) {
+            audio_push(apu_mem->sink);
         }
-    }
-    return 0;
-}
-
-PaStream* stream;
-
-void apu_init(apu_memory* apu_mem) {
-    // TODO: Put PortAudio stuff into its own file
-    // Initialize PortAudio
-    PaError err = Pa_Initialize();
-    if (err != paNoError) {
-        errx(EXIT_FAILURE, "Unable to initialize PortAudio: %s", Pa_GetErrorText(err));
-    }
-
-    err = Pa_OpenDefaultStream(&stream, 0, 1, paFloat32, AUDIO_SAMPLE_RATE, 32, paCallback, apu_mem);
-
-
-    if (err != paNoError) {
-        errx(EXIT_FAILURE, "Unable to open PortAudio stream: %s", Pa_GetErrorText(err));
-    }
-
-    err = Pa_StartStream(stream);
-
-    if (err != paNoError) {
-        errx(EXIT_FAILURE, "Unable to start PortAudio stream: %s", Pa_GetErrorText(err));
     }
 
 }
@@ -668,6 +727,10 @@ void write_apu_register(apu_memory* apu_mem, int register_num, byte value) {
     }
     else if (register_num < 0x14) {
         write_dmc_register(&apu_mem->dmc, register_num % 4, value);
+        if (!apu_mem->dmc.irq_enabled) {
+            apu_mem->dmc_interrupt = false;
+            release_irq(apu_mem->scheduler, IRQ_DMC);
+        }
     }
     else if (register_num == 0x15) {
         // Channel enable and length counter status
@@ -677,10 +740,14 @@ void write_apu_register(apu_memory* apu_mem, int register_num, byte value) {
                 apu_mem->dmc.sample_length = apu_mem->dmc.sample_length_register;
                 apu_mem->dmc.sample_address = apu_mem->dmc.sample_address_register;
             }
+            schedule_dmc_fetch(apu_mem);
         }
         else {
             apu_mem->dmc.sample_length = 0;
+            cancel_event(apu_mem->scheduler, EVENT_DMC_FETCH);
         }
+        apu_mem->dmc_interrupt = false;
+        release_irq(apu_mem->scheduler, IRQ_DMC);
         apu_mem->noise.enable = ((value >> 3) & 1) == 1;
         apu_mem->triangle.enable = ((value >> 2) & 1) == 1;
         apu_mem->pulse2.enable = ((value >> 1) & 1) == 1;
@@ -697,6 +764,11 @@ void write_apu_register(apu_memory* apu_mem, int register_num, byte value) {
         // Frame counter
         apu_mem->frame_counter_mode = (value >> 7) & 1;
         apu_mem->interrupt_inhibit = ((value >> 6) & 1) == 1;
+        if (apu_mem->interrupt_inhibit) {
+            apu_mem->frame_interrupt = false;
+            release_irq(apu_mem->scheduler, IRQ_APU_FRAME);
+        }
+        reset_frame_counter(apu_mem);
 
         if (apu_mem->frame_counter_mode == FC_5STEP) {
             clock_envelope(apu_mem);
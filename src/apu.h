@@ -1,14 +1,26 @@
 #pragma once
 #include "util.h"
+#include "scheduler.h"
 
 #define AUDIO_SAMPLE_RATE 44100.0
 #define APU_RING_BUFFER_SIZE 10000
 #define APU_STEPS_PER_SAMPLE (CPU_FREQUENCY / AUDIO_SAMPLE_RATE)
-#define APU_STEPS_PER_FRAME_COUNTER_STEP (CPU_FREQUENCY / 240.0)
+#define FRAME_COUNTER_STEPS_PER_SECOND 240
 
 #define FC_4STEP 0
 #define FC_5STEP 1
 
+struct audio_sink_t;
+
+typedef enum apu_sample_format_t {
+    SAMPLE_FLOAT, // -1 to 1
+    SAMPLE_INT16  // INT16_MIN to INT16_MAX
+} apu_sample_format;
+
+static inline size_t apu_sample_size(apu_sample_format format) {
+    return format == SAMPLE_INT16 ? sizeof(int16_t) : sizeof(float);
+}
+
 typedef struct pulse_oscillator_t {
     bool enable;
 
@@ -88,9 +100,20 @@ typedef struct dmc_oscillator_t {
 
 typedef struct apu_memory_t {
     long cycle;
-    float buffer[APU_RING_BUFFER_SIZE];
+    // Samples on their way to the speakers. These belong to whoever's playing them rather than the console, so
+    // savestates leave them alone, and need them kept together. See copy_console.
+    union {
+        float f32[APU_RING_BUFFER_SIZE];
+        int16_t int16[APU_RING_BUFFER_SIZE];
+    } buffer;
     volatile long buffer_write_index;
     volatile long buffer_read_index;
+    apu_sample_format sample_format; // Change it before a sink's opened, not after
+    float filter_in; // The last sample into the high-pass that centres the output, and the last one out
+    float filter_out;
+    volatile bool real_time; // The sink's playing the ring buffer as it goes, so frames wait for it to fill up
+    struct audio_sink_t* sink; // See audio.h
+    bool muted; // Run-ahead frames are run without writing their samples out
 
     pulse_oscillator pulse1;
     pulse_oscillator pulse2;
@@ -102,7 +125,13 @@ typedef struct apu_memory_t {
     int frame_counter_mode;
     bool interrupt_inhibit;
     byte frame_counter;
+    long frame_counter_start; // Cycle the sequencer was last reset on
+    long frame_counter_steps; // Steps taken since then
+    bool frame_interrupt;
+    bool dmc_interrupt;
     dmc_oscillator dmc;
+
+    scheduler* scheduler;
 } apu_memory;
 
 apu_memory get_apu_mem();
@@ -110,5 +139,6 @@ apu_memory get_apu_mem();
 byte read_apu_status(apu_memory *apu_mem);
 void write_apu_register(apu_memory* apu_mem, int register_num, byte value);
 void apu_step(apu_memory* apu_mem);
-void apu_init(apu_memory* apu_mem);
+void reset_frame_counter(apu_memory* apu_mem);
+void clock_frame_counter(apu_memory* apu_mem);
 void set_apu_tracker_enabled(bool enabled);
@@ -0,0 +1,364 @@
+#include <portaudio.h>
+#include <err.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "audio.h"
+
+// 64K samples is about a second and a half of sound
+#define AUDIO_FILE_BLOCK_SAMPLES (1 << 16)
+#define AUDIO_FILE_QUEUE_LENGTH 8
+#define WAV_HEADER_SIZE 44
+#define WAV_FORMAT_PCM 1
+#define WAV_FORMAT_FLOAT 3
+
+static void attach(audio_sink* sink, apu_memory* apu_mem, const audio_sink_ops* ops) {
+    sink->ops = ops;
+    sink->apu_mem = apu_mem;
+    sink->pushed = apu_mem->buffer_write_index;
+    sink->stream = NULL;
+    sink->file = NULL;
+    sink->last_f32 = 0;
+    sink->last_int16 = 0;
+    apu_mem->real_time = false;
+    apu_mem->sink = sink;
+}
+
+void audio_push(audio_sink* sink) {
+    apu_memory* apu_mem = sink->apu_mem;
+    long end = apu_mem->buffer_write_index;
+    if (sink->ops->push != NULL) {
+        size_t sample_size = apu_sample_size(apu_mem->sample_format);
+        // Anything that's already been written over is gone
+        long start = sink->pushed;
+        if (end - start > APU_RING_BUFFER_SIZE) {
+            start = end - APU_RING_BUFFER_SIZE;
+        }
+        while (start < end) {
+            long offset = start % APU_RING_BUFFER_SIZE;
+            long count = end - start;
+            if (offset + count > APU_RING_BUFFER_SIZE) {
+                count = APU_RING_BUFFER_SIZE - offset;
+            }
+            sink->ops->push(sink, (const byte*)&apu_mem->buffer + offset * sample_size, count);
+            start += count;
+        }
+    }
+    sink->pushed = end;
+}
+
+void audio_close(audio_sink* sink) {
+    if (sink->apu_mem == NULL) {
+        return;
+    }
+    audio_push(sink);
+    if (sink->ops->close != NULL) {
+        sink->ops->close(sink);
+    }
+    if (sink->apu_mem->sink == sink) {
+        sink->apu_mem->real_time = false;
+        sink->apu_mem->sink = NULL;
+    }
+    sink->apu_mem = NULL;
+}
+
+// Null
+
+static const audio_sink_ops null_ops = {
+    .name = "none",
+    .push = NULL,
+    .close = NULL
+};
+
+void audio_open_null(audio_sink* sink, apu_memory* apu_mem) {
+    attach(sink, apu_mem, &null_ops);
+}
+
+// PortAudio
+
+static int pa_callback(const void* input_buffer, void* output_buffer,
+                       unsigned long frames_per_buffer,
+                       const PaStreamCallbackTimeInfo* time_info,
+                       PaStreamCallbackFlags status_flags,
+                       void* user_data) {
+    audio_sink* sink = (audio_sink*)user_data;
+    apu_memory* apu_mem = sink->apu_mem;
+    float* out = (float*)output_buffer;
+    int16_t* out_int16 = (int16_t*)output_buffer;
+
+    for (uint32_t i = 0; i < frames_per_buffer; i++) {
+        // Read sample from ring buffer. While the ring buffer is empty, hold the last one, since dropping to 0 pops.
+        bool empty = apu_mem->buffer_read_index >= apu_mem->buffer_write_index;
+        long index = apu_mem->buffer_read_index % APU_RING_BUFFER_SIZE;
+        if (apu_mem->sample_format == SAMPLE_INT16) {
+            sink->last_int16 = out_int16[i] = empty ? sink->last_int16 : apu_mem->buffer.int16[index];
+        }
+        else {
+            sink->last_f32 = out[i] = empty ? sink->last_f32 : apu_mem->buffer.f32[index];
+        }
+        if (!empty) {
+            apu_mem->buffer_read_index++;
+        }
+    }
+    return 0;
+}
+
+static void pa_close(audio_sink* sink) {
+    Pa_StopStream(sink->stream);
+    Pa_CloseStream(sink->stream);
+    Pa_Terminate();
+    sink->stream = NULL;
+}
+
+static const audio_sink_ops portaudio_ops = {
+    .name = "portaudio",
+    .push = NULL,
+    .close = pa_close
+};
+
+void audio_open_portaudio(audio_sink* sink, apu_memory* apu_mem) {
+    PaError err = Pa_Initialize();
+    if (err != paNoError) {
+        warnx("Unable to initialize PortAudio, carrying on without sound: %s", Pa_GetErrorText(err));
+        audio_open_null(sink, apu_mem);
+        return;
+    }
+
+    // Attached first, since the callback can start as soon as the stream does
+    attach(sink, apu_mem, &portaudio_ops);
+    PaStream* stream = NULL;
+    unsigned long format = apu_mem->sample_format == SAMPLE_INT16 ? paInt16 : paFloat32;
+    err = Pa_OpenDefaultStream(&stream, 0, 1, format, AUDIO_SAMPLE_RATE, 32, pa_callback, sink);
+    if (err == paNoError) {
+        err = Pa_StartStream(stream);
+        if (err != paNoError) {
+            Pa_CloseStream(stream);
+        }
+    }
+    if (err != paNoError) {
+        warnx("Unable to open a PortAudio stream, carrying on without sound: %s", Pa_GetErrorText(err));
+        Pa_Terminate();
+        audio_open_null(sink, apu_mem);
+        return;
+    }
+    sink->stream = stream;
+    apu_mem->real_time = true;
+}
+
+// File
+
+/*
+ * Samples are copied into blocks by the emulation thread and written out by the worker, the same way capture does
+ * frames. Nothing's dropped: if the worker's a whole queue behind, the emulator waits for it.
+ */
+typedef struct audio_file_t {
+    FILE* fp;
+    audio_file_format format;
+    apu_sample_format sample_format;
+    size_t sample_size;
+    // Big enough for either sample format
+    byte blocks[AUDIO_FILE_QUEUE_LENGTH][AUDIO_FILE_BLOCK_SAMPLES * sizeof(float)];
+    long block_samples[AUDIO_FILE_QUEUE_LENGTH];
+    long filling; // Samples in the block being filled, which is blocks_queued % AUDIO_FILE_QUEUE_LENGTH
+    long blocks_queued;
+    long blocks_written;
+    long samples_written;
+    bool closing;
+
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    pthread_t thread;
+} audio_file;
+
+static void put_le16(byte* at, uint16_t value) {
+    at[0] = value & 0xFF;
+    at[1] = value >> 8;
+}
+
+static void put_le32(byte* at, uint32_t value) {
+    put_le16(at, value & 0xFFFF);
+    put_le16(at + 2, value >> 16);
+}
+
+static void write_wav_header(audio_file* file, long samples) {
+    uint16_t sample_size = file->sample_size;
+    uint32_t data_size = samples * sample_size;
+    byte header[WAV_HEADER_SIZE];
+    memcpy(header, "RIFF", 4);
+    put_le32(header + 4, WAV_HEADER_SIZE - 8 + data_size);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_le32(header + 16, 16);
+    put_le16(header + 20, file->sample_format == SAMPLE_INT16 ? WAV_FORMAT_PCM : WAV_FORMAT_FLOAT);
+    put_le16(header + 22, 1); // Channels
+    put_le32(header + 24, AUDIO_SAMPLE_RATE);
+    put_le32(header + 28, AUDIO_SAMPLE_RATE * sample_size);
+    put_le16(header + 32, sample_size); // Bytes per frame
+    put_le16(header + 34, sample_size * 8);
+    memcpy(header + 36, "data", 4);
+    put_le32(header + 40, data_size);
+    if (fwrite(header, sizeof(header), 1, file->fp) != 1) {
+        errx(EXIT_FAILURE, "Error writing WAV header: %s", strerror(errno));
+    }
+}
+
+static void* file_worker(void* arg) {
+    audio_file* file = arg;
+    pthread_mutex_lock(&file->lock);
+    while (true) {
+        while (file->blocks_written == file->blocks_queued && !file->closing) {
+            pthread_cond_wait(&file->cond, &file->lock);
+        }
+        if (file->blocks_written == file->blocks_queued) {
+            break; // Closing, and everything has been written
+        }
+        // The block stays ours until blocks_written moves past it
+        int block = file->blocks_written % AUDIO_FILE_QUEUE_LENGTH;
+        pthread_mutex_unlock(&file->lock);
+
+        // Samples go out as the host has them, which is little-endian anywhere this is going to run
+        long samples = file->block_samples[block];
+        if (fwrite(file->blocks[block], file->sample_size, samples, file->fp) != (size_t)samples) {
+            errx(EXIT_FAILURE, "Error writing audio: %s", strerror(errno));
+        }
+
+        pthread_mutex_lock(&file->lock);
+        file->samples_written += samples;
+        file->blocks_written++;
+        pthread_cond_broadcast(&file->cond);
+    }
+    pthread_mutex_unlock(&file->lock);
+    return NULL;
+}
+
+// Gives the block being filled to the worker
+static void queue_block(audio_file* file) {
+    pthread_mutex_lock(&file->lock);
+    file->block_samples[file->blocks_queued % AUDIO_FILE_QUEUE_LENGTH] = file->filling;
+    file->blocks_queued++;
+    pthread_cond_broadcast(&file->cond);
+    while (file->blocks_queued - file->blocks_written >= AUDIO_FILE_QUEUE_LENGTH) {
+        pthread_cond_wait(&file->cond, &file->lock);
+    }
+    pthread_mutex_unlock(&file->lock);
+    file->filling = 0;
+}
+
+static void file_push(audio_sink* sink, const void* samples, long count) {
+    audio_file* file = sink->file;
+    const byte* from = samples;
+    while (count > 0) {
+        // Only this thread moves blocks_queued, and the worker won't touch this block until it's queued
+        byte* block = file->blocks[file->blocks_queued % AUDIO_FILE_QUEUE_LENGTH];
+        long space = AUDIO_FILE_BLOCK_SAMPLES - file->filling;
+        long n = count < space ? count : space;
+        memcpy(block + file->filling * file->sample_size, from, n * file->sample_size);
+        file->filling += n;
+        from += n * file->sample_size;
+        count -= n;
+        if (file->filling == AUDIO_FILE_BLOCK_SAMPLES) {
+            queue_block(file);
+        }
+    }
+}
+
+static void file_close(audio_sink* sink) {
+    audio_file* file = sink->file;
+    if (file->filling > 0) {
+        queue_block(file);
+    }
+
+    pthread_mutex_lock(&file->lock);
+    file->closing = true;
+    pthread_cond_broadcast(&file->cond);
+    pthread_mutex_unlock(&file->lock);
+    pthread_join(file->thread, NULL);
+
+    // Now the length's known
+    if (file->format == AUDIO_FILE_WAV) {
+        if (fseek(file->fp, 0, SEEK_SET) == 0) {
+            write_wav_header(file, file->samples_written);
+        }
+    }
+    if (fclose(file->fp) != 0) {
+        errx(EXIT_FAILURE, "Error finishing audio file: %s", strerror(errno));
+    }
+
+    pthread_mutex_destroy(&file->lock);
+    pthread_cond_destroy(&file->cond);
+    free(file);
+    sink->file = NULL;
+}
+
+static const audio_sink_ops file_ops = {
+    .name = "file",
+    .push = file_push,
+    .close = file_close
+};
+
+void audio_open_file(audio_sink* sink, apu_memory* apu_mem, const char* path, audio_file_format format) {
+    audio_file* file = calloc(1, sizeof(audio_file));
+    if (file == NULL) {
+        errx(EXIT_FAILURE, "Unable to allocate audio file buffers");
+    }
+    file->fp = fopen(path, "wb");
+    if (file->fp == NULL) {
+        errx(EXIT_FAILURE, "Unable to open %s for audio: %s", path, strerror(errno));
+    }
+    file->format = format;
+    file->sample_format = apu_mem->sample_format;
+    file->sample_size = apu_sample_size(apu_mem->sample_format);
+    if (format == AUDIO_FILE_WAV) {
+        // Filled in properly on close
+        write_wav_header(file, 0);
+    }
+
+    pthread_mutex_init(&file->lock, NULL);
+    pthread_cond_init(&file->cond, NULL);
+    if (pthread_create(&file->thread, NULL, file_worker, file) != 0) {
+        errx(EXIT_FAILURE, "Unable to start audio writer thread");
+    }
+
+    attach(sink, apu_mem, &file_ops);
+    sink->file = file;
+}
+
+static bool ends_with(const char* str, const char* suffix) {
+    size_t str_len = strlen(str);
+    size_t suffix_len = strlen(suffix);
+    return str_len >= suffix_len && strcmp(str + str_len - suffix_len, suffix) == 0;
+}
+
+bool audio_open_by_name(audio_sink* sink, apu_memory* apu_mem, const char* name) {
+    if (strcmp(name, "portaudio") == 0) {
+        audio_open_portaudio(sink, apu_mem);
+    }
+    else if (strcmp(name, "none") == 0) {
+        audio_open_null(sink, apu_mem);
+    }
+    else if (ends_with(name, ".wav")) {
+        audio_open_file(sink, apu_mem, name, AUDIO_FILE_WAV);
+    }
+    else if (ends_with(name, ".raw")) {
+        audio_open_file(sink, apu_mem, name, AUDIO_FILE_RAW);
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+bool audio_set_sample_format(apu_memory* apu_mem, const char* name) {
+    if (strcmp(name, "float") == 0) {
+        apu_mem->sample_format = SAMPLE_FLOAT;
+    }
+    else if (strcmp(name, "int16") == 0) {
+        apu_mem->sample_format = SAMPLE_INT16;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdbool.h>
+
+#include "apu.h"
+
+// How many samples the APU collects before handing them to a sink that has them pushed
+#define AUDIO_PUSH_SAMPLES 1024
+
+struct audio_sink_ops_t;
+struct audio_file_t;
+
+typedef enum audio_file_format_t {
+    AUDIO_FILE_WAV, // Mono at AUDIO_SAMPLE_RATE, 32 bit float or 16 bit PCM, whichever the APU's making
+    AUDIO_FILE_RAW  // The same samples without a header
+} audio_file_format;
+
+/*
+ * Where the APU's samples go. PortAudio pulls them out of the APU's ring buffer as the sound device needs them, from
+ * a thread of its own. Everything else has them pushed from apu_step, AUDIO_PUSH_SAMPLES at a time, so they never
+ * touch the ring buffer's read index and frames are never held back waiting for them.
+ */
+typedef struct audio_sink_t {
+    const struct audio_sink_ops_t* ops;
+    apu_memory* apu_mem;
+    long pushed; // How far through the APU's samples it's been given
+    void* stream; // PortAudio
+    struct audio_file_t* file; // File
+    float last_f32; // PortAudio: the last sample played, to keep playing if the APU falls behind
+    int16_t last_int16;
+} audio_sink;
+
+typedef struct audio_sink_ops_t {
+    const char* name;
+    // count samples in the APU's sample format. NULL for sinks that read the ring buffer themselves.
+    void (*push)(audio_sink* sink, const void* samples, long count);
+    void (*close)(audio_sink* sink);
+} audio_sink_ops;
+
+// Throws everything away, for headless runs that don't care about sound
+void audio_open_null(audio_sink* sink, apu_memory* apu_mem);
+// The default sound device. Without one, it warns and carries on as a null sink.
+void audio_open_portaudio(audio_sink* sink, apu_memory* apu_mem);
+// Writes every sample to path. The writing's done on a thread of its own, through a big buffer, so the emulator only
+// waits on it if the disk can't keep up.
+void audio_open_file(audio_sink* sink, apu_memory* apu_mem, const char* path, audio_file_format format);
+// "portaudio", "none", or a path ending in .wav or .raw. False if it's none of those.
+bool audio_open_by_name(audio_sink* sink, apu_memory* apu_mem, const char* name);
+// "float" or "int16", for what the APU makes from now on. False if it's neither.
+bool audio_set_sample_format(apu_memory* apu_mem, const char* name);
+// Hands over everything the APU's made since the last push. apu_step does this on its own.
+void audio_push(audio_sink* sink);
+// Pushes whatever's left, waits for it all to be written, and disconnects the sink from the APU
+void audio_close(audio_sink* sink);
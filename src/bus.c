@@ -0,0 +1,65 @@
+#include <err.h>
+#include <stdlib.h>
+
+#include "bus.h"
+
+static byte flat_read(memory* mem, uint16_t address) {
+    return ((byte*)mem->bus_context)[address];
+}
+
+static void flat_write(memory* mem, uint16_t address, byte value) {
+    ((byte*)mem->bus_context)[address] = value;
+}
+
+const cpu_bus flat_bus = {
+    .read = flat_read,
+    .write = flat_write
+};
+
+// The access being traced has already been counted, along with the cycles before it in the instruction
+static long access_cycle(memory* mem) {
+    return mem->total_cycles + mem->bus_cycles + mem->bus_pending - 1;
+}
+
+// The bus underneath gets its own context back for as long as it's being used
+static byte tracing_read(memory* mem, uint16_t address) {
+    bus_trace* trace = mem->bus_context;
+    mem->bus_context = trace->bus_context;
+    byte value = trace->bus->read(mem, address);
+    mem->bus_context = trace;
+    fprintf(trace->out, "%10ld R $%04X = $%02X\n", access_cycle(mem), address, value);
+    return value;
+}
+
+static void tracing_write(memory* mem, uint16_t address, byte value) {
+    bus_trace* trace = mem->bus_context;
+    fprintf(trace->out, "%10ld W $%04X = $%02X\n", access_cycle(mem), address, value);
+    mem->bus_context = trace->bus_context;
+    trace->bus->write(mem, address, value);
+    mem->bus_context = trace;
+}
+
+const cpu_bus tracing_bus = {
+    .read = tracing_read,
+    .write = tracing_write
+};
+
+void start_bus_trace(memory* mem, bus_trace* trace, FILE* out) {
+    if (mem->bus == &tracing_bus) {
+        errx(EXIT_FAILURE, "The CPU's bus is already being traced");
+    }
+    trace->bus = mem->bus;
+    trace->bus_context = mem->bus_context;
+    trace->out = out;
+    mem->bus = &tracing_bus;
+    mem->bus_context = trace;
+}
+
+void stop_bus_trace(memory* mem) {
+    if (mem->bus != &tracing_bus) {
+        return;
+    }
+    bus_trace* trace = mem->bus_context;
+    mem->bus = trace->bus;
+    mem->bus_context = trace->bus_context;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <stdio.h>
+
+#include "mem.h"
+
+#define FLAT_BUS_BYTES 0x10000
+
+// 64KB of RAM and nothing else, for running the CPU on its own in tests and benchmarks. The bus context is the RAM,
+// FLAT_BUS_BYTES of it.
+extern const cpu_bus flat_bus;
+
+// Passes everything through to another bus, printing each access and the CPU cycle it lands on along the way. The bus
+// context is a bus_trace.
+extern const cpu_bus tracing_bus;
+
+typedef struct bus_trace_t {
+    const cpu_bus* bus;
+    void* bus_context;
+    FILE* out;
+} bus_trace;
+
+// Starts printing every CPU access to out, in front of whatever bus the CPU's on now. trace has to stay around until
+// it's stopped.
+void start_bus_trace(memory* mem, bus_trace* trace, FILE* out);
+void stop_bus_trace(memory* mem);
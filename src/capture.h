@@ -0,0 +1,14 @@
+#pragma once
+#include <stdbool.h>
+
+typedef enum capture_format_t {
+    CAPTURE_Y4M,     // YUV4MPEG2, 4:4:4
+    CAPTURE_RAW_RGB  // Headerless packed 24 bit RGB, one 256x240 frame after another
+} capture_format;
+
+// Start streaming frames to path, or to stdout if path is "-". When streaming to stdout, anything else the
+// emulator prints is sent to stderr instead so it doesn't end up in the video.
+void capture_open(const char* path, capture_format format);
+// Wait for every queued frame to be written, then close the output.
+void capture_close();
+long capture_frames_queued();
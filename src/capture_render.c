@@ -0,0 +1,163 @@
+#include <err.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "render.h"
+#include "capture.h"
+#include "frame.h"
+
+#define CAPTURE_QUEUE_LENGTH 8
+#define CAPTURE_FILE_BUFFER_SIZE (1 << 20)
+#define FRAME_PIXELS (FRAME_WIDTH * FRAME_HEIGHT)
+
+// Frames are copied into this ring by the emulation thread and converted and written out by the worker.
+// The emulator only blocks if the worker falls a whole queue behind, frames are never dropped.
+byte capture_queue[CAPTURE_QUEUE_LENGTH][FRAME_HEIGHT][FRAME_WIDTH];
+long frames_queued = 0;
+long frames_written = 0;
+bool capture_closing = false;
+bool capture_running = false;
+
+pthread_mutex_t capture_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t capture_cond = PTHREAD_COND_INITIALIZER;
+pthread_t capture_thread;
+
+FILE* capture_fp = NULL;
+capture_format current_format;
+
+void write_or_die(const void* data, size_t size) {
+    if (fwrite(data, size, 1, capture_fp) != 1) {
+        errx(EXIT_FAILURE, "Error writing captured frame: %s", strerror(errno));
+    }
+}
+
+void write_frame(byte (*screen)[FRAME_HEIGHT][FRAME_WIDTH]) {
+    static uint32_t rgba[FRAME_PIXELS];
+    static byte planes[3][FRAME_PIXELS];
+
+    frame_to_rgba(&(*screen)[0][0], rgba, FRAME_PIXELS, PIXEL_RGBA);
+
+    switch (current_format) {
+        case CAPTURE_Y4M:
+            frame_rgba_to_yuv444(rgba, FRAME_PIXELS, planes[0], planes[1], planes[2]);
+            write_or_die("FRAME\n", 6);
+            write_or_die(planes, sizeof(planes));
+            break;
+        case CAPTURE_RAW_RGB:
+            frame_rgba_to_rgb24(rgba, FRAME_PIXELS, planes[0]);
+            write_or_die(planes, FRAME_PIXELS * 3);
+            break;
+    }
+}
+
+void* capture_worker(void* arg) {
+    pthread_mutex_lock(&capture_lock);
+    while (true) {
+        while (frames_written == frames_queued && !capture_closing) {
+            pthread_cond_wait(&capture_cond, &capture_lock);
+        }
+        if (frames_written == frames_queued) {
+            break; // Closing, and everything has been written
+        }
+        // The slot stays ours until frames_written moves past it, so it's safe to work on without the lock
+        byte (*screen)[FRAME_HEIGHT][FRAME_WIDTH] = &capture_queue[frames_written % CAPTURE_QUEUE_LENGTH];
+        pthread_mutex_unlock(&capture_lock);
+
+        write_frame(screen);
+
+        pthread_mutex_lock(&capture_lock);
+        frames_written++;
+        pthread_cond_broadcast(&capture_cond);
+    }
+    pthread_mutex_unlock(&capture_lock);
+    return NULL;
+}
+
+void capture_open(const char* path, capture_format format) {
+    if (capture_running) {
+        errx(EXIT_FAILURE, "Capture is already running");
+    }
+
+    if (strcmp(path, "-") == 0) {
+        // Keep stdout for the video, and point everything that printf()s at stderr
+        int video_fd = dup(STDOUT_FILENO);
+        fflush(stdout);
+        if (video_fd < 0 || dup2(STDERR_FILENO, STDOUT_FILENO) < 0) {
+            errx(EXIT_FAILURE, "Unable to redirect stdout for capture: %s", strerror(errno));
+        }
+        capture_fp = fdopen(video_fd, "wb");
+    }
+    else {
+        capture_fp = fopen(path, "wb");
+    }
+
+    if (capture_fp == NULL) {
+        errx(EXIT_FAILURE, "Unable to open %s for capture: %s", path, strerror(errno));
+    }
+    setvbuf(capture_fp, NULL, _IOFBF, CAPTURE_FILE_BUFFER_SIZE);
+
+    current_format = format;
+    if (format == CAPTURE_Y4M) {
+        // NTSC NES: ~60.0988 frames per second, 8:7 pixels
+        fprintf(capture_fp, "YUV4MPEG2 W%d H%d F39375000:655171 Ip A8:7 C444\n", FRAME_WIDTH, FRAME_HEIGHT);
+    }
+
+    frames_queued = 0;
+    frames_written = 0;
+    capture_closing = false;
+    if (pthread_create(&capture_thread, NULL, capture_worker, NULL) != 0) {
+        errx(EXIT_FAILURE, "Unable to start capture thread");
+    }
+    capture_running = true;
+}
+
+void capture_close() {
+    if (!capture_running) {
+        return;
+    }
+
+    pthread_mutex_lock(&capture_lock);
+    capture_closing = true;
+    pthread_cond_broadcast(&capture_cond);
+    pthread_mutex_unlock(&capture_lock);
+
+    pthread_join(capture_thread, NULL);
+    capture_running = false;
+
+    if (fclose(capture_fp) != 0) {
+        errx(EXIT_FAILURE, "Error finishing capture: %s", strerror(errno));
+    }
+    capture_fp = NULL;
+}
+
+long capture_frames_queued() {
+    return frames_queued;
+}
+
+void render_screen(byte (*screen)[FRAME_HEIGHT][FRAME_WIDTH]) {
+    if (!capture_running) {
+        return;
+    }
+
+    pthread_mutex_lock(&capture_lock);
+    while (frames_queued - frames_written >= CAPTURE_QUEUE_LENGTH) {
+        pthread_cond_wait(&capture_cond, &capture_lock);
+    }
+    pthread_mutex_unlock(&capture_lock);
+
+    // Only this thread moves frames_queued, and the worker won't touch this slot until it's queued
+    memcpy(capture_queue[frames_queued % CAPTURE_QUEUE_LENGTH], screen, sizeof(*screen));
+
+    pthread_mutex_lock(&capture_lock);
+    frames_queued++;
+    pthread_cond_broadcast(&capture_cond);
+    pthread_mutex_unlock(&capture_lock);
+}
+
+void poll_input(input_snapshot* input) {
+    // Nobody's playing
+}
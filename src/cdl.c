@@ -0,0 +1,83 @@
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cdl.h"
+
+// The log that's saved at exit. There's only ever the one ROM running.
+rom* open_cdl_rom = NULL;
+char* open_cdl_path = NULL;
+
+void cdl_start(rom* r) {
+    cdl_stop(r);
+    // One spare at the end of each for the sink
+    r->cdl_prg = calloc(r->prg_rom_size + 1, 1);
+    if (!r->chr_ram && r->chr_rom_size > 0) {
+        r->cdl_chr = calloc(r->chr_rom_size + 1, 1);
+    }
+}
+
+void cdl_stop(rom* r) {
+    free(r->cdl_prg);
+    free(r->cdl_chr);
+    r->cdl_prg = NULL;
+    r->cdl_chr = NULL;
+}
+
+static size_t chr_log_bytes(rom* r) {
+    return r->cdl_chr != NULL ? r->chr_rom_size : 0;
+}
+
+bool cdl_read(rom* r, FILE* f) {
+    size_t prg_bytes = r->prg_rom_size;
+    size_t chr_bytes = chr_log_bytes(r);
+    byte* log = malloc(prg_bytes + chr_bytes + 1);
+    // One more than there should be, to catch a log that's too long
+    size_t read = fread(log, 1, prg_bytes + chr_bytes + 1, f);
+    if (read != prg_bytes + chr_bytes) {
+        free(log);
+        return false;
+    }
+    for (size_t i = 0; i < prg_bytes; i++) {
+        r->cdl_prg[i] |= log[i];
+    }
+    for (size_t i = 0; i < chr_bytes; i++) {
+        r->cdl_chr[i] |= log[prg_bytes + i];
+    }
+    free(log);
+    return true;
+}
+
+void cdl_write(rom* r, FILE* f) {
+    fwrite(r->cdl_prg, 1, r->prg_rom_size, f);
+    if (r->cdl_chr != NULL) {
+        fwrite(r->cdl_chr, 1, r->chr_rom_size, f);
+    }
+}
+
+void save_open_cdl() {
+    FILE* f = fopen(open_cdl_path, "wb");
+    if (f == NULL) {
+        warn("Couldn't save the code/data log to %s", open_cdl_path);
+        return;
+    }
+    cdl_write(open_cdl_rom, f);
+    fclose(f);
+}
+
+void cdl_open(rom* r, const char* filename) {
+    if (open_cdl_rom != NULL) {
+        errx(EXIT_FAILURE, "Only one code/data log can be open at a time");
+    }
+    cdl_start(r);
+    FILE* f = fopen(filename, "rb");
+    if (f != NULL) {
+        if (!cdl_read(r, f)) {
+            errx(EXIT_FAILURE, "%s isn't a code/data log for this ROM", filename);
+        }
+        fclose(f);
+    }
+    open_cdl_rom = r;
+    open_cdl_path = strdup(filename);
+    atexit(save_open_cdl);
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "util.h"
+#include "mapper/rom.h"
+
+/*
+ * Code/data logging, for finding out what a run actually touched. Every read of PRG ROM or CHR ROM ORs a flag into
+ * the byte's entry in the log, keyed by where it is in the ROM rather than where it's mapped, so it doesn't matter how
+ * the mapper's banked things. The log's written in the same format as FCEUX's .cdl files: one byte per byte of PRG
+ * ROM, followed by one per byte of CHR ROM.
+ */
+
+// PRG
+#define CDL_CODE   0x01
+#define CDL_DATA   0x02
+// Bits 2-3 are which 8KB of 0x8000-0xFFFF the byte was read through
+#define CDL_PCM    0x40 // Played by the DMC
+#define CDL_OPCODE 0x80 // First byte of an instruction. FCEUX doesn't use this bit.
+
+// CHR
+#define CDL_CHR_RENDERED 0x01
+#define CDL_CHR_READ     0x02 // Read by the CPU, through 0x2007
+
+// The spare entries past the end of each log, where reads of anything that isn't ROM end up. Having somewhere for
+// them to go means logging's just an OR, whatever was read.
+static inline size_t cdl_prg_sink(rom* r) {
+    return r->prg_rom_size;
+}
+
+static inline size_t cdl_chr_sink(rom* r) {
+    return r->chr_rom_size;
+}
+
+// Starts logging, with an empty log. Carts with CHR RAM only get a PRG log.
+void cdl_start(rom* r);
+void cdl_stop(rom* r);
+// The log's the same for every run of the same ROM, so this merges an earlier one in. False if it's not for this ROM.
+bool cdl_read(rom* r, FILE* f);
+void cdl_write(rom* r, FILE* f);
+// Starts logging, picking up from filename if it's already there, and saves it back there on exit
+void cdl_open(rom* r, const char* filename);
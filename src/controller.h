@@ -1,10 +1,16 @@
 #pragma once
+#include <stdbool.h>
+#include "util.h"
 
 typedef enum player_t {
     one,
-    two
+    two,
+    three, // Three and four only with a Four Score plugged in
+    four
 } player;
 
+#define NUM_PLAYERS 4
+
 typedef enum button_t {
     A,
     B,
@@ -15,3 +21,23 @@ typedef enum button_t {
     LEFT,
     RIGHT
 } button;
+
+#define NUM_BUTTONS 8
+
+/*
+ * Everything the player's doing, taken once a frame by the frontend. The input devices only ever look at this, so a
+ * game polling the controller a hundred times a frame doesn't mean a hundred trips to SDL, and what it sees can't
+ * change under it halfway through a frame.
+ */
+typedef struct input_snapshot_t {
+    bool buttons[NUM_PLAYERS][NUM_BUTTONS];
+
+    // Where the Zapper's pointed, in screen pixels. Negative when it's pointed off the screen.
+    int pointer_x;
+    int pointer_y;
+    bool trigger;
+
+    // Arkanoid knob, 0 turned all the way left to 255 all the way right
+    byte paddle;
+    bool paddle_button;
+} input_snapshot;
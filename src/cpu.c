@@ -6,6 +6,7 @@
 #include "debugger.h"
 #include "util.h"
 #include "opcode_names.h"
+#include "cdl.h"
 
 const char* docs_prefix = "https://www.masswerk.at/6502/6502_instruction_set.html#";
 #define DOCS_PREFIX_LENGTH 55
@@ -13,23 +14,27 @@ const char* docs_prefix = "https://www.masswerk.at/6502/6502_instruction_set.htm
 #define NMI_PC_LOCATION 0xFFFA
 #define IRQ_PC_LOCATION 0xFFFE
 
-long total_cycles = 0;
-int stall_cycles = 0;
-
-void stall_cpu(int cycles) {
-    stall_cycles += cycles;
+void stall_cpu(memory* mem, int cycles) {
+    mem->stall_cycles += cycles;
 }
 
-long get_total_cpu_cycles() {
-    return total_cycles;
+long get_total_cpu_cycles(memory* mem) {
+    return mem->total_cycles;
 }
 
-byte read_byte_and_inc_pc(memory* mem) {
-    byte data = read_byte(mem, mem->pc);
+// Anything the CPU reads other than through here is data, as far as the code/data log's concerned
+static inline byte fetch_byte(memory* mem, byte cdl_access) {
+    mem->cdl_access = cdl_access;
+    byte data = cpu_read(mem, mem->pc);
+    mem->cdl_access = CDL_DATA;
     mem->pc++;
     return data;
 }
 
+byte read_byte_and_inc_pc(memory* mem) {
+    return fetch_byte(mem, CDL_CODE);
+}
+
 uint16_t read_address(memory* mem, uint16_t address) {
     uint16_t addr_upper = address & (uint16_t)0xFF00;
     byte     addr_lower = (byte)(address & 0x00FF) + (byte)1;
@@ -37,8 +42,8 @@ uint16_t read_address(memory* mem, uint16_t address) {
     uint16_t lower_byte_address = address;
     uint16_t upper_byte_address = addr_upper | addr_lower;
 
-    byte lower = read_byte(mem, lower_byte_address);
-    byte upper = read_byte(mem, upper_byte_address);
+    byte lower = cpu_read(mem, lower_byte_address);
+    byte upper = cpu_read(mem, upper_byte_address);
 
     return ((uint16_t)upper << 8) | lower;
 }
@@ -49,8 +54,21 @@ uint16_t read_address_and_inc_pc(memory* mem) {
     return (upper << 8) | lower;
 }
 
+// Indexing takes an extra cycle when it crosses a page, to fix up the high byte. Instructions that write always take
+// it, and pass NULL for cycles since it's already in their count.
+static inline void index_cycle(memory* mem, int* cycles, uint16_t addr, byte index) {
+    bool page_crossed = (0xFF & addr) > (0xFF & (addr + index));
+    if (cycles == NULL || page_crossed) {
+        cpu_idle(mem);
+    }
+    if (cycles != NULL) {
+        *cycles += page_crossed; // If page crossed, add a cycle
+    }
+}
+
 uint16_t indirect_x_address(memory* mem, int* cycles) {
     byte b = read_byte_and_inc_pc(mem);
+    cpu_idle(mem); // Adding x
     byte temp_addr = b + mem->x;
     uint16_t addr = read_address(mem, temp_addr);
     return addr;
@@ -61,9 +79,7 @@ uint16_t indirect_y_address(memory* mem, int* cycles) {
     byte b = read_byte_and_inc_pc(mem);
     uint16_t addr = read_address(mem, b);
     dprintf("Ind Y: b: 0x%02X ind addr: 0x%04x y: 0x%02X\n", b, addr, mem->y);
-    if (cycles != NULL) {
-        *cycles += (0xFF & addr) > (0xFF & (addr + mem->y)); // If page crossed, add a cycle
-    }
+    index_cycle(mem, cycles, addr, mem->y);
     addr += mem->y;
 
     return addr;
@@ -71,28 +87,28 @@ uint16_t indirect_y_address(memory* mem, int* cycles) {
 
 uint16_t absolute_x_address(memory* mem, int* cycles) {
     uint16_t addr = read_address_and_inc_pc(mem);
-    if (cycles != NULL) {
-        *cycles += (0xFF & addr) > (0xFF & (addr + mem->x)); // If page crossed, add a cycle
-    }
+    index_cycle(mem, cycles, addr, mem->x);
     addr += mem->x;
     return addr;
 }
 
 uint16_t absolute_y_address(memory* mem, int* cycles) {
     uint16_t addr = read_address_and_inc_pc(mem);
-    if (cycles != NULL) {
-        *cycles += (0xFF & addr) > (0xFF & (addr + mem->y)); // If page crossed, add a cycle
-    }
+    index_cycle(mem, cycles, addr, mem->y);
     addr += mem->y;
     return addr;
 }
 
 uint16_t zeropage_x_address(memory* mem) {
-    return ((uint16_t)read_byte_and_inc_pc(mem) + (uint16_t)mem->x) & (uint16_t)0xFF;
+    uint16_t base = read_byte_and_inc_pc(mem);
+    cpu_idle(mem); // Adding x
+    return (base + (uint16_t)mem->x) & (uint16_t)0xFF;
 }
 
 uint16_t zeropage_y_address(memory* mem) {
-    return ((uint16_t)read_byte_and_inc_pc(mem) + (uint16_t)mem->y) & (uint16_t)0xFF;
+    uint16_t base = read_byte_and_inc_pc(mem);
+    cpu_idle(mem); // Adding y
+    return (base + (uint16_t)mem->y) & (uint16_t)0xFF;
 }
 
 byte read_value(memory* mem, int* cycles, addressing_mode mode) {
@@ -101,34 +117,34 @@ byte read_value(memory* mem, int* cycles, addressing_mode mode) {
             return read_byte_and_inc_pc(mem);
 
         case Absolute:
-            return read_byte(mem, read_address_and_inc_pc(mem));
+            return cpu_read(mem, read_address_and_inc_pc(mem));
 
         case Absolute_X: {
-            return read_byte(mem, absolute_x_address(mem, cycles));
+            return cpu_read(mem, absolute_x_address(mem, cycles));
         }
 
         case Absolute_Y: {
-            return read_byte(mem, absolute_y_address(mem, cycles));
+            return cpu_read(mem, absolute_y_address(mem, cycles));
         }
 
         case Indirect_X: {
-            return read_byte(mem, indirect_x_address(mem, cycles));
+            return cpu_read(mem, indirect_x_address(mem, cycles));
         }
 
         case Indirect_Y: {
-            return read_byte(mem, indirect_y_address(mem, cycles));
+            return cpu_read(mem, indirect_y_address(mem, cycles));
         }
 
         case Zeropage: {
-            return read_byte(mem, read_byte_and_inc_pc(mem));
+            return cpu_read(mem, read_byte_and_inc_pc(mem));
         }
 
         case Zeropage_X: {
-            return read_byte(mem, zeropage_x_address(mem));
+            return cpu_read(mem, zeropage_x_address(mem));
         }
 
         case Zeropage_Y: {
-            return read_byte(mem, zeropage_y_address(mem));
+            return cpu_read(mem, zeropage_y_address(mem));
         }
 
         default:
@@ -211,7 +227,7 @@ void cmp(memory* mem, byte reg, byte value) {
 }
 
 void php(memory* mem) {
-    byte temp_p = mem->p;
+    byte temp_p = get_p(mem);
     temp_p |= 0b00110000;
     stack_push(mem, temp_p);
 }
@@ -262,9 +278,7 @@ int interrupt_irq(memory* mem) {
     return 7;
 }
 
-interrupt_type interrupt = NONE;
-
-int interrupt_cpu_step(memory* mem) {
+int interrupt_cpu_step(memory* mem, interrupt_type interrupt) {
     debug_hook(INTERRUPT, mem);
     // Before doing the step, see if there was an interrupt triggered
     if (interrupt == nmi) {
@@ -278,34 +292,41 @@ int interrupt_cpu_step(memory* mem) {
 
 byte ror(memory* mem, uint16_t address) {
     bool oldc = (bool) get_p_carry(mem);
-    byte value = read_byte(mem, address);
+    byte value = cpu_read(mem, address);
     set_p_carry_to(mem, (bool) (value & 1));
     value = (byte) (((value >> 1) & 0b01111111) | ((byte)oldc << 7));
-    write_byte(mem, address, value);
+    cpu_idle(mem); // Writes the old value back first
+    cpu_write(mem, address, value);
     return value;
 }
 
 byte rol(memory* mem, uint16_t address) {
     bool oldc = (bool) get_p_carry(mem);
-    byte value = read_byte(mem, address);
+    byte value = cpu_read(mem, address);
     set_p_carry_to(mem, (value >> 7) & 1);
     value = (value << 1) | oldc;
     set_p_zn_on(mem, value);
-    write_byte(mem, address, value);
+    cpu_idle(mem); // Writes the old value back first
+    cpu_write(mem, address, value);
     return value;
 }
 
 int normal_cpu_step(memory* mem) {
     debug_hook(STEP, mem);
     uint16_t old_pc = mem->pc;
-    byte opcode = read_byte_and_inc_pc(mem);
+    byte opcode = fetch_byte(mem, CDL_CODE | CDL_OPCODE);
     int cycles = opcode_cycles[opcode];
 
     switch (opcode) {
         case BRK: {
-            // Set interrupt flag on status register
+            // Goes through the IRQ vector like an interrupt would, but the byte after it's skipped and B is set in
+            // what's pushed
+            cpu_idle(mem); // Reads that byte
+            mem->pc++;
+            stack_push16(mem, mem->pc);
+            php(mem);
             set_p_interrupt(mem);
-            mem->pc++; // Skip next byte
+            mem->pc = read_address(mem, IRQ_PC_LOCATION);
             break;
         }
 
@@ -321,21 +342,21 @@ int normal_cpu_step(memory* mem) {
         case STA_Absolute_Y:
         case STA_Indirect_X:
         case STA_Indirect_Y: {
-            write_byte(mem, address_for_opcode(mem, opcode, NULL), mem->a);
+            cpu_write(mem, address_for_opcode(mem, opcode, NULL), mem->a);
             break;
         }
 
         case STX_Absolute:
         case STX_Zeropage:
         case STX_Zeropage_Y: {
-            write_byte(mem, address_for_opcode(mem, opcode, NULL), mem->x);
+            cpu_write(mem, address_for_opcode(mem, opcode, NULL), mem->x);
             break;
         }
 
         case STY_Absolute:
         case STY_Zeropage:
         case STY_Zeropage_X: {
-            write_byte(mem, address_for_opcode(mem, opcode, NULL), mem->y);
+            cpu_write(mem, address_for_opcode(mem, opcode, NULL), mem->y);
             break;
         }
 
@@ -494,21 +515,27 @@ int normal_cpu_step(memory* mem) {
         }
 
         case JSR: {
-            uint16_t addr = read_address_and_inc_pc(mem);
-            stack_push16(mem, mem->pc - 1);
-            mem->pc = addr;
+            // The high byte of the address is read last, after pushing where it is
+            byte lower = read_byte_and_inc_pc(mem);
+            cpu_idle(mem); // Reads the stack
+            stack_push16(mem, mem->pc);
+            mem->pc = (read_byte_and_inc_pc(mem) << 8) | lower;
             break;
         }
 
         case RTS: {
-            mem->pc = stack_pop16(mem) + 1;
+            cpu_idle(mem); // Reads the next byte
+            cpu_idle(mem); // Reads the stack
+            mem->pc = stack_pop16(mem);
+            cpu_idle(mem); // Reads the byte before where it's returning to
+            mem->pc++;
             break;
         }
 
         case RTI: {
-            mem->p = stack_pop(mem);
-            mem->p &= 0b11101111;
-            mem->p |= 0b00100000;
+            cpu_idle(mem); // Reads the next byte
+            cpu_idle(mem); // Reads the stack
+            set_p(mem, (stack_pop(mem) & 0b11101111) | 0b00100000);
             mem->pc = stack_pop16(mem);
             break;
         }
@@ -541,10 +568,11 @@ int normal_cpu_step(memory* mem) {
         case INC_Absolute_X:
         case INC_Zeropage:
         case INC_Zeropage_X: {
-            uint16_t addr = address_for_opcode(mem, opcode, &cycles);
-            byte value = read_byte(mem, addr);
+            uint16_t addr = address_for_opcode(mem, opcode, NULL);
+            byte value = cpu_read(mem, addr);
             value++;
-            write_byte(mem, addr, value);
+            cpu_idle(mem); // Writes the old value back first
+            cpu_write(mem, addr, value);
             set_p_zn_on(mem, value);
             break;
         }
@@ -553,10 +581,11 @@ int normal_cpu_step(memory* mem) {
         case DEC_Absolute_X:
         case DEC_Zeropage:
         case DEC_Zeropage_X: {
-            uint16_t addr = address_for_opcode(mem, opcode, &cycles);
-            byte value = read_byte(mem, addr);
+            uint16_t addr = address_for_opcode(mem, opcode, NULL);
+            byte value = cpu_read(mem, addr);
             value--;
-            write_byte(mem, addr, value);
+            cpu_idle(mem); // Writes the old value back first
+            cpu_write(mem, addr, value);
             set_p_zn_on(mem, value);
             break;
         }
@@ -605,16 +634,20 @@ int normal_cpu_step(memory* mem) {
         }
 
         case PHP: {
+            cpu_idle(mem); // Reads the next byte
             php(mem);
             break;
         }
 
         case PHA: {
+            cpu_idle(mem); // Reads the next byte
             stack_push(mem, mem->a);
             break;
         }
 
         case PLA: {
+            cpu_idle(mem); // Reads the next byte
+            cpu_idle(mem); // Reads the stack
             mem->a = stack_pop(mem);
             set_p_zn_on(mem, mem->a);
             break;
@@ -632,12 +665,13 @@ int normal_cpu_step(memory* mem) {
         case LSR_Absolute_X:
         case LSR_Zeropage:
         case LSR_Zeropage_X: {
-            uint16_t addr = address_for_opcode(mem, opcode, &cycles);
-            byte value = read_byte(mem, addr);
+            uint16_t addr = address_for_opcode(mem, opcode, NULL);
+            byte value = cpu_read(mem, addr);
             set_p_carry_to(mem, (bool) (value & 1));
             value >>= 1;
             set_p_zn_on(mem, value);
-            write_byte(mem, addr, value);
+            cpu_idle(mem); // Writes the old value back first
+            cpu_write(mem, addr, value);
             break;
         }
 
@@ -653,7 +687,7 @@ int normal_cpu_step(memory* mem) {
         case ROL_Absolute_X:
         case ROL_Zeropage:
         case ROL_Zeropage_X: {
-            uint16_t address = address_for_opcode(mem, opcode, &cycles);
+            uint16_t address = address_for_opcode(mem, opcode, NULL);
             rol(mem, address);
             break;
         }
@@ -662,9 +696,8 @@ int normal_cpu_step(memory* mem) {
         case ROR_Absolute_X:
         case ROR_Zeropage:
         case ROR_Zeropage_X: {
-            uint16_t address = address_for_opcode(mem, opcode, &cycles);
-            ror(mem, address);
-            set_p_zn_on(mem, read_byte(mem, address));
+            uint16_t address = address_for_opcode(mem, opcode, NULL);
+            set_p_zn_on(mem, ror(mem, address));
             break;
         }
 
@@ -722,12 +755,13 @@ int normal_cpu_step(memory* mem) {
         case ASL_Absolute_X:
         case ASL_Zeropage:
         case ASL_Zeropage_X: {
-            uint16_t addr = address_for_opcode(mem, opcode, &cycles);
-            byte value = read_byte(mem, addr);
+            uint16_t addr = address_for_opcode(mem, opcode, NULL);
+            byte value = cpu_read(mem, addr);
             set_p_carry_to(mem, (value >> 7) & 1);
             value <<= 1;
             set_p_zn_on(mem, value);
-            write_byte(mem, addr, value);
+            cpu_idle(mem); // Writes the old value back first
+            cpu_write(mem, addr, value);
             break;
         }
 
@@ -744,9 +778,9 @@ int normal_cpu_step(memory* mem) {
         }
 
         case PLP: {
-            mem->p = stack_pop(mem);
-            mem->p &= 0b11101111;
-            mem->p |= 0b00100000;
+            cpu_idle(mem); // Reads the next byte
+            cpu_idle(mem); // Reads the stack
+            set_p(mem, (stack_pop(mem) & 0b11101111) | 0b00100000);
             break;
         }
 
@@ -823,7 +857,7 @@ int normal_cpu_step(memory* mem) {
         case 0x8F: {
             uint16_t addr = address_for_opcode(mem, opcode, NULL);
             byte value = mem->a & mem->x;
-            write_byte(mem, addr, value);
+            cpu_write(mem, addr, value);
             break;
         }
 
@@ -842,9 +876,10 @@ int normal_cpu_step(memory* mem) {
         case 0xC3:
         case 0xD3: {
             uint16_t addr = address_for_opcode(mem, opcode, NULL);
-            byte value = read_byte(mem, addr);
+            byte value = cpu_read(mem, addr);
             value -= 1;
-            write_byte(mem, addr, value);
+            cpu_idle(mem); // Writes the old value back first
+            cpu_write(mem, addr, value);
             cmp(mem, mem->a, value);
             break;
         }
@@ -858,9 +893,10 @@ int normal_cpu_step(memory* mem) {
         case 0xE3:
         case 0xF3: {
             uint16_t addr = address_for_opcode(mem, opcode, NULL);
-            byte value = read_byte(mem, addr);
+            byte value = cpu_read(mem, addr);
             value += 1;
-            write_byte(mem, addr, value);
+            cpu_idle(mem); // Writes the old value back first
+            cpu_write(mem, addr, value);
             sbc(mem, value);
             break;
         }
@@ -874,10 +910,11 @@ int normal_cpu_step(memory* mem) {
         case 0x03:
         case 0x13: {
             uint16_t addr = address_for_opcode(mem, opcode, NULL);
-            byte value = read_byte(mem, addr);
+            byte value = cpu_read(mem, addr);
             set_p_carry_to(mem, (value >> 7) & 1);
             value <<= 1;
-            write_byte(mem, addr, value);
+            cpu_idle(mem); // Writes the old value back first
+            cpu_write(mem, addr, value);
             mem->a |= value;
             set_p_zn_on(mem, mem->a);
             break;
@@ -906,10 +943,11 @@ int normal_cpu_step(memory* mem) {
         case 0x43:
         case 0x53: {
             uint16_t addr = address_for_opcode(mem, opcode, NULL);
-            byte value = read_byte(mem, addr);
+            byte value = cpu_read(mem, addr);
             set_p_carry_to(mem, (bool) (value & 1));
             value >>= 1;
-            write_byte(mem, addr, value);
+            cpu_idle(mem); // Writes the old value back first
+            cpu_write(mem, addr, value);
             mem->a ^= value;
             set_p_zn_on(mem, mem->a);
             break;
@@ -939,42 +977,26 @@ int normal_cpu_step(memory* mem) {
     return cycles;
 }
 
-void trigger_nmi() {
-    dprintf("!!! NMI TRIGGERED !!!\n");
-    interrupt = nmi;
-}
-
-void trigger_oam_dma(memory* mem, uint16_t address) {
-    byte oam_address = mem->ppu_mem.oam_address;
-    for (uint16_t i = 0; i <= 0xFF; i++) {
-        write_oam_byte(&mem->ppu_mem, read_byte(mem, address + i));
-    }
-
-    if (total_cycles % 2 == 1) {
-        stall_cpu(1);
-    }
-
-    stall_cpu(513);
-
-    mem->ppu_mem.oam_address = oam_address; // Should leave it intact
-}
-
 int cpu_step(memory* mem) {
     int cycles;
-    if (mem->r->mapperdata.irq_next_cycle) {
-        mem->r->mapperdata.irq_next_cycle = false;
-        interrupt = irq;
+    scheduler* s = &mem->scheduler;
+    if (mem->timing == TIMING_INSTRUCTION) {
+        // system_step does this too, but the CPU gets run on its own as well
+        mem->bus_pending = 0;
     }
-
-    if (interrupt != NONE) {
-        cycles = interrupt_cpu_step(mem);
-        interrupt = NONE;
+    if (s->nmi_pending) {
+        s->nmi_pending = false;
+        cycles = interrupt_cpu_step(mem, nmi);
+    }
+    else if (s->irq_line && !get_p_interrupt(mem)) {
+        // IRQ is level triggered, it keeps firing until whatever raised it is acknowledged
+        cycles = interrupt_cpu_step(mem, irq);
     }
     else {
         cycles = normal_cpu_step(mem);
     }
-    cycles += stall_cycles;
-    total_cycles += cycles;
-    stall_cycles = 0;
+    cycles += mem->stall_cycles;
+    mem->total_cycles += cycles;
+    mem->stall_cycles = 0;
     return cycles;
 }
@@ -14,10 +14,8 @@ uint16_t read_address(memory* mem, uint16_t address);
 int cpu_step(memory* mem);
 const char* opcode_to_name_full(byte opcode);
 const char* opcode_to_name_short(byte opcode);
-void trigger_nmi();
-void stall_cpu(int cycles);
-void trigger_oam_dma(memory* mem, uint16_t address);
-long get_total_cpu_cycles();
+void stall_cpu(memory* mem, int cycles);
+long get_total_cpu_cycles(memory* mem);
 
 typedef enum addressing_mode_t {
     Implied,
@@ -0,0 +1,66 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "bus.h"
+#include "cpu.h"
+#include "mem.h"
+
+#define DEFAULT_INSTRUCTIONS 100000000L
+#define NTSC_CPU_HZ 1789773.0
+
+// A loop of the sort of thing games spend their time on: indexed loads and stores, arithmetic, branches, a subroutine
+// and the stack
+static const byte program[] = {
+        0xA2, 0x00,       // 8000 LDX #$00
+        0xBD, 0x00, 0x02, // 8002 LDA $0200,X
+        0x18,             // 8005 CLC
+        0x69, 0x01,       // 8006 ADC #$01
+        0x9D, 0x00, 0x02, // 8008 STA $0200,X
+        0xE8,             // 800B INX
+        0xD0, 0xF4,       // 800C BNE $8002
+        0xE6, 0x10,       // 800E INC $10
+        0x20, 0x16, 0x80, // 8010 JSR $8016
+        0x4C, 0x00, 0x80, // 8013 JMP $8000
+        0xB1, 0x10,       // 8016 LDA ($10),Y
+        0x49, 0xFF,       // 8018 EOR #$FF
+        0x48,             // 801A PHA
+        0x68,             // 801B PLA
+        0x60,             // 801C RTS
+};
+
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char** argv) {
+    long instructions = argc > 1 ? atol(argv[1]) : DEFAULT_INSTRUCTIONS;
+    if (instructions <= 0) {
+        printf("cpubench: benchmark the CPU on its own, running from flat RAM\n");
+        printf("Usage: %s [instructions]\n", argv[0]);
+        return 2;
+    }
+
+    byte* ram = calloc(FLAT_BUS_BYTES, 1);
+    for (size_t i = 0; i < sizeof(program); i++) {
+        ram[0x8000 + i] = program[i];
+    }
+    ram[0xFFFC] = 0x00;
+    ram[0xFFFD] = 0x80;
+    memory* mem = get_cpu_memory(&flat_bus, ram);
+
+    double start = now_seconds();
+    for (long i = 0; i < instructions; i++) {
+        cpu_step(mem);
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("%ld instructions, %ld cycles in %.3f s\n", instructions, mem->total_cycles, elapsed);
+    printf("%8.2f ns/instruction %8.1f M instructions/s %8.1fx NTSC speed\n", elapsed / instructions * 1e9,
+           instructions / elapsed / 1e6, mem->total_cycles / elapsed / NTSC_CPU_HZ);
+
+    free(mem);
+    free(ram);
+}
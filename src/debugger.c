@@ -3,18 +3,63 @@
 #include <stdlib.h>
 #include <err.h>
 #include <string.h>
+#include <strings.h>
 
 #include "debugger.h"
 #include "mem.h"
 #include "set.h"
 #include "opcode_names.h"
 #include "cpu.h"
+#include "disassembler.h"
 
-bool debug = false;
+byte debug_hooks = 0;
+bool cpu_watchpoints_armed = false;
+bool ppu_watchpoints_armed = false;
 bool breakpoints_muted = false;
 int cpu_steps = 0;
-address_tree* breakpoints = NULL;
 
+address_set breakpoints;
+address_set conditional_breakpoints;
+address_set watchpoints[NUM_WATCH_TYPES];
+
+// What debug_hooks is made of
+#define HOOK_DEBUG_MODE  0b0001
+#define HOOK_BREAKPOINTS 0b0010
+#define HOOK_PENDING     0b0100
+#define HOOK_STEPPING    0b1000
+
+typedef enum debug_register_t {
+    REGISTER_A,
+    REGISTER_X,
+    REGISTER_Y,
+    REGISTER_SP,
+    REGISTER_P
+} debug_register;
+
+typedef enum condition_op_t {
+    CONDITION_EQUAL,
+    CONDITION_NOT_EQUAL,
+    CONDITION_LESS,
+    CONDITION_LESS_EQUAL,
+    CONDITION_GREATER,
+    CONDITION_GREATER_EQUAL
+} condition_op;
+
+typedef struct breakpoint_condition_t {
+    uint16_t address;
+    debug_register reg;
+    condition_op op;
+    byte value;
+} breakpoint_condition;
+
+#define MAX_BREAKPOINT_CONDITIONS 64
+breakpoint_condition conditions[MAX_BREAKPOINT_CONDITIONS];
+int num_conditions = 0;
+
+// A watchpoint that's gone off, to stop on before the next instruction
+debug_break pending_break;
+
+debug_break_handler break_handler = NULL;
 
 typedef enum debugger_state_value_t {
     RUNNING,
@@ -22,11 +67,156 @@ typedef enum debugger_state_value_t {
     STEPPING
 } debugger_state_value;
 
+debugger_state_value debugger_state = RUNNING;
+bool breakpoint_on_interrupt = false;
+
+void set_debug_hook_bit(byte bit, bool value) {
+    debug_hooks = (debug_hooks & ~bit) | (value ? bit : 0);
+}
+
+void update_breakpoints_armed() {
+    set_debug_hook_bit(HOOK_BREAKPOINTS, breakpoint_on_interrupt || !address_set_empty(&breakpoints)
+                                         || !address_set_empty(&conditional_breakpoints));
+    cpu_watchpoints_armed = !address_set_empty(&watchpoints[WATCH_CPU_READ])
+                            || !address_set_empty(&watchpoints[WATCH_CPU_WRITE]);
+    ppu_watchpoints_armed = !address_set_empty(&watchpoints[WATCH_PPU_READ])
+                            || !address_set_empty(&watchpoints[WATCH_PPU_WRITE]);
+}
+
 void set_breakpoint(uint16_t address) {
-    if (breakpoints == NULL) {
-        breakpoints = new_address_tree();
+    address_set_add(&breakpoints, address);
+    update_breakpoints_armed();
+}
+
+void clear_breakpoint(uint16_t address) {
+    address_set_remove(&breakpoints, address);
+    address_set_remove(&conditional_breakpoints, address);
+    int kept = 0;
+    for (int i = 0; i < num_conditions; i++) {
+        if (conditions[i].address != address) {
+            conditions[kept++] = conditions[i];
+        }
+    }
+    num_conditions = kept;
+    update_breakpoints_armed();
+}
+
+bool parse_register(const char** text, debug_register* reg) {
+    const char* names[] = {"a", "x", "y", "sp", "p"};
+    // sp before p, so the longer name's tried first
+    const debug_register order[] = {REGISTER_SP, REGISTER_A, REGISTER_X, REGISTER_Y, REGISTER_P};
+    for (int i = 0; i < 5; i++) {
+        const char* name = names[order[i]];
+        size_t length = strlen(name);
+        if (strncasecmp(*text, name, length) == 0) {
+            *reg = order[i];
+            *text += length;
+            return true;
+        }
     }
-    insert_to_address_tree(breakpoints, address);
+    return false;
+}
+
+bool parse_condition_op(const char** text, condition_op* op) {
+    // Two character ones first, so < isn't taken for the start of <=
+    const char* names[] = {"==", "!=", "<=", ">=", "<", ">"};
+    const condition_op ops[] = {CONDITION_EQUAL, CONDITION_NOT_EQUAL, CONDITION_LESS_EQUAL, CONDITION_GREATER_EQUAL,
+                                CONDITION_LESS, CONDITION_GREATER};
+    for (int i = 0; i < 6; i++) {
+        size_t length = strlen(names[i]);
+        if (strncmp(*text, names[i], length) == 0) {
+            *op = ops[i];
+            *text += length;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool set_conditional_breakpoint(uint16_t address, const char* condition) {
+    breakpoint_condition c;
+    c.address = address;
+    while (*condition == ' ') {
+        condition++;
+    }
+    if (!parse_register(&condition, &c.reg) || !parse_condition_op(&condition, &c.op)) {
+        return false;
+    }
+    char* end;
+    long value = strtol(condition, &end, 16);
+    if (end == condition || value < 0 || value > 0xFF || num_conditions == MAX_BREAKPOINT_CONDITIONS) {
+        return false;
+    }
+    c.value = value;
+    conditions[num_conditions++] = c;
+    address_set_add(&conditional_breakpoints, address);
+    update_breakpoints_armed();
+    return true;
+}
+
+void set_watchpoint(watch_type type, uint16_t address) {
+    address_set_add(&watchpoints[type], address);
+    update_breakpoints_armed();
+}
+
+void clear_watchpoint(watch_type type, uint16_t address) {
+    address_set_remove(&watchpoints[type], address);
+    update_breakpoints_armed();
+}
+
+void clear_all_breakpoints() {
+    address_set_clear(&breakpoints);
+    address_set_clear(&conditional_breakpoints);
+    for (int i = 0; i < NUM_WATCH_TYPES; i++) {
+        address_set_clear(&watchpoints[i]);
+    }
+    num_conditions = 0;
+    update_breakpoints_armed();
+}
+
+bool parse_address(const char* text, uint16_t* address, const char** end) {
+    char* parse_end;
+    long value = strtol(text, &parse_end, 16);
+    if (parse_end == text || value < 0 || value > 0xFFFF) {
+        return false;
+    }
+    *address = value;
+    if (end != NULL) {
+        *end = parse_end;
+    }
+    return true;
+}
+
+bool add_breakpoint_spec(const char* spec) {
+    const char* watch_names[] = {"read", "write", "ppuread", "ppuwrite"};
+    while (*spec == ' ') {
+        spec++;
+    }
+    for (int i = 0; i < NUM_WATCH_TYPES; i++) {
+        size_t length = strlen(watch_names[i]);
+        if (strncasecmp(spec, watch_names[i], length) == 0 && spec[length] == ' ') {
+            uint16_t address;
+            if (!parse_address(spec + length, &address, NULL)) {
+                return false;
+            }
+            set_watchpoint(i, address);
+            return true;
+        }
+    }
+
+    uint16_t address;
+    const char* condition;
+    if (!parse_address(spec, &address, &condition)) {
+        return false;
+    }
+    while (*condition == ' ') {
+        condition++;
+    }
+    if (*condition == '\0' || *condition == '\n' || *condition == '\r') {
+        set_breakpoint(address);
+        return true;
+    }
+    return set_conditional_breakpoint(address, condition);
 }
 
 void set_breakpoints_for_rom(char* filename) {
@@ -39,27 +229,113 @@ void set_breakpoints_for_rom(char* filename) {
 
     if (bpfp != NULL) {
         printf("Breakpoints file %s found, loading\n", bpfilename);
-        char buf[10];
-        while (fgets(buf, 10, bpfp) != NULL) {
-            uint16_t address = strtol(buf, NULL, 16);
-            printf("Setting breakpoint at 0x%04X\n", address);
-            set_breakpoint(address);
+        char buf[64];
+        while (fgets(buf, sizeof(buf), bpfp) != NULL) {
+            if (buf[0] == '\n' || buf[0] == '#') {
+                continue;
+            }
+            printf("Setting breakpoint %s", buf);
+            if (!add_breakpoint_spec(buf)) {
+                printf("WARNING: couldn't make sense of breakpoint %s", buf);
+            }
         }
+        fclose(bpfp);
     }
 }
 
-bool is_breakpoint(uint16_t address) {
-    if (breakpoints == NULL) {
-        breakpoints = new_address_tree();
+byte register_value(memory* mem, debug_register reg) {
+    switch (reg) {
+        case REGISTER_A:
+            return mem->a;
+        case REGISTER_X:
+            return mem->x;
+        case REGISTER_Y:
+            return mem->y;
+        case REGISTER_SP:
+            return mem->sp;
+        case REGISTER_P:
+            return get_p(mem);
+        default:
+            errx(EXIT_FAILURE, "Unknown register %d", reg);
     }
-    bool result = address_tree_contains(breakpoints, address);
+}
 
-    return result;
+bool condition_met(memory* mem, const breakpoint_condition* c) {
+    byte value = register_value(mem, c->reg);
+    switch (c->op) {
+        case CONDITION_EQUAL:
+            return value == c->value;
+        case CONDITION_NOT_EQUAL:
+            return value != c->value;
+        case CONDITION_LESS:
+            return value < c->value;
+        case CONDITION_LESS_EQUAL:
+            return value <= c->value;
+        case CONDITION_GREATER:
+            return value > c->value;
+        case CONDITION_GREATER_EQUAL:
+            return value >= c->value;
+        default:
+            errx(EXIT_FAILURE, "Unknown condition %d", c->op);
+    }
+}
+
+bool is_breakpoint(memory* mem) {
+    uint16_t address = mem->pc;
+    if (address_set_contains(&breakpoints, address)) {
+        return true;
+    }
+    if (!address_set_contains(&conditional_breakpoints, address)) {
+        return false;
+    }
+    for (int i = 0; i < num_conditions; i++) {
+        if (conditions[i].address == address && condition_met(mem, &conditions[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void watchpoint_hit(debug_break_reason reason, uint16_t address, byte value) {
+    // The first one an instruction sets off is the one that's reported
+    if (!(debug_hooks & HOOK_PENDING)) {
+        pending_break.reason = reason;
+        pending_break.address = address;
+        pending_break.value = value;
+        set_debug_hook_bit(HOOK_PENDING, true);
+    }
+}
+
+void cpu_watch(uint16_t address, byte value, bool write) {
+    if (address_set_contains(&watchpoints[write ? WATCH_CPU_WRITE : WATCH_CPU_READ], address)) {
+        watchpoint_hit(write ? BREAK_CPU_WRITE : BREAK_CPU_READ, address, value);
+    }
+}
+
+void ppu_watch(uint16_t address, byte value, bool write) {
+    address %= 0x4000;
+    if (address_set_contains(&watchpoints[write ? WATCH_PPU_WRITE : WATCH_PPU_READ], address)) {
+        watchpoint_hit(write ? BREAK_PPU_WRITE : BREAK_PPU_READ, address, value);
+    }
+}
+
+void set_debug_break_handler(debug_break_handler handler) {
+    break_handler = handler;
+}
+
+void debugger_pause() {
+    debugger_state = STEPPING;
+    set_debug_hook_bit(HOOK_STEPPING, true);
+}
+
+void debugger_resume() {
+    debugger_state = RUNNING;
+    set_debug_hook_bit(HOOK_STEPPING, false);
 }
 
-bool breakpoint_on_interrupt = false;
 void set_breakpoint_on_interrupt() {
     breakpoint_on_interrupt = true;
+    update_breakpoints_armed();
 }
 
 void set_debug() {
@@ -69,6 +345,7 @@ void set_debug() {
         printf("WARNING: status code of %d returned while attempting to disable waiting for enter in getchar(). The debugger might not work correctly.", result);
     }
     debug = true;
+    set_debug_hook_bit(HOOK_DEBUG_MODE, true);
 }
 
 void print_byte_binary(byte value) {
@@ -110,7 +387,7 @@ void print_status(memory* mem) {
     printf("p   : NVBDIZC\n"); 
     printf("    : %d%d%d", get_p_negative(mem), get_p_overflow(mem), get_p_break(mem));
     printf("%d%d%d%d", get_p_decimal(mem), get_p_interrupt(mem), get_p_zero(mem), get_p_carry(mem));
-    printf(" -- 0x%02X\n\n", mem->p);
+    printf(" -- 0x%02X\n\n", get_p(mem));
     printf("PPUCTRL  : VPHBSINN\n");
     printf("           ");
     dump_byte(ppu_mem->control);
@@ -174,7 +451,6 @@ void debugger_read_byte(memory* mem) {
     }
 }
 
-debugger_state_value debugger_state = RUNNING;
 void process_debugger_command(memory* mem, char command) {
     switch (command) {
         case 's':
@@ -214,54 +490,12 @@ char* disassemble(memory* mem, uint16_t addr) {
     const int buffer_size = 20;
     char* disassembly = malloc(buffer_size);
 
-    byte opcode = read_byte(mem, mem->pc);
-    //byte size = opcode_sizes[opcode];
-
-    int bytesused = snprintf(disassembly, 10, "%s", opcode_to_name_short(opcode));
-
-    switch (opcode_addressing_modes[opcode]) {
-        case Accumulator:
-            snprintf(disassembly + bytesused, buffer_size - bytesused, " A");
-            break;
-        case Absolute:
-            snprintf(disassembly + bytesused, buffer_size - bytesused, " $%04X", read_address(mem, mem->pc + 1));
-            break;
-        case Absolute_X:
-            snprintf(disassembly + bytesused, buffer_size - bytesused, " $%04X,X", read_address(mem, mem->pc + 1));
-            break;
-        case Absolute_Y:
-            snprintf(disassembly + bytesused, buffer_size - bytesused, " $%04X,Y", read_address(mem, mem->pc + 1));
-            break;
-        case Immediate:
-            snprintf(disassembly + bytesused, buffer_size - bytesused, " #%02X", read_byte(mem, mem->pc + 1));
-            break;
-        case Implied:
-            break; // No args, instruction is 1 byte
-        case Indirect:
-            snprintf(disassembly + bytesused, buffer_size - bytesused, " ($%04X)", read_address(mem, mem->pc + 1));
-            break;
-        case Indirect_X:
-            snprintf(disassembly + bytesused, buffer_size - bytesused, " ($%02X,X)", read_byte(mem, mem->pc + 1));
-            break;
-        case Indirect_Y:
-            snprintf(disassembly + bytesused, buffer_size - bytesused, " ($%02X),Y", read_byte(mem, mem->pc + 1));
-            break;
-        case Relative:
-            snprintf(disassembly + bytesused, buffer_size - bytesused, " $%02X", read_byte(mem, mem->pc + 1));
-            break;
-        case Zeropage:
-            snprintf(disassembly + bytesused, buffer_size - bytesused, " $%02X", read_byte(mem, mem->pc + 1));
-            break;
-        case Zeropage_X:
-            snprintf(disassembly + bytesused, buffer_size - bytesused, " $%02X,X", read_byte(mem, mem->pc + 1));
-            break;
-        case Zeropage_Y:
-            snprintf(disassembly + bytesused, buffer_size - bytesused, " $%02X,Y", read_byte(mem, mem->pc + 1));
-            break;
-        default:
-            errx(EXIT_FAILURE, "Unrecognized addressing mode %d for opcode %02X!", opcode_addressing_modes[opcode], opcode);
-            break;
+    byte bytes[3];
+    bytes[0] = read_byte(mem, addr);
+    for (int i = 1; i < instruction_size(bytes[0]); i++) {
+        bytes[i] = read_byte(mem, addr + i);
     }
+    format_instruction(disassembly, buffer_size, addr, bytes, false);
 
     return disassembly;
 }
@@ -272,23 +506,42 @@ void print_disassembly(memory* mem, uint16_t addr) {
     free(disassembly);
 }
 
-void debug_hook(debug_hook_type type, memory* mem) {
-    if (debug_mode()) {
+void stop(memory* mem, debug_break_reason reason, uint16_t address, byte value) {
+    if (break_handler != NULL) {
+        debug_break brk = {reason, address, value};
+        break_handler(mem, &brk);
+    }
+    else {
+        debugger_wait(mem);
+    }
+    // Keep coming back here while stepping, even with nothing else set
+    set_debug_hook_bit(HOOK_STEPPING, debugger_state != RUNNING);
+}
+
+void run_debug_hook(debug_hook_type type, memory* mem) {
+    if (debug) {
         print_status(mem);
-        if (type == INTERRUPT && breakpoint_on_interrupt) {
-            debugger_wait(mem);
-        }
-        else if (type == STEP) {
-            printf("\n\nSteps: %d\nCycles: %ld\n$%04x: Executing instruction ", cpu_steps++, get_total_cpu_cycles(), mem->pc);
-            print_disassembly(mem, mem->pc);
-            printf("\n");
-            if (is_breakpoint(mem->pc) || debugger_state == STEPPING || debugger_state == STOPPED) {
-                debugger_wait(mem);
-            }
+    }
+    if (type == INTERRUPT) {
+        if (breakpoint_on_interrupt) {
+            stop(mem, BREAK_INTERRUPT, mem->pc, 0);
         }
+        return;
     }
-}
 
-bool debug_mode() {
-    return debug;
+    if (debug) {
+        printf("\n\nSteps: %d\nCycles: %ld\n$%04x: Executing instruction ", cpu_steps++, get_total_cpu_cycles(mem), mem->pc);
+        print_disassembly(mem, mem->pc);
+        printf("\n");
+    }
+    if (debug_hooks & HOOK_PENDING) {
+        set_debug_hook_bit(HOOK_PENDING, false);
+        stop(mem, pending_break.reason, pending_break.address, pending_break.value);
+    }
+    else if (is_breakpoint(mem)) {
+        stop(mem, BREAK_BREAKPOINT, mem->pc, 0);
+    }
+    else if (debugger_state == STEPPING || debugger_state == STOPPED) {
+        stop(mem, BREAK_STEP, mem->pc, 0);
+    }
 }
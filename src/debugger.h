@@ -10,12 +10,83 @@ typedef enum debug_hook_type_t {
     INTERRUPT
 } debug_hook_type;
 
-bool debug_mode();
-void debug_hook(debug_hook_type type, memory* mem);
+// Why the debugger's stopped
+typedef enum debug_break_reason_t {
+    BREAK_STEP,
+    BREAK_BREAKPOINT,
+    BREAK_INTERRUPT,
+    BREAK_CPU_READ,
+    BREAK_CPU_WRITE,
+    BREAK_PPU_READ,
+    BREAK_PPU_WRITE
+} debug_break_reason;
+
+typedef struct debug_break_t {
+    debug_break_reason reason;
+    uint16_t address; // pc for breakpoints, otherwise what was read or written
+    byte value; // What was read or written
+} debug_break;
+
+typedef enum watch_type_t {
+    WATCH_CPU_READ,
+    WATCH_CPU_WRITE,
+    // PPU accesses through 0x2007. Rendering isn't watched.
+    WATCH_PPU_READ,
+    WATCH_PPU_WRITE,
+    NUM_WATCH_TYPES
+} watch_type;
+
+extern bool debug;
+// Non zero whenever the debugger needs to see every instruction: in debug mode, with breakpoints set, or with a
+// watchpoint that's gone off
+extern byte debug_hooks;
+extern bool ppu_watchpoints_armed;
+
+// These are checked on every instruction and every pixel, so they're inline and cost next to nothing when the
+// debugger's off
+static inline bool debug_mode() {
+    return debug;
+}
+
+void run_debug_hook(debug_hook_type type, memory* mem);
+
+static inline void debug_hook(debug_hook_type type, memory* mem) {
+    if (debug_hooks) {
+        run_debug_hook(type, mem);
+    }
+}
+
+void ppu_watch(uint16_t address, byte value, bool write);
+
+static inline void ppu_watch_access(uint16_t address, byte value, bool write) {
+    if (ppu_watchpoints_armed) {
+        ppu_watch(address, value, write);
+    }
+}
+
 void set_debug();
 void set_breakpoint(uint16_t address);
+// Removes conditional breakpoints at the address too
+void clear_breakpoint(uint16_t address);
+// Only stops when a register compares true, e.g. "a==3F", "x>=10" or "sp!=FD". Registers are a, x, y, sp and p,
+// values are hex. False if the condition doesn't parse.
+bool set_conditional_breakpoint(uint16_t address, const char* condition);
+void set_watchpoint(watch_type type, uint16_t address);
+void clear_watchpoint(watch_type type, uint16_t address);
+void clear_all_breakpoints();
+// One line of a .breakpoints file: an address with an optional condition, e.g. "C5F5" or "C5F5 a==00", or a
+// watchpoint, e.g. "read 2002", "write 4014", "ppuread 23C0" or "ppuwrite 3F00". False if it doesn't parse.
+bool add_breakpoint_spec(const char* spec);
 void set_breakpoints_for_rom(char* filename);
 void set_breakpoint_on_interrupt();
+// Called instead of the interactive debugger whenever something's hit, for running with breakpoints unattended. NULL
+// goes back to the interactive debugger.
+typedef void (*debug_break_handler)(memory* mem, const debug_break* brk);
+void set_debug_break_handler(debug_break_handler handler);
+// Stops before the next instruction, and every one after that until resumed. Safe to call from a break handler, which
+// is how a handler steps.
+void debugger_pause();
+void debugger_resume();
 void debugger_wait();
 char* disassemble(memory* mem, uint16_t addr);
 
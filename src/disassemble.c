@@ -1,21 +1,32 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <err.h>
 
 #include "mapper/rom.h"
-#include "mem.h"
-#include "debugger.h"
+#include "disassembler.h"
 
 int main(int argc, char** argv) {
-    if (argc != 2) {
-        printf("disassemble: disassemble PRG ROM of INES file\n");
-        printf("Usage: %s <rom.nes>\n", argv[0]);
+    if (argc != 2 && argc != 3) {
+        printf("disassemble: disassemble PRG ROM of INES file, following the code from the vectors\n");
+        printf("Usage: %s <rom.nes> [code bitmap file]\n", argv[0]);
         return 2;
     }
     rom* r = read_rom(argv[1]);
-    memory* mem = get_blank_memory(r);
 
-    char* disassembly = disassemble(mem, mem->pc);
+    prg_map map;
+    prg_map_init(&map, r);
+    prg_map_trace(&map);
+    prg_map_print(&map, stdout);
 
-    printf("%s", disassembly);
+    if (argc == 3) {
+        FILE* f = fopen(argv[2], "wb");
+        if (f == NULL) {
+            err(EXIT_FAILURE, "Couldn't open %s", argv[2]);
+        }
+        prg_map_write_bitmap(&map, f);
+        fclose(f);
+    }
 
-    free(disassembly);
+    prg_map_free(&map);
+    free_rom(r);
 }
@@ -0,0 +1,343 @@
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "disassembler.h"
+#include "cpu.h"
+#include "opcode_names.h"
+
+#define NMI_VECTOR 0xFFFA
+#define RESET_VECTOR 0xFFFC
+#define IRQ_VECTOR 0xFFFE
+
+// Paths still to be followed
+typedef struct prg_path_t {
+    int bank;
+    uint16_t address;
+} prg_path;
+
+typedef struct prg_worklist_t {
+    prg_path* paths;
+    int count;
+    int capacity;
+} prg_worklist;
+
+static void push_path(prg_worklist* list, int bank, uint16_t address) {
+    if (list->count == list->capacity) {
+        list->capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+        list->paths = realloc(list->paths, list->capacity * sizeof(prg_path));
+        if (list->paths == NULL) {
+            errx(EXIT_FAILURE, "Out of memory following code paths");
+        }
+    }
+    list->paths[list->count].bank = bank;
+    list->paths[list->count].address = address;
+    list->count++;
+}
+
+static int fixed_bank(const prg_map* map) {
+    return map->banks - 1;
+}
+
+// The lowest address the bank's seen at
+static int bank_base(const prg_map* map, int bank) {
+    if (bank == fixed_bank(map)) {
+        return 0x10000 - (int)map->bank_bytes;
+    }
+    return 0x10000 - 2 * (int)map->bank_bytes;
+}
+
+static bool in_window(const prg_map* map, int bank, int address) {
+    if (map->banks == 1) {
+        // Mirrored all the way down
+        return address >= 0x8000 && address <= 0xFFFF;
+    }
+    int base = bank_base(map, bank);
+    return address >= base && address < base + (int)map->bank_bytes;
+}
+
+static size_t prg_offset(const prg_map* map, int bank, uint16_t address) {
+    return bank * map->bank_bytes + (address - 0x8000) % map->bank_bytes;
+}
+
+// The banks that could be at address when it's reached from bank from. False if it isn't in PRG at all.
+static bool target_banks(const prg_map* map, int from, uint16_t address, int* first, int* last) {
+    if (address < 0x8000) {
+        return false;
+    }
+    if (map->banks == 1 || in_window(map, fixed_bank(map), address)) {
+        *first = *last = fixed_bank(map);
+    }
+    else if (from != fixed_bank(map)) {
+        // Staying in the switched window, so it's whatever bank's already there
+        *first = *last = from;
+    }
+    else {
+        // No telling which bank's been switched in
+        *first = 0;
+        *last = fixed_bank(map) - 1;
+    }
+    return true;
+}
+
+static void push_target(prg_map* map, prg_worklist* list, int from, uint16_t address, bool label) {
+    int first, last;
+    if (!target_banks(map, from, address, &first, &last)) {
+        return;
+    }
+    for (int bank = first; bank <= last; bank++) {
+        size_t offset = prg_offset(map, bank, address);
+        if (offset >= map->size) {
+            continue;
+        }
+        if (label) {
+            map->flags[offset] |= PRG_LABEL;
+        }
+        push_path(list, bank, address);
+    }
+}
+
+static bool is_instruction(byte opcode) {
+    return strcmp(opcode_to_name_short(opcode), "INVALID") != 0;
+}
+
+int instruction_size(byte opcode) {
+    switch (opcode_addressing_modes[opcode]) {
+        case Implied:
+        case Accumulator:
+            return 1;
+        case Absolute:
+        case Absolute_X:
+        case Absolute_Y:
+        case Indirect:
+            return 3;
+        default:
+            return 2;
+    }
+}
+
+// Follows one path until it ends, runs into code that's already been found, or into something that isn't code
+static void follow_path(prg_map* map, prg_worklist* list, int bank, uint16_t address) {
+    while (true) {
+        if (!in_window(map, bank, address)) {
+            // Ran off the end of the bank into the next window
+            push_target(map, list, bank, address, false);
+            return;
+        }
+        size_t offset = prg_offset(map, bank, address);
+        if (offset >= map->size || (map->flags[offset] & PRG_CODE) != 0) {
+            return;
+        }
+        byte opcode = map->prg[offset];
+        if (!is_instruction(opcode)) {
+            return;
+        }
+        int size = instruction_size(opcode);
+        if (!in_window(map, bank, address + size - 1) || offset + size > map->size) {
+            return;
+        }
+        for (int i = 1; i < size; i++) {
+            if ((map->flags[offset + i] & PRG_CODE) != 0) {
+                // Overlaps an instruction that's already been found, so one of them's wrong. Trust the first.
+                return;
+            }
+        }
+
+        map->flags[offset] |= PRG_OPCODE;
+        for (int i = 1; i < size; i++) {
+            map->flags[offset + i] |= PRG_OPERAND;
+        }
+
+        const byte* bytes = &map->prg[offset];
+        uint16_t operand = size == 3 ? bytes[1] | (bytes[2] << 8) : bytes[1];
+        switch (opcode) {
+            case JSR:
+                push_target(map, list, bank, operand, true);
+                break;
+            case JMP_Absolute:
+                push_target(map, list, bank, operand, true);
+                return;
+            case JMP_Indirect:
+            case RTS:
+            case RTI:
+            case BRK:
+                return;
+            default:
+                if (opcode_addressing_modes[opcode] == Relative) {
+                    push_target(map, list, bank, address + 2 + (int8_t)bytes[1], true);
+                }
+                break;
+        }
+        address += size;
+    }
+}
+
+static void follow_all(prg_map* map, prg_worklist* list) {
+    while (list->count > 0) {
+        prg_path path = list->paths[--list->count];
+        follow_path(map, list, path.bank, path.address);
+    }
+    free(list->paths);
+}
+
+static uint16_t read_vector(const prg_map* map, uint16_t address) {
+    size_t offset = prg_offset(map, fixed_bank(map), address);
+    if (offset + 1 >= map->size) {
+        return 0;
+    }
+    return map->prg[offset] | (map->prg[offset + 1] << 8);
+}
+
+void prg_map_init(prg_map* map, rom* r) {
+    map->prg = r->prg_rom;
+    map->size = get_prg_rom_bytes(r);
+    if (map->size == 0) {
+        errx(EXIT_FAILURE, "prg_map_init: ROM has no PRG");
+    }
+    map->bank_bytes = map->size < PRG_MAP_BANK_BYTES ? map->size : PRG_MAP_BANK_BYTES;
+    map->banks = (int)((map->size + map->bank_bytes - 1) / map->bank_bytes);
+    map->flags = calloc(map->size, 1);
+    map->nmi = read_vector(map, NMI_VECTOR);
+    map->reset = read_vector(map, RESET_VECTOR);
+    map->irq = read_vector(map, IRQ_VECTOR);
+}
+
+void prg_map_free(prg_map* map) {
+    free(map->flags);
+    map->flags = NULL;
+}
+
+void prg_map_trace(prg_map* map) {
+    prg_worklist list = {0};
+    push_target(map, &list, fixed_bank(map), map->nmi, false);
+    push_target(map, &list, fixed_bank(map), map->reset, false);
+    push_target(map, &list, fixed_bank(map), map->irq, false);
+    follow_all(map, &list);
+}
+
+void prg_map_trace_from(prg_map* map, uint16_t address) {
+    prg_worklist list = {0};
+    push_target(map, &list, fixed_bank(map), address, true);
+    follow_all(map, &list);
+}
+
+void prg_map_write_bitmap(const prg_map* map, FILE* f) {
+    byte bits = 0;
+    for (size_t offset = 0; offset < map->size; offset++) {
+        bits |= prg_map_is_code(map, offset) << (offset % 8);
+        if (offset % 8 == 7 || offset == map->size - 1) {
+            fputc(bits, f);
+            bits = 0;
+        }
+    }
+}
+
+void format_instruction(char* out, size_t size, uint16_t address, const byte* bytes, bool labels) {
+    byte opcode = bytes[0];
+    const char* name = opcode_to_name_short(opcode);
+    const char* target = labels ? "L" : "$";
+    switch (opcode_addressing_modes[opcode]) {
+        case Accumulator:
+            snprintf(out, size, "%s A", name);
+            break;
+        case Absolute:
+            if (opcode == JSR || opcode == JMP_Absolute) {
+                snprintf(out, size, "%s %s%04X", name, target, bytes[1] | (bytes[2] << 8));
+            }
+            else {
+                snprintf(out, size, "%s $%04X", name, bytes[1] | (bytes[2] << 8));
+            }
+            break;
+        case Absolute_X:
+            snprintf(out, size, "%s $%04X,X", name, bytes[1] | (bytes[2] << 8));
+            break;
+        case Absolute_Y:
+            snprintf(out, size, "%s $%04X,Y", name, bytes[1] | (bytes[2] << 8));
+            break;
+        case Immediate:
+            snprintf(out, size, "%s #$%02X", name, bytes[1]);
+            break;
+        case Implied:
+            snprintf(out, size, "%s", name);
+            break;
+        case Indirect:
+            snprintf(out, size, "%s ($%04X)", name, bytes[1] | (bytes[2] << 8));
+            break;
+        case Indirect_X:
+            snprintf(out, size, "%s ($%02X,X)", name, bytes[1]);
+            break;
+        case Indirect_Y:
+            snprintf(out, size, "%s ($%02X),Y", name, bytes[1]);
+            break;
+        case Relative:
+            snprintf(out, size, "%s %s%04X", name, target, (uint16_t)(address + 2 + (int8_t)bytes[1]));
+            break;
+        case Zeropage:
+            snprintf(out, size, "%s $%02X", name, bytes[1]);
+            break;
+        case Zeropage_X:
+            snprintf(out, size, "%s $%02X,X", name, bytes[1]);
+            break;
+        case Zeropage_Y:
+            snprintf(out, size, "%s $%02X,Y", name, bytes[1]);
+            break;
+        default:
+            errx(EXIT_FAILURE, "Unrecognized addressing mode %d for opcode %02X!", opcode_addressing_modes[opcode], opcode);
+    }
+}
+
+static void print_labels(const prg_map* map, int bank, uint16_t address, byte flags, FILE* f) {
+    if (bank == fixed_bank(map)) {
+        if (address == map->nmi) {
+            fprintf(f, "NMI:\n");
+        }
+        if (address == map->reset) {
+            fprintf(f, "RESET:\n");
+        }
+        if (address == map->irq) {
+            fprintf(f, "IRQ:\n");
+        }
+    }
+    if (flags & PRG_LABEL) {
+        fprintf(f, "L%04X:\n", address);
+    }
+}
+
+void prg_map_print(const prg_map* map, FILE* f) {
+    size_t code_bytes = 0;
+    for (int bank = 0; bank < map->banks; bank++) {
+        int base = bank_base(map, bank);
+        size_t start = bank * map->bank_bytes;
+        size_t end = start + map->bank_bytes < map->size ? start + map->bank_bytes : map->size;
+        fprintf(f, "; Bank %d at $%04X\n", bank, base);
+
+        size_t offset = start;
+        while (offset < end) {
+            uint16_t address = base + (offset - start);
+            byte flags = map->flags[offset];
+            if (flags & PRG_OPCODE) {
+                const byte* bytes = &map->prg[offset];
+                int size = instruction_size(bytes[0]);
+                char hex[10] = "";
+                for (int i = 0; i < size; i++) {
+                    snprintf(hex + i * 3, sizeof(hex) - i * 3, "%02X ", bytes[i]);
+                }
+                char text[20];
+                format_instruction(text, sizeof(text), address, bytes, true);
+                print_labels(map, bank, address, flags, f);
+                fprintf(f, "    %04X  %-9s %s\n", address, hex, text);
+                offset += size;
+                code_bytes += size;
+            }
+            else {
+                fprintf(f, "    %04X  .byte ", address);
+                for (int i = 0; i < 8 && offset < end && !(map->flags[offset] & PRG_CODE); i++, offset++) {
+                    fprintf(f, i == 0 ? "$%02X" : ", $%02X", map->prg[offset]);
+                }
+                fprintf(f, "\n");
+            }
+        }
+        fprintf(f, "\n");
+    }
+    fprintf(f, "; %zu of %zu bytes are code\n", code_bytes, map->size);
+}
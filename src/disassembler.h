@@ -0,0 +1,55 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "util.h"
+#include "mapper/rom.h"
+
+// What's been worked out about each byte of PRG ROM. Anything that's none of these is taken to be data.
+#define PRG_OPCODE  0b001 // First byte of an instruction
+#define PRG_OPERAND 0b010 // The rest of an instruction
+#define PRG_LABEL   0b100 // Something jumps, branches or calls here
+#define PRG_CODE (PRG_OPCODE | PRG_OPERAND)
+
+// 16KB at a time is what most mappers switch, or at least what their banks pair up into
+#define PRG_MAP_BANK_BYTES 0x4000
+
+/*
+ * Works out which bytes of a ROM's PRG are code by following every path from the vectors. Nothing's run, so the
+ * mapper's registers are never known. The last bank's assumed to be fixed at the top of memory and the rest switched
+ * in below it, which is what most carts do. Jumps from the fixed bank into the switched window are followed in every
+ * bank that could be there, and anything else that can't be worked out statically, like JMP (indirect) or code in
+ * RAM, is left alone.
+ */
+typedef struct prg_map_t {
+    const byte* prg;
+    size_t size;
+    size_t bank_bytes;
+    int banks;
+    byte* flags; // PRG_* for each byte of PRG ROM
+    uint16_t nmi;
+    uint16_t reset;
+    uint16_t irq;
+} prg_map;
+
+void prg_map_init(prg_map* map, rom* r);
+void prg_map_free(prg_map* map);
+// Follows everything reachable from the NMI, reset and IRQ vectors
+void prg_map_trace(prg_map* map);
+// Follows everything reachable from an address as the CPU sees it, for entry points found some other way
+void prg_map_trace_from(prg_map* map, uint16_t address);
+
+static inline bool prg_map_is_code(const prg_map* map, size_t offset) {
+    return (map->flags[offset] & PRG_CODE) != 0;
+}
+
+// One bit per byte of PRG, set for code, lowest bit first
+void prg_map_write_bitmap(const prg_map* map, FILE* f);
+// A listing of every bank, instructions and all, with the data left as .byte lines
+void prg_map_print(const prg_map* map, FILE* f);
+
+int instruction_size(byte opcode);
+// Formats one instruction at address. Jump, call and branch targets are written as labels if labels is set,
+// otherwise as addresses.
+void format_instruction(char* out, size_t size, uint16_t address, const byte* bytes, bool labels);
@@ -0,0 +1,50 @@
+#include "dma.h"
+
+// One cycle to halt the CPU and one to throw away a read, then the read itself
+#define DMC_DMA_CYCLES 3
+
+void dma_init(dma_unit* dma) {
+    dma->oam_pending = false;
+    dma->oam_page = 0;
+    dma->oam_start = 0;
+    dma->oam_end = 0;
+}
+
+void request_oam_dma(dma_unit* dma, byte page) {
+    dma->oam_pending = true;
+    dma->oam_page = page;
+}
+
+int start_oam_dma(dma_unit* dma, uint64_t cycle) {
+    dma->oam_pending = false;
+    // A cycle to halt, one more if the next one's a put, then a get and a put for each byte
+    int cycles = 1 + (is_get_cycle(cycle + 1) ? 0 : 1) + OAM_DMA_BYTES * 2;
+    dma->oam_start = cycle;
+    dma->oam_end = cycle + cycles;
+    return cycles;
+}
+
+int dmc_dma(dma_unit* dma, uint64_t cycle) {
+    int cycles;
+    if (cycle >= dma->oam_start && cycle < dma->oam_end) {
+        // The CPU's already halted, so the DMC just takes one of the OAM DMA's gets, and the OAM DMA loses its put
+        // waiting to line up again. Right at the end it's different: on the last get the OAM DMA's only got its put
+        // left to do, and on the last put the DMC has to wait for it, then line up on its own.
+        uint64_t left = dma->oam_end - cycle;
+        if (left == 2) {
+            cycles = 1;
+        }
+        else if (left == 1) {
+            cycles = 3;
+        }
+        else {
+            cycles = 2;
+        }
+        dma->oam_end += cycles;
+    }
+    else {
+        // Halt, a dummy read, then the read has to land on a get
+        cycles = DMC_DMA_CYCLES + (is_get_cycle(cycle + 2) ? 0 : 1);
+    }
+    return cycles;
+}
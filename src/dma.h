@@ -0,0 +1,31 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "util.h"
+
+// The CPU alternates between get and put cycles. DMA can only read on a get and write on a put, so it sometimes has to
+// waste a cycle to line up.
+static inline bool is_get_cycle(uint64_t cycle) {
+    return cycle % 2 == 0;
+}
+
+#define OAM_DMA_BYTES 256
+
+/*
+ * Works out how long the OAM and DMC DMAs halt the CPU for. The copying itself is done by system_step, this only does
+ * the timing, in CPU cycles since power on.
+ */
+typedef struct dma_unit_t {
+    bool oam_pending; // Set by writing 0x4014, the DMA starts once the instruction that wrote it has finished
+    byte oam_page;
+    // The cycles the last OAM DMA has the CPU halted for, end exclusive, so a DMC DMA can tell it's landed in the middle
+    uint64_t oam_start;
+    uint64_t oam_end;
+} dma_unit;
+
+void dma_init(dma_unit* dma);
+void request_oam_dma(dma_unit* dma, byte page);
+// Starts the pending OAM DMA on the given cycle. Returns the cycles the CPU is halted for.
+int start_oam_dma(dma_unit* dma, uint64_t cycle);
+// A DMC sample fetch asked for on the given cycle. Returns the cycles the CPU is halted for.
+int dmc_dma(dma_unit* dma, uint64_t cycle);
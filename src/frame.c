@@ -0,0 +1,288 @@
+#include <err.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "frame.h"
+#include "palette.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define FRAME_X86
+#endif
+
+// Both get set up on first use, which can be on the capture thread or the emulator's (for the Zapper), so only once
+uint32_t packed_palette[2][64];
+pthread_once_t packed_palette_once = PTHREAD_ONCE_INIT;
+
+frame_simd_level simd_level;
+pthread_once_t simd_level_once = PTHREAD_ONCE_INIT;
+
+void pack_palette() {
+    for (int i = 0; i < 64; i++) {
+        color c = rgb_palette[i];
+        // Build the pixels byte by byte so the result is the same regardless of endianness
+        byte rgba[4] = { c.r, c.g, c.b, c.a };
+        byte bgra[4] = { c.b, c.g, c.r, c.a };
+        memcpy(&packed_palette[PIXEL_RGBA][i], rgba, 4);
+        memcpy(&packed_palette[PIXEL_BGRA][i], bgra, 4);
+    }
+}
+
+frame_simd_level detect_simd_level() {
+#ifdef FRAME_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SIMD_AVX2;
+    }
+#endif
+#ifdef __SSE2__
+    return SIMD_SSE2;
+#else
+    return SIMD_NONE;
+#endif
+}
+
+void init_simd_level() {
+    simd_level = detect_simd_level();
+}
+
+frame_simd_level frame_get_simd_level() {
+    pthread_once(&simd_level_once, init_simd_level);
+    return simd_level;
+}
+
+// For tests, before anything's converting frames on another thread
+void frame_force_simd_level(frame_simd_level level) {
+    pthread_once(&simd_level_once, init_simd_level);
+    frame_simd_level supported = detect_simd_level();
+    simd_level = level > supported ? supported : level;
+}
+
+/*
+ * Palette index -> pixel conversion
+ */
+void to_rgba_scalar(const byte* indices, uint32_t* out, size_t count, const uint32_t* palette) {
+    for (size_t i = 0; i < count; i++) {
+        out[i] = palette[indices[i] & 0x3F];
+    }
+}
+
+#ifdef __SSE2__
+void to_rgba_sse2(const byte* indices, uint32_t* out, size_t count, const uint32_t* palette) {
+    // No gather in SSE2, so look the entries up in scalar code and do the stores 16 bytes at a time
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i pixels = _mm_set_epi32(palette[indices[i + 3] & 0x3F],
+                                       palette[indices[i + 2] & 0x3F],
+                                       palette[indices[i + 1] & 0x3F],
+                                       palette[indices[i]     & 0x3F]);
+        _mm_storeu_si128((__m128i*)(out + i), pixels);
+    }
+    to_rgba_scalar(indices + i, out + i, count - i, palette);
+}
+#endif
+
+#ifdef FRAME_X86
+__attribute__((target("avx2")))
+void to_rgba_avx2(const byte* indices, uint32_t* out, size_t count, const uint32_t* palette) {
+    const __m256i mask = _mm256_set1_epi32(0x3F);
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        // Widen 8 indices to 32 bits each, then gather their palette entries
+        __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(indices + i)));
+        index = _mm256_and_si256(index, mask);
+        __m256i pixels = _mm256_i32gather_epi32((const int*)palette, index, 4);
+        _mm256_storeu_si256((__m256i*)(out + i), pixels);
+    }
+    to_rgba_scalar(indices + i, out + i, count - i, palette);
+}
+#endif
+
+void frame_to_rgba(const byte* indices, uint32_t* out, size_t count, pixel_format format) {
+    pthread_once(&packed_palette_once, pack_palette);
+    const uint32_t* palette = packed_palette[format];
+
+    switch (frame_get_simd_level()) {
+#ifdef FRAME_X86
+        case SIMD_AVX2:
+            to_rgba_avx2(indices, out, count, palette);
+            return;
+#endif
+#ifdef __SSE2__
+        case SIMD_SSE2:
+            to_rgba_sse2(indices, out, count, palette);
+            return;
+#endif
+        default:
+            to_rgba_scalar(indices, out, count, palette);
+            return;
+    }
+}
+
+/*
+ * Nearest-neighbor scaling
+ */
+void scale_row_scalar(const uint32_t* in, int width, uint32_t* out, int scale) {
+    for (int x = 0; x < width; x++) {
+        for (int i = 0; i < scale; i++) {
+            *out++ = in[x];
+        }
+    }
+}
+
+#ifdef __SSE2__
+void scale_row_sse2(const uint32_t* in, int width, uint32_t* out, int scale) {
+    // Every case takes 4 input pixels to scale vectors of output
+    int x = 0;
+    switch (scale) {
+        case 2:
+            for (; x + 4 <= width; x += 4, out += 8) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(in + x));
+                _mm_storeu_si128((__m128i*)out,       _mm_unpacklo_epi32(v, v));
+                _mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi32(v, v));
+            }
+            break;
+        case 3:
+            for (; x + 4 <= width; x += 4, out += 12) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(in + x));
+                _mm_storeu_si128((__m128i*)out,       _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 0, 0)));
+                _mm_storeu_si128((__m128i*)(out + 4), _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 1, 1)));
+                _mm_storeu_si128((__m128i*)(out + 8), _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 2)));
+            }
+            break;
+        case 4:
+            for (; x + 4 <= width; x += 4, out += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i*)(in + x));
+                _mm_storeu_si128((__m128i*)out,        _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 0, 0, 0)));
+                _mm_storeu_si128((__m128i*)(out + 4),  _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 1, 1, 1)));
+                _mm_storeu_si128((__m128i*)(out + 8),  _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 2, 2, 2)));
+                _mm_storeu_si128((__m128i*)(out + 12), _mm_shuffle_epi32(v, _MM_SHUFFLE(3, 3, 3, 3)));
+            }
+            break;
+        default:
+            break;
+    }
+    scale_row_scalar(in + x, width - x, out, scale);
+}
+#endif
+
+void scale_row(const uint32_t* in, int width, uint32_t* out, int scale) {
+    if (scale == 1) {
+        memcpy(out, in, width * sizeof(uint32_t));
+        return;
+    }
+#ifdef __SSE2__
+    if (frame_get_simd_level() != SIMD_NONE) {
+        scale_row_sse2(in, width, out, scale);
+        return;
+    }
+#endif
+    scale_row_scalar(in, width, out, scale);
+}
+
+void frame_scale(const uint32_t* in, int width, int height, uint32_t* out, size_t out_pitch, int scale) {
+    if (scale < 1 || scale > 4) {
+        errx(EXIT_FAILURE, "Unsupported frame scale %d, only 1-4 are supported", scale);
+    }
+
+    for (int y = 0; y < height; y++) {
+        uint32_t* row = out + (size_t)y * scale * out_pitch;
+        scale_row(in + (size_t)y * width, width, row, scale);
+        // The rest of the rows for this line are copies of the first
+        for (int i = 1; i < scale; i++) {
+            memcpy(row + i * out_pitch, row, (size_t)width * scale * sizeof(uint32_t));
+        }
+    }
+}
+
+/*
+ * Colorspace conversion for video output
+ */
+
+// BT.601 limited range, 8 bit fixed point. The rounding constant rides along with B so the SIMD path can use
+// two multiply-adds per plane.
+#define YUV_Y(r, g, b) ((( 66 * (r) + 129 * (g) +  25 * (b) + 128) >> 8) + 16)
+#define YUV_U(r, g, b) (((-38 * (r) -  74 * (g) + 112 * (b) + 128) >> 8) + 128)
+#define YUV_V(r, g, b) (((112 * (r) -  94 * (g) -  18 * (b) + 128) >> 8) + 128)
+
+void rgba_to_yuv444_scalar(const uint32_t* rgba, size_t count, byte* y, byte* u, byte* v) {
+    for (size_t i = 0; i < count; i++) {
+        const byte* px = (const byte*)&rgba[i];
+        int r = px[0];
+        int g = px[1];
+        int b = px[2];
+        y[i] = (byte)YUV_Y(r, g, b);
+        u[i] = (byte)YUV_U(r, g, b);
+        v[i] = (byte)YUV_V(r, g, b);
+    }
+}
+
+#ifdef __SSE2__
+// Two 16 bit coefficients packed into each 32 bit lane, for _mm_madd_epi16
+#define COEFFS(lo, hi) _mm_set1_epi32((int)(((uint32_t)(uint16_t)(hi) << 16) | (uint16_t)(lo)))
+
+static inline __m128i yuv_plane(__m128i rg, __m128i b1, __m128i coeff_rg, __m128i coeff_b1, int offset) {
+    __m128i sum = _mm_add_epi32(_mm_madd_epi16(rg, coeff_rg), _mm_madd_epi16(b1, coeff_b1));
+    return _mm_add_epi32(_mm_srai_epi32(sum, 8), _mm_set1_epi32(offset));
+}
+
+void rgba_to_yuv444_sse2(const uint32_t* rgba, size_t count, byte* y, byte* u, byte* v) {
+    const __m128i low_byte = _mm_set1_epi32(0xFF);
+    const __m128i one_high = _mm_set1_epi32(1 << 16);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i ys[4];
+        __m128i us[4];
+        __m128i vs[4];
+        for (int j = 0; j < 4; j++) {
+            __m128i px = _mm_loadu_si128((const __m128i*)(rgba + i + j * 4));
+            // R and G as a pair of 16 bit values, then B paired with 1 to pick up the rounding constant
+            __m128i rg = _mm_or_si128(_mm_and_si128(px, low_byte),
+                                      _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(px, 8), low_byte), 16));
+            __m128i b1 = _mm_or_si128(_mm_and_si128(_mm_srli_epi32(px, 16), low_byte), one_high);
+
+            ys[j] = yuv_plane(rg, b1, COEFFS(66, 129),  COEFFS(25, 128),  16);
+            us[j] = yuv_plane(rg, b1, COEFFS(-38, -74), COEFFS(112, 128), 128);
+            vs[j] = yuv_plane(rg, b1, COEFFS(112, -94), COEFFS(-18, 128), 128);
+        }
+        _mm_storeu_si128((__m128i*)(y + i), _mm_packus_epi16(_mm_packs_epi32(ys[0], ys[1]), _mm_packs_epi32(ys[2], ys[3])));
+        _mm_storeu_si128((__m128i*)(u + i), _mm_packus_epi16(_mm_packs_epi32(us[0], us[1]), _mm_packs_epi32(us[2], us[3])));
+        _mm_storeu_si128((__m128i*)(v + i), _mm_packus_epi16(_mm_packs_epi32(vs[0], vs[1]), _mm_packs_epi32(vs[2], vs[3])));
+    }
+    rgba_to_yuv444_scalar(rgba + i, count - i, y + i, u + i, v + i);
+}
+#endif
+
+void frame_rgba_to_yuv444(const uint32_t* rgba, size_t count, byte* y, byte* u, byte* v) {
+#ifdef __SSE2__
+    if (frame_get_simd_level() != SIMD_NONE) {
+        rgba_to_yuv444_sse2(rgba, count, y, u, v);
+        return;
+    }
+#endif
+    rgba_to_yuv444_scalar(rgba, count, y, u, v);
+}
+
+void frame_rgba_to_rgb24(const uint32_t* rgba, size_t count, byte* rgb) {
+    for (size_t i = 0; i < count; i++) {
+        memcpy(rgb + i * 3, &rgba[i], 3);
+    }
+}
+
+void frame_convert_scaled(byte (*screen)[FRAME_HEIGHT][FRAME_WIDTH], uint32_t* out, size_t out_pitch, int scale, pixel_format format) {
+    if (scale == 1) {
+        for (int y = 0; y < FRAME_HEIGHT; y++) {
+            frame_to_rgba((*screen)[y], out + (size_t)y * out_pitch, FRAME_WIDTH, format);
+        }
+        return;
+    }
+
+    // Convert a line at a time into a small buffer that stays in cache, then scale it out
+    uint32_t line[FRAME_WIDTH];
+    for (int y = 0; y < FRAME_HEIGHT; y++) {
+        frame_to_rgba((*screen)[y], line, FRAME_WIDTH, format);
+        frame_scale(line, FRAME_WIDTH, 1, out + (size_t)y * scale * out_pitch, out_pitch, scale);
+    }
+}
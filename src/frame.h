@@ -0,0 +1,41 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "util.h"
+
+#define FRAME_WIDTH 256
+#define FRAME_HEIGHT 240
+
+// Byte order of a converted pixel in memory
+typedef enum pixel_format_t {
+    PIXEL_RGBA,
+    PIXEL_BGRA
+} pixel_format;
+
+typedef enum frame_simd_level_t {
+    SIMD_NONE,
+    SIMD_SSE2,
+    SIMD_AVX2
+} frame_simd_level;
+
+// Converts count NES palette indices (0-63) to packed 32 bit pixels in out.
+void frame_to_rgba(const byte* indices, uint32_t* out, size_t count, pixel_format format);
+
+// Nearest-neighbor upscale of a width x height image of 32 bit pixels by 1, 2, 3 or 4.
+// out_pitch is the distance between output rows, in pixels.
+void frame_scale(const uint32_t* in, int width, int height, uint32_t* out, size_t out_pitch, int scale);
+
+// Converts a whole frame of palette indices and scales it in one pass, straight into out.
+void frame_convert_scaled(byte (*screen)[FRAME_HEIGHT][FRAME_WIDTH], uint32_t* out, size_t out_pitch, int scale, pixel_format format);
+
+// Converts count RGBA pixels (as produced with PIXEL_RGBA) to BT.601 limited range YUV 4:4:4 planes.
+void frame_rgba_to_yuv444(const uint32_t* rgba, size_t count, byte* y, byte* u, byte* v);
+
+// Drops the alpha channel of count RGBA pixels, writing 3 bytes per pixel.
+void frame_rgba_to_rgb24(const uint32_t* rgba, size_t count, byte* rgb);
+
+// Best level the CPU supports, and the one actually in use. Forcing a level is for tests and benchmarks,
+// a level the CPU doesn't support is clamped to the best one that it does.
+frame_simd_level frame_get_simd_level();
+void frame_force_simd_level(frame_simd_level level);
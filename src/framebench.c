@@ -0,0 +1,62 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "frame.h"
+
+#define DEFAULT_ITERATIONS 2000
+
+const char* simd_level_names[] = { "scalar", "sse2", "avx2" };
+
+double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void report(const char* name, frame_simd_level level, int scale, int iterations, double elapsed) {
+    double pixels = (double)FRAME_WIDTH * FRAME_HEIGHT * scale * scale * iterations;
+    printf("%-14s %-6s %dx: %8.1f us/frame %8.1f Mpix/s\n", name, simd_level_names[level], scale,
+           elapsed / iterations * 1e6, pixels / elapsed / 1e6);
+}
+
+int main(int argc, char** argv) {
+    int iterations = argc > 1 ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    if (iterations <= 0) {
+        printf("framebench: benchmark palette conversion and scaling of NES frames\n");
+        printf("Usage: %s [iterations]\n", argv[0]);
+        return 2;
+    }
+
+    byte (*screen)[FRAME_HEIGHT][FRAME_WIDTH] = malloc(sizeof(*screen));
+    uint32_t* out = malloc((size_t)FRAME_WIDTH * FRAME_HEIGHT * 16 * sizeof(uint32_t));
+
+    srand(1);
+    for (int y = 0; y < FRAME_HEIGHT; y++) {
+        for (int x = 0; x < FRAME_WIDTH; x++) {
+            (*screen)[y][x] = (byte)(rand() % 64);
+        }
+    }
+
+    frame_simd_level best = frame_get_simd_level();
+    for (frame_simd_level level = SIMD_NONE; level <= best; level++) {
+        frame_force_simd_level(level);
+
+        double start = now_seconds();
+        for (int i = 0; i < iterations; i++) {
+            frame_to_rgba(&(*screen)[0][0], out, FRAME_WIDTH * FRAME_HEIGHT, PIXEL_RGBA);
+        }
+        report("convert", level, 1, iterations, now_seconds() - start);
+
+        for (int scale = 2; scale <= 4; scale++) {
+            start = now_seconds();
+            for (int i = 0; i < iterations; i++) {
+                frame_convert_scaled(screen, out, FRAME_WIDTH * scale, scale, PIXEL_BGRA);
+            }
+            report("convert+scale", level, scale, iterations, now_seconds() - start);
+        }
+    }
+
+    free(out);
+    free(screen);
+}
@@ -0,0 +1,166 @@
+#include <string.h>
+
+#include "input.h"
+#include "frame.h"
+#include "debugger.h"
+
+byte input_buttons_pressed(const input_snapshot* input, player p) {
+    byte buttons = 0;
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+        if (input->buttons[p][i]) {
+            buttons |= 1 << i;
+        }
+    }
+    return buttons;
+}
+
+void input_set_buttons(input_snapshot* input, player p, byte buttons) {
+    for (int i = 0; i < NUM_BUTTONS; i++) {
+        input->buttons[p][i] = (buttons >> i) & 1;
+    }
+}
+
+// Serial devices shift out their bits one read at a time. Official controllers send 1s once they've run out.
+static byte shift_out(input_port* port) {
+    byte bit = port->shift & 1;
+    port->shift = (port->shift >> 1) | 0x80000000;
+    return bit;
+}
+
+static void controller_latch(input_port* port, const input_snapshot* input) {
+    port->shift = (uint32_t)input_buttons_pressed(input, port->number == 0 ? one : two) | 0xFFFFFF00;
+}
+
+static byte controller_read(input_port* port, const input_snapshot* input, ppu_memory* ppu) {
+    return shift_out(port);
+}
+
+// Players one and three on 0x4016, two and four on 0x4017, then a signature so games can tell it's there
+static void four_score_latch(input_port* port, const input_snapshot* input) {
+    uint32_t signature = port->number == 0 ? 0x08 : 0x04;
+    port->shift = (uint32_t)input_buttons_pressed(input, port->number == 0 ? one : two)
+                  | (uint32_t)input_buttons_pressed(input, port->number == 0 ? three : four) << 8
+                  | signature << 16
+                  | 0xFF000000;
+}
+
+// The Zapper only sees light, so it's anything bright enough, not just white
+static bool is_bright(byte color) {
+    uint32_t pixel;
+    frame_to_rgba(&color, &pixel, 1, PIXEL_RGBA);
+    int r = pixel & 0xFF;
+    int g = (pixel >> 8) & 0xFF;
+    int b = (pixel >> 16) & 0xFF;
+    return (r * 299 + g * 587 + b * 114) / 1000 >= 0x99;
+}
+
+// Light comes from the pixel under the pointer for a little while after the beam has drawn it
+static bool zapper_sees_light(const input_snapshot* input, ppu_memory* ppu) {
+    int x = input->pointer_x;
+    int y = input->pointer_y;
+    if (x < 0 || y < 0 || x >= FRAME_WIDTH || y >= FRAME_HEIGHT) {
+        return false;
+    }
+
+    int lines_since = get_screen_y(ppu) - y;
+    if (lines_since < 0 || lines_since >= ZAPPER_SENSE_LINES) {
+        return false;
+    }
+    if (lines_since == 0 && get_screen_x(ppu) <= x) {
+        return false;
+    }
+    return is_bright(ppu->screen[y][x]);
+}
+
+// Bit 3 is low when it sees light, bit 4 is high while the trigger's held
+static byte zapper_read(input_port* port, const input_snapshot* input, ppu_memory* ppu) {
+    byte value = zapper_sees_light(input, ppu) ? 0 : 0x08;
+    if (input->trigger) {
+        value |= 0x10;
+    }
+    return value;
+}
+
+// The knob's position is sent inverted, most significant bit first
+static void arkanoid_latch(input_port* port, const input_snapshot* input) {
+    byte position = ARKANOID_MIN + input->paddle * (ARKANOID_MAX - ARKANOID_MIN) / 0xFF;
+    port->shift = (uint32_t)(byte)~position << 24;
+}
+
+// Bit 4 is the next bit of the position, bit 3 the button
+static byte arkanoid_read(input_port* port, const input_snapshot* input, ppu_memory* ppu) {
+    byte value = (port->shift >> 31) << 4;
+    port->shift <<= 1;
+    if (input->paddle_button) {
+        value |= 0x08;
+    }
+    return value;
+}
+
+static byte nothing_read(input_port* port, const input_snapshot* input, ppu_memory* ppu) {
+    return 0;
+}
+
+static const input_device_ops devices[] = {
+    { .type = INPUT_NONE, .name = "nothing", .read = nothing_read },
+    { .type = INPUT_CONTROLLER, .name = "controller", .latch = controller_latch, .read = controller_read },
+    { .type = INPUT_FOUR_SCORE, .name = "Four Score", .latch = four_score_latch, .read = controller_read },
+    { .type = INPUT_ZAPPER, .name = "Zapper", .read = zapper_read },
+    { .type = INPUT_ARKANOID, .name = "Arkanoid controller", .latch = arkanoid_latch, .read = arkanoid_read },
+};
+
+void input_connect(input_port* port, int number, input_device_type type) {
+    port->ops = &devices[0];
+    for (size_t i = 0; i < sizeof(devices) / sizeof(devices[0]); i++) {
+        if (devices[i].type == type) {
+            port->ops = &devices[i];
+            break;
+        }
+    }
+    dprintf("Port %d has a %s plugged in\n", number + 1, port->ops->name);
+    port->number = number;
+    port->strobe = false;
+    port->shift = 0;
+}
+
+bool input_connect_by_name(input_port ports[2], const char* setup) {
+    input_device_type port2;
+    if (strcmp(setup, "controllers") == 0) {
+        port2 = INPUT_CONTROLLER;
+    }
+    else if (strcmp(setup, "fourscore") == 0) {
+        input_connect(&ports[0], 0, INPUT_FOUR_SCORE);
+        input_connect(&ports[1], 1, INPUT_FOUR_SCORE);
+        return true;
+    }
+    else if (strcmp(setup, "zapper") == 0) {
+        port2 = INPUT_ZAPPER;
+    }
+    else if (strcmp(setup, "arkanoid") == 0) {
+        port2 = INPUT_ARKANOID;
+    }
+    else {
+        return false;
+    }
+    input_connect(&ports[0], 0, INPUT_CONTROLLER);
+    input_connect(&ports[1], 1, port2);
+    return true;
+}
+
+byte input_read(input_port* port, const input_snapshot* input, ppu_memory* ppu) {
+    // With the strobe high the device is reloaded all the time, so reads keep getting the first bit
+    if (port->strobe && port->ops->latch != NULL) {
+        port->ops->latch(port, input);
+    }
+    return port->ops->read(port, input, ppu);
+}
+
+void input_write(input_port* port, const input_snapshot* input, byte value) {
+    // Dropping the strobe leaves the device holding whatever it was last reloaded with, so reads made while it was
+    // high don't count
+    bool was_strobed = port->strobe;
+    port->strobe = value & 1;
+    if ((was_strobed || port->strobe) && port->ops->latch != NULL) {
+        port->ops->latch(port, input);
+    }
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "util.h"
+#include "ppu.h"
+#include "controller.h"
+
+typedef enum input_device_type_t {
+    INPUT_NONE,
+    INPUT_CONTROLLER,
+    INPUT_FOUR_SCORE, // Goes in both ports
+    INPUT_ZAPPER,
+    INPUT_ARKANOID
+} input_device_type;
+
+struct input_device_ops_t;
+
+// What's plugged into one of the two controller ports, 0x4016 or 0x4017
+typedef struct input_port_t {
+    const struct input_device_ops_t* ops;
+    int number; // 0 or 1
+    bool strobe; // Bit 0 of the last write to 0x4016, the devices keep reloading while it's high
+    uint32_t shift; // Serial devices: bits still to be read, next one lowest
+} input_port;
+
+typedef struct input_device_ops_t {
+    input_device_type type;
+    const char* name;
+    // Takes what the device is going to send from the snapshot. NULL for devices that don't care about the strobe.
+    void (*latch)(input_port* port, const input_snapshot* input);
+    // Returns bits 0-4 of a read from the port. The PPU is there for the Zapper to look at the screen.
+    byte (*read)(input_port* port, const input_snapshot* input, ppu_memory* ppu);
+} input_device_ops;
+
+void input_connect(input_port* port, int number, input_device_type type);
+// Plugs in the devices named by setup: "controllers", "fourscore", "zapper" or "arkanoid", the last two in port 2
+// with a controller in port 1. Returns false if it's not one of those.
+bool input_connect_by_name(input_port ports[2], const char* setup);
+
+// A player's buttons as a byte, bit n set for button n held down. That's the order controllers send them in.
+byte input_buttons_pressed(const input_snapshot* input, player p);
+void input_set_buttons(input_snapshot* input, player p, byte buttons);
+
+byte input_read(input_port* port, const input_snapshot* input, ppu_memory* ppu);
+void input_write(input_port* port, const input_snapshot* input, byte value);
+
+// How many lines the Zapper's photodiode keeps seeing a pixel for after the beam's drawn it
+#define ZAPPER_SENSE_LINES 20
+// The Arkanoid knob doesn't turn through the whole range
+#define ARKANOID_MIN 0x62
+#define ARKANOID_MAX 0xF2
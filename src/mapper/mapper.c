@@ -1,135 +1,129 @@
 #include <err.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "../util.h"
+#include "../debugger.h"
 #include "rom.h"
 #include "mapper.h"
 #include "mapper0.h"
 #include "mapper1.h"
 #include "mapper2.h"
 #include "mapper4.h"
+#include "mapper5.h"
 #include "mapper7.h"
+#include "mapper9.h"
+#include "mapper10.h"
+#include "mapper21.h"
+#include "mapper24.h"
 #include "mapper31.h"
+#include "mapper69.h"
 
-void mapper_init(rom* r) {
-    switch (r->mapper) {
-        case 0:
-            mapper0_init(&r->mapperdata);
-            break;
-        case 1:
-            mapper1_init(&r->mapperdata);
-            break;
-        case 2:
-            mapper2_init(&r->mapperdata);
-            break;
-        case 4:
-            mapper4_init(r);
-            break;
-        case 7:
-            break;
-        case 31:
-            mapper31_init(&r->mapperdata);
-            break;
-        default:
-            errx(EXIT_FAILURE, "init: Unknown mapper %d!", r->mapper);
-    }
-}
+// Adding a mapper is a matter of adding a line here
+static const mapper_ops mappers[] = {
+    {
+        .number = 0, .name = "NROM", .init = mapper0_init,
+        .prg_read = mapper0_prg_read, .prg_write = mapper0_prg_write,
+        .chr_read = mapper0_chr_read, .chr_write = mapper0_chr_write
+    },
+    {
+        .number = 1, .name = "MMC1", .init = mapper1_init,
+        .prg_read = mapper1_prg_read, .prg_write = mapper1_prg_write,
+        .chr_read = mapper1_chr_read, .chr_write = mapper1_chr_write
+    },
+    {
+        .number = 2, .name = "UxROM", .init = mapper2_init,
+        .prg_read = mapper2_prg_read, .prg_write = mapper2_prg_write,
+        .chr_read = mapper2_chr_read, .chr_write = mapper2_chr_write
+    },
+    {
+        .number = 4, .name = "MMC3", .init = mapper4_init,
+        .prg_read = mapper4_prg_read, .prg_write = mapper4_prg_write,
+        .chr_read = mapper4_chr_read, .chr_write = mapper4_chr_write,
+        .a12_rise = mapper4_a12_rise
+    },
+    {
+        .number = 5, .name = "MMC5", .init = mapper5_init,
+        .prg_read = mapper5_prg_read, .prg_write = mapper5_prg_write,
+        .chr_read = mapper5_chr_read, .chr_write = mapper5_chr_write,
+        .scanline = mapper5_scanline
+    },
+    {
+        .number = 7, .name = "AxROM", .init = mapper7_init,
+        .prg_read = mapper7_prg_read, .prg_write = mapper7_prg_write,
+        .chr_read = mapper7_chr_read, .chr_write = mapper7_chr_write
+    },
+    {
+        .number = 9, .name = "MMC2", .init = mapper9_init,
+        .prg_read = mapper9_prg_read, .prg_write = mapper9_prg_write,
+        .chr_read = mapper9_chr_read, .chr_write = mapper9_chr_write
+    },
+    {
+        .number = 10, .name = "MMC4", .init = mapper10_init,
+        .prg_read = mapper10_prg_read, .prg_write = mapper9_prg_write,
+        .chr_read = mapper10_chr_read, .chr_write = mapper9_chr_write
+    },
+    {
+        .number = 21, .name = "VRC4a/VRC4c", .init = mapper21_init,
+        .prg_read = mapper21_prg_read, .prg_write = mapper21_prg_write,
+        .chr_read = mapper21_chr_read, .chr_write = mapper21_chr_write,
+        .timer = vrc_irq_timer
+    },
+    {
+        .number = 22, .name = "VRC2a", .init = mapper21_init,
+        .prg_read = mapper21_prg_read, .prg_write = mapper22_prg_write,
+        .chr_read = mapper21_chr_read, .chr_write = mapper21_chr_write
+    },
+    {
+        .number = 23, .name = "VRC2b/VRC4e", .init = mapper21_init,
+        .prg_read = mapper21_prg_read, .prg_write = mapper23_prg_write,
+        .chr_read = mapper21_chr_read, .chr_write = mapper21_chr_write,
+        .timer = vrc_irq_timer
+    },
+    {
+        .number = 24, .name = "VRC6a", .init = mapper24_init,
+        .prg_read = mapper24_prg_read, .prg_write = mapper24_prg_write,
+        .chr_read = mapper24_chr_read, .chr_write = mapper24_chr_write,
+        .timer = vrc_irq_timer
+    },
+    {
+        .number = 25, .name = "VRC2c/VRC4b/VRC4d", .init = mapper21_init,
+        .prg_read = mapper21_prg_read, .prg_write = mapper25_prg_write,
+        .chr_read = mapper21_chr_read, .chr_write = mapper21_chr_write,
+        .timer = vrc_irq_timer
+    },
+    {
+        .number = 26, .name = "VRC6b", .init = mapper24_init,
+        .prg_read = mapper24_prg_read, .prg_write = mapper26_prg_write,
+        .chr_read = mapper24_chr_read, .chr_write = mapper24_chr_write,
+        .timer = vrc_irq_timer
+    },
+    {
+        .number = 31, .name = "NSF", .init = mapper31_init,
+        .prg_read = mapper31_prg_read, .prg_write = mapper31_prg_write,
+        .chr_read = mapper31_chr_read, .chr_write = mapper31_chr_write
+    },
+    {
+        .number = 69, .name = "FME-7", .init = mapper69_init,
+        .prg_read = mapper69_prg_read, .prg_write = mapper69_prg_write,
+        .chr_read = mapper69_chr_read, .chr_write = mapper69_chr_write,
+        .timer = mapper69_timer
+    },
+};
 
-byte mapper_prg_read(rom* r, uint16_t address) {
-    switch (r->mapper) {
-        case 0:
-            return mapper0_prg_read(r, address);
-        case 1:
-            return mapper1_prg_read(r, address);
-        case 2:
-            return mapper2_prg_read(r, address);
-        case 4:
-            return mapper4_prg_read(r, address);
-        case 7:
-            return mapper7_prg_read(r, address);
-        case 31:
-            return mapper31_prg_read(r, address);
-        default:
-            errx(EXIT_FAILURE, "prg read: Unknown mapper %d!", r->mapper);
-    }
-}
-
-void mapper_prg_write(rom* r, uint16_t address, byte value) {
-    switch (r->mapper) {
-        case 0:
-            mapper0_prg_write(r, address, value);
-            break;
-        case 1:
-            mapper1_prg_write(r, address, value);
-            break;
-        case 2:
-            mapper2_prg_write(r, address, value);
-            break;
-        case 4:
-            mapper4_prg_write(r, address, value);
-            break;
-        case 7:
-            mapper7_prg_write(r, address, value);
-            break;
-        case 31:
-            mapper31_prg_write(r, address, value);
+void mapper_init(rom* r) {
+    r->ops = NULL;
+    for (size_t i = 0; i < sizeof(mappers) / sizeof(mappers[0]); i++) {
+        if (mappers[i].number == r->mapper) {
+            r->ops = &mappers[i];
             break;
-        default:
-            errx(EXIT_FAILURE, "prg write: Unknown mapper %d!", r->mapper);
-    }
-}
-
-byte mapper_chr_read(rom* r, uint16_t address) {
-    switch (r->mapper) {
-        case 0:
-            return mapper0_chr_read(r, address);
-        case 1:
-            return mapper1_chr_read(r, address);
-        case 2:
-            return mapper2_chr_read(r, address);
-        case 4:
-            return mapper4_chr_read(r, address);
-        case 7:
-            return mapper7_chr_read(r, address);
-        case 31:
-            return mapper31_chr_read(r, address);
-        default:
-            errx(EXIT_FAILURE, "chr read: Unknown mapper %d!", r->mapper);
+        }
     }
-}
-
-void mapper_chr_write(rom* r, uint16_t address, byte value) {
-    switch (r->mapper) {
-        case 0:
-            mapper0_chr_write(r, address, value);
-            break;
-        case 1:
-            mapper1_chr_write(r, address, value);
-            break;
-        case 2:
-            mapper2_chr_write(r, address, value);
-            break;
-        case 4:
-            mapper4_chr_write(r, address, value);
-            break;
-        case 7:
-            mapper7_chr_write(r, address, value);
-            break;
-        case 31:
-            mapper31_chr_write(r, address, value);
-            break;
-        default:
-            errx(EXIT_FAILURE, "chr write: Unknown mapper %d!", r->mapper);
+    if (r->ops == NULL) {
+        errx(EXIT_FAILURE, "init: Unknown mapper %d!", r->mapper);
     }
+    dprintf("Mapper %d is %s\n", r->mapper, r->ops->name);
+    memset(&r->mapperdata, 0, sizeof(r->mapperdata));
+    r->ops->init(r);
 }
-
-void mapper_ppu_step(rom *r, int cycle, int scan_line, bool rendering_enabled) {
-    switch (r->mapper) {
-        case 4:
-            mapper4_ppu_step(r, cycle, scan_line, rendering_enabled);
-            break;
-        default:
-            break;
-    }
-}
\ No newline at end of file
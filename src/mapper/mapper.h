@@ -1,13 +1,90 @@
 #pragma once
 #include <stdint.h>
+#include <stdbool.h>
 #include "rom.h"
+#include "../scheduler.h"
+
+/*
+ * Everything one mapper does, looked up once by mapper number when the rom is loaded. The hooks for watching the PPU
+ * and counting CPU cycles are NULL for mappers that don't need them, so nobody pays for what they don't use.
+ */
+typedef struct mapper_ops_t {
+    uint16_t number;
+    const char* name;
+    void (*init)(rom* r);
+    byte (*prg_read)(rom* r, uint16_t address);
+    void (*prg_write)(rom* r, uint16_t address, byte value);
+    byte (*chr_read)(rom* r, uint16_t address);
+    void (*chr_write)(rom* r, uint16_t address, byte value);
+    // Called when A12 rises after being low for at least MAPPER_A12_FILTER_DOTS. Returns true to raise the IRQ
+    bool (*a12_rise)(rom* r);
+    // Called near the start of each line the PPU renders, 0-239, then with 240 once the frame is over. Returns true to
+    // raise the IRQ
+    bool (*scanline)(rom* r, int line);
+    // Catches a counter that runs off the CPU clock up to time, raising or releasing the IRQ as needed. Returns when
+    // it next needs calling, or NEVER.
+    timestamp (*timer)(rom* r, timestamp time);
+} mapper_ops;
 
 void mapper_init(rom* r);
 
-byte mapper_prg_read(rom* r, uint16_t address);
-void mapper_prg_write(rom* r, uint16_t address, byte value);
+// A12 has to have been low for about 3 CPU cycles before the MMC3 will count it rising again. This is what stops it
+// counting every tile when the background and sprites use different pattern tables.
+#define MAPPER_A12_FILTER_DOTS 10
+
+static inline byte mapper_prg_read(rom* r, uint16_t address) {
+    return r->ops->prg_read(r, address);
+}
+
+static inline void mapper_prg_write(rom* r, uint16_t address, byte value) {
+    r->ops->prg_write(r, address, value);
+}
+
+static inline byte mapper_chr_read(rom* r, uint16_t address) {
+    return r->ops->chr_read(r, address);
+}
+
+static inline void mapper_chr_write(rom* r, uint16_t address, byte value) {
+    if (!r->chr_ram) {
+        // Writes to CHR ROM go nowhere on the real thing, and here it's a read only mapping of the file
+        return;
+    }
+    r->ops->chr_write(r, address, value);
+}
+
+// Mappers that watch the PPU's A12 address line to count scan lines
+static inline bool mapper_watches_a12(rom* r) {
+    return r->ops->a12_rise != NULL;
+}
+
+static inline bool mapper_a12_rise(rom* r) {
+    return r->ops->a12_rise(r);
+}
+
+// Mappers that count the lines the PPU renders some other way
+static inline bool mapper_watches_scanlines(rom* r) {
+    return r->ops->scanline != NULL;
+}
+
+static inline bool mapper_scanline(rom* r, int line) {
+    return r->ops->scanline(r, line);
+}
+
+static inline bool mapper_has_timer(rom* r) {
+    return r->ops->timer != NULL;
+}
+
+static inline timestamp mapper_timer(rom* r, timestamp time) {
+    return r->ops->timer(r, time);
+}
 
-byte mapper_chr_read(rom* r, uint16_t address);
-void mapper_chr_write(rom* r, uint16_t address, byte value);
+// Timers count CPU cycles rather than the scheduler's PPU dots
+static inline uint64_t mapper_cpu_cycle(timestamp time) {
+    return time / DOTS_PER_CPU_CYCLE;
+}
 
-void mapper_ppu_step(rom *r, int cycle, int scan_line, bool rendering_enabled);
\ No newline at end of file
+// Where the system's up to, for catching a timer up before a register write changes it. Without a system time stands
+// still.
+static inline uint64_t mapper_current_cycle(rom* r) {
+    return r->scheduler != NULL ? mapper_cpu_cycle(r->scheduler->now) : r->mapperdata.irq_cycle;
+}
@@ -3,7 +3,7 @@
 #include "../util.h"
 #include "rom.h"
 
-void mapper0_init(mapper_data* mapperdata);
+void mapper0_init(rom* r);
 byte mapper0_prg_read(rom* r, uint16_t address);
 void mapper0_prg_write(rom* r, uint16_t address, byte value);
 byte mapper0_chr_read(rom* r, uint16_t address);
@@ -3,7 +3,8 @@
 #include "mapper1.h"
 #include "../debugger.h"
 
-void mapper1_init(mapper_data* mapperdata) {
+void mapper1_init(rom* r) {
+    mapper_data* mapperdata = &r->mapperdata;
     mapperdata->prg_bank_mode = 1;
     mapperdata->chr_bank_mode = 0;
 
@@ -28,24 +29,36 @@ int prg_offset_for_bank(rom* r, int bank) {
     if (bank >= 0x80) {
         bank -= 0x100;
     }
-    bank %= r->header->prg_rom_blocks;
+    bank %= get_prg_rom_blocks(r);
     return bank * BYTES_PER_PRG_ROM_BLOCK;
 }
 
 int get_last_prg_bank(rom* r) {
-    return prg_offset_for_bank(r, r->header->prg_rom_blocks - 1);
+    return prg_offset_for_bank(r, get_prg_rom_blocks(r) - 1);
 }
 
 int chr_offset_for_bank(rom* r, int bank) {
     if (bank >= 0x80) {
         bank -= 0x100;
     }
-    if (bank > 0 && r->header->chr_rom_blocks > 0) {
-        bank %= r->header->chr_rom_blocks;
+    if (bank > 0 && get_chr_rom_blocks(r) > 0) {
+        bank %= get_chr_rom_blocks(r);
     }
     return bank * (BYTES_PER_CHR_ROM_BLOCK / 2);
 }
 
+// SOROM and SXROM have more than 8KB of PRG RAM, banked by the upper bits of CHR bank 0
+int mapper1_prg_ram_offset(rom* r) {
+    switch (get_prg_ram_bytes(r)) {
+        case 0x4000:
+            return ((r->mapperdata.chr_bank_0 >> 3) & 0b1) * 0x2000;
+        case 0x8000:
+            return ((r->mapperdata.chr_bank_0 >> 2) & 0b11) * 0x2000;
+        default:
+            return 0;
+    }
+}
+
 byte mapper1_prg_read(rom* r, uint16_t address) {
     byte result;
     if (address < 0x6000) {
@@ -53,17 +66,17 @@ byte mapper1_prg_read(rom* r, uint16_t address) {
         result = 0x00;
     }
     else if (address < 0x8000) {
-        result = r->prg_ram[address - 0x6000];
+        result = prg_ram_read(r, mapper1_prg_ram_offset(r) + address - 0x6000);
     }
     else if (address < 0xC000) { // PRG bank 0, 0x8000 - 0xBFFF
-        result = r->prg_rom[r->mapperdata.prg_bank_0_offset + (address  % 0x4000)];
+        result = prg_rom_read(r, r->mapperdata.prg_bank_0_offset + (address  % 0x4000));
     }
     else { // PRG bank 1, 0xC000 - 0xFFFF
         if (r->mapperdata.prg_bank_1_offset == -1) {
             r->mapperdata.prg_bank_1_offset = get_last_prg_bank(r);
         }
 
-        result = r->prg_rom[r->mapperdata.prg_bank_1_offset + (address % 0x4000)];
+        result = prg_rom_read(r, r->mapperdata.prg_bank_1_offset + (address % 0x4000));
     }
 
     return result;
@@ -82,19 +95,19 @@ void load_register(uint16_t address, rom* r) {
 
         if (mirroring == 0) {
             dprintf("Mirroring mode is now: SINGLE_LOWER\n");
-            r->nametable_mirroring_mode = SINGLE_LOWER;
+            set_nametable_mirroring(r, SINGLE_LOWER);
         }
         else if (mirroring == 1) {
             dprintf("Mirroring mode is now: SINGLE_UPPER\n");
-            r->nametable_mirroring_mode = SINGLE_UPPER;
+            set_nametable_mirroring(r, SINGLE_UPPER);
         }
         else if (mirroring == 2) {
             dprintf("Mirroring mode is now: VERTICAL\n");
-            r->nametable_mirroring_mode = VERTICAL;
+            set_nametable_mirroring(r, VERTICAL);
         }
         else if (mirroring == 3) {
             dprintf("Mirroring mode is now: HORIZONTAL\n");
-            r->nametable_mirroring_mode = HORIZONTAL;
+            set_nametable_mirroring(r, HORIZONTAL);
         }
         else {
             errx(EXIT_FAILURE, "Mapper 1: unrecognized or unimplemented mirroring mode %d", mirroring);
@@ -148,7 +161,7 @@ void mapper1_prg_write(rom* r, uint16_t address, byte value) {
     }
     else if (address < 0x8000) {
         // 8kb prg ram bank
-        r->prg_ram[address - 0x6000] = value;
+        prg_ram_write(r, mapper1_prg_ram_offset(r) + address - 0x6000, value);
     }
     else {
         // TODO need to discard writes that happen on consecutive cycles, see https://wiki.nesdev.com/w/index.php/MMC1
@@ -185,7 +198,7 @@ byte mapper1_chr_read(rom* r, uint16_t address) {
     else {
         errx(EXIT_FAILURE, "Mapper 1: Attempt to read out of range CHR address 0x%04X", address);
     }
-    return r->chr_rom[offset + (address % 0x1000)];
+    return chr_rom_read(r, (offset + (address % 0x1000)) % get_chr_bytes(r));
 }
 
 void mapper1_chr_write(rom* r, uint16_t address, byte value) {
@@ -199,5 +212,5 @@ void mapper1_chr_write(rom* r, uint16_t address, byte value) {
     else {
         errx(EXIT_FAILURE, "Mapper 1: Attempt to write 0x%02X to out of range CHR address 0x%04X", value, address);
     }
-    r->chr_rom[offset + (address % 0x1000)] = value;
+    r->chr_rom[(offset + (address % 0x1000)) % get_chr_bytes(r)] = value;
 }
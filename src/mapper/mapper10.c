@@ -0,0 +1,29 @@
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "mapper10.h"
+#include "mapper9.h"
+#include "mapper1.h" // For helper functions
+
+void mapper10_init(rom* r) {
+    mapper9_init(r);
+}
+
+byte mapper10_prg_read(rom* r, uint16_t address) {
+    if (address < 0x8000) {
+        // Same RAM as the MMC2
+        return mapper9_prg_read(r, address);
+    }
+    else if (address < 0xC000) { // Switchable 16KB bank
+        return prg_rom_read(r, prg_offset_for_bank(r, r->mapperdata.prg_bank) + (address % 0x4000));
+    }
+    else { // Fixed to the last 16KB bank
+        return prg_rom_read(r, get_last_prg_bank(r) + (address % 0x4000));
+    }
+}
+
+byte mapper10_chr_read(rom* r, uint16_t address) {
+    byte result = chr_rom_read(r, mapper9_chr_index(r, address));
+    mapper9_update_latch(r, address, false);
+    return result;
+}
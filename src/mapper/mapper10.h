@@ -0,0 +1,9 @@
+#pragma once
+#include <stdint.h>
+#include "../util.h"
+#include "rom.h"
+
+// Everything else is the same as MMC2, see mapper9.h
+void mapper10_init(rom* r);
+byte mapper10_prg_read(rom* r, uint16_t address);
+byte mapper10_chr_read(rom* r, uint16_t address);
@@ -6,7 +6,8 @@
 
 #include "../debugger.h"
 
-void mapper2_init(mapper_data* mapperdata) {
+void mapper2_init(rom* r) {
+    mapper_data* mapperdata = &r->mapperdata;
     mapperdata->prg_bank_0_offset = 0;
     mapperdata->prg_bank_1_offset = -1;
 }
@@ -19,34 +20,28 @@ byte mapper2_prg_read(rom* r, uint16_t address) {
         result = 0x00;
     }
     else if (address < 0x8000) {
-        size_t prg_ram_bytes = get_prg_ram_bytes(r);
-        address -= 0x6000;
-        address %= prg_ram_bytes;
-        result = r->prg_ram[address];
+        result = prg_ram_read(r, address - 0x6000);
     }
     else if (address < 0xC000) { // PRG bank 0, 0x8000 - 0xBFFF
-        result = r->prg_rom[r->mapperdata.prg_bank_0_offset + (address % 0x4000)];
+        result = prg_rom_read(r, r->mapperdata.prg_bank_0_offset + (address % 0x4000));
     }
     else { // PRG bank 1, 0xC000 - 0xFFFF
         if (r->mapperdata.prg_bank_1_offset == -1) {
             r->mapperdata.prg_bank_1_offset = get_last_prg_bank(r);
         }
 
-        result = r->prg_rom[r->mapperdata.prg_bank_1_offset + (address % 0x4000)];
+        result = prg_rom_read(r, r->mapperdata.prg_bank_1_offset + (address % 0x4000));
     }
     return result;
 }
 
 void mapper2_prg_write(rom* r, uint16_t address, byte value) {
     if (address >= 0x6000 && address < 0x8000) {
-        size_t prg_ram_bytes = get_prg_ram_bytes(r);
-        address -= 0x6000;
-        address %= prg_ram_bytes;
-        r->prg_ram[address] = value;
-        printf("Wrote 0x%02X to 0x%04X\n", value, address + 0x6000);
+        prg_ram_write(r, address - 0x6000, value);
+        printf("Wrote 0x%02X to 0x%04X\n", value, address);
     }
     else if (address >= 0x8000) {
-        r->mapperdata.prg_bank_0_offset = (value % (r->header->prg_rom_blocks - 1)) * BYTES_PER_PRG_ROM_BLOCK;
+        r->mapperdata.prg_bank_0_offset = (value % (get_prg_rom_blocks(r) - 1)) * BYTES_PER_PRG_ROM_BLOCK;
     }
     else {
         printf("Mapper 2: unhandled write 0x%02X to PRG at 0x%04X\n", value, address);
@@ -54,10 +49,9 @@ void mapper2_prg_write(rom* r, uint16_t address, byte value) {
 }
 
 byte mapper2_chr_read(rom* r, uint16_t address) {
-    return r->chr_rom[address];
+    return chr_rom_read(r, address % get_chr_bytes(r));
 }
 
 void mapper2_chr_write(rom* r, uint16_t address, byte value) {
-    printf("WARNING: UxROM pattern tables (CHR ROM) written to! allowing it because I'm a dumb emulator\n");
-    r->chr_rom[address] = value;
+    r->chr_rom[address % get_chr_bytes(r)] = value;
 }
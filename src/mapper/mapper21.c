@@ -0,0 +1,134 @@
+#include <err.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mapper21.h"
+#include "mapper4.h" // For helper functions
+#include "../debugger.h"
+
+void mapper21_init(rom* r) {
+    r->mapperdata.prg_bank_mode = 0;
+    vrc_irq_init(r);
+}
+
+byte mapper21_prg_read(rom* r, uint16_t address) {
+    int bank;
+    if (address < 0x6000) {
+        dprintf("VRC4: Sub-0x6000 unsupported memory address read, 0x%04X\n", address);
+        return 0x00;
+    }
+    else if (address < 0x8000) {
+        return prg_ram_read(r, address - 0x6000);
+    }
+    else if (address < 0xA000) {
+        bank = r->mapperdata.prg_bank_mode == 0 ? r->mapperdata.prg_banks[0] : -2;
+    }
+    else if (address < 0xC000) {
+        bank = r->mapperdata.prg_banks[1];
+    }
+    else if (address < 0xE000) {
+        bank = r->mapperdata.prg_bank_mode == 0 ? -2 : r->mapperdata.prg_banks[0];
+    }
+    else {
+        bank = -1;
+    }
+    return prg_rom_read(r, prg_offset_for_8kb_bank(r, bank) + (address % 0x2000));
+}
+
+// reg is the register within each 0x1000 block, 0-3, once the board's wiring has been undone
+void vrc4_write(rom* r, uint16_t address, int reg, byte value) {
+    mapper_data* md = &r->mapperdata;
+    if (address < 0x6000) {
+        dprintf("VRC4: unhandled write 0x%02X to PRG at 0x%04X\n", value, address);
+    }
+    else if (address < 0x8000) {
+        prg_ram_write(r, address - 0x6000, value);
+    }
+    else if (address < 0x9000) {
+        md->prg_banks[0] = value & (byte)0b11111;
+    }
+    else if (address < 0xA000) {
+        // The VRC2 only has the one mirroring bit, and nothing else here
+        if (r->mapper != 22 && reg >= 2) {
+            md->prg_bank_mode = (value >> 1) & (byte)1;
+        }
+        else if (r->nametable_mirroring_mode != FOUR_SCREEN) {
+            static const nametable_mirroring modes[] = {VERTICAL, HORIZONTAL, SINGLE_LOWER, SINGLE_UPPER};
+            set_nametable_mirroring(r, modes[value & (r->mapper == 22 ? 0b01 : 0b11)]);
+        }
+    }
+    else if (address < 0xB000) {
+        md->prg_banks[1] = value & (byte)0b11111;
+    }
+    else if (address < 0xF000) {
+        // Each 1KB CHR bank is written a nybble at a time, low then high
+        int bank = ((address - 0xB000) / 0x1000) * 2 + reg / 2;
+        if (reg % 2 == 0) {
+            md->chr_banks[bank] = (md->chr_banks[bank] & 0x1F0) | (value & 0x0F);
+        }
+        else {
+            md->chr_banks[bank] = (md->chr_banks[bank] & 0x00F) | ((value & 0x1F) << 4);
+        }
+    }
+    else {
+        switch (reg) {
+            case 0:
+                vrc_irq_write_latch(r, (md->irq_latch & 0xF0) | (value & 0x0F));
+                break;
+            case 1:
+                vrc_irq_write_latch(r, (md->irq_latch & 0x0F) | (value << 4));
+                break;
+            case 2:
+                vrc_irq_write_control(r, value);
+                break;
+            default:
+                vrc_irq_acknowledge(r);
+                break;
+        }
+    }
+}
+
+// VRC4a on A1 and A2, VRC4c on A6 and A7
+void mapper21_prg_write(rom* r, uint16_t address, byte value) {
+    int reg = ((address >> 1) | (address >> 6)) & 1;
+    reg |= (((address >> 2) | (address >> 7)) & 1) << 1;
+    vrc4_write(r, address, reg, value);
+}
+
+// VRC2a on A1 and A0, the other way round
+void mapper22_prg_write(rom* r, uint16_t address, byte value) {
+    int reg = ((address >> 1) & 1) | ((address & 1) << 1);
+    vrc4_write(r, address, reg, value);
+}
+
+// VRC2b on A0 and A1, VRC4e on A2 and A3
+void mapper23_prg_write(rom* r, uint16_t address, byte value) {
+    int reg = (address | (address >> 2)) & 1;
+    reg |= (((address >> 1) | (address >> 3)) & 1) << 1;
+    vrc4_write(r, address, reg, value);
+}
+
+// VRC2c and VRC4b on A1 and A0, VRC4d on A3 and A2
+void mapper25_prg_write(rom* r, uint16_t address, byte value) {
+    int reg = ((address >> 1) | (address >> 3)) & 1;
+    reg |= ((address | (address >> 2)) & 1) << 1;
+    vrc4_write(r, address, reg, value);
+}
+
+int mapper21_chr_index(rom* r, uint16_t address) {
+    int bank = r->mapperdata.chr_banks[address / 0x400];
+    if (r->mapper == 22) {
+        // VRC2a ignores the low bit
+        bank >>= 1;
+    }
+    return (int)((bank * 0x400 + (address % 0x400)) % get_chr_bytes(r));
+}
+
+byte mapper21_chr_read(rom* r, uint16_t address) {
+    return chr_rom_read(r, mapper21_chr_index(r, address));
+}
+
+void mapper21_chr_write(rom* r, uint16_t address, byte value) {
+    r->chr_rom[mapper21_chr_index(r, address)] = value;
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include "../util.h"
+#include "rom.h"
+#include "vrc.h"
+
+/*
+ * VRC2 and VRC4, which are mappers 21, 22, 23 and 25 depending on which CPU address lines the board wired up to the
+ * register select pins. Each board only uses one pair, so the pairs for every board sharing a number are ORed together.
+ */
+void mapper21_init(rom* r);
+byte mapper21_prg_read(rom* r, uint16_t address);
+void mapper21_prg_write(rom* r, uint16_t address, byte value);
+void mapper22_prg_write(rom* r, uint16_t address, byte value);
+void mapper23_prg_write(rom* r, uint16_t address, byte value);
+void mapper25_prg_write(rom* r, uint16_t address, byte value);
+byte mapper21_chr_read(rom* r, uint16_t address);
+void mapper21_chr_write(rom* r, uint16_t address, byte value);
@@ -0,0 +1,101 @@
+#include <err.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mapper24.h"
+#include "mapper1.h" // For helper functions
+#include "mapper4.h"
+#include "../debugger.h"
+
+void mapper24_init(rom* r) {
+    r->mapperdata.ram_enabled = 0;
+    vrc_irq_init(r);
+}
+
+byte mapper24_prg_read(rom* r, uint16_t address) {
+    if (address < 0x6000) {
+        dprintf("VRC6: Sub-0x6000 unsupported memory address read, 0x%04X\n", address);
+        return 0x00;
+    }
+    else if (address < 0x8000) {
+        return r->mapperdata.ram_enabled ? prg_ram_read(r, address - 0x6000) : (byte)0x00;
+    }
+    else if (address < 0xC000) { // Switchable 16KB bank
+        return prg_rom_read(r, prg_offset_for_bank(r, r->mapperdata.prg_banks[0]) + (address % 0x4000));
+    }
+    else if (address < 0xE000) { // Switchable 8KB bank
+        return prg_rom_read(r, prg_offset_for_8kb_bank(r, r->mapperdata.prg_banks[1]) + (address % 0x2000));
+    }
+    else { // Fixed to the last 8KB bank
+        return prg_rom_read(r, prg_offset_for_8kb_bank(r, -1) + (address % 0x2000));
+    }
+}
+
+// The expansion audio registers at 0x9000-0xB002 aren't emulated, so writes to them are dropped. So are the CHR banking
+// modes other than the usual eight 1KB banks, which no commercial game uses.
+void vrc6_write(rom* r, uint16_t address, int reg, byte value) {
+    mapper_data* md = &r->mapperdata;
+    if (address < 0x6000) {
+        dprintf("VRC6: unhandled write 0x%02X to PRG at 0x%04X\n", value, address);
+    }
+    else if (address < 0x8000) {
+        if (md->ram_enabled) {
+            prg_ram_write(r, address - 0x6000, value);
+        }
+    }
+    else if (address < 0x9000) {
+        md->prg_banks[0] = value & (byte)0b1111;
+    }
+    else if (address < 0xB000 || (address < 0xC000 && reg != 3)) {
+        dprintf("VRC6: ignoring write 0x%02X to audio register 0x%04X\n", value, address);
+    }
+    else if (address < 0xC000) {
+        md->ram_enabled = (value >> 7) & (byte)1;
+        if (r->nametable_mirroring_mode != FOUR_SCREEN) {
+            static const nametable_mirroring modes[] = {VERTICAL, HORIZONTAL, SINGLE_LOWER, SINGLE_UPPER};
+            set_nametable_mirroring(r, modes[(value >> 2) & 0b11]);
+        }
+    }
+    else if (address < 0xD000) {
+        md->prg_banks[1] = value & (byte)0b11111;
+    }
+    else if (address < 0xF000) {
+        md->chr_banks[((address - 0xD000) / 0x1000) * 4 + reg] = value;
+    }
+    else {
+        switch (reg) {
+            case 0:
+                vrc_irq_write_latch(r, value);
+                break;
+            case 1:
+                vrc_irq_write_control(r, value);
+                break;
+            case 2:
+                vrc_irq_acknowledge(r);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void mapper24_prg_write(rom* r, uint16_t address, byte value) {
+    vrc6_write(r, address, address & 0b11, value);
+}
+
+void mapper26_prg_write(rom* r, uint16_t address, byte value) {
+    vrc6_write(r, address, ((address & 1) << 1) | ((address >> 1) & 1), value);
+}
+
+int mapper24_chr_index(rom* r, uint16_t address) {
+    return (int)((r->mapperdata.chr_banks[address / 0x400] * 0x400 + (address % 0x400)) % get_chr_bytes(r));
+}
+
+byte mapper24_chr_read(rom* r, uint16_t address) {
+    return chr_rom_read(r, mapper24_chr_index(r, address));
+}
+
+void mapper24_chr_write(rom* r, uint16_t address, byte value) {
+    r->chr_rom[mapper24_chr_index(r, address)] = value;
+}
@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+#include "../util.h"
+#include "rom.h"
+#include "vrc.h"
+
+// VRC6. Mapper 26 is the same chip with A0 and A1 swapped.
+void mapper24_init(rom* r);
+byte mapper24_prg_read(rom* r, uint16_t address);
+void mapper24_prg_write(rom* r, uint16_t address, byte value);
+void mapper26_prg_write(rom* r, uint16_t address, byte value);
+byte mapper24_chr_read(rom* r, uint16_t address);
+void mapper24_chr_write(rom* r, uint16_t address, byte value);
@@ -4,8 +4,8 @@
 
 #include "rom.h"
 
-void mapper31_init(mapper_data* mapperdata) {
-    mapperdata->prg_bank_7_offset = 0xFF;
+void mapper31_init(rom* r) {
+    r->mapperdata.prg_bank_7_offset = 0xFF;
 }
 
 int mapper31_get_bank(uint16_t address) {
@@ -37,18 +37,14 @@ int* mapper31_get_offset(int bank, mapper_data* mapperdata) {
 
 byte mapper31_prg_read(rom* r, uint16_t address) {
     if (address >= 0x6000 && address < 0x8000) {
-        size_t prg_ram_bytes = get_prg_ram_bytes(r);
-        address -= 0x6000;
-        address %= prg_ram_bytes;
-        byte result = r->prg_ram[address];
-        return result;
+        return prg_ram_read(r, address - 0x6000);
     }
     else if (address >= 0x8000) { // Can't be more than 0xFFFF
         int bank = mapper31_get_bank(address);
         int* offset = mapper31_get_offset(bank, &r->mapperdata);
 
         int prg_rom_address = (address % 0x1000) + (*offset * 0x1000);
-        byte result = r->prg_rom[prg_rom_address];
+        byte result = prg_rom_read(r, prg_rom_address);
 
         return result;
     }
@@ -59,10 +55,7 @@ byte mapper31_prg_read(rom* r, uint16_t address) {
 
 void mapper31_prg_write(rom* r, uint16_t address, byte value) {
     if (address >= 0x6000 && address < 0x8000) {
-        size_t prg_ram_bytes = get_prg_ram_bytes(r);
-        address -= 0x6000;
-        address %= prg_ram_bytes;
-        r->prg_ram[address] = value;
+        prg_ram_write(r, address - 0x6000, value);
     }
     else if (address >= 0x5000 && address <= 0x5fff){
         int bank_to_set = address & 0b111;
@@ -75,9 +68,9 @@ void mapper31_prg_write(rom* r, uint16_t address, byte value) {
 }
 
 byte mapper31_chr_read(rom* r, uint16_t address) {
-    return r->chr_rom[address];
+    return chr_rom_read(r, address % get_chr_bytes(r));
 }
 
 void mapper31_chr_write(rom* r, uint16_t address, byte value) {
-    r->chr_rom[address] = value;
+    r->chr_rom[address % get_chr_bytes(r)] = value;
 }
@@ -5,27 +5,26 @@
 
 #include "rom.h"
 #include "../debugger.h"
+#include "../scheduler.h"
 
 int prg_offset_for_8kb_bank(rom* r, int bank) {
     if (bank < 0) {
         // Bank is negative, so this'll get the last bank for -1, 2nd to last for -2, etc
-        bank = (r->header->prg_rom_blocks * 2) + bank; // prg_rom_blocks is given in 16kb units
+        bank = (get_prg_rom_blocks(r) * 2) + bank; // prg_rom_blocks is given in 16kb units
     }
 
     if (bank >= 0x80) {
         bank -= 0x100;
     }
-    bank %= (r->header->prg_rom_blocks * 2); // prg_rom_blocks is given in 16kb units
+    bank %= (get_prg_rom_blocks(r) * 2); // prg_rom_blocks is given in 16kb units
     int offset = bank * (0x2000);
     return offset;
 }
 
 int chr_offset_for_1kb_bank(rom *r, int bank) {
-    int blocks = r->header->chr_rom_blocks;
-    if (blocks == 0) {
-        blocks = 1;
-    }
-    bank %= (blocks * 8); // chr_rom_blocks is given in 8kb units
+    // NES 2.0 CHR RAM can be less than a bank, in which case there's only the one
+    int banks = (int)(get_chr_bytes(r) / 0x400);
+    bank %= banks > 0 ? banks : 1;
     int offset = bank * 0x400;
     dprintf("CHR bank %d offset = 0x%04X\n", bank, offset);
     return offset;
@@ -45,8 +44,8 @@ void mapper4_init(rom* r) {
     r->mapperdata.ram_enabled = 1;
     r->mapperdata.ram_write_protect = 0;
     r->mapperdata.irq_enable = false;
-
-    r->mapperdata.irq_next_cycle = false;
+    r->mapperdata.irq_latch = 0;
+    r->mapperdata.counter = 0;
 }
 
 byte mapper4_prg_read(rom* r, uint16_t address) {
@@ -56,34 +55,31 @@ byte mapper4_prg_read(rom* r, uint16_t address) {
         errx(EXIT_FAILURE, "MMC3: Invalid PRG read at 0x%04X", address);
     }
     else if (address < 0x8000) {
-        size_t prg_ram_bytes = get_prg_ram_bytes(r);
-        address -= 0x6000;
-        address %= prg_ram_bytes;
-        result = r->prg_ram[address];
+        result = prg_ram_read(r, address - 0x6000);
     }
     else if (address < 0xA000) {
         // 8KB switchable rom bank
         if (r->mapperdata.prg_bank_mode == 0) {
-            result = r->prg_rom[r->mapperdata.prg_bank_0_offset + (address % 0x2000)];
+            result = prg_rom_read(r, r->mapperdata.prg_bank_0_offset + (address % 0x2000));
         }
         else {
-            result = r->prg_rom[r->mapperdata.prg_bank_2_offset + (address % 0x2000)];
+            result = prg_rom_read(r, r->mapperdata.prg_bank_2_offset + (address % 0x2000));
         }
     }
     else if (address < 0xC000) {
         // 8KB switchable rom bank 2
-        result = r->prg_rom[r->mapperdata.prg_bank_1_offset + (address % 0x2000)];
+        result = prg_rom_read(r, r->mapperdata.prg_bank_1_offset + (address % 0x2000));
     }
     else if (address < 0xE000) {
         if (r->mapperdata.prg_bank_mode == 0) {
-            result = r->prg_rom[r->mapperdata.prg_bank_2_offset + (address % 0x2000)];
+            result = prg_rom_read(r, r->mapperdata.prg_bank_2_offset + (address % 0x2000));
         }
         else {
-            result = r->prg_rom[r->mapperdata.prg_bank_0_offset + (address % 0x2000)];
+            result = prg_rom_read(r, r->mapperdata.prg_bank_0_offset + (address % 0x2000));
         }
     }
     else { // <= 0xFFFF
-        result = r->prg_rom[r->mapperdata.prg_bank_3_offset + (address % 0x2000)];
+        result = prg_rom_read(r, r->mapperdata.prg_bank_3_offset + (address % 0x2000));
     }
 
     return result;
@@ -94,11 +90,8 @@ void mapper4_prg_write(rom* r, uint16_t address, byte value) {
         errx(EXIT_FAILURE, "MMC3: Unhandled PRG write at 0x%04X", address);
     }
     else if (address < 0x8000) { // RAM
-        size_t prg_ram_bytes = get_prg_ram_bytes(r);
-        address -= 0x6000;
-        address %= prg_ram_bytes;
-        r->prg_ram[address] = value;
-        dprintf("Wrote 0x%02X to 0x%04X\n", value, address + 0x6000);
+        prg_ram_write(r, address - 0x6000, value);
+        dprintf("Wrote 0x%02X to 0x%04X\n", value, address);
     }
     else if (address < 0xA000 && address % 2 == 0) {
         // Bank select
@@ -151,13 +144,16 @@ void mapper4_prg_write(rom* r, uint16_t address, byte value) {
         }
     }
     else if (address < 0xC000 && address % 2 == 0) {
-        // Mirroring
+        // Mirroring. Boards with four screen VRAM have this hardwired.
+        if (r->nametable_mirroring_mode == FOUR_SCREEN) {
+            return;
+        }
         if ((value & (byte)1) == 0) {
-            r->nametable_mirroring_mode = VERTICAL;
+            set_nametable_mirroring(r, VERTICAL);
             printf("Nametable mirroring mode is now: VERTICAL\n");
         }
         else {
-            r->nametable_mirroring_mode = HORIZONTAL;
+            set_nametable_mirroring(r, HORIZONTAL);
             printf("Nametable mirroring mode is now: HORIZONTAL\n");
         }
     }
@@ -176,8 +172,11 @@ void mapper4_prg_write(rom* r, uint16_t address, byte value) {
         r->mapperdata.counter = 0;
     }
     else if (address <= 0xFFFF && address % 2 == 0) {
-        // IRQ disable
+        // IRQ disable, which also acknowledges any pending IRQ
         r->mapperdata.irq_enable = false;
+        if (r->scheduler != NULL) {
+            release_irq(r->scheduler, IRQ_MAPPER);
+        }
         dprintf("IRQs are now DISABLED\n");
     }
     else if (address <= 0xFFFF && address % 2 == 1) {
@@ -240,22 +239,21 @@ int mapper4_get_chr_rom_index(rom *r, uint16_t address) {
 }
 
 byte mapper4_chr_read(rom* r, uint16_t address) {
-    return r->chr_rom[mapper4_get_chr_rom_index(r, address)];
+    return chr_rom_read(r, mapper4_get_chr_rom_index(r, address) % get_chr_bytes(r));
 }
 
 void mapper4_chr_write(rom* r, uint16_t address, byte value) {
-    r->chr_rom[mapper4_get_chr_rom_index(r, address)] = value;
+    r->chr_rom[mapper4_get_chr_rom_index(r, address) % get_chr_bytes(r)] = value;
 }
 
-void mapper4_ppu_step(rom* r, int cycle, int scan_line, bool rendering_enabled) {
-    if (cycle == 260 && rendering_enabled && scan_line < 231) {
-        if (r->mapperdata.counter == 0) {
-            r->mapperdata.counter = r->mapperdata.irq_latch;
-        }
-        else {
-            if (--r->mapperdata.counter == 0 && r->mapperdata.irq_enable) {
-                r->mapperdata.irq_next_cycle = true;
-            }
+bool mapper4_a12_rise(rom* r) {
+    if (r->mapperdata.counter == 0) {
+        r->mapperdata.counter = r->mapperdata.irq_latch;
+    }
+    else {
+        if (--r->mapperdata.counter == 0 && r->mapperdata.irq_enable) {
+            return true;
         }
     }
+    return false;
 }
@@ -8,5 +8,10 @@ byte mapper4_prg_read(rom* r, uint16_t address);
 void mapper4_prg_write(rom* r, uint16_t address, byte value);
 byte mapper4_chr_read(rom* r, uint16_t address);
 void mapper4_chr_write(rom* r, uint16_t address, byte value);
-void mapper4_ppu_step(rom* r, int cycle, int scan_line, bool rendering_enabled);
+bool mapper4_a12_rise(rom* r);
+
+// Bank numbers to offsets, shared with the other mappers that bank in 8KB PRG and 1KB CHR units. Negative PRG banks count
+// back from the end.
+int prg_offset_for_8kb_bank(rom* r, int bank);
+int chr_offset_for_1kb_bank(rom *r, int bank);
 
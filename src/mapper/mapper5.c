@@ -0,0 +1,263 @@
+#include <err.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "mapper5.h"
+#include "mapper4.h" // For helper functions
+#include "../debugger.h"
+#include "../scheduler.h"
+
+// prg_banks 0 is 0x5113 (the RAM bank at 0x6000), 1-4 are 0x5114-0x5117. chr_banks are 0x5120-0x512B, 0-7 being set A
+// and 8-11 set B. irq_latch is the line to raise the IRQ on, counter the line the PPU is on.
+
+// Where ExRAM and the fill mode nametable live in the PPU's nametable RAM, past the 2KB the console uses itself
+#define MMC5_EXRAM_PAGE 0x800
+#define MMC5_FILL_PAGE 0xC00
+#define MMC5_EXRAM_BYTES 0x400
+
+#define MMC5_ROM_BANK 0b10000000
+
+void mapper5_init(rom* r) {
+    r->mapperdata.prg_bank_mode = 3;
+    r->mapperdata.prg_banks[4] = 0xFF;
+    r->mapperdata.chr_bank_mode = 3;
+}
+
+// Which 8KB bank each of 0x8000, 0xA000, 0xC000 and 0xE000 (slot 0-3) is mapped to. Sets rom_bank to false if it's RAM.
+int mapper5_prg_bank(rom* r, int slot, bool* rom_bank) {
+    mapper_data* md = &r->mapperdata;
+    byte value;
+    int bank;
+    switch (md->prg_bank_mode) {
+        case 0: // One 32KB bank
+            value = md->prg_banks[4];
+            bank = (value & 0b1111100) | slot;
+            break;
+        case 1: // Two 16KB banks
+            value = md->prg_banks[slot < 2 ? 2 : 4];
+            bank = (value & 0b1111110) | (slot & 1);
+            break;
+        case 2: // One 16KB bank then two 8KB banks
+            value = md->prg_banks[slot < 2 ? 2 : slot + 1];
+            bank = slot < 2 ? (value & 0b1111110) | (slot & 1) : value & 0b1111111;
+            break;
+        default: // Four 8KB banks
+            value = md->prg_banks[slot + 1];
+            bank = value & 0b1111111;
+            break;
+    }
+    // The last bank is always ROM
+    *rom_bank = slot == 3 || (value & MMC5_ROM_BANK);
+    return bank;
+}
+
+bool mapper5_ram_writable(rom* r) {
+    return r->mapperdata.ram_protect[0] == 0b10 && r->mapperdata.ram_protect[1] == 0b01;
+}
+
+size_t mapper5_ram_offset(int bank, uint16_t address) {
+    return (size_t)(bank & 0b111) * 0x2000 + (address % 0x2000);
+}
+
+// Fill mode is done by keeping a nametable of nothing but the fill tile and attribute in the spare page
+void mapper5_update_fill(rom* r, uint16_t offset, byte value, uint16_t length) {
+    if (r->nametable_ram != NULL) {
+        memset(r->nametable_ram + MMC5_FILL_PAGE + offset, value, length);
+    }
+}
+
+byte mapper5_read_register(rom* r, uint16_t address) {
+    mapper_data* md = &r->mapperdata;
+    switch (address) {
+        case 0x5204: {
+            byte status = (byte)(md->irq_pending << 7) | (byte)(md->in_frame << 6);
+            // Reading acknowledges the IRQ
+            md->irq_pending = false;
+            if (r->scheduler != NULL) {
+                release_irq(r->scheduler, IRQ_MAPPER);
+            }
+            return status;
+        }
+        case 0x5205:
+            return (byte)(md->multiplicand[0] * md->multiplicand[1]);
+        case 0x5206:
+            return (byte)((md->multiplicand[0] * md->multiplicand[1]) >> 8);
+        default:
+            dprintf("MMC5: unhandled read from 0x%04X\n", address);
+            return 0x00;
+    }
+}
+
+void mapper5_write_register(rom* r, uint16_t address, byte value) {
+    mapper_data* md = &r->mapperdata;
+    if (address >= 0x5114 && address <= 0x5117) {
+        md->prg_banks[address - 0x5113] = value;
+    }
+    else if (address >= 0x5120 && address <= 0x512B) {
+        md->chr_banks[address - 0x5120] = value | (md->chr_upper_bits << 8);
+        md->chr_set_b_last = address >= 0x5128;
+    }
+    else {
+        switch (address) {
+            case 0x5100:
+                md->prg_bank_mode = value & (byte)0b11;
+                break;
+            case 0x5101:
+                md->chr_bank_mode = value & (byte)0b11;
+                break;
+            case 0x5102:
+                md->ram_protect[0] = value & (byte)0b11;
+                break;
+            case 0x5103:
+                md->ram_protect[1] = value & (byte)0b11;
+                break;
+            case 0x5104:
+                md->exram_mode = value & (byte)0b11;
+                break;
+            case 0x5105: {
+                // Two bits for each nametable: CIRAM page 0 or 1, ExRAM or fill mode
+                static const uint16_t pages[] = {0x000, 0x400, MMC5_EXRAM_PAGE, MMC5_FILL_PAGE};
+                for (int i = 0; i < 4; i++) {
+                    r->nametable_pages[i] = pages[(value >> (i * 2)) & 0b11];
+                }
+                break;
+            }
+            case 0x5106:
+                mapper5_update_fill(r, 0, value, 0x3C0);
+                break;
+            case 0x5107:
+                mapper5_update_fill(r, 0x3C0, (value & 0b11) * (byte)0b01010101, 0x40);
+                break;
+            case 0x5113:
+                md->prg_banks[0] = value;
+                break;
+            case 0x5130:
+                md->chr_upper_bits = value & (byte)0b11;
+                break;
+            case 0x5203:
+                md->irq_latch = value;
+                break;
+            case 0x5204:
+                md->irq_enable = (value & 0b10000000) != 0;
+                if (r->scheduler != NULL) {
+                    if (md->irq_enable && md->irq_pending) {
+                        assert_irq(r->scheduler, IRQ_MAPPER);
+                    }
+                    else {
+                        release_irq(r->scheduler, IRQ_MAPPER);
+                    }
+                }
+                break;
+            case 0x5205:
+                md->multiplicand[0] = value;
+                break;
+            case 0x5206:
+                md->multiplicand[1] = value;
+                break;
+            default:
+                // Including the expansion audio at 0x5000-0x5015
+                dprintf("MMC5: unhandled write 0x%02X to 0x%04X\n", value, address);
+                break;
+        }
+    }
+}
+
+byte mapper5_prg_read(rom* r, uint16_t address) {
+    if (address < 0x5C00) {
+        return mapper5_read_register(r, address);
+    }
+    else if (address < 0x6000) {
+        // ExRAM, only readable by the CPU in modes 2 and 3
+        if (r->mapperdata.exram_mode < 2 || r->nametable_ram == NULL) {
+            return 0x00;
+        }
+        return r->nametable_ram[MMC5_EXRAM_PAGE + (address % MMC5_EXRAM_BYTES)];
+    }
+    else if (address < 0x8000) {
+        return prg_ram_read(r, mapper5_ram_offset(r->mapperdata.prg_banks[0], address));
+    }
+    else {
+        bool rom_bank;
+        int bank = mapper5_prg_bank(r, (address - 0x8000) / 0x2000, &rom_bank);
+        if (!rom_bank) {
+            return prg_ram_read(r, mapper5_ram_offset(bank, address));
+        }
+        return prg_rom_read(r, prg_offset_for_8kb_bank(r, bank) + (address % 0x2000));
+    }
+}
+
+void mapper5_prg_write(rom* r, uint16_t address, byte value) {
+    if (address < 0x5C00) {
+        mapper5_write_register(r, address, value);
+    }
+    else if (address < 0x6000) {
+        // Read only in mode 3
+        if (r->mapperdata.exram_mode != 3 && r->nametable_ram != NULL) {
+            r->nametable_ram[MMC5_EXRAM_PAGE + (address % MMC5_EXRAM_BYTES)] = value;
+        }
+    }
+    else if (!mapper5_ram_writable(r)) {
+        dprintf("MMC5: PRG RAM is write protected, dropping write 0x%02X to 0x%04X\n", value, address);
+    }
+    else if (address < 0x8000) {
+        prg_ram_write(r, mapper5_ram_offset(r->mapperdata.prg_banks[0], address), value);
+    }
+    else {
+        bool rom_bank;
+        int bank = mapper5_prg_bank(r, (address - 0x8000) / 0x2000, &rom_bank);
+        if (!rom_bank) {
+            prg_ram_write(r, mapper5_ram_offset(bank, address), value);
+        }
+    }
+}
+
+/*
+ * Set A is eight registers and set B four, each covering 8KB, 4KB, 2KB or 1KB depending on the mode. Set B is repeated
+ * in both pattern tables. With 8x16 sprites, sprites use set A and the background set B. Otherwise everything uses
+ * whichever set was written last.
+ */
+int mapper5_chr_index(rom* r, uint16_t address) {
+    mapper_data* md = &r->mapperdata;
+    int mode = md->chr_bank_mode;
+    int size = 0x2000 >> mode;
+    bool set_b = r->ppu_tall_sprites ? !r->ppu_fetching_sprites : md->chr_set_b_last;
+    if (set_b) {
+        address &= 0x0FFF;
+    }
+    // The last register of each slot does the work when the banks are bigger than 1KB
+    int reg = ((address / size) + 1) * (8 >> mode) - 1;
+    if (set_b) {
+        reg = 8 + (reg & 0b11);
+    }
+    return (int)((md->chr_banks[reg] * size + (address % size)) % get_chr_bytes(r));
+}
+
+byte mapper5_chr_read(rom* r, uint16_t address) {
+    return chr_rom_read(r, mapper5_chr_index(r, address));
+}
+
+void mapper5_chr_write(rom* r, uint16_t address, byte value) {
+    r->chr_rom[mapper5_chr_index(r, address)] = value;
+}
+
+// The real thing spots a new line by the PPU fetching the same nametable byte three times in a row at the end of the
+// one before, and the end of the frame by the fetches stopping
+bool mapper5_scanline(rom* r, int line) {
+    mapper_data* md = &r->mapperdata;
+    if (line >= 240) {
+        md->in_frame = false;
+        return false;
+    }
+    if (line == 0 || !md->in_frame) {
+        md->in_frame = true;
+        md->counter = 0;
+        return false;
+    }
+    if (++md->counter == md->irq_latch) {
+        md->irq_pending = true;
+        return md->irq_enable;
+    }
+    return false;
+}
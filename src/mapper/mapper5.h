@@ -0,0 +1,16 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include "../util.h"
+#include "rom.h"
+
+/*
+ * MMC5. Covers PRG and CHR banking, PRG RAM, ExRAM as a nametable or plain RAM, fill mode, the scan line IRQ and the
+ * multiplier. Expansion audio, extended attributes and the vertical split aren't emulated.
+ */
+void mapper5_init(rom* r);
+byte mapper5_prg_read(rom* r, uint16_t address);
+void mapper5_prg_write(rom* r, uint16_t address, byte value);
+byte mapper5_chr_read(rom* r, uint16_t address);
+void mapper5_chr_write(rom* r, uint16_t address, byte value);
+bool mapper5_scanline(rom* r, int line);
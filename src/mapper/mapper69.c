@@ -0,0 +1,143 @@
+#include <err.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mapper69.h"
+#include "mapper.h"
+#include "mapper4.h" // For helper functions
+#include "../debugger.h"
+
+// prg_banks 0 is the 0x6000 bank, 1-3 are 0x8000, 0xA000 and 0xC000
+#define FME7_RAM_SELECT 0b01000000
+#define FME7_RAM_ENABLE 0b10000000
+
+void mapper69_init(rom* r) {
+    r->mapperdata.irq_cycle = mapper_current_cycle(r);
+}
+
+byte mapper69_prg_read(rom* r, uint16_t address) {
+    int bank;
+    if (address < 0x6000) {
+        dprintf("FME-7: Sub-0x6000 unsupported memory address read, 0x%04X\n", address);
+        return 0x00;
+    }
+    else if (address < 0x8000) {
+        byte select = r->mapperdata.prg_banks[0];
+        if (!(select & FME7_RAM_SELECT)) {
+            bank = select & 0b111111;
+        }
+        else if (select & FME7_RAM_ENABLE) {
+            return prg_ram_read(r, address - 0x6000);
+        }
+        else {
+            return 0x00;
+        }
+    }
+    else if (address < 0xE000) {
+        bank = r->mapperdata.prg_banks[1 + (address - 0x8000) / 0x2000];
+    }
+    else {
+        bank = -1;
+    }
+    return prg_rom_read(r, prg_offset_for_8kb_bank(r, bank) + (address % 0x2000));
+}
+
+// The IRQ counter counts down every CPU cycle, and goes off when it wraps from 0 to 0xFFFF
+void mapper69_catch_up(rom* r, uint64_t cycle) {
+    mapper_data* md = &r->mapperdata;
+    uint64_t cycles = cycle - md->irq_cycle;
+    md->irq_cycle = cycle;
+    if (!md->irq_counter_enable) {
+        return;
+    }
+    if (cycles > md->irq_counter && md->irq_enable) {
+        md->irq_pending = true;
+        if (r->scheduler != NULL) {
+            assert_irq(r->scheduler, IRQ_MAPPER);
+        }
+    }
+    md->irq_counter = (uint16_t)(md->irq_counter - cycles);
+}
+
+void mapper69_write_parameter(rom* r, byte value) {
+    mapper_data* md = &r->mapperdata;
+    byte command = md->command;
+    if (command < 0x8) {
+        md->chr_banks[command] = value;
+    }
+    else if (command == 0x8) {
+        md->prg_banks[0] = value;
+    }
+    else if (command < 0xC) {
+        md->prg_banks[command - 0x8] = value & (byte)0b111111;
+    }
+    else if (command == 0xC) {
+        if (r->nametable_mirroring_mode != FOUR_SCREEN) {
+            static const nametable_mirroring modes[] = {VERTICAL, HORIZONTAL, SINGLE_LOWER, SINGLE_UPPER};
+            set_nametable_mirroring(r, modes[value & 0b11]);
+        }
+    }
+    else {
+        // Everything else is the IRQ, so catch it up before it changes
+        mapper69_catch_up(r, mapper_current_cycle(r));
+        if (command == 0xD) {
+            // Any write acknowledges the IRQ
+            md->irq_enable = (value & 0b00000001) != 0;
+            md->irq_counter_enable = (value & 0b10000000) != 0;
+            md->irq_pending = false;
+            if (r->scheduler != NULL) {
+                release_irq(r->scheduler, IRQ_MAPPER);
+            }
+        }
+        else if (command == 0xE) {
+            md->irq_counter = (md->irq_counter & 0xFF00) | value;
+        }
+        else {
+            md->irq_counter = (md->irq_counter & 0x00FF) | (value << 8);
+        }
+    }
+}
+
+void mapper69_prg_write(rom* r, uint16_t address, byte value) {
+    if (address < 0x6000) {
+        dprintf("FME-7: unhandled write 0x%02X to PRG at 0x%04X\n", value, address);
+    }
+    else if (address < 0x8000) {
+        byte select = r->mapperdata.prg_banks[0];
+        if ((select & FME7_RAM_SELECT) && (select & FME7_RAM_ENABLE)) {
+            prg_ram_write(r, address - 0x6000, value);
+        }
+    }
+    else if (address < 0xA000) {
+        r->mapperdata.command = value & (byte)0b1111;
+    }
+    else if (address < 0xC000) {
+        mapper69_write_parameter(r, value);
+    }
+    else {
+        // Sunsoft 5B audio isn't emulated
+        dprintf("FME-7: ignoring write 0x%02X to audio register 0x%04X\n", value, address);
+    }
+}
+
+timestamp mapper69_timer(rom* r, timestamp time) {
+    mapper_data* md = &r->mapperdata;
+    mapper69_catch_up(r, mapper_cpu_cycle(time));
+    if (!md->irq_counter_enable || !md->irq_enable) {
+        return NEVER;
+    }
+    return (md->irq_cycle + md->irq_counter + 1) * DOTS_PER_CPU_CYCLE;
+}
+
+int mapper69_chr_index(rom* r, uint16_t address) {
+    return (int)((r->mapperdata.chr_banks[address / 0x400] * 0x400 + (address % 0x400)) % get_chr_bytes(r));
+}
+
+byte mapper69_chr_read(rom* r, uint16_t address) {
+    return chr_rom_read(r, mapper69_chr_index(r, address));
+}
+
+void mapper69_chr_write(rom* r, uint16_t address, byte value) {
+    r->chr_rom[mapper69_chr_index(r, address)] = value;
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+#include "../util.h"
+#include "../scheduler.h"
+#include "rom.h"
+
+void mapper69_init(rom* r);
+byte mapper69_prg_read(rom* r, uint16_t address);
+void mapper69_prg_write(rom* r, uint16_t address, byte value);
+byte mapper69_chr_read(rom* r, uint16_t address);
+void mapper69_chr_write(rom* r, uint16_t address, byte value);
+timestamp mapper69_timer(rom* r, timestamp time);
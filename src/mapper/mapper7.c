@@ -4,20 +4,16 @@
 
 #include "rom.h"
 
-void mapper7_init(mapper_data* mapperdata) {}
+void mapper7_init(rom* r) {}
 
 byte mapper7_prg_read(rom* r, uint16_t address) {
 
     if (address >= 0x6000 && address < 0x8000) {
-        size_t prg_ram_bytes = get_prg_ram_bytes(r);
-        address -= 0x6000;
-        address %= prg_ram_bytes;
-        byte result = r->prg_ram[address];
-        return result;
+        return prg_ram_read(r, address - 0x6000);
     }
     else if (address >= 0x8000) { // Can't be more than 0xFFFF
         int prg_rom_index = (address - 0x8000) + r->mapperdata.prg_bank_0_offset;
-        byte result = r->prg_rom[prg_rom_index];
+        byte result = prg_rom_read(r, prg_rom_index);
 
         return result;
     }
@@ -28,19 +24,16 @@ byte mapper7_prg_read(rom* r, uint16_t address) {
 
 void mapper7_prg_write(rom* r, uint16_t address, byte value) {
     if (address >= 0x6000 && address < 0x8000) {
-        size_t prg_ram_bytes = get_prg_ram_bytes(r);
-        address -= 0x6000;
-        address %= prg_ram_bytes;
-        r->prg_ram[address] = value;
-        printf("Wrote 0x%02X to 0x%04X\n", value, address + 0x6000);
+        prg_ram_write(r, address - 0x6000, value);
+        printf("Wrote 0x%02X to 0x%04X\n", value, address);
     }
     else if (address >= 0x8000){
         switch ((value & 0b00010000) >> 4) {
             case 0:
-                r->nametable_mirroring_mode = SINGLE_LOWER;
+                set_nametable_mirroring(r, SINGLE_LOWER);
                 break;
             case 1:
-                r->nametable_mirroring_mode = SINGLE_UPPER;
+                set_nametable_mirroring(r, SINGLE_UPPER);
                 break;
             default:
                 break;
@@ -52,9 +45,9 @@ void mapper7_prg_write(rom* r, uint16_t address, byte value) {
 }
 
 byte mapper7_chr_read(rom* r, uint16_t address) {
-    return r->chr_rom[address];
+    return chr_rom_read(r, address % get_chr_bytes(r));
 }
 
 void mapper7_chr_write(rom* r, uint16_t address, byte value) {
-    r->chr_rom[address] = value;
+    r->chr_rom[address % get_chr_bytes(r)] = value;
 }
@@ -0,0 +1,92 @@
+#include <err.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "mapper9.h"
+#include "mapper4.h" // For helper functions
+#include "../debugger.h"
+
+#define LATCH_FD 0
+#define LATCH_FE 1
+
+// chr_banks 0-3 are 0x0000/FD, 0x0000/FE, 0x1000/FD, 0x1000/FE
+void mapper9_init(rom* r) {
+    r->mapperdata.prg_bank = 0;
+    r->mapperdata.chr_latch[0] = LATCH_FE;
+    r->mapperdata.chr_latch[1] = LATCH_FE;
+}
+
+byte mapper9_prg_read(rom* r, uint16_t address) {
+    if (address < 0x6000) {
+        dprintf("MMC2: Sub-0x6000 unsupported memory address read, 0x%04X\n", address);
+        return 0x00;
+    }
+    else if (address < 0x8000) {
+        return prg_ram_read(r, address - 0x6000);
+    }
+    else if (address < 0xA000) { // Switchable 8KB bank
+        return prg_rom_read(r, prg_offset_for_8kb_bank(r, r->mapperdata.prg_bank) + (address % 0x2000));
+    }
+    else { // The last three 8KB banks are fixed
+        int bank = ((address - 0xA000) / 0x2000) - 3;
+        return prg_rom_read(r, prg_offset_for_8kb_bank(r, bank) + (address % 0x2000));
+    }
+}
+
+void mapper9_prg_write(rom* r, uint16_t address, byte value) {
+    if (address < 0x6000) {
+        dprintf("MMC2: unhandled write 0x%02X to PRG at 0x%04X\n", value, address);
+    }
+    else if (address < 0x8000) {
+        prg_ram_write(r, address - 0x6000, value);
+    }
+    else if (address < 0xA000) {
+        dprintf("MMC2: unhandled write 0x%02X to PRG at 0x%04X\n", value, address);
+    }
+    else if (address < 0xB000) {
+        r->mapperdata.prg_bank = value & (byte)0b1111;
+    }
+    else if (address < 0xF000) {
+        r->mapperdata.chr_banks[(address - 0xB000) / 0x1000] = value & (byte)0b11111;
+    }
+    else if (r->nametable_mirroring_mode != FOUR_SCREEN) {
+        set_nametable_mirroring(r, (value & 1) ? HORIZONTAL : VERTICAL);
+    }
+}
+
+int mapper9_chr_index(rom* r, uint16_t address) {
+    int table = address / 0x1000;
+    int bank = r->mapperdata.chr_banks[table * 2 + r->mapperdata.chr_latch[table]];
+    return (int)((bank * 0x1000 + (address % 0x1000)) % get_chr_bytes(r));
+}
+
+// Fetching from tile FD or FE switches that pattern table to the matching bank, but only after the fetch. The MMC2 only
+// looks at one address for the first table, the MMC4 (and both for the second table) look at the whole high plane.
+void mapper9_update_latch(rom* r, uint16_t address, bool exact) {
+    uint16_t tile_address = address & (uint16_t)0x0FF8;
+    if (exact && address < 0x1000) {
+        if (address == 0x0FD8) {
+            r->mapperdata.chr_latch[0] = LATCH_FD;
+        }
+        else if (address == 0x0FE8) {
+            r->mapperdata.chr_latch[0] = LATCH_FE;
+        }
+    }
+    else if (tile_address == 0x0FD8) {
+        r->mapperdata.chr_latch[address / 0x1000] = LATCH_FD;
+    }
+    else if (tile_address == 0x0FE8) {
+        r->mapperdata.chr_latch[address / 0x1000] = LATCH_FE;
+    }
+}
+
+byte mapper9_chr_read(rom* r, uint16_t address) {
+    byte result = chr_rom_read(r, mapper9_chr_index(r, address));
+    mapper9_update_latch(r, address, true);
+    return result;
+}
+
+void mapper9_chr_write(rom* r, uint16_t address, byte value) {
+    r->chr_rom[mapper9_chr_index(r, address)] = value;
+}
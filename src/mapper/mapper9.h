@@ -0,0 +1,14 @@
+#pragma once
+#include <stdint.h>
+#include "../util.h"
+#include "rom.h"
+
+void mapper9_init(rom* r);
+byte mapper9_prg_read(rom* r, uint16_t address);
+void mapper9_prg_write(rom* r, uint16_t address, byte value);
+byte mapper9_chr_read(rom* r, uint16_t address);
+void mapper9_chr_write(rom* r, uint16_t address, byte value);
+
+// Shared with MMC4, which only differs in PRG banking and which fetches flip the latches
+int mapper9_chr_index(rom* r, uint16_t address);
+void mapper9_update_latch(rom* r, uint16_t address, bool exact);
@@ -3,9 +3,17 @@
 #include <string.h>
 #include <err.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "rom.h"
+#include "romdb.h"
+#include "sram.h"
 #include "mapper.h"
+#include "../debugger.h"
 
 const unsigned char magic_string[4] = {0x4E, 0x45, 0x53, 0x1A}; // ASCII: NES<EOF>
 
@@ -18,77 +26,306 @@ int has_trainer(ines_header* header) {
     return (header->flags_6 & 0b00000100) > 0;
 }
 
+bool is_nes2(ines_header* header) {
+    return (header->flags_7 & 0b00001100) == 0b00001000;
+}
+
+// Old dumps sometimes have junk like "DiskDude!" in bytes 7-15. If they aren't zero, only trust flags 6.
+bool is_archaic_ines(ines_header* header) {
+    return !is_nes2(header) && (header->flags_12 | header->flags_13 | header->flags_14 | header->flags_15) != 0;
+}
+
 size_t get_prg_rom_bytes(rom* r) {
-  return (size_t) BYTES_PER_PRG_ROM_BLOCK * r->header->prg_rom_blocks;
+    return r->prg_rom_size;
 }
 
 size_t get_prg_ram_bytes(rom* r) {
-    size_t prg_ram_blocks = r->header->prg_ram_blocks;
-    if (prg_ram_blocks == 0) {
-        prg_ram_blocks = 1;
-    }
-
-    return prg_ram_blocks * BYTES_PER_PRG_RAM_BLOCK;
+    return r->prg_ram_size + r->prg_nvram_size;
 }
 
 size_t get_chr_rom_bytes(rom* r) {
-  int blocks = r->header->chr_rom_blocks;
+    return r->chr_rom_size;
+}
 
-  // See https://wiki.nesdev.com/w/index.php/INES#iNES_file_format
-  if (blocks == 0) {
-    blocks = 1;
-  }
+size_t get_chr_bytes(rom* r) {
+    return r->chr_ram ? r->chr_ram_size + r->chr_nvram_size : r->chr_rom_size;
+}
+
+int get_prg_rom_blocks(rom* r) {
+    return r->prg_rom_size / BYTES_PER_PRG_ROM_BLOCK;
+}
 
-  return (size_t) blocks * BYTES_PER_CHR_ROM_BLOCK;
+int get_chr_rom_blocks(rom* r) {
+    return r->chr_rom_size / BYTES_PER_CHR_ROM_BLOCK;
 }
 
+uint16_t get_mapper_number(rom* r) {
+    uint16_t lower_nybble = r->header->flags_6 & (byte)0b11110000;
+    uint16_t upper_nybble = r->header->flags_7 & (byte)0b11110000;
+
+    if (is_archaic_ines(r->header)) {
+        return lower_nybble >> 4;
+    }
+    else if (is_nes2(r->header)) {
+        return (lower_nybble >> 4) | upper_nybble | ((r->header->flags_8 & 0x0F) << 8);
+    }
+    return (lower_nybble >> 4) | upper_nybble;
+}
 
-unsigned char get_mapper_number(rom* r) {
-  unsigned char lower_nybble = r->header->flags_6 & (byte)0b11110000;
-  unsigned char upper_nybble = r->header->flags_7 & (byte)0b11110000;
+// NES 2.0 ROM sizes are a 12 bit count of blocks, or if the MSB nybble is F, 2^E * (MM * 2 + 1) bytes with the LSB as EEEEEEMM
+size_t nes2_rom_bytes(byte lsb, byte msb, size_t block_bytes) {
+    if (msb == 0xF) {
+        return ((size_t)1 << (lsb >> 2)) * ((lsb & 0b11) * 2 + 1);
+    }
+    return (((size_t)msb << 8) | lsb) * block_bytes;
+}
 
-  return (lower_nybble >> 4 ) | upper_nybble;
+// NES 2.0 RAM sizes are 64 << shift bytes, a shift of 0 means there isn't any
+size_t nes2_ram_bytes(byte shift) {
+    return shift == 0 ? 0 : (size_t)64 << shift;
+}
+
+void parse_header(rom* r) {
+    ines_header* header = r->header;
+
+    r->nes2 = is_nes2(header);
+    r->battery = (header->flags_6 & 0b00000010) > 0;
+    r->mapper = get_mapper_number(r);
+
+    if (r->nes2) {
+        r->submapper = header->flags_8 >> 4;
+        r->prg_rom_size = nes2_rom_bytes(header->prg_rom_blocks, header->flags_9 & 0x0F, BYTES_PER_PRG_ROM_BLOCK);
+        r->chr_rom_size = nes2_rom_bytes(header->chr_rom_blocks, header->flags_9 >> 4, BYTES_PER_CHR_ROM_BLOCK);
+        r->prg_ram_size = nes2_ram_bytes(header->flags_10 & 0x0F);
+        r->prg_nvram_size = nes2_ram_bytes(header->flags_10 >> 4);
+        r->chr_ram_size = nes2_ram_bytes(header->flags_11 & 0x0F);
+        r->chr_nvram_size = nes2_ram_bytes(header->flags_11 >> 4);
+    }
+    else {
+        r->submapper = 0;
+        r->prg_rom_size = (size_t)header->prg_rom_blocks * BYTES_PER_PRG_ROM_BLOCK;
+        r->chr_rom_size = (size_t)header->chr_rom_blocks * BYTES_PER_CHR_ROM_BLOCK;
+
+        // iNES can't say there's no PRG RAM, so there's always at least 8KB. With a battery, all of it is kept.
+        size_t prg_ram_blocks = is_archaic_ines(header) || header->flags_8 == 0 ? 1 : header->flags_8;
+        r->prg_ram_size = prg_ram_blocks * BYTES_PER_PRG_RAM_BLOCK;
+        r->prg_nvram_size = 0;
+        if (r->battery) {
+            r->prg_nvram_size = r->prg_ram_size;
+            r->prg_ram_size = 0;
+        }
+
+        // See https://wiki.nesdev.com/w/index.php/INES#iNES_file_format
+        r->chr_ram_size = header->chr_rom_blocks == 0 ? BYTES_PER_CHR_ROM_BLOCK : 0;
+        r->chr_nvram_size = 0;
+    }
+
+    dprintf("%s header: mapper %d.%d, %lu/%lu bytes of PRG RAM/NVRAM, %lu/%lu bytes of CHR RAM/NVRAM\n",
+            r->nes2 ? "NES 2.0" : "iNES", r->mapper, r->submapper,
+            r->prg_ram_size, r->prg_nvram_size, r->chr_ram_size, r->chr_nvram_size);
+}
+
+byte prg_ram_read(rom* r, size_t offset) {
+    size_t prg_ram_bytes = get_prg_ram_bytes(r);
+    if (prg_ram_bytes == 0) {
+        return 0;
+    }
+    return r->prg_ram[offset % prg_ram_bytes];
+}
+
+void prg_ram_write(rom* r, size_t offset, byte value) {
+    size_t prg_ram_bytes = get_prg_ram_bytes(r);
+    if (prg_ram_bytes == 0) {
+        return;
+    }
+    offset %= prg_ram_bytes;
+    if (r->sram != NULL && offset >= r->prg_ram_size) {
+        // Rewriting the same value is common and doesn't need saving
+        if (r->prg_ram[offset] == value) {
+            return;
+        }
+        sram_mark_dirty(r->sram, offset - r->prg_ram_size);
+    }
+    r->prg_ram[offset] = value;
 }
 
 /*
  * For reading the rom itself
  */
-void read_trainer(FILE* fp, rom* r) {
-    if (has_trainer(r->header)) {
-        r->trainer = malloc(TRAINER_BYTES);
-        int trainer_read = fread(r->trainer, TRAINER_BYTES, 1, fp);
-        if (trainer_read != 1) {
-            errx(EXIT_FAILURE, "Error reading trainer");
+typedef struct rom_image_t {
+    dev_t device;
+    ino_t inode;
+    struct timespec modified;
+    byte* data;
+    size_t size;
+    int references;
+    struct rom_image_t* next;
+} rom_image;
+
+// Every ROM file mapped by this process. Loading the same file again just takes another reference.
+rom_image* rom_images = NULL;
+pthread_mutex_t rom_images_lock = PTHREAD_MUTEX_INITIALIZER;
+
+bool same_file(rom_image* image, struct stat* st) {
+    return image->device == st->st_dev && image->inode == st->st_ino && image->size == (size_t)st->st_size
+        && image->modified.tv_sec == st->st_mtim.tv_sec && image->modified.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+rom_image* map_rom_image(const char* filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        errx(EXIT_FAILURE, "Unable to open ROM %s: %s", filename, strerror(errno));
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        errx(EXIT_FAILURE, "Unable to stat ROM %s: %s", filename, strerror(errno));
+    }
+
+    pthread_mutex_lock(&rom_images_lock);
+    rom_image* image;
+    for (image = rom_images; image != NULL; image = image->next) {
+        if (same_file(image, &st)) {
+            image->references++;
+            pthread_mutex_unlock(&rom_images_lock);
+            close(fd);
+            dprintf("Sharing the already mapped %s\n", filename);
+            return image;
         }
-        printf("Has trainer.\n");
+    }
+
+    if ((size_t)st.st_size < sizeof(ines_header)) {
+        errx(EXIT_FAILURE, "%s is too small to be a ROM (%ld bytes)", filename, (long)st.st_size);
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        errx(EXIT_FAILURE, "Unable to map ROM %s: %s", filename, strerror(errno));
+    }
+
+    image = malloc(sizeof(rom_image));
+    image->device = st.st_dev;
+    image->inode = st.st_ino;
+    image->modified = st.st_mtim;
+    image->data = data;
+    image->size = st.st_size;
+    image->references = 1;
+    image->next = rom_images;
+    rom_images = image;
+    pthread_mutex_unlock(&rom_images_lock);
+
+    return image;
+}
+
+void release_rom_image(rom_image* image) {
+    pthread_mutex_lock(&rom_images_lock);
+    if (--image->references == 0) {
+        rom_image** link = &rom_images;
+        while (*link != image) {
+            link = &(*link)->next;
+        }
+        *link = image->next;
+        munmap(image->data, image->size);
+        free(image);
+    }
+    pthread_mutex_unlock(&rom_images_lock);
+}
+
+// Hands out the next length bytes of the file, or bails if it's been cut short
+byte* read_rom_section(rom* r, size_t* offset, size_t length, const char* name) {
+    if (length > r->image->size - *offset) {
+        errx(EXIT_FAILURE, "ROM is truncated: expected %lu bytes of %s at offset %lu, but the file is only %lu bytes",
+             length, name, *offset, r->image->size);
+    }
+    byte* section = r->image->data + *offset;
+    *offset += length;
+    dprintf("Read %lu bytes of %s\n", length, name);
+    return section;
+}
+
+void read_trainer(rom* r, size_t* offset) {
+    if (has_trainer(r->header)) {
+        r->trainer = read_rom_section(r, offset, TRAINER_BYTES, "trainer");
     } else {
         r->trainer = NULL;
-        printf("No trainer.\n");
+        dprintf("No trainer.\n");
     }
 }
 
-void read_prg_rom(FILE* fp, rom* r) {
-    size_t prg_rom_bytes = get_prg_rom_bytes(r);
-    r->prg_rom = malloc(prg_rom_bytes);
-    int prg_rom_read = fread(r->prg_rom, prg_rom_bytes, 1, fp);
-    if (prg_rom_read == -1) {
-        errx(EXIT_FAILURE, "Error reading PRG ROM: %s", strerror(errno));
+void read_prg_rom(rom* r, size_t* offset) {
+    r->prg_rom = read_rom_section(r, offset, r->prg_rom_size, "PRG ROM");
+}
+
+void read_chr_rom(rom* r, size_t* offset) {
+    if (r->chr_rom_size > 0) {
+        r->chr_ram = false;
+        r->chr_rom = read_rom_section(r, offset, r->chr_rom_size, "CHR ROM");
+        return;
+    }
+
+    // Mappers write into chr_rom, so CHR RAM has to be ours rather than part of the shared mapping
+    r->chr_ram = true;
+    if (r->chr_ram_size + r->chr_nvram_size == 0) {
+        // Only a NES 2.0 header can say this, but with no CHR at all the mapper has nowhere to fetch patterns from
+        dprintf("No CHR ROM or CHR RAM, assuming 8KB of CHR RAM\n");
+        r->chr_ram_size = BYTES_PER_CHR_ROM_BLOCK;
+    }
+    r->chr_rom = calloc(1, get_chr_bytes(r));
+    dprintf("Using %lu bytes of CHR RAM\n", get_chr_bytes(r));
+}
+
+void allocate_prg_ram(rom* r) {
+    size_t prg_ram_bytes = get_prg_ram_bytes(r);
+    r->prg_ram = prg_ram_bytes > 0 ? calloc(1, prg_ram_bytes) : NULL;
+
+    // The trainer belongs at 0x7000
+    if (r->trainer != NULL && prg_ram_bytes >= 0x1000 + TRAINER_BYTES) {
+        memcpy(r->prg_ram + 0x1000, r->trainer, TRAINER_BYTES);
     }
-    printf("Read %lu bytes of PRG ROM\n", prg_rom_bytes);
 }
 
-void read_chr_rom(FILE* fp, rom* r) {
-    size_t chr_rom_bytes = get_chr_rom_bytes(r);
-    r->chr_rom = malloc(chr_rom_bytes);
-    int chr_rom_read = fread(r->chr_rom, chr_rom_bytes, 1, fp);
-    if (chr_rom_read == -1) {
-        errx(EXIT_FAILURE, "Error reading CHR ROM: %s", strerror(errno));
+// Patches up bad headers with whatever the ROM database knows about this dump
+void apply_rom_database_fixups(rom* r) {
+    if (!rom_database_loaded()) {
+        return;
+    }
+
+    uint32_t crc = rom_crc32(r->image->data + sizeof(ines_header), r->image->size - sizeof(ines_header));
+    const rom_db_entry* entry = rom_database_lookup(crc);
+    if (entry == NULL) {
+        dprintf("CRC32 %08X is not in the ROM database\n", crc);
+        return;
+    }
+    dprintf("Applying ROM database fixups for CRC32 %08X\n", crc);
+
+    if (entry->mapper != ROMDB_KEEP) {
+        r->mapper = entry->mapper;
+        r->submapper = 0;
+    }
+    if (entry->mirroring != ROMDB_KEEP) {
+        set_nametable_mirroring(r, entry->mirroring);
+    }
+    if (entry->battery != ROMDB_KEEP) {
+        r->battery = entry->battery;
+    }
+    if (entry->prg_ram_kb != ROMDB_KEEP) {
+        r->prg_ram_size = (size_t)entry->prg_ram_kb * 1024;
+        r->prg_nvram_size = 0;
+    }
+    if (entry->battery != ROMDB_KEEP || entry->prg_ram_kb != ROMDB_KEEP) {
+        // The database doesn't split work RAM and battery backed RAM, so it's all one or the other
+        size_t prg_ram_bytes = get_prg_ram_bytes(r);
+        r->prg_ram_size = r->battery ? 0 : prg_ram_bytes;
+        r->prg_nvram_size = r->battery ? prg_ram_bytes : 0;
     }
-    printf("Read %lu bytes of CHR ROM\n", chr_rom_bytes);
 }
 
 nametable_mirroring get_nametable_mirroring_mode(rom* r) {
-    if ((r->header->flags_6 & 0b00000001) > 0) {
+    if ((r->header->flags_6 & 0b00001000) > 0) {
+        return FOUR_SCREEN;
+    }
+    else if ((r->header->flags_6 & 0b00000001) > 0) {
         return VERTICAL;
     }
     else {
@@ -96,44 +333,105 @@ nametable_mirroring get_nametable_mirroring_mode(rom* r) {
     }
 }
 
-rom* read_rom(char* filename) {
+void set_nametable_mirroring(rom* r, nametable_mirroring mode) {
+    r->nametable_mirroring_mode = mode;
 
-    rom* r = malloc(sizeof(rom));
-    ines_header* header = malloc(sizeof(ines_header));
+    switch (mode) {
+        case HORIZONTAL:
+            // 1st and 2nd nametables share the first 1KB, 3rd and 4th share the second
+            r->nametable_pages[0] = 0x000;
+            r->nametable_pages[1] = 0x000;
+            r->nametable_pages[2] = 0x400;
+            r->nametable_pages[3] = 0x400;
+            break;
+        case VERTICAL:
+            // 3rd and 4th nametables are mirrors of the 1st and 2nd
+            r->nametable_pages[0] = 0x000;
+            r->nametable_pages[1] = 0x400;
+            r->nametable_pages[2] = 0x000;
+            r->nametable_pages[3] = 0x400;
+            break;
+        case SINGLE_LOWER:
+            r->nametable_pages[0] = 0x000;
+            r->nametable_pages[1] = 0x000;
+            r->nametable_pages[2] = 0x000;
+            r->nametable_pages[3] = 0x000;
+            break;
+        case SINGLE_UPPER:
+            r->nametable_pages[0] = 0x400;
+            r->nametable_pages[1] = 0x400;
+            r->nametable_pages[2] = 0x400;
+            r->nametable_pages[3] = 0x400;
+            break;
+        case FOUR_SCREEN:
+            // The cart supplies another 2KB of VRAM, so every nametable is unique
+            r->nametable_pages[0] = 0x000;
+            r->nametable_pages[1] = 0x400;
+            r->nametable_pages[2] = 0x800;
+            r->nametable_pages[3] = 0xC00;
+            break;
+        default:
+            errx(EXIT_FAILURE, "Need to implement some kind of mirroring! Rev up those debuggers!");
+    }
+}
 
-    FILE* fp = fopen(filename, "rb");
+rom* read_rom(char* filename) {
+    rom* r = malloc(sizeof(rom));
+    r->sram = NULL;
+    r->scheduler = NULL;
+    r->nametable_ram = NULL;
+    r->ppu_fetching_sprites = false;
+    r->ppu_tall_sprites = false;
+    r->prg_offset = 0;
+    r->chr_offset = 0;
+    r->cdl_prg = NULL;
+    r->cdl_chr = NULL;
+    r->image = map_rom_image(filename);
 
-    int header_read = fread(header, sizeof(*header), 1, fp);
-    if (header_read != 1) {
-        errx(EXIT_FAILURE, "Error reading ROM header");
-    }
-    r->header = header;
+    r->header = malloc(sizeof(ines_header));
+    memcpy(r->header, r->image->data, sizeof(ines_header));
 
     if (memcmp(r->header->nes, magic_string, 4)) {
         errx(EXIT_FAILURE, "This is not an INES ROM!");
     }
 
-    read_trainer(fp, r);
-    read_prg_rom(fp, r);
-    read_chr_rom(fp, r);
+    parse_header(r);
+    set_nametable_mirroring(r, get_nametable_mirroring_mode(r));
+    apply_rom_database_fixups(r);
+
+    size_t offset = sizeof(ines_header);
+    read_trainer(r, &offset);
+    read_prg_rom(r, &offset);
+    read_chr_rom(r, &offset);
+    allocate_prg_ram(r);
 
-    r->mapper = get_mapper_number(r);
-    r->nametable_mirroring_mode = get_nametable_mirroring_mode(r);
     switch (r->nametable_mirroring_mode) {
         case HORIZONTAL:
-            printf("Nametable mirroring mode: HORIZONTAL\n");
+            dprintf("Nametable mirroring mode: HORIZONTAL\n");
             break;
         case VERTICAL:
-            printf("Nametable mirroring mode: VERTICAL\n");
+            dprintf("Nametable mirroring mode: VERTICAL\n");
+            break;
+        case FOUR_SCREEN:
+            dprintf("Nametable mirroring mode: FOUR_SCREEN\n");
             break;
         default:
-            printf("Nametable mirroring mode: UNKNOWN\n");
+            dprintf("Nametable mirroring mode: UNKNOWN\n");
     }
 
-    printf("Rom has mapper %d\n", r->mapper);
-
-    fclose(fp);
+    dprintf("Rom has mapper %d\n", r->mapper);
 
     mapper_init(r);
     return r;
 }
+
+void free_rom(rom* r) {
+    sram_close(r);
+    if (r->chr_ram) {
+        free(r->chr_rom);
+    }
+    free(r->prg_ram);
+    free(r->header);
+    release_rom_image(r->image);
+    free(r);
+}
@@ -1,5 +1,6 @@
 #pragma once
 #include <stdio.h>
+#include <stdint.h>
 #include <stdbool.h>
 #include "../util.h"
 
@@ -14,17 +15,23 @@ typedef struct ines_header_t {
     byte chr_rom_blocks; // multiply by 8KB to get actual size of CHR ROM. Value of 0 means board uses CHR RAM
     byte flags_6; // http://wiki.nesdev.com/w/index.php/INES#Flags_6
     byte flags_7; // http://wiki.nesdev.com/w/index.php/INES#Flags_7
-    byte prg_ram_blocks; // Multiply by 8KB, 0 also means 8KB (compatibility reasons, see http://wiki.nesdev.com/w/index.php/PRG_RAM_circuit)
-    byte flags_9; // http://wiki.nesdev.com/w/index.php/INES#Flags_9
-    byte flags_10_unofficial; // http://wiki.nesdev.com/w/index.php/INES#Flags_10. Ignored.
-    byte zero[5]; // All zeros
+    // The rest means different things in iNES and NES 2.0, see http://wiki.nesdev.com/w/index.php/NES_2.0
+    byte flags_8; // iNES: PRG RAM in 8KB units, 0 also means 8KB (see http://wiki.nesdev.com/w/index.php/PRG_RAM_circuit). NES 2.0: submapper, mapper MSB
+    byte flags_9; // iNES: TV system. NES 2.0: CHR ROM and PRG ROM size MSBs
+    byte flags_10; // iNES: unofficial, ignored. NES 2.0: PRG NVRAM and PRG RAM shift counts
+    byte flags_11; // NES 2.0: CHR NVRAM and CHR RAM shift counts
+    byte flags_12; // NES 2.0: CPU/PPU timing
+    byte flags_13; // NES 2.0: Vs. System type
+    byte flags_14; // NES 2.0: Number of miscellaneous ROMs
+    byte flags_15; // NES 2.0: Default expansion device
 } ines_header;
 
 typedef enum nametable_mirroring_t {
     HORIZONTAL,
     VERTICAL,
     SINGLE_LOWER,
-    SINGLE_UPPER
+    SINGLE_UPPER,
+    FOUR_SCREEN
 } nametable_mirroring;
 
 typedef struct mapper_data_t {
@@ -60,23 +67,106 @@ typedef struct mapper_data_t {
     bool irq_enable;
     byte irq_latch;
     byte counter;
-    bool irq_next_cycle;
+
+    // The mappers with more registers than fit above keep their banks as they were written, and work out offsets on
+    // each access
+    uint16_t prg_banks[5];
+    uint16_t chr_banks[12];
+    byte chr_latch[2]; // MMC2/MMC4: whether each pattern table is using its FD or FE bank
+    byte command; // FME-7: register the next parameter write goes to
+    byte ram_protect[2]; // MMC5: both have to be written just right to allow PRG RAM writes
+
+    // IRQs counted off the CPU clock (VRC, FME-7). These are only caught up when something needs them.
+    uint64_t irq_cycle; // CPU cycle the counter has been caught up to
+    int irq_prescaler;
+    uint16_t irq_counter;
+    bool irq_enable_after_ack;
+    bool irq_cycle_mode; // VRC: count every CPU cycle rather than every scan line
+    bool irq_counter_enable;
+    bool irq_pending;
+
+    // MMC5
+    byte exram_mode;
+    byte chr_upper_bits;
+    bool chr_set_b_last; // Which CHR set was written last, that's the one used for everything with 8x8 sprites
+    bool in_frame;
+    byte multiplicand[2];
 } mapper_data;
 
+struct rom_image_t;
+struct sram_t;
+struct scheduler_t;
+struct mapper_ops_t;
+
 typedef struct rom_t {
-  ines_header* header;
+  ines_header* header; // A private copy of the header, everything below comes from parsing it
+  // trainer, prg_rom and chr_rom (unless it's CHR RAM) point into a read only mapping of the file
+  // that's shared by every rom loaded from it in this process, so never write to them.
+  struct rom_image_t* image;
   byte* trainer; // 512 bytes, or NULL.
   byte* prg_rom;
   byte* chr_rom;
-  byte mapper;
+  bool chr_ram; // chr_rom is a writable buffer of our own, since the cart has no CHR ROM
+  bool nes2;
+  bool battery;
+  uint16_t mapper;
+  byte submapper;
+  // Exactly what the cart has. Everything but the ROMs can be 0.
+  size_t prg_rom_size;
+  size_t chr_rom_size;
+  size_t prg_ram_size;
+  size_t prg_nvram_size;
+  size_t chr_ram_size;
+  size_t chr_nvram_size;
   nametable_mirroring nametable_mirroring_mode;
+  // Offset into the PPU's nametable RAM of each of the four 1KB nametables at 0x2000, 0x2400, 0x2800 and 0x2C00.
+  // Only changes when the mirroring mode does, so nametable fetches don't have to look at the mode at all.
+  uint16_t nametable_pages[4];
+  const struct mapper_ops_t* ops; // Set by mapper_init, see mapper.h
   mapper_data mapperdata;
-  byte prg_ram[0x2000];
+  // prg_ram_size bytes of work RAM followed by prg_nvram_size bytes of battery backed RAM, or NULL if there's neither
+  byte* prg_ram;
+  struct sram_t* sram; // Persists the NVRAM once sram_open has been called, otherwise NULL
+  struct scheduler_t* scheduler; // For raising and acknowledging IRQs, set once the rom is plugged into a system
+  // The PPU's 4KB of nametable RAM, for mappers that keep their own nametables in the half the console doesn't use
+  // (MMC5). Set once the rom is plugged into a system, otherwise NULL.
+  byte* nametable_ram;
+  // What the PPU's up to, for mappers that bank differently for sprites and the background (MMC5)
+  bool ppu_fetching_sprites;
+  bool ppu_tall_sprites;
+  // Where in prg_rom and chr_rom the last read came from, for the code/data logger. See prg_rom_read
+  size_t prg_offset;
+  size_t chr_offset;
+  // Code/data log for each byte of PRG ROM and CHR ROM, or NULL when nobody's logging. See cdl.h
+  byte* cdl_prg;
+  byte* cdl_chr;
 } rom;
 
 size_t get_prg_rom_bytes(rom* r);
-size_t get_prg_ram_bytes(rom* r);
-size_t get_chr_rom_bytes(rom* r);
+size_t get_prg_ram_bytes(rom* r); // Work RAM and battery backed RAM together
+size_t get_chr_rom_bytes(rom* r); // 0 for carts with CHR RAM
+size_t get_chr_bytes(rom* r); // Size of chr_rom, whether it's ROM or RAM
+int get_prg_rom_blocks(rom* r); // In 16KB units
+int get_chr_rom_blocks(rom* r); // In 8KB units, 0 for carts with CHR RAM
 int has_trainer(ines_header* header);
 rom* read_rom(char* filename);
-unsigned char get_mapper_number(rom* r);
+void free_rom(rom* r);
+uint16_t get_mapper_number(rom* r);
+size_t nes2_rom_bytes(byte lsb, byte msb, size_t block_bytes);
+
+// Mappers read their ROMs through these, so whoever called them can find out where the byte came from
+static inline byte prg_rom_read(rom* r, size_t offset) {
+    r->prg_offset = offset;
+    return r->prg_rom[offset];
+}
+
+static inline byte chr_rom_read(rom* r, size_t offset) {
+    r->chr_offset = offset;
+    return r->chr_rom[offset];
+}
+
+// PRG RAM accesses from mappers, offset wraps around the RAM the cart has. Without any, reads return 0 and writes are dropped.
+byte prg_ram_read(rom* r, size_t offset);
+void prg_ram_write(rom* r, size_t offset, byte value);
+
+void set_nametable_mirroring(rom* r, nametable_mirroring mode);
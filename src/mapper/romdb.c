@@ -0,0 +1,285 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "romdb.h"
+#include "rom.h"
+#include "../debugger.h"
+
+// Bump whenever rom_db_entry changes, so old caches get rebuilt instead of misread
+const char romdb_cache_magic[8] = {'N', 'E', 'S', 'R', 'D', 'B', '0', '1'};
+
+typedef struct rom_db_cache_header_t {
+    char magic[8];
+    uint32_t entry_size;
+    uint32_t count;
+} rom_db_cache_header;
+
+const rom_db_entry* db_entries = NULL;
+size_t db_entry_count = 0;
+bool db_loaded = false;
+
+// Exactly one of these backs db_entries
+void* db_mapping = NULL;
+size_t db_mapping_size = 0;
+rom_db_entry* db_parsed = NULL;
+
+uint32_t crc32_table[256];
+pthread_once_t crc32_table_once = PTHREAD_ONCE_INIT;
+
+void romdb_build_crc32_table() {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int bit = 0; bit < 8; bit++) {
+            c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+        }
+        crc32_table[i] = c;
+    }
+}
+
+uint32_t rom_crc32(const byte* data, size_t length) {
+    pthread_once(&crc32_table_once, romdb_build_crc32_table);
+    uint32_t c = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        c = crc32_table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    }
+    return c ^ 0xFFFFFFFF;
+}
+
+int romdb_compare(const void* a, const void* b) {
+    uint32_t crc_a = ((const rom_db_entry*)a)->crc32;
+    uint32_t crc_b = ((const rom_db_entry*)b)->crc32;
+    return (crc_a > crc_b) - (crc_a < crc_b);
+}
+
+void unload_rom_database() {
+    if (db_mapping != NULL) {
+        munmap(db_mapping, db_mapping_size);
+        db_mapping = NULL;
+    }
+    free(db_parsed);
+    db_parsed = NULL;
+    db_entries = NULL;
+    db_entry_count = 0;
+    db_loaded = false;
+}
+
+bool romdb_newer_than(struct stat* a, struct stat* b) {
+    if (a->st_mtim.tv_sec != b->st_mtim.tv_sec) {
+        return a->st_mtim.tv_sec > b->st_mtim.tv_sec;
+    }
+    return a->st_mtim.tv_nsec > b->st_mtim.tv_nsec;
+}
+
+// Maps the cache if it exists, is up to date and was written by this version. Anything else just means rebuild it.
+bool romdb_map_cache(const char* cache_path, struct stat* db_stat) {
+    int fd = open(cache_path, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat cache_stat;
+    if (fstat(fd, &cache_stat) != 0 || romdb_newer_than(db_stat, &cache_stat)
+            || (size_t)cache_stat.st_size < sizeof(rom_db_cache_header)) {
+        close(fd);
+        return false;
+    }
+
+    size_t size = cache_stat.st_size;
+    void* mapping = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+
+    const rom_db_cache_header* header = mapping;
+    if (memcmp(header->magic, romdb_cache_magic, sizeof(romdb_cache_magic)) != 0
+            || header->entry_size != sizeof(rom_db_entry)
+            || size != sizeof(rom_db_cache_header) + (size_t)header->count * sizeof(rom_db_entry)) {
+        dprintf("Ignoring stale ROM database cache %s\n", cache_path);
+        munmap(mapping, size);
+        return false;
+    }
+
+    db_mapping = mapping;
+    db_mapping_size = size;
+    db_entries = (const rom_db_entry*)(header + 1);
+    db_entry_count = header->count;
+    return true;
+}
+
+void romdb_parse_fixup(rom_db_entry* entry, const char* token, const char* path, int line) {
+    char key[16];
+    char value[16];
+    if (sscanf(token, "%15[^=]=%15s", key, value) != 2) {
+        errx(EXIT_FAILURE, "%s:%d: expected key=value, got %s", path, line, token);
+    }
+
+    if (strcmp(key, "mirroring") == 0) {
+        if (strcmp(value, "h") == 0) {
+            entry->mirroring = HORIZONTAL;
+        }
+        else if (strcmp(value, "v") == 0) {
+            entry->mirroring = VERTICAL;
+        }
+        else if (strcmp(value, "4") == 0) {
+            entry->mirroring = FOUR_SCREEN;
+        }
+        else {
+            errx(EXIT_FAILURE, "%s:%d: unknown mirroring %s, expected h, v or 4", path, line, value);
+        }
+        return;
+    }
+
+    char* end;
+    long number = strtol(value, &end, 10);
+    if (*end != '\0' || number < 0) {
+        errx(EXIT_FAILURE, "%s:%d: bad value for %s: %s", path, line, key, value);
+    }
+
+    if (strcmp(key, "mapper") == 0 && number < 4096) {
+        entry->mapper = number;
+    }
+    else if (strcmp(key, "battery") == 0 && number < 2) {
+        entry->battery = number;
+    }
+    else if (strcmp(key, "prg_ram") == 0 && number <= 1024) {
+        entry->prg_ram_kb = number;
+    }
+    else {
+        errx(EXIT_FAILURE, "%s:%d: bad fixup %s", path, line, token);
+    }
+}
+
+void romdb_parse(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        errx(EXIT_FAILURE, "Unable to open ROM database %s: %s", path, strerror(errno));
+    }
+
+    size_t capacity = 256;
+    db_parsed = malloc(capacity * sizeof(rom_db_entry));
+    db_entry_count = 0;
+
+    char* line = NULL;
+    size_t line_size = 0;
+    int line_number = 0;
+    while (getline(&line, &line_size, fp) != -1) {
+        line_number++;
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+
+        char* save;
+        char* token = strtok_r(line, " \t\r\n", &save);
+        if (token == NULL) {
+            continue;
+        }
+
+        char* end;
+        unsigned long crc = strtoul(token, &end, 16);
+        if (*end != '\0' || crc > 0xFFFFFFFF) {
+            errx(EXIT_FAILURE, "%s:%d: expected a CRC32, got %s", path, line_number, token);
+        }
+
+        if (db_entry_count == capacity) {
+            capacity *= 2;
+            db_parsed = realloc(db_parsed, capacity * sizeof(rom_db_entry));
+        }
+
+        rom_db_entry* entry = &db_parsed[db_entry_count++];
+        memset(entry, 0, sizeof(rom_db_entry));
+        entry->crc32 = crc;
+        entry->mapper = ROMDB_KEEP;
+        entry->prg_ram_kb = ROMDB_KEEP;
+        entry->mirroring = ROMDB_KEEP;
+        entry->battery = ROMDB_KEEP;
+
+        while ((token = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+            romdb_parse_fixup(entry, token, path, line_number);
+        }
+    }
+    free(line);
+    fclose(fp);
+
+    qsort(db_parsed, db_entry_count, sizeof(rom_db_entry), romdb_compare);
+    for (size_t i = 1; i < db_entry_count; i++) {
+        if (db_parsed[i].crc32 == db_parsed[i - 1].crc32) {
+            errx(EXIT_FAILURE, "%s: more than one entry for CRC32 %08X", path, db_parsed[i].crc32);
+        }
+    }
+    db_entries = db_parsed;
+}
+
+// Best effort, a read only directory just means parsing again next time.
+// Written to a temporary file and renamed so concurrent runs never see half a cache.
+void romdb_write_cache(const char* cache_path) {
+    char temp_path[PATH_MAX];
+    snprintf(temp_path, sizeof(temp_path), "%s.%d", cache_path, getpid());
+
+    FILE* fp = fopen(temp_path, "wb");
+    if (fp == NULL) {
+        dprintf("Unable to write ROM database cache %s: %s\n", temp_path, strerror(errno));
+        return;
+    }
+
+    rom_db_cache_header header;
+    memcpy(header.magic, romdb_cache_magic, sizeof(header.magic));
+    header.entry_size = sizeof(rom_db_entry);
+    header.count = db_entry_count;
+
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+            && fwrite(db_entries, sizeof(rom_db_entry), db_entry_count, fp) == db_entry_count;
+    ok = fclose(fp) == 0 && ok;
+
+    if (!ok || rename(temp_path, cache_path) != 0) {
+        dprintf("Unable to write ROM database cache %s\n", cache_path);
+        unlink(temp_path);
+    }
+}
+
+void load_rom_database(const char* path) {
+    unload_rom_database();
+
+    struct stat db_stat;
+    if (stat(path, &db_stat) != 0) {
+        errx(EXIT_FAILURE, "Unable to open ROM database %s: %s", path, strerror(errno));
+    }
+
+    char cache_path[PATH_MAX];
+    if (snprintf(cache_path, sizeof(cache_path), "%s.cache", path) >= (int)sizeof(cache_path)) {
+        errx(EXIT_FAILURE, "ROM database path too long: %s", path);
+    }
+
+    if (romdb_map_cache(cache_path, &db_stat)) {
+        dprintf("Mapped %lu ROM database entries from %s\n", db_entry_count, cache_path);
+    }
+    else {
+        romdb_parse(path);
+        romdb_write_cache(cache_path);
+        dprintf("Parsed %lu ROM database entries from %s\n", db_entry_count, path);
+    }
+
+    db_loaded = true;
+}
+
+bool rom_database_loaded() {
+    return db_loaded;
+}
+
+const rom_db_entry* rom_database_lookup(uint32_t crc32) {
+    if (db_entry_count == 0) {
+        return NULL;
+    }
+    rom_db_entry key = {.crc32 = crc32};
+    return bsearch(&key, db_entries, db_entry_count, sizeof(rom_db_entry), romdb_compare);
+}
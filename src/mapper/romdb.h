@@ -0,0 +1,32 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "../util.h"
+
+#define ROMDB_KEEP -1
+
+// Header fixups for one ROM, keyed by the CRC32 of everything after the 16 byte iNES header.
+// Fields set to ROMDB_KEEP leave whatever the header says alone.
+typedef struct rom_db_entry_t {
+    uint32_t crc32;
+    int16_t mapper;
+    int16_t prg_ram_kb;
+    int8_t mirroring; // A nametable_mirroring, only HORIZONTAL, VERTICAL or FOUR_SCREEN make sense here
+    int8_t battery;
+    byte padding[2];
+} rom_db_entry;
+
+/*
+ * Loads a text ROM database. Each line is a CRC32 in hex followed by any of
+ * mapper=N, mirroring=h|v|4, battery=0|1 or prg_ram=KB, and # starts a comment.
+ *
+ * The parsed, sorted index is cached next to the database as <path>.cache and reused
+ * as long as the database isn't newer, so later runs just map it and binary search.
+ */
+void load_rom_database(const char* path);
+void unload_rom_database();
+bool rom_database_loaded();
+const rom_db_entry* rom_database_lookup(uint32_t crc32);
+
+uint32_t rom_crc32(const byte* data, size_t length);
@@ -0,0 +1,286 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sram.h"
+#include "../debugger.h"
+
+#define BITS_PER_WORD 64
+
+typedef struct sram_t {
+    rom* r;
+    char* path;
+    byte* nvram;
+    size_t size;
+    size_t pages;
+    size_t words;
+
+    // Only touched by the emulator thread
+    uint64_t* dirty;
+    bool any_dirty;
+    struct timespec last_flush;
+
+    // Handed over to the writer under lock
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    byte* pending;
+    uint64_t* pending_dirty;
+    bool has_pending;
+    bool quit;
+
+    // Only touched by the writer
+    pthread_t writer;
+    int fd;
+    byte* writing;
+    uint64_t* writing_dirty;
+
+    struct sram_t* next;
+} sram;
+
+// Every sram that's open, so they can all be flushed at exit
+sram* open_srams = NULL;
+pthread_mutex_t open_srams_lock = PTHREAD_MUTEX_INITIALIZER;
+pthread_once_t sram_atexit_once = PTHREAD_ONCE_INIT;
+
+char* sav_path(const char* rom_path) {
+    size_t length = strlen(rom_path);
+    if (length > 4 && strcasecmp(rom_path + length - 4, ".nes") == 0) {
+        length -= 4;
+    }
+    char* path = malloc(length + 5);
+    memcpy(path, rom_path, length);
+    strcpy(path + length, ".sav");
+    return path;
+}
+
+bool open_sav_for_writing(sram* s) {
+    s->fd = open(s->path, O_WRONLY | O_CREAT, 0644);
+    if (s->fd < 0) {
+        warn("Unable to open %s, SRAM won't be saved", s->path);
+        s->fd = -2; // Don't try again every second
+        return false;
+    }
+    // Keep the file the full size of the NVRAM even if only some pages ever get written
+    if (ftruncate(s->fd, s->size) != 0) {
+        warn("Unable to size %s", s->path);
+    }
+    return true;
+}
+
+// Writes every dirty page in the writer's buffer, a run of consecutive pages at a time
+void write_dirty_pages(sram* s) {
+    if ((s->fd == -1 && !open_sav_for_writing(s)) || s->fd < 0) {
+        memset(s->writing_dirty, 0, s->words * sizeof(uint64_t));
+        return;
+    }
+
+    size_t page = 0;
+    while (page < s->pages) {
+        if (!(s->writing_dirty[page / BITS_PER_WORD] & (1ULL << (page % BITS_PER_WORD)))) {
+            page++;
+            continue;
+        }
+        size_t first = page;
+        while (page < s->pages && s->writing_dirty[page / BITS_PER_WORD] & (1ULL << (page % BITS_PER_WORD))) {
+            page++;
+        }
+
+        size_t offset = first * SRAM_PAGE_BYTES;
+        size_t length = page * SRAM_PAGE_BYTES;
+        if (length > s->size) {
+            length = s->size;
+        }
+        length -= offset;
+        if (pwrite(s->fd, s->writing + offset, length, offset) != (ssize_t)length) {
+            warn("Unable to write %s", s->path);
+        }
+    }
+    memset(s->writing_dirty, 0, s->words * sizeof(uint64_t));
+}
+
+void* sram_writer(void* arg) {
+    sram* s = arg;
+    pthread_mutex_lock(&s->lock);
+    while (true) {
+        while (!s->has_pending && !s->quit) {
+            pthread_cond_wait(&s->wake, &s->lock);
+        }
+        if (!s->has_pending) {
+            break;
+        }
+
+        // Take the pages and get off the lock before doing any I/O
+        for (size_t word = 0; word < s->words; word++) {
+            uint64_t bits = s->pending_dirty[word];
+            s->writing_dirty[word] |= bits;
+            s->pending_dirty[word] = 0;
+            while (bits) {
+                size_t offset = (word * BITS_PER_WORD + __builtin_ctzll(bits)) * SRAM_PAGE_BYTES;
+                size_t length = s->size - offset < SRAM_PAGE_BYTES ? s->size - offset : SRAM_PAGE_BYTES;
+                memcpy(s->writing + offset, s->pending + offset, length);
+                bits &= bits - 1;
+            }
+        }
+        s->has_pending = false;
+
+        pthread_mutex_unlock(&s->lock);
+        write_dirty_pages(s);
+        pthread_mutex_lock(&s->lock);
+    }
+    pthread_mutex_unlock(&s->lock);
+    return NULL;
+}
+
+// Copies the dirty pages for the writer and wakes it up
+void sram_schedule_flush(sram* s) {
+    pthread_mutex_lock(&s->lock);
+    for (size_t word = 0; word < s->words; word++) {
+        uint64_t bits = s->dirty[word];
+        s->pending_dirty[word] |= bits;
+        s->dirty[word] = 0;
+        while (bits) {
+            size_t offset = (word * BITS_PER_WORD + __builtin_ctzll(bits)) * SRAM_PAGE_BYTES;
+            size_t length = s->size - offset < SRAM_PAGE_BYTES ? s->size - offset : SRAM_PAGE_BYTES;
+            memcpy(s->pending + offset, s->nvram + offset, length);
+            bits &= bits - 1;
+        }
+    }
+    s->has_pending = true;
+    pthread_cond_signal(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+
+    s->any_dirty = false;
+    clock_gettime(CLOCK_MONOTONIC, &s->last_flush);
+}
+
+void close_open_srams() {
+    pthread_mutex_lock(&open_srams_lock);
+    while (open_srams != NULL) {
+        rom* r = open_srams->r;
+        pthread_mutex_unlock(&open_srams_lock);
+        sram_close(r);
+        pthread_mutex_lock(&open_srams_lock);
+    }
+    pthread_mutex_unlock(&open_srams_lock);
+}
+
+void register_sram_atexit() {
+    atexit(close_open_srams);
+}
+
+void sram_open(rom* r, const char* rom_path) {
+    if (!r->battery || r->prg_nvram_size == 0 || r->sram != NULL) {
+        return;
+    }
+
+    sram* s = calloc(1, sizeof(sram));
+    s->r = r;
+    s->path = sav_path(rom_path);
+    s->nvram = r->prg_ram + r->prg_ram_size;
+    s->size = r->prg_nvram_size;
+    s->pages = (s->size + SRAM_PAGE_BYTES - 1) / SRAM_PAGE_BYTES;
+    s->words = (s->pages + BITS_PER_WORD - 1) / BITS_PER_WORD;
+    s->dirty = calloc(s->words, sizeof(uint64_t));
+    s->pending = malloc(s->size);
+    s->pending_dirty = calloc(s->words, sizeof(uint64_t));
+    s->writing = malloc(s->size);
+    s->writing_dirty = calloc(s->words, sizeof(uint64_t));
+    s->fd = -1;
+    clock_gettime(CLOCK_MONOTONIC, &s->last_flush);
+
+    int fd = open(s->path, O_RDONLY);
+    if (fd >= 0) {
+        ssize_t bytes_read = read(fd, s->nvram, s->size);
+        if (bytes_read < 0) {
+            errx(EXIT_FAILURE, "Unable to read %s: %s", s->path, strerror(errno));
+        }
+        dprintf("Loaded %ld bytes of SRAM from %s\n", (long)bytes_read, s->path);
+        close(fd);
+    }
+    else if (errno != ENOENT) {
+        errx(EXIT_FAILURE, "Unable to open %s: %s", s->path, strerror(errno));
+    }
+
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->wake, NULL);
+    if (pthread_create(&s->writer, NULL, sram_writer, s) != 0) {
+        errx(EXIT_FAILURE, "Unable to start the SRAM writer");
+    }
+
+    pthread_once(&sram_atexit_once, register_sram_atexit);
+    pthread_mutex_lock(&open_srams_lock);
+    s->next = open_srams;
+    open_srams = s;
+    pthread_mutex_unlock(&open_srams_lock);
+
+    r->sram = s;
+}
+
+void sram_close(rom* r) {
+    sram* s = r->sram;
+    if (s == NULL) {
+        return;
+    }
+
+    pthread_mutex_lock(&open_srams_lock);
+    sram** link = &open_srams;
+    while (*link != s) {
+        link = &(*link)->next;
+    }
+    *link = s->next;
+    pthread_mutex_unlock(&open_srams_lock);
+
+    if (s->any_dirty) {
+        sram_schedule_flush(s);
+    }
+    pthread_mutex_lock(&s->lock);
+    s->quit = true;
+    pthread_cond_signal(&s->wake);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->writer, NULL);
+
+    if (s->fd >= 0) {
+        if (fsync(s->fd) != 0) {
+            warn("Unable to sync %s", s->path);
+        }
+        close(s->fd);
+    }
+
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->wake);
+    free(s->path);
+    free(s->dirty);
+    free(s->pending);
+    free(s->pending_dirty);
+    free(s->writing);
+    free(s->writing_dirty);
+    free(s);
+    r->sram = NULL;
+}
+
+void sram_frame(rom* r) {
+    sram* s = r->sram;
+    if (s == NULL || !s->any_dirty) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long elapsed = (now.tv_sec - s->last_flush.tv_sec) * 1000000000L + (now.tv_nsec - s->last_flush.tv_nsec);
+    if (elapsed >= SRAM_FLUSH_INTERVAL_NS) {
+        sram_schedule_flush(s);
+    }
+}
+
+void sram_mark_dirty(sram* s, size_t offset) {
+    size_t page = offset / SRAM_PAGE_BYTES;
+    s->dirty[page / BITS_PER_WORD] |= 1ULL << (page % BITS_PER_WORD);
+    s->any_dirty = true;
+}
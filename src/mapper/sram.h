@@ -0,0 +1,21 @@
+#pragma once
+#include <stddef.h>
+#include "rom.h"
+
+#define SRAM_PAGE_BYTES 256
+#define SRAM_FLUSH_INTERVAL_NS 1000000000L
+
+/*
+ * Battery backed PRG RAM, kept in a .sav file next to the ROM.
+ *
+ * prg_ram_write only marks pages dirty. Once a frame the PPU calls sram_frame, which at most once a second
+ * copies the dirty pages off to a writer thread, so games that write SRAM every frame cost no I/O of their own.
+ * Everything left is flushed by sram_close, which also runs at exit for anything still open.
+ */
+
+// Loads <rom path minus .nes>.sav into the cart's NVRAM, if it has a battery
+void sram_open(rom* r, const char* rom_path);
+void sram_close(rom* r);
+void sram_frame(rom* r);
+
+void sram_mark_dirty(struct sram_t* sram, size_t offset);
@@ -0,0 +1,102 @@
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vrc.h"
+#include "mapper.h"
+
+// 341 PPU dots a line, 3 for every CPU cycle
+#define VRC_PRESCALER_RELOAD 341
+#define VRC_PRESCALER_STEP 3
+
+void vrc_irq_init(rom* r) {
+    r->mapperdata.irq_prescaler = VRC_PRESCALER_RELOAD;
+    r->mapperdata.irq_cycle = mapper_current_cycle(r);
+}
+
+// Runs the counter from where it was left up to cycle
+void vrc_irq_catch_up(rom* r, uint64_t cycle) {
+    mapper_data* md = &r->mapperdata;
+    uint64_t cycles = cycle - md->irq_cycle;
+    md->irq_cycle = cycle;
+    if (!md->irq_enable || cycles == 0) {
+        return;
+    }
+
+    uint64_t clocks;
+    if (md->irq_cycle_mode) {
+        clocks = cycles;
+    }
+    else if (cycles * VRC_PRESCALER_STEP < md->irq_prescaler) {
+        md->irq_prescaler -= cycles * VRC_PRESCALER_STEP;
+        clocks = 0;
+    }
+    else {
+        // The prescaler gets 341 added every time it reaches 0 or less
+        uint64_t past = cycles * VRC_PRESCALER_STEP - md->irq_prescaler;
+        clocks = 1 + past / VRC_PRESCALER_RELOAD;
+        md->irq_prescaler = VRC_PRESCALER_RELOAD - (int)(past % VRC_PRESCALER_RELOAD);
+    }
+
+    uint64_t to_overflow = 256 - md->counter;
+    if (clocks < to_overflow) {
+        md->counter += clocks;
+    }
+    else {
+        // Reloads from the latch on every overflow
+        md->counter = md->irq_latch + (clocks - to_overflow) % (256 - md->irq_latch);
+        md->irq_pending = true;
+        if (r->scheduler != NULL) {
+            assert_irq(r->scheduler, IRQ_MAPPER);
+        }
+    }
+}
+
+void vrc_irq_write_latch(rom* r, byte value) {
+    r->mapperdata.irq_latch = value;
+}
+
+void vrc_irq_write_control(rom* r, byte value) {
+    mapper_data* md = &r->mapperdata;
+    vrc_irq_catch_up(r, mapper_current_cycle(r));
+    md->irq_enable_after_ack = (value & 0b001) != 0;
+    md->irq_enable = (value & 0b010) != 0;
+    md->irq_cycle_mode = (value & 0b100) != 0;
+    if (md->irq_enable) {
+        md->counter = md->irq_latch;
+        md->irq_prescaler = VRC_PRESCALER_RELOAD;
+    }
+    md->irq_pending = false;
+    if (r->scheduler != NULL) {
+        release_irq(r->scheduler, IRQ_MAPPER);
+    }
+}
+
+void vrc_irq_acknowledge(rom* r) {
+    mapper_data* md = &r->mapperdata;
+    vrc_irq_catch_up(r, mapper_current_cycle(r));
+    md->irq_enable = md->irq_enable_after_ack;
+    md->irq_pending = false;
+    if (r->scheduler != NULL) {
+        release_irq(r->scheduler, IRQ_MAPPER);
+    }
+}
+
+timestamp vrc_irq_timer(rom* r, timestamp time) {
+    mapper_data* md = &r->mapperdata;
+    vrc_irq_catch_up(r, mapper_cpu_cycle(time));
+    if (!md->irq_enable) {
+        return NEVER;
+    }
+
+    // Cycles until the clock that overflows the counter
+    uint64_t clocks = 256 - md->counter;
+    uint64_t cycles;
+    if (md->irq_cycle_mode) {
+        cycles = clocks;
+    }
+    else {
+        uint64_t dots = md->irq_prescaler + (clocks - 1) * VRC_PRESCALER_RELOAD;
+        cycles = (dots + VRC_PRESCALER_STEP - 1) / VRC_PRESCALER_STEP;
+    }
+    return (md->irq_cycle + cycles) * DOTS_PER_CPU_CYCLE;
+}
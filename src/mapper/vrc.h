@@ -0,0 +1,18 @@
+#pragma once
+#include <stdint.h>
+#include "../util.h"
+#include "../scheduler.h"
+#include "rom.h"
+
+/*
+ * The IRQ counter shared by the VRC4, VRC6 and VRC7. An 8 bit counter counts up once a scan line (worked out from the
+ * CPU clock with a prescaler, the mapper can't see the PPU), or once every CPU cycle, and raises the IRQ and reloads
+ * the latch when it overflows.
+ *
+ * Nothing runs on each cycle, the counter is caught up when it's written or when vrc_irq_timer is called.
+ */
+void vrc_irq_init(rom* r);
+void vrc_irq_write_latch(rom* r, byte value);
+void vrc_irq_write_control(rom* r, byte value);
+void vrc_irq_acknowledge(rom* r);
+timestamp vrc_irq_timer(rom* r, timestamp time);
@@ -1,13 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <err.h>
+#include <string.h>
 
 #include "util.h"
 #include "mem.h"
 #include "ppu.h"
 #include "cpu.h"
 #include "debugger.h"
-#include "render.h"
+#include "cdl.h"
 #include "mapper/mapper.h"
 
 // http://wiki.nesdev.com/w/index.php/CPU_memory_map
@@ -25,38 +26,40 @@ byte read_byte(memory* mem, uint16_t address) {
     else if (address == 0x4015) {
         return read_apu_status(&mem->apu_mem);
     }
-    else if (address == 0x4016) {
-        bool state;
-        if (mem->ctrl1.allread) {
-            // The first 8 reads will indicate which buttons are pressed (1 if pressed, 0 if not pressed).
-            // All subsequent reads will return D=1 on a Nintendo brand controller but may return D=0 on third party controllers such as the U-Force.
-            state = true; //
-        }
-        else {
-            state = get_button(mem->ctrl1.index, one);
-        }
-        if (!(mem->ctrl1.lastwrite & 0b1)) { // If the LSB of the last write to $2006 is NOT set
-            if (mem->ctrl1.index == RIGHT) {
-                mem->ctrl1.lastwrite = true;
-            }
-            else {
-                mem->ctrl1.index++;
-            }
-        }
-        return (byte)state;
-    }
-    else if (address == 0x4017) {
-        dprintf("Access to controller register #2 attempted, returning 0x00 for now.\n");
-        return 0x00;
+    else if (address == 0x4016 || address == 0x4017) {
+        return input_read(&mem->ports[address - 0x4016], &mem->input, &mem->ppu_mem);
     }
     else if (address >= 0x4020) {
-        return mapper_prg_read(mem->r, address);
+        rom* r = mem->r;
+        r->prg_offset = cdl_prg_sink(r);
+        byte value = mapper_prg_read(r, address);
+        if (r->cdl_prg != NULL) {
+            r->cdl_prg[r->prg_offset] |= mem->cdl_access | ((address >> 11) & 0b1100);
+        }
+        return value;
     }
     else {
         errx(EXIT_FAILURE, "Access attempted for invalid address: %x", address);
     }
 }
 
+const cpu_bus nes_bus = {
+    .read = read_byte,
+    .write = write_byte
+};
+
+byte peek_byte(memory* mem, uint16_t address) {
+    if (address < 0x2000) {
+        return mem->ram[address % 0x800];
+    }
+    else if (address < 0x4020) {
+        return mem->ppu_mem.open_bus;
+    }
+    else {
+        return mapper_prg_read(mem->r, address);
+    }
+}
+
 void write_byte(memory* mem, uint16_t address, byte value) {
     if (address < 0x2000) { // RAM
         mem->ram[address % 0x800] = value;
@@ -68,16 +71,13 @@ void write_byte(memory* mem, uint16_t address, byte value) {
         write_ppu_register(&mem->ppu_mem, register_num, value);
     }
     else if (address == 0x4014) {
-        address = (uint16_t)value << 8;
-        dprintf("Triggered OAM DMA at 0x%04X\n", address);
-        trigger_oam_dma(mem, address);
+        dprintf("Triggered OAM DMA at 0x%02X00\n", value);
+        request_oam_dma(&mem->dma, value);
     }
     else if (address == 0x4016) {
-        if (value & 0b1) {
-            mem->ctrl1.index = 0;
-            mem->ctrl1.allread = false;
-        }
-        mem->ctrl1.lastwrite = value;
+        // The strobe goes to both ports
+        input_write(&mem->ports[0], &mem->input, value);
+        input_write(&mem->ports[1], &mem->input, value);
     }
     else if (address < 0x4018) {
         write_apu_register(&mem->apu_mem, address - 0x4000, value);
@@ -87,23 +87,49 @@ void write_byte(memory* mem, uint16_t address, byte value) {
     }
     else {
         mapper_prg_write(mem->r, address, value);
+        if (mapper_has_timer(mem->r)) {
+            // The write might have changed when the mapper's IRQ goes off
+            schedule_mapper_timer(mem, mem->scheduler.now);
+        }
+    }
+}
+
+void schedule_mapper_timer(memory* mem, timestamp time) {
+    timestamp next = mapper_timer(mem->r, time);
+    if (next == NEVER) {
+        cancel_event(&mem->scheduler, EVENT_MAPPER_TIMER);
+    }
+    else {
+        schedule_event(&mem->scheduler, EVENT_MAPPER_TIMER, next, 0);
     }
 }
 
 memory* get_blank_memory(rom* r) {
     // http://wiki.nesdev.com/w/index.php/CPU_power_up_state
-    memory* mem = malloc(sizeof(memory));
+    // Anything not set below starts at zero rather than whatever malloc had lying around, so every run of the same
+    // input goes the same way
+    memory* mem = calloc(1, sizeof(memory));
 
     mem->a = 0x00;
     mem->x = 0x00;
     mem->y = 0x00;
     mem->sp = 0xFD;
-    mem->p = 0x34;
+    set_p(mem, 0x34);
+    mem->total_cycles = 0;
+    mem->stall_cycles = 0;
+    mem->timing = TIMING_INSTRUCTION;
+    mem->bus = &nes_bus;
     mem->r = r;
     mem->ppu_mem = get_ppu_mem(r);
 
-    mem->ctrl1.index = A;
-    mem->ctrl1.lastwrite = 0;
+    input_connect(&mem->ports[0], 0, INPUT_CONTROLLER);
+    input_connect(&mem->ports[1], 1, INPUT_CONTROLLER);
+    memset(&mem->input, 0, sizeof(mem->input));
+    mem->input.pointer_x = -1;
+    mem->input.pointer_y = -1;
+    mem->input_frame = 0;
+    mem->hold_input = false;
+    mem->cdl_access = CDL_DATA;
 
     // Read initial value of program counter from the reset vector
     mem->pc = (mapper_prg_read(mem->r, 0xFFFD) << 8) | mapper_prg_read(mem->r, 0xFFFC);
@@ -114,148 +140,49 @@ memory* get_blank_memory(rom* r) {
 
     mem->ppu_mem.apu_ring_buffer_read_index = &(mem->apu_mem.buffer_read_index);
     mem->ppu_mem.apu_ring_buffer_write_index = &(mem->apu_mem.buffer_write_index);
+    mem->ppu_mem.apu_real_time = &(mem->apu_mem.real_time);
 
-    return mem;
-}
-
-bool is_negative(byte value) {
-    return (value & 0b10000000) > 0;
-}
-
-// 01-34567
-// NV-BDIZC
-
-void set_p_flag(memory* mem, int index) {
-    mem->p |= mask_flag(index);
-}
-void clear_p_flag(memory* mem, int index) {
-    mem->p &= ~mask_flag(index);
-}
-int get_p_flag(memory* mem, int index) {
-    return (mem->p & mask_flag(index)) != 0;
-}
-void set_p_flag_to(memory* mem, int index, bool value) {
-    if (value) {
-        set_p_flag(mem, index);
-    }
-    else {
-        clear_p_flag(mem, index);
+    scheduler_init(&mem->scheduler);
+    dma_init(&mem->dma);
+    mem->ppu_mem.scheduler = &mem->scheduler;
+    mem->apu_mem.scheduler = &mem->scheduler;
+    mem->r->scheduler = &mem->scheduler;
+    mem->r->nametable_ram = mem->ppu_mem.name_tables;
+    reset_frame_counter(&mem->apu_mem);
+    mapper_watch_changed(&mem->ppu_mem);
+    if (mapper_has_timer(mem->r)) {
+        schedule_mapper_timer(mem, mem->scheduler.now);
     }
-}
 
-int get_p_negative(memory* mem) {
-    return get_p_flag(mem, P_NEGATIVE);
-}
-int get_p_overflow(memory* mem) {
-    return get_p_flag(mem, P_OVERFLOW);
-}
-int get_p_break(memory* mem) {
-    return get_p_flag(mem, P_BREAK);
-}
-int get_p_decimal(memory* mem) {
-    return get_p_flag(mem, P_DECIMAL);
-}
-int get_p_interrupt(memory* mem) {
-    return get_p_flag(mem, P_INTERRUPT);
-}
-int get_p_zero(memory* mem) {
-    return get_p_flag(mem, P_ZERO);
-}
-int get_p_carry(memory* mem) {
-    return get_p_flag(mem, P_CARRY);
-}
-
-void set_p_negative(memory* mem) {
-    set_p_flag(mem, P_NEGATIVE);
-}
-void set_p_overflow(memory* mem) {
-    set_p_flag(mem, P_OVERFLOW);
-}
-void set_p_break(memory* mem) {
-    set_p_flag(mem, P_BREAK);
-}
-void set_p_decimal(memory* mem) {
-    set_p_flag(mem, P_DECIMAL);
-}
-void set_p_interrupt(memory* mem) {
-    set_p_flag(mem, P_INTERRUPT);
-}
-void set_p_zero(memory* mem) {
-    set_p_flag(mem, P_ZERO);
-}
-void set_p_carry(memory* mem) {
-    set_p_flag(mem, P_CARRY);
+    return mem;
 }
 
-void clear_p_negative(memory* mem) {
-    clear_p_flag(mem, P_NEGATIVE);
-}
-void clear_p_overflow(memory* mem) {
-    clear_p_flag(mem, P_OVERFLOW);
-}
-void clear_p_break(memory* mem) {
-    clear_p_flag(mem, P_BREAK);
-}
-void clear_p_decimal(memory* mem) {
-    clear_p_flag(mem, P_DECIMAL);
-}
-void clear_p_interrupt(memory* mem) {
-    clear_p_flag(mem, P_INTERRUPT);
-}
-void clear_p_zero(memory* mem) {
-    clear_p_flag(mem, P_ZERO);
-}
-void clear_p_carry(memory* mem) {
-    clear_p_flag(mem, P_CARRY);
-}
+memory* get_cpu_memory(const cpu_bus* bus, void* bus_context) {
+    memory* mem = calloc(1, sizeof(memory));
+    if (mem == NULL) {
+        errx(EXIT_FAILURE, "Unable to allocate memory for the CPU");
+    }
 
-void set_p_negative_to(memory* mem, bool value) {
-    set_p_flag_to(mem, P_NEGATIVE, value);
-}
-void set_p_overflow_to(memory* mem, bool value) {
-    set_p_flag_to(mem, P_OVERFLOW, value);
-}
-void set_p_break_to(memory* mem, bool value) {
-    set_p_flag_to(mem, P_BREAK, value);
-}
-void set_p_decimal_to(memory* mem, bool value) {
-    set_p_flag_to(mem, P_DECIMAL, value);
-}
-void set_p_interrupt_to(memory* mem, bool value) {
-    set_p_flag_to(mem, P_INTERRUPT, value);
-}
-void set_p_zero_to(memory* mem, bool value) {
-    set_p_flag_to(mem, P_ZERO, value);
-}
-void set_p_carry_to(memory* mem, bool value) {
-    set_p_flag_to(mem, P_CARRY, value);
-}
+    mem->sp = 0xFD;
+    set_p(mem, 0x34);
+    mem->timing = TIMING_INSTRUCTION;
+    mem->bus = bus;
+    mem->bus_context = bus_context;
+    mem->cdl_access = CDL_DATA;
+    mem->pc = (bus->read(mem, 0xFFFD) << 8) | bus->read(mem, 0xFFFC);
 
-void set_p_zero_on(memory* mem, byte value) {
-    if (value == 0x00) {
-        set_p_zero(mem);
-    }
-    else {
-        clear_p_zero(mem);
-    }
-}
+    scheduler_init(&mem->scheduler);
+    dma_init(&mem->dma);
 
-void set_p_negative_on(memory* mem, byte value) {
-    if (is_negative(value)) {
-        set_p_negative(mem);
-    }
-    else {
-        clear_p_negative(mem);
-    }
+    return mem;
 }
 
-void set_p_zn_on(memory* mem, byte value) {
-    set_p_zero_on(mem, value);
-    set_p_negative_on(mem, value);
+bool is_negative(byte value) {
+    return (value & 0b10000000) > 0;
 }
 
 void stack_push(memory* mem, byte value) {
-    write_byte(mem, 0x100 | mem->sp, value);
+    cpu_write(mem, 0x100 | mem->sp, value);
     mem->sp--;
 }
 
@@ -269,7 +196,7 @@ void stack_push16(memory* mem, uint16_t value) {
 
 byte stack_pop(memory* mem) {
     mem->sp++;
-    return read_byte(mem, 0x100 | mem->sp);
+    return cpu_read(mem, 0x100 | mem->sp);
 }
 
 uint16_t stack_pop16(memory* mem) {
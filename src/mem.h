@@ -7,12 +7,30 @@
 #include "ppu.h"
 #include "apu.h"
 #include "controller.h"
+#include "scheduler.h"
+#include "dma.h"
+#include "input.h"
 
-typedef struct controller_t {
-    button index;
-    byte lastwrite;
-    bool allread;
-} controller;
+// How closely the rest of the system keeps up with the CPU. Pick per run, trading accuracy for speed.
+typedef enum cpu_timing_t {
+    // Each instruction runs whole, then everything else is run for however long it took. Fastest, but every read and
+    // write lands at the start of the instruction as far as the PPU's concerned.
+    TIMING_INSTRUCTION,
+    // Cycles are counted as the instruction goes, and the rest of the system's caught up to the right cycle just
+    // before the CPU touches a register. Memory accesses don't wait.
+    TIMING_CATCH_UP,
+    // Everything else is run for a CPU cycle before every single read and write
+    TIMING_BUS_CYCLE
+} cpu_timing;
+
+struct memory_t;
+
+// Where the CPU's reads and writes go. That's the NES's memory map, nes_bus, unless the CPU's being run on its own.
+// See bus.h for the others.
+typedef struct cpu_bus_t {
+    byte (*read)(struct memory_t* mem, uint16_t address);
+    void (*write)(struct memory_t* mem, uint16_t address, byte value);
+} cpu_bus;
 
 typedef struct memory_t {
     // accumulator
@@ -32,7 +50,24 @@ typedef struct memory_t {
 
     // processor status register (bitwise flags)
     // NV-BDIZC
-    byte p;
+    // Only I, D, B and the unused bit are kept in flags. Use get_p and set_p for the whole thing.
+    byte flags;
+    byte n_result; // N is bit 7 of this
+    byte z_result; // Z is set when this is 0
+    bool overflow;
+    bool carry;
+
+    long total_cycles;
+    int stall_cycles; // Cycles the CPU's been held up for by DMA, added on to the next instruction
+
+    cpu_timing timing;
+    int bus_cycles; // Cycles of the current instruction the rest of the system's already been run for
+    // Cycles of the current instruction that have been counted but not run yet. They're counted with TIMING_INSTRUCTION
+    // too, though nothing's run off them, so a bus trace can tell which cycle of the instruction an access is on.
+    int bus_pending;
+
+    const cpu_bus* bus;
+    void* bus_context; // Whatever the bus needs to get at, nothing for nes_bus
 
     // currently loaded nes rom
     rom* r;
@@ -46,22 +81,80 @@ typedef struct memory_t {
     // Internal RAM
     byte ram[0x800];
 
-    controller ctrl1;
+    // Controller ports, and what the player was doing as of the last frame
+    input_port ports[2];
+    input_snapshot input;
+    unsigned long long input_frame; // The PPU frame the snapshot was taken for
+    bool hold_input; // The snapshot's being filled in by someone else, like run-ahead, so don't poll for it
+
+    byte cdl_access; // CDL_* flags for what the CPU's reading PRG for right now, if there's a code/data log
+
+    // Pending interrupts and timed events for the PPU, APU and mapper
+    scheduler scheduler;
+
+    dma_unit dma;
 } memory;
 
 byte read_byte(memory* mem, uint16_t address);
 void write_byte(memory* mem, uint16_t address, byte value);
-
-
-void set_flag(memory* mem, int index);
-void clear_flag(memory* mem, int index);
-int get_flag(memory* mem, int index);
+extern const cpu_bus nes_bus;
+// Reads without anything noticing, for debuggers. Registers read as open bus, since reading them changes things.
+byte peek_byte(memory* mem, uint16_t address);
+// Catches the mapper's CPU cycle counter up to time, and schedules the next time it needs looking at
+void schedule_mapper_timer(memory* mem, timestamp time);
 
 
 memory* get_blank_memory(rom* r);
+// Just a CPU, in its power up state, with bus behind it in place of the rest of the NES. Only good for cpu_step with
+// TIMING_INSTRUCTION.
+memory* get_cpu_memory(const cpu_bus* bus, void* bus_context);
 
 void load_rom_into_memory(memory* mem, rom* r);
 
+// Runs the rest of the system for the cycles the CPU's counted so far this instruction. Lives in system.c
+void bus_catch_up(memory* mem);
+
+// PPU, APU and controller registers, and whatever a mapper puts at 0x4020-0x5FFF. Mappers also take writes anywhere
+// in ROM.
+static inline bool is_io_access(uint16_t address, bool write) {
+    return (address >= 0x2000 && address < 0x6000) || (write && address >= 0x8000);
+}
+
+// Set by the debugger when there are CPU watchpoints, so reads and writes only have to look any further then
+extern bool cpu_watchpoints_armed;
+void cpu_watch(uint16_t address, byte value, bool write);
+
+static inline void cpu_bus_cycle(memory* mem, uint16_t address, bool write) {
+    mem->bus_pending++;
+    if (mem->timing == TIMING_BUS_CYCLE || (mem->timing == TIMING_CATCH_UP && is_io_access(address, write))) {
+        bus_catch_up(mem);
+    }
+}
+
+// Reads and writes made by the CPU, which take a cycle each. Everything else, like DMA and the debugger, uses
+// read_byte and write_byte directly.
+static inline byte cpu_read(memory* mem, uint16_t address) {
+    cpu_bus_cycle(mem, address, false);
+    byte value = mem->bus->read(mem, address);
+    if (cpu_watchpoints_armed) {
+        cpu_watch(address, value, false);
+    }
+    return value;
+}
+
+static inline void cpu_write(memory* mem, uint16_t address, byte value) {
+    cpu_bus_cycle(mem, address, true);
+    mem->bus->write(mem, address, value);
+    if (cpu_watchpoints_armed) {
+        cpu_watch(address, value, true);
+    }
+}
+
+// A cycle where the real thing does a dummy read or write. Those aren't emulated, but they still take the time.
+static inline void cpu_idle(memory* mem) {
+    mem->bus_pending++;
+}
+
 #define P_NEGATIVE 7
 #define P_OVERFLOW 6
 #define P_BREAK 4
@@ -70,46 +163,108 @@ void load_rom_into_memory(memory* mem, rom* r);
 #define P_ZERO 1
 #define P_CARRY 0
 
+// The flags that live outside of mem->flags, see get_p
+#define P_LAZY_MASK 0b11000011
+
 
 #define SAME_PAGE(addr1, addr2) (addr1 & 0xFF00) == (addr2 & 0xFF00)
 
 bool is_negative(byte value);
 
-int get_p_negative(memory* mem);
-int get_p_overflow(memory* mem);
-int get_p_break(memory* mem);
-int get_p_decimal(memory* mem);
-int get_p_interrupt(memory* mem);
-int get_p_zero(memory* mem);
-int get_p_carry(memory* mem);
-
-void set_p_negative(memory* mem);
-void set_p_overflow(memory* mem);
-void set_p_break(memory* mem);
-void set_p_decimal(memory* mem);
-void set_p_interrupt(memory* mem);
-void set_p_zero(memory* mem);
-void set_p_carry(memory* mem);
-
-void set_p_negative_to(memory* mem, bool value);
-void set_p_overflow_to(memory* mem, bool value);
-void set_p_break_to(memory* mem, bool value);
-void set_p_decimal_to(memory* mem, bool value);
-void set_p_interrupt_to(memory* mem, bool value);
-void set_p_zero_to(memory* mem, bool value);
-void set_p_carry_to(memory* mem, bool value);
-
-void clear_p_negative(memory* mem);
-void clear_p_overflow(memory* mem);
-void clear_p_break(memory* mem);
-void clear_p_decimal(memory* mem);
-void clear_p_interrupt(memory* mem);
-void clear_p_zero(memory* mem);
-void clear_p_carry(memory* mem);
-
-void set_p_zero_on(memory* mem, byte value);
-void set_p_negative_on(memory* mem, byte value);
-void set_p_zn_on(memory* mem, byte value);
+/*
+ * Nearly every instruction sets N and Z, and plenty set C and V, so those are kept however's cheapest to set them:
+ * N and Z as the result they came from, C and V as bools. They're only put together into P when something wants
+ * the whole byte, like PHP, BRK and interrupts. All inline, so the compiler can keep them in registers.
+ */
+static inline byte get_p(const memory* mem) {
+    return (mem->flags & ~P_LAZY_MASK)
+           | (mem->n_result & 0x80)
+           | (mem->overflow << P_OVERFLOW)
+           | ((mem->z_result == 0) << P_ZERO)
+           | (mem->carry << P_CARRY);
+}
+
+static inline void set_p(memory* mem, byte value) {
+    mem->flags = value & ~P_LAZY_MASK;
+    mem->n_result = value;
+    mem->overflow = (value >> P_OVERFLOW) & 1;
+    mem->z_result = (~value >> P_ZERO) & 1; // Anything non zero clears Z
+    mem->carry = (value >> P_CARRY) & 1;
+}
+
+static inline int get_p_negative(const memory* mem) {
+    return mem->n_result >> 7;
+}
+static inline int get_p_overflow(const memory* mem) {
+    return mem->overflow;
+}
+static inline int get_p_break(const memory* mem) {
+    return (mem->flags >> P_BREAK) & 1;
+}
+static inline int get_p_decimal(const memory* mem) {
+    return (mem->flags >> P_DECIMAL) & 1;
+}
+static inline int get_p_interrupt(const memory* mem) {
+    return (mem->flags >> P_INTERRUPT) & 1;
+}
+static inline int get_p_zero(const memory* mem) {
+    return mem->z_result == 0;
+}
+static inline int get_p_carry(const memory* mem) {
+    return mem->carry;
+}
+
+static inline void set_p_negative_to(memory* mem, bool value) {
+    mem->n_result = value ? 0x80 : 0x00;
+}
+static inline void set_p_overflow_to(memory* mem, bool value) {
+    mem->overflow = value;
+}
+static inline void set_p_flags_bit_to(memory* mem, int index, bool value) {
+    mem->flags = (mem->flags & ~(1 << index)) | (value << index);
+}
+static inline void set_p_break_to(memory* mem, bool value) {
+    set_p_flags_bit_to(mem, P_BREAK, value);
+}
+static inline void set_p_decimal_to(memory* mem, bool value) {
+    set_p_flags_bit_to(mem, P_DECIMAL, value);
+}
+static inline void set_p_interrupt_to(memory* mem, bool value) {
+    set_p_flags_bit_to(mem, P_INTERRUPT, value);
+}
+static inline void set_p_zero_to(memory* mem, bool value) {
+    mem->z_result = !value;
+}
+static inline void set_p_carry_to(memory* mem, bool value) {
+    mem->carry = value;
+}
+
+static inline void set_p_negative(memory* mem) { set_p_negative_to(mem, true); }
+static inline void set_p_overflow(memory* mem) { set_p_overflow_to(mem, true); }
+static inline void set_p_break(memory* mem) { set_p_break_to(mem, true); }
+static inline void set_p_decimal(memory* mem) { set_p_decimal_to(mem, true); }
+static inline void set_p_interrupt(memory* mem) { set_p_interrupt_to(mem, true); }
+static inline void set_p_zero(memory* mem) { set_p_zero_to(mem, true); }
+static inline void set_p_carry(memory* mem) { set_p_carry_to(mem, true); }
+
+static inline void clear_p_negative(memory* mem) { set_p_negative_to(mem, false); }
+static inline void clear_p_overflow(memory* mem) { set_p_overflow_to(mem, false); }
+static inline void clear_p_break(memory* mem) { set_p_break_to(mem, false); }
+static inline void clear_p_decimal(memory* mem) { set_p_decimal_to(mem, false); }
+static inline void clear_p_interrupt(memory* mem) { set_p_interrupt_to(mem, false); }
+static inline void clear_p_zero(memory* mem) { set_p_zero_to(mem, false); }
+static inline void clear_p_carry(memory* mem) { set_p_carry_to(mem, false); }
+
+static inline void set_p_zero_on(memory* mem, byte value) {
+    mem->z_result = value;
+}
+static inline void set_p_negative_on(memory* mem, byte value) {
+    mem->n_result = value;
+}
+static inline void set_p_zn_on(memory* mem, byte value) {
+    mem->z_result = value;
+    mem->n_result = value;
+}
 
 void stack_push(memory* mem, byte value);
 void stack_push16(memory* mem, uint16_t value);
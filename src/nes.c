@@ -1,15 +1,38 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <err.h>
+#include <unistd.h>
 
 #include "system.h"
 #include "cpu.h"
 #include "apu.h"
+#include "audio.h"
+#include "cdl.h"
 #include "debugger.h"
 #include "mem.h"
+#include "runahead.h"
+#include "rollback.h"
+#include "remote.h"
+#include "render.h"
 #include "mapper/rom.h"
+#include "mapper/romdb.h"
+#include "mapper/sram.h"
 #include "util.h"
 
+audio_sink audio;
+
+void close_audio() {
+    audio_close(&audio);
+}
+
+remote_debugger remote;
+
+void close_remote() {
+    remote_close(&remote);
+}
+
 int main(int argc, char** argv) {
     if (argc < 2) {
         printf("Usage: %s <rom.nes>\n", argv[0]);
@@ -34,12 +57,101 @@ int main(int argc, char** argv) {
     }
 
 
+    char* romdb = getenv("NES_ROMDB");
+    if (romdb != NULL) {
+        load_rom_database(romdb);
+    }
+
     rom* r = read_rom(argv[1]);
+    sram_open(r, argv[1]);
+
+    char* cdl = getenv("NES_CDL");
+    if (cdl != NULL) {
+        cdl_open(r, cdl);
+    }
 
     memory* mem = get_blank_memory(r);
 
+    char* input = getenv("NES_INPUT");
+    if (input != NULL && !input_connect_by_name(mem->ports, input)) {
+        errx(EXIT_FAILURE, "Unknown NES_INPUT %s, expected controllers, fourscore, zapper or arkanoid", input);
+    }
 
-    apu_init(&mem->apu_mem);
+    char* timing = getenv("NES_TIMING");
+    if (timing != NULL) {
+        if (strcmp(timing, "instruction") == 0) {
+            mem->timing = TIMING_INSTRUCTION;
+        }
+        else if (strcmp(timing, "catchup") == 0) {
+            mem->timing = TIMING_CATCH_UP;
+        }
+        else if (strcmp(timing, "cycle") == 0) {
+            mem->timing = TIMING_BUS_CYCLE;
+        }
+        else {
+            errx(EXIT_FAILURE, "Unknown NES_TIMING %s, expected instruction, catchup or cycle", timing);
+        }
+    }
+
+    char* audio_format = getenv("NES_AUDIO_FORMAT");
+    if (audio_format != NULL && !audio_set_sample_format(&mem->apu_mem, audio_format)) {
+        errx(EXIT_FAILURE, "Unknown NES_AUDIO_FORMAT %s, expected float or int16", audio_format);
+    }
+    char* audio_output = getenv("NES_AUDIO");
+    if (!audio_open_by_name(&audio, &mem->apu_mem, audio_output != NULL ? audio_output : "portaudio")) {
+        errx(EXIT_FAILURE, "Unknown NES_AUDIO %s, expected portaudio, none, or a .wav or .raw file", audio_output);
+    }
+    atexit(close_audio);
+
+    // Rollback and run-ahead both run frames more than once, which the remote debugger can't make sense of
+    char* netplay = getenv("NES_NETPLAY");
+    char* frames_ahead = getenv("NES_RUNAHEAD");
+    char* debug_socket = getenv("NES_DEBUG_SOCKET");
+    if (debug_socket != NULL && (netplay != NULL || (frames_ahead != NULL && atoi(frames_ahead) > 0))) {
+        errx(EXIT_FAILURE, "NES_DEBUG_SOCKET can't be used with NES_NETPLAY or NES_RUNAHEAD");
+    }
+
+    if (netplay != NULL) {
+        int player_number, local_port, peer_port;
+        if (sscanf(netplay, "%d:%d:%d", &player_number, &local_port, &peer_port) != 3
+            || (player_number != 1 && player_number != 2)) {
+            errx(EXIT_FAILURE, "NES_NETPLAY should be <player 1 or 2>:<local port>:<peer port>, not %s", netplay);
+        }
+        netplay_link link;
+        udp_open(&link, local_port, peer_port);
+        rollback_session session;
+        rollback_init(&session, mem, &link, player_number == 1 ? one : two);
+        input_snapshot snapshot;
+        bool warned = false;
+        while (true) {
+            // Whoever's at this keyboard plays as the netplay player
+            poll_input(&snapshot);
+            if (!rollback_advance(&session, input_buttons_pressed(&snapshot, one))) {
+                usleep(1000);
+            }
+            if (session.desynced && !warned) {
+                printf("Netplay desynced from the other player at frame %u\n", session.desync_frame);
+                warned = true;
+            }
+        }
+    }
+
+    if (frames_ahead != NULL && atoi(frames_ahead) > 0) {
+        run_ahead ra;
+        run_ahead_init(&ra, mem, atoi(frames_ahead));
+        while (true) {
+            run_ahead_frame(&ra, mem);
+        }
+    }
+
+    if (debug_socket != NULL) {
+        remote_open(&remote, debug_socket);
+        atexit(close_remote);
+        while (true) {
+            system_run_frame(mem);
+            remote_poll(&remote, mem);
+        }
+    }
 
     while (true) {
         system_step(mem);
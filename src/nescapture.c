@@ -0,0 +1,79 @@
+#include <err.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "system.h"
+#include "audio.h"
+#include "mem.h"
+#include "cdl.h"
+#include "capture.h"
+#include "mapper/rom.h"
+#include "mapper/romdb.h"
+
+#define DEFAULT_FRAMES 600
+
+bool ends_with(const char* str, const char* suffix) {
+    size_t str_len = strlen(str);
+    size_t suffix_len = strlen(suffix);
+    return str_len >= suffix_len && strcmp(str + str_len - suffix_len, suffix) == 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        printf("nescapture: run a ROM without a display and record its video\n");
+        printf("Usage: %s <rom.nes> <output.y4m|output.rgb|-> [frames] [y4m|rgb]\n", argv[0]);
+        printf("Writes %d frames by default. Use - to stream to stdout, e.g. into ffmpeg.\n", DEFAULT_FRAMES);
+        return 2;
+    }
+
+    const char* output = argv[2];
+    long frames = argc > 3 ? atol(argv[3]) : DEFAULT_FRAMES;
+
+    capture_format format = ends_with(output, ".rgb") ? CAPTURE_RAW_RGB : CAPTURE_Y4M;
+    if (argc > 4) {
+        if (strcmp(argv[4], "rgb") == 0) {
+            format = CAPTURE_RAW_RGB;
+        }
+        else if (strcmp(argv[4], "y4m") == 0) {
+            format = CAPTURE_Y4M;
+        }
+        else {
+            printf("Unknown capture format %s, expected y4m or rgb\n", argv[4]);
+            return 2;
+        }
+    }
+
+    // Open the output first, so if it's stdout, loading the ROM doesn't print into the video
+    capture_open(output, format);
+
+    char* romdb = getenv("NES_ROMDB");
+    if (romdb != NULL) {
+        load_rom_database(romdb);
+    }
+
+    rom* r = read_rom(argv[1]);
+    char* cdl = getenv("NES_CDL");
+    if (cdl != NULL) {
+        cdl_open(r, cdl);
+    }
+    memory* mem = get_blank_memory(r);
+
+    char* audio_format = getenv("NES_AUDIO_FORMAT");
+    if (audio_format != NULL && !audio_set_sample_format(&mem->apu_mem, audio_format)) {
+        errx(EXIT_FAILURE, "Unknown NES_AUDIO_FORMAT %s, expected float or int16", audio_format);
+    }
+    audio_sink audio;
+    char* audio_output = getenv("NES_AUDIO");
+    if (!audio_open_by_name(&audio, &mem->apu_mem, audio_output != NULL ? audio_output : "none")) {
+        errx(EXIT_FAILURE, "Unknown NES_AUDIO %s, expected portaudio, none, or a .wav or .raw file", audio_output);
+    }
+
+    while (capture_frames_queued() < frames) {
+        system_step(mem);
+    }
+
+    audio_close(&audio);
+    capture_close();
+    return 0;
+}
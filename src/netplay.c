@@ -0,0 +1,129 @@
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "netplay.h"
+#include "debugger.h"
+
+static void loopback_send(netplay_link* link, const byte* data, size_t length) {
+    loopback_queue* q = link->outbox;
+    if (q->count == LOOPBACK_QUEUE_LENGTH || length > NETPLAY_MAX_PACKET) {
+        dprintf("Loopback queue full, dropping a packet\n");
+        return;
+    }
+    loopback_packet* packet = &q->packets[(q->head + q->count++) % LOOPBACK_QUEUE_LENGTH];
+    memcpy(packet->data, data, length);
+    packet->length = length;
+    packet->ready_at = q->now + q->latency;
+}
+
+static size_t loopback_receive(netplay_link* link, byte* data, size_t length) {
+    loopback_queue* q = link->inbox;
+    if (q->count == 0 || q->packets[q->head].ready_at > q->now) {
+        return 0;
+    }
+    loopback_packet* packet = &q->packets[q->head];
+    q->head = (q->head + 1) % LOOPBACK_QUEUE_LENGTH;
+    q->count--;
+    size_t received = packet->length < length ? packet->length : length;
+    memcpy(data, packet->data, received);
+    return received;
+}
+
+static void loopback_close(netplay_link* link) {
+    link->inbox = NULL;
+    link->outbox = NULL;
+}
+
+static const netplay_link_ops loopback_ops = {
+    .name = "loopback", .send = loopback_send, .receive = loopback_receive, .close = loopback_close
+};
+
+static void loopback_queue_init(loopback_queue* q, uint64_t latency) {
+    q->head = 0;
+    q->count = 0;
+    q->now = 0;
+    q->latency = latency;
+}
+
+void loopback_open(netplay_link* a, netplay_link* b, loopback_queue* a_to_b, loopback_queue* b_to_a, uint64_t latency) {
+    loopback_queue_init(a_to_b, latency);
+    loopback_queue_init(b_to_a, latency);
+    a->ops = &loopback_ops;
+    a->socket = -1;
+    a->outbox = a_to_b;
+    a->inbox = b_to_a;
+    b->ops = &loopback_ops;
+    b->socket = -1;
+    b->outbox = b_to_a;
+    b->inbox = a_to_b;
+}
+
+void loopback_tick(netplay_link* a) {
+    a->inbox->now++;
+    a->outbox->now++;
+}
+
+static void udp_send(netplay_link* link, const byte* data, size_t length) {
+    // A full socket buffer is just another lost packet
+    if (send(link->socket, data, length, 0) < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNREFUSED) {
+        dprintf("Netplay send failed: %s\n", strerror(errno));
+    }
+}
+
+static size_t udp_receive(netplay_link* link, byte* data, size_t length) {
+    while (true) {
+        ssize_t received = recv(link->socket, data, length, 0);
+        if (received >= 0) {
+            return (size_t)received;
+        }
+        // The peer not being up yet shows up here as a refused connection, there's nothing to do but keep going
+        if (errno != ECONNREFUSED) {
+            return 0;
+        }
+    }
+}
+
+static void udp_close(netplay_link* link) {
+    close(link->socket);
+    link->socket = -1;
+}
+
+static const netplay_link_ops udp_ops = {
+    .name = "UDP", .send = udp_send, .receive = udp_receive, .close = udp_close
+};
+
+void udp_open(netplay_link* link, uint16_t local_port, uint16_t peer_port) {
+    link->ops = &udp_ops;
+    link->inbox = NULL;
+    link->outbox = NULL;
+    link->socket = socket(AF_INET, SOCK_DGRAM, 0);
+    if (link->socket < 0) {
+        errx(EXIT_FAILURE, "Unable to open a netplay socket: %s", strerror(errno));
+    }
+
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons(local_port);
+    if (bind(link->socket, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        errx(EXIT_FAILURE, "Unable to listen for netplay on port %d: %s", local_port, strerror(errno));
+    }
+
+    // Connected, so packets from anywhere but the peer are ignored
+    address.sin_port = htons(peer_port);
+    if (connect(link->socket, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        errx(EXIT_FAILURE, "Unable to reach the netplay peer on port %d: %s", peer_port, strerror(errno));
+    }
+
+    if (fcntl(link->socket, F_SETFL, fcntl(link->socket, F_GETFL) | O_NONBLOCK) < 0) {
+        errx(EXIT_FAILURE, "Unable to set up the netplay socket: %s", strerror(errno));
+    }
+}
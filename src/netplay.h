@@ -0,0 +1,64 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "util.h"
+
+#define NETPLAY_MAX_PACKET 64
+#define LOOPBACK_QUEUE_LENGTH 64
+
+struct netplay_link_ops_t;
+
+typedef struct loopback_packet_t {
+    byte data[NETPLAY_MAX_PACKET];
+    size_t length;
+    uint64_t ready_at;
+} loopback_packet;
+
+// One direction of a loopback pair. Packets come out latency ticks after they went in, or not at all if it's full.
+typedef struct loopback_queue_t {
+    loopback_packet packets[LOOPBACK_QUEUE_LENGTH];
+    int head;
+    int count;
+    uint64_t now;
+    uint64_t latency;
+} loopback_queue;
+
+/*
+ * How netplay peers get packets to each other. Packets can go missing and nothing's retried, so whatever's sent has
+ * to make sense on its own.
+ */
+typedef struct netplay_link_t {
+    const struct netplay_link_ops_t* ops;
+    int socket; // UDP
+    loopback_queue* inbox; // Loopback
+    loopback_queue* outbox;
+} netplay_link;
+
+typedef struct netplay_link_ops_t {
+    const char* name;
+    void (*send)(netplay_link* link, const byte* data, size_t length);
+    // Returns the length of the next packet waiting, or 0 if there isn't one. Never blocks.
+    size_t (*receive)(netplay_link* link, byte* data, size_t length);
+    void (*close)(netplay_link* link);
+} netplay_link_ops;
+
+// Two links talking to each other in the same process, for tests. a_to_b and b_to_a are the packets in flight.
+void loopback_open(netplay_link* a, netplay_link* b, loopback_queue* a_to_b, loopback_queue* b_to_a, uint64_t latency);
+// Moves time along for both directions of the pair a is part of
+void loopback_tick(netplay_link* a);
+
+// Talks to a peer on this machine over UDP
+void udp_open(netplay_link* link, uint16_t local_port, uint16_t peer_port);
+
+static inline void netplay_send(netplay_link* link, const byte* data, size_t length) {
+    link->ops->send(link, data, length);
+}
+
+static inline size_t netplay_receive(netplay_link* link, byte* data, size_t length) {
+    return link->ops->receive(link, data, length);
+}
+
+static inline void netplay_close(netplay_link* link) {
+    link->ops->close(link);
+}
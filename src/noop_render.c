@@ -1,8 +1,8 @@
 #include "render.h"
-void render_screen(color (*screen)[240][256]) {
+void render_screen(byte (*screen)[240][256]) {
     // Do nothing
 }
 
-bool get_button(button btn, player p) {
-    return false;
+void poll_input(input_snapshot* input) {
+    // Nobody's playing
 }
@@ -1,22 +1,25 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <string.h>
 #include <err.h>
 
 #include "ppu.h"
-#include "cpu.h"
 #include "debugger.h"
 #include "render.h"
-#include "palette.h"
 #include "mapper/mapper.h"
+#include "mapper/sram.h"
+#include "cdl.h"
 
 #define VBLANK_LINE 241
 #define MAX_SPRITES_PER_LINE 8
 
 ppu_memory get_ppu_mem(rom* r) {
     ppu_memory ppu_mem;
+    memset(&ppu_mem, 0, sizeof(ppu_mem));
 
     ppu_mem.r = r;
+    ppu_mem.cdl_access = CDL_CHR_RENDERED;
 
     ppu_mem.control     = 0b00000000;
     ppu_mem.mask        = 0b00000000;
@@ -26,6 +29,7 @@ ppu_memory get_ppu_mem(rom* r) {
     ppu_mem.t           = 0b0000000000000000;
     ppu_mem.w           = HIGH;
     ppu_mem.data        = 0b00000000;
+    ppu_mem.open_bus    = 0b00000000;
 
     ppu_mem.tile.attribute_table  = 0;
     ppu_mem.tile.nametable        = 0;
@@ -35,8 +39,26 @@ ppu_memory get_ppu_mem(rom* r) {
     ppu_mem.frame = 1;
     ppu_mem.scan_line = 0;
     ppu_mem.cycle = 0;
+    ppu_mem.dot = 0;
+
+    ppu_mem.present = true;
+    ppu_mem.speculative = false;
 
     ppu_mem.num_sprites = 0;
+    ppu_mem.sprite_index_dirty = true;
+
+    ppu_mem.watch_a12 = mapper_watches_a12(r);
+    ppu_mem.watch_scanlines = mapper_watches_scanlines(r);
+    ppu_mem.watch_time = 1; // The first step takes the PPU to cycle 1
+    ppu_mem.watch_frame = ppu_mem.frame;
+    ppu_mem.watch_line = 0;
+    ppu_mem.watch_cycle = 1;
+    ppu_mem.a12_level = false;
+    ppu_mem.a12_low_since = 0;
+
+    for (int i = 0; i < 256; i++) {
+        ppu_mem.sprite_line[i].color = 0;
+    }
 
     return ppu_mem;
 }
@@ -96,43 +118,9 @@ uint16_t get_attribute_address(ppu_memory* ppu_mem) {
     return (uint16_t) (0x23C0 | (ppu_mem->v & 0x0C00) | ((ppu_mem->v >> 4) & 0x38) | ((ppu_mem->v >> 2) & 0x07));
 }
 
-uint16_t mirror_nametable_address(uint16_t addr, ppu_memory* ppu_mem) {
-    uint16_t nametable_addr = addr - (uint16_t)0x2000;
-    nametable_mirroring mirror_mode = ppu_mem->r->nametable_mirroring_mode;
-
-    if (mirror_mode == HORIZONTAL) {
-        if (nametable_addr < 0x400) {
-            // Nothing!
-        } else if (nametable_addr < 0x800) {
-            // 2nd nametable is a mirror of the first
-            nametable_addr -= 0x400;
-        } else if (nametable_addr < 0xC00) {
-            // third nametable is the 2nd in memory
-            nametable_addr -= 0x400;
-        } else {
-            // fourth nametable is a mirror of the third
-            nametable_addr %= 0x800;
-        }
-    } else if (mirror_mode == VERTICAL) {
-        if (nametable_addr >= 0x800) {
-            // First and second nametables are 0x000-0x800
-            // Third and fourth are mirrors of first and second, respectively
-            nametable_addr %= 0x800;
-        }
-    } else if (mirror_mode == SINGLE_LOWER) {
-        nametable_addr %= 0x400;
-    } else if (mirror_mode == SINGLE_UPPER) {
-        nametable_addr %= 0x400;
-        nametable_addr += 0x400;
-    } else {
-        errx(EXIT_FAILURE, "Need to implement some kind of mirroring! Rev up those debuggers!");
-    }
-
-    if (nametable_addr >= 0x800) {
-        errx(EXIT_FAILURE, "Got a value >= 0x800 after mirroring! Rev up those debuggers!");
-    }
-
-    return nametable_addr;
+static inline uint16_t mirror_nametable_address(uint16_t addr, ppu_memory* ppu_mem) {
+    // Bits 10 and 11 select one of the four nametables, the mapper decides where each one lives
+    return ppu_mem->r->nametable_pages[(addr >> 10) & 0b11] | (addr & (uint16_t)0x3FF);
 }
 
 uint16_t mirror_palette_address(uint16_t address) {
@@ -173,7 +161,12 @@ byte vram_read(ppu_memory* ppu_mem, uint16_t address) {
 
     // Pattern tables
     if (address < 0x2000) {
-        result = mapper_chr_read(ppu_mem->r, address);
+        rom* r = ppu_mem->r;
+        r->chr_offset = cdl_chr_sink(r);
+        result = mapper_chr_read(r, address);
+        if (r->cdl_chr != NULL) {
+            r->cdl_chr[r->chr_offset] |= ppu_mem->cdl_access;
+        }
     }
     // Nametables
     else if (address < 0x3F00) {
@@ -193,6 +186,19 @@ byte vram_read(ppu_memory* ppu_mem, uint16_t address) {
     return result;
 }
 
+byte ppu_peek(ppu_memory* ppu_mem, uint16_t address) {
+    address %= 0x4000;
+    if (address < 0x2000) {
+        return mapper_chr_read(ppu_mem->r, address);
+    }
+    else if (address < 0x3F00) {
+        return ppu_mem->name_tables[mirror_nametable_address(address, ppu_mem)];
+    }
+    else {
+        return ppu_mem->palette_ram[mirror_palette_address(address)];
+    }
+}
+
 bool get_control_flag(ppu_memory* mem, int index) {
     return (mem->control & mask_flag(index)) != 0;
 }
@@ -229,15 +235,6 @@ uint16_t get_sprite_pattern_table_address(ppu_memory* ppu_mem) {
     return get_sprite_pattern_table_flag(ppu_mem) * (uint16_t)0x1000;
 }
 
-// 0 - 261
-// 0: Pre-render
-// 1-240: Visible
-// 241: Post-render
-// 242-261: VBLANK
-#define NUM_LINES 262
-// 0 - 340
-#define CYCLES_PER_LINE 341
-
 bool rendering_enabled(ppu_memory* ppu_mem) {
     return (ppu_mem->mask & 0b00011000) > 0; // Enable sprites OR enable background flags enabled
 }
@@ -283,7 +280,8 @@ bool is_visible(ppu_memory* ppu_mem) {
 void set_vblank(ppu_memory* ppu_mem) {
     ppu_mem->status |= 0b10000000; // Set VBlank flag on PPUSTATUS
     if (vblank_nmi(ppu_mem)) {
-        trigger_nmi();
+        dprintf("!!! NMI TRIGGERED !!!\n");
+        schedule_event(ppu_mem->scheduler, EVENT_NMI, ppu_mem->dot, 0);
     }
 }
 
@@ -324,11 +322,10 @@ byte get_color(byte fine_x, tiledata tile) {
     }
 }
 
-color get_real_color(ppu_memory* ppu_mem, byte colorbyte) {
+byte get_real_color(ppu_memory* ppu_mem, byte colorbyte) {
     uint16_t addr = (uint16_t)(colorbyte + 0x3F00);
     byte palette_entry = vram_read(ppu_mem, addr);
-    palette_entry %= 64;
-    return rgb_palette[palette_entry];
+    return palette_entry % (byte)64;
 }
 
 int get_screen_x(ppu_memory* ppu_mem) {
@@ -349,47 +346,23 @@ void render_pixel(ppu_memory* ppu_mem) {
 
     // Background
     byte background_color = 0;
-    color real_background_color;
+    byte real_background_color;
 
     if (background_enabled(ppu_mem)) {
         background_color = get_color(get_fine_x(ppu_mem), ppu_mem->tile);
     }
     real_background_color = get_real_color(ppu_mem, background_color);
 
-    byte sprite_color;
-    color real_sprite_color;
-    bool found_sprite = false;
-    int found_sprite_index = -1;
     // Sprites
-    if (sprites_enabled(ppu_mem)) {
-        for (int i = 0; i < ppu_mem->num_sprites && !found_sprite; i++) {
-            sprite s = ppu_mem->sprites[i];
-            int offset = x - s.x_coord;
-            // Does the sprite overlap the pixel we're currently in?
-            if (offset >= 0 && offset < 8) {
-                byte color = (s.pattern.palette & (byte) 0b11) << 2;
-                int shift = s.pattern.reverse ? offset : 7 - offset;
-                color |= ((s.pattern.high_byte >> shift) & 1) << 1;
-                color |= (s.pattern.low_byte >> shift) & 1;
-
-                // Is the pixel of the sprite we want to render non-transparent?
-                if (color % 4 != 0) {
-                    dprintf("Color: %02X\n", color);
-                    found_sprite = true;
-                    sprite_color = color | (byte) 0x10;
-                    found_sprite_index = i;
-                    real_sprite_color = get_real_color(ppu_mem, sprite_color);
-                }
-            }
-        }
-    }
+    sprite_pixel sp = ppu_mem->sprite_line[x];
 
-    if (found_sprite) {
-        dprintf("RENDERING SPRITE PIXEL! %02X%02X%02X%02X\n", real_sprite_color.r, real_sprite_color.g, real_sprite_color.b, real_sprite_color.a);
-        if (found_sprite_index == 0 && background_color != 0 && x != 255) {
+    if (sprites_enabled(ppu_mem) && sp.color != 0) {
+        byte real_sprite_color = get_real_color(ppu_mem, sp.color);
+        dprintf("RENDERING SPRITE PIXEL! %02X\n", real_sprite_color);
+        if (sp.sprite_zero && background_color != 0 && x != 255) {
             set_sprite_zero_hit(ppu_mem);
         }
-        if (background_color != 0 && ppu_mem->sprites[found_sprite_index].priority == 1) {
+        if (background_color != 0 && sp.priority) {
             ppu_mem->screen[y][x] = real_background_color;
         }
         else {
@@ -400,7 +373,7 @@ void render_pixel(ppu_memory* ppu_mem) {
         ppu_mem->screen[y][x] = real_background_color;
     }
 
-    dprintf("Pixel %d,%d is 0x%02X0x%02X0x%02X\n", x, y, real_background_color.r, real_background_color.g, real_background_color.b);
+    dprintf("Pixel %d,%d is 0x%02X\n", x, y, ppu_mem->screen[y][x]);
 }
 
 void fetch_step(ppu_memory* ppu_mem) {
@@ -519,42 +492,272 @@ sprite_pattern get_sprite_pattern(ppu_memory* ppu_mem, byte tile, byte attr, int
     return sp;
 }
 
-void evaluate_sprites(ppu_memory* ppu_mem) {
+void rebuild_sprite_index(ppu_memory* ppu_mem) {
     int sprite_height = get_sprite_height(ppu_mem);
-    byte num_sprites_found = 0;
+
+    for (int line = 0; line < 240; line++) {
+        ppu_mem->sprite_line_count[line] = 0;
+    }
+
     for (byte i = 0; i < 64; i++) {
+        int y_coord = ppu_mem->oam_data[i * 4];
+        for (int line = y_coord; line < y_coord + sprite_height && line < 240; line++) {
+            byte count = ppu_mem->sprite_line_count[line];
+            if (count < MAX_SPRITES_PER_LINE) {
+                ppu_mem->sprite_line_index[line][count] = i;
+            }
+            // Saturate at one more than the max, that's all we need to know to set the overflow flag.
+            if (count <= MAX_SPRITES_PER_LINE) {
+                ppu_mem->sprite_line_count[line] = count + (byte)1;
+            }
+        }
+    }
+
+    ppu_mem->sprite_index_dirty = false;
+}
+
+void rasterize_sprites(ppu_memory* ppu_mem) {
+    for (int x = 0; x < 256; x++) {
+        ppu_mem->sprite_line[x].color = 0;
+    }
+
+    // Earlier sprites win, so draw them back to front and let the front ones overwrite
+    for (int i = ppu_mem->num_sprites - 1; i >= 0; i--) {
+        sprite s = ppu_mem->sprites[i];
+        byte palette = (s.pattern.palette & (byte) 0b11) << 2;
+
+        for (int offset = 0; offset < 8 && s.x_coord + offset < 256; offset++) {
+            int shift = s.pattern.reverse ? offset : 7 - offset;
+            byte color = palette;
+            color |= ((s.pattern.high_byte >> shift) & 1) << 1;
+            color |= (s.pattern.low_byte >> shift) & 1;
+
+            // Transparent pixels don't cover up sprites behind them
+            if (color % 4 != 0) {
+                sprite_pixel* px = &ppu_mem->sprite_line[s.x_coord + offset];
+                px->color = color | (byte) 0x10;
+                px->priority = s.priority;
+                // Sprite zero hit is checked against the first sprite found on the line
+                px->sprite_zero = i == 0;
+            }
+        }
+    }
+}
+
+void evaluate_sprites(ppu_memory* ppu_mem) {
+    if (ppu_mem->sprite_index_dirty) {
+        rebuild_sprite_index(ppu_mem);
+    }
+
+    byte num_sprites_found = ppu_mem->sprite_line_count[ppu_mem->scan_line];
+
+    if (num_sprites_found > MAX_SPRITES_PER_LINE) {
+        num_sprites_found = MAX_SPRITES_PER_LINE;
+        set_sprite_overflow(ppu_mem);
+    }
+
+    // Only fetch pattern data for the sprites that'll actually be drawn. Some mappers bank sprites separately.
+    ppu_mem->r->ppu_fetching_sprites = true;
+    for (byte n = 0; n < num_sprites_found; n++) {
+        byte i = ppu_mem->sprite_line_index[ppu_mem->scan_line][n];
         byte y_coord = ppu_mem->oam_data[i * 4];
         byte tile    = ppu_mem->oam_data[i * 4 + 1];
         byte attr    = ppu_mem->oam_data[i * 4 + 2];
         byte x_coord = ppu_mem->oam_data[i * 4 + 3];
 
         // How many pixels offset from the current scan line the sprite is
-        int16_t offset = (int16_t)ppu_mem->scan_line - (int16_t)y_coord;
-        if (offset >= 0 && offset < sprite_height) {
-            sprite s;
-            s.pattern = get_sprite_pattern(ppu_mem, tile, attr, offset);
-            s.x_coord = x_coord;
-            s.priority = (attr & 0b00100000) > 0;
-            s.index = i;
-
-            if (num_sprites_found < MAX_SPRITES_PER_LINE) {
-                ppu_mem->sprites[num_sprites_found] = s;
+        int offset = ppu_mem->scan_line - y_coord;
+
+        sprite s;
+        s.pattern = get_sprite_pattern(ppu_mem, tile, attr, offset);
+        s.x_coord = x_coord;
+        s.priority = (attr & 0b00100000) > 0;
+        s.index = i;
+
+        ppu_mem->sprites[n] = s;
+    }
+    ppu_mem->r->ppu_fetching_sprites = false;
+
+    ppu_mem->num_sprites = num_sprites_found;
+
+    rasterize_sprites(ppu_mem);
+}
+
+// scan_line is one ahead of the usual numbering (0 is the pre-render line), so lines 0 to 240 are the ones the real
+// PPU fetches pattern data on.
+#define A12_LAST_FETCH_LINE 240
+// While rendering, a fetch starts every 2 dots from 1 to 339. Nametable and attribute fetches (the first half of each
+// 8 dots) keep A12 low, pattern fetches (the second half) depend on the table, so it can only change every 4 dots.
+#define A12_LAST_FETCH_CYCLE 337
+// Mappers that count lines are told about each visible line this far in, and then about the post-render line
+#define MAPPER_SCANLINE_CYCLE 4
+#define MAPPER_FRAME_END_LINE 241
+
+bool is_a12_stop(int line, int cycle) {
+    return line <= A12_LAST_FETCH_LINE && cycle <= A12_LAST_FETCH_CYCLE && (cycle - 1) % 4 == 0;
+}
+
+// The frame end gets through even with rendering off, so the mapper doesn't think it's still in the frame
+bool is_scanline_stop(int line, bool is_rendering_enabled) {
+    return line == MAPPER_FRAME_END_LINE || (is_rendering_enabled && line >= 1 && line <= 240);
+}
+
+bool a12_sprite_level(ppu_memory* ppu_mem, int line, int slot) {
+    if (!get_sprite_size_flag(ppu_mem)) {
+        return get_sprite_pattern_table_flag(ppu_mem);
+    }
+    if (line < 240) {
+        if (ppu_mem->sprite_index_dirty) {
+            rebuild_sprite_index(ppu_mem);
+        }
+        if (slot < ppu_mem->sprite_line_count[line] && slot < MAX_SPRITES_PER_LINE) {
+            byte tile = ppu_mem->oam_data[ppu_mem->sprite_line_index[line][slot] * 4 + 1];
+            return (tile & 1) == 1;
+        }
+    }
+    // Empty slots fetch tile 0xFF, and 8x16 sprites take their pattern table from bit 0 of the tile
+    return true;
+}
+
+bool a12_fetch_level(ppu_memory* ppu_mem, int line, int cycle) {
+    if ((cycle - 1) % 8 < 4) {
+        return false;
+    }
+    if (cycle > 256 && cycle <= 320) {
+        return a12_sprite_level(ppu_mem, line, (cycle - 257) / 8);
+    }
+    return get_control_flag(ppu_mem, 4);
+}
+
+// Returns true if this is a rise the mapper would notice
+bool move_a12(bool* level, timestamp* low_since, bool new_level, timestamp time) {
+    bool noticed = new_level && !*level && time - *low_since >= MAPPER_A12_FILTER_DOTS;
+    if (!new_level && *level) {
+        *low_since = time;
+    }
+    *level = new_level;
+    return noticed;
+}
+
+/*
+ * Works out what the mapper sees of the PPU from watch_time up to and including until, from the registers as they are
+ * now: A12 rising for mappers that watch it, and lines starting for mappers that count them. Anything that changes the
+ * registers calls mapper_watch_changed first, so they can't have changed in between.
+ *
+ * If commit is set, the mapper is told about everything it'd notice and the new state is kept. Otherwise nothing is
+ * changed, and the time of the first thing the mapper would notice is returned, or NEVER if there isn't one.
+ */
+timestamp walk_mapper_watch(ppu_memory* ppu_mem, timestamp until, bool commit) {
+    timestamp time = ppu_mem->watch_time;
+    unsigned long long frame = ppu_mem->watch_frame;
+    int line = ppu_mem->watch_line;
+    int cycle = ppu_mem->watch_cycle;
+    bool level = ppu_mem->a12_level;
+    timestamp low_since = ppu_mem->a12_low_since;
+    bool is_rendering_enabled = rendering_enabled(ppu_mem);
+    bool watch_a12 = ppu_mem->watch_a12 && is_rendering_enabled;
+    bool watch_scanlines = ppu_mem->watch_scanlines;
+
+    while (true) {
+        // Skip straight to the next fetch or line start, or to the start of the next line if there isn't one
+        int next = CYCLES_PER_LINE;
+        if (watch_a12 && line <= A12_LAST_FETCH_LINE && cycle <= A12_LAST_FETCH_CYCLE) {
+            next = cycle <= 1 ? 1 : ((cycle + 2) / 4) * 4 + 1;
+        }
+        if (watch_scanlines && cycle <= MAPPER_SCANLINE_CYCLE && next > MAPPER_SCANLINE_CYCLE
+            && is_scanline_stop(line, is_rendering_enabled)) {
+            next = MAPPER_SCANLINE_CYCLE;
+        }
+        if (time + (next - cycle) > until) {
+            cycle += until + 1 - time;
+            time = until + 1;
+            break;
+        }
+        time += next - cycle;
+        cycle = next;
+
+        if (cycle == CYCLES_PER_LINE) {
+            cycle = 0;
+            if (++line >= NUM_LINES) {
+                line = 0;
+                frame++;
+                // Same as ppu_step
+                if (frame % 2 == 1 && is_rendering_enabled) {
+                    cycle++;
+                }
             }
+            continue;
+        }
 
-            num_sprites_found++;
+        if (watch_scanlines && cycle == MAPPER_SCANLINE_CYCLE && is_scanline_stop(line, is_rendering_enabled)) {
+            if (!commit) {
+                return time;
+            }
+            if (mapper_scanline(ppu_mem->r, line - 1)) {
+                assert_irq(ppu_mem->scheduler, IRQ_MAPPER);
+            }
+        }
+
+        if (watch_a12 && is_a12_stop(line, cycle)
+            && move_a12(&level, &low_since, a12_fetch_level(ppu_mem, line, cycle), time)) {
+            if (!commit) {
+                return time;
+            }
+            if (mapper_a12_rise(ppu_mem->r)) {
+                assert_irq(ppu_mem->scheduler, IRQ_MAPPER);
+            }
         }
+        time++;
+        cycle++;
     }
 
-    if (num_sprites_found > MAX_SPRITES_PER_LINE) {
-        num_sprites_found = MAX_SPRITES_PER_LINE;
-        set_sprite_overflow(ppu_mem);
+    if (commit) {
+        ppu_mem->watch_time = time;
+        ppu_mem->watch_frame = frame;
+        ppu_mem->watch_line = line;
+        ppu_mem->watch_cycle = cycle;
+        ppu_mem->a12_level = level;
+        ppu_mem->a12_low_since = low_since;
     }
+    return NEVER;
+}
 
-    ppu_mem->num_sprites = num_sprites_found;
+// Catches up to the next thing the mapper will notice, and schedules the one after
+void mapper_watch_event(ppu_memory* ppu_mem, timestamp time) {
+    walk_mapper_watch(ppu_mem, time, true);
+
+    // Some setups (everything in the same pattern table) never let A12 fall long enough, so don't look forever
+    timestamp horizon = time + NUM_LINES * CYCLES_PER_LINE;
+    timestamp next = walk_mapper_watch(ppu_mem, horizon, false);
+    schedule_event(ppu_mem->scheduler, EVENT_MAPPER_PPU, next == NEVER ? horizon : next, 0);
+}
+
+// Call before changing anything the mapper watch depends on. Everything up to now happened the old way.
+void mapper_watch_changed(ppu_memory* ppu_mem) {
+    if (!ppu_mem->watch_a12 && !ppu_mem->watch_scanlines) {
+        return;
+    }
+    walk_mapper_watch(ppu_mem, ppu_mem->dot, true);
+    // The next one gets worked out again once the change has been made
+    schedule_event(ppu_mem->scheduler, EVENT_MAPPER_PPU, ppu_mem->dot, 0);
+}
+
+// When not rendering, the address bus is left holding v
+void a12_follow_v(ppu_memory* ppu_mem) {
+    if (!ppu_mem->watch_a12 || rendering_enabled(ppu_mem)) {
+        return;
+    }
+    mapper_watch_changed(ppu_mem);
+    if (move_a12(&ppu_mem->a12_level, &ppu_mem->a12_low_since, (ppu_mem->v & 0x1000) != 0, ppu_mem->dot)) {
+        if (mapper_a12_rise(ppu_mem->r)) {
+            assert_irq(ppu_mem->scheduler, IRQ_MAPPER);
+        }
+    }
 }
 
 void ppu_step(ppu_memory* ppu_mem) {
     bool is_rendering_enabled = rendering_enabled(ppu_mem);
+    ppu_mem->dot++;
     ppu_mem->cycle++;
     if (ppu_mem->cycle >= CYCLES_PER_LINE) {
         ppu_mem->cycle = 0;
@@ -571,19 +774,23 @@ void ppu_step(ppu_memory* ppu_mem) {
             }
 
             dprintf("Rendering frame %llu\n", ppu_mem->frame);
-            long buffered_samples = *(ppu_mem->apu_ring_buffer_write_index) - *(ppu_mem->apu_ring_buffer_read_index);
-            // We need about 735 samples to get through a frame, wait for 1000 just to be safe
-            if (buffered_samples > 1000) {
-                render_screen(&ppu_mem->screen);
+            if (ppu_mem->present) {
+                long buffered_samples = *(ppu_mem->apu_ring_buffer_write_index) - *(ppu_mem->apu_ring_buffer_read_index);
+                // We need about 735 samples to get through a frame, wait for 1000 just to be safe. Only when something's
+                // playing them as they come, though: nothing else reads them out, so they'd never catch up.
+                if (!*(ppu_mem->apu_real_time) || buffered_samples > 1000) {
+                    render_screen(&ppu_mem->screen);
+                }
+                else {
+                    printf("Skipped frame\n");
+                }
             }
-            else {
-                printf("Skipped frame\n");
+            if (!ppu_mem->speculative) {
+                sram_frame(ppu_mem->r);
             }
         }
     }
 
-    mapper_ppu_step(ppu_mem->r, ppu_mem->cycle, ppu_mem->scan_line, is_rendering_enabled);
-
     // Visible
     if (ppu_mem->scan_line < 240) {
         if (is_rendering_enabled) {
@@ -642,6 +849,12 @@ void ppu_step(ppu_memory* ppu_mem) {
     }
 }
 
+void ppu_run(ppu_memory* ppu_mem, int dots) {
+    for (int i = 0; i < dots; i++) {
+        ppu_step(ppu_mem);
+    }
+}
+
 byte read_status_sideeffects(ppu_memory* ppu_mem) {
     dprintf("WARNING: returning status register with sideeffects\n");
     byte oldval = ppu_mem->status;
@@ -650,14 +863,12 @@ byte read_status_sideeffects(ppu_memory* ppu_mem) {
     return oldval;
 }
 
-byte ppu_open_bus;
-
 byte read_ppu_register(ppu_memory* ppu_mem, byte register_num) {
     byte result;
     switch (register_num) {
         case 2: {
             // Update last 5 bits of status register from open bus
-            byte last5 = ppu_open_bus & (byte)0b00011111;
+            byte last5 = ppu_mem->open_bus & (byte)0b00011111;
             ppu_mem->status = (ppu_mem->status & (byte)0b11100000) | last5;
             result = read_status_sideeffects(ppu_mem);
             break;
@@ -666,7 +877,10 @@ byte read_ppu_register(ppu_memory* ppu_mem, byte register_num) {
             result = ppu_mem->oam_data[ppu_mem->oam_address];
             break;
         case 7: {
+            ppu_mem->cdl_access = CDL_CHR_READ;
             byte value = vram_read(ppu_mem, ppu_mem->v);
+            ppu_mem->cdl_access = CDL_CHR_RENDERED;
+            ppu_watch_access(ppu_mem->v, value, false);
             if (ppu_mem->v < 0x3F00) {
                 byte return_value = ppu_mem->fake_buffer;
                 ppu_mem->fake_buffer = value;
@@ -676,34 +890,64 @@ byte read_ppu_register(ppu_memory* ppu_mem, byte register_num) {
                 ppu_mem->fake_buffer = vram_read(ppu_mem, ppu_mem->v - (uint16_t)0x1000);
             }
             ppu_mem->v += get_addr_increment(ppu_mem);
+            a12_follow_v(ppu_mem);
 
             result = value;
             break;
         }
         default:
             printf("WARNING: reading from invalid PPU register %x - only 2, 4, and 7 are capable of being read from\n", register_num);
-            return ppu_open_bus;
+            return ppu_mem->open_bus;
     }
 
-    ppu_open_bus = result;
+    ppu_mem->open_bus = result;
 
     return result;
 }
 
 void write_oam_byte(ppu_memory* ppu_mem, byte value) {
+    if (get_sprite_size_flag(ppu_mem)) {
+        // 8x16 sprites pick their pattern table by tile number
+        mapper_watch_changed(ppu_mem);
+    }
     ppu_mem->oam_data[ppu_mem->oam_address++] = value;
+    ppu_mem->sprite_index_dirty = true;
+}
+
+// All 256 bytes at once from OAM DMA, starting and ending at oam_address
+void write_oam_page(ppu_memory* ppu_mem, const byte* data) {
+    if (get_sprite_size_flag(ppu_mem)) {
+        mapper_watch_changed(ppu_mem);
+    }
+    size_t first = sizeof(ppu_mem->oam_data) - ppu_mem->oam_address;
+    memcpy(&ppu_mem->oam_data[ppu_mem->oam_address], data, first);
+    memcpy(ppu_mem->oam_data, data + first, sizeof(ppu_mem->oam_data) - first);
+    ppu_mem->sprite_index_dirty = true;
 }
 
 void write_ppu_register(ppu_memory* ppu_mem, byte register_num, byte value) {
     switch (register_num) {
         case 0:
+            if ((ppu_mem->control ^ value) & 0b00111000) {
+                // Pattern tables or sprite size
+                mapper_watch_changed(ppu_mem);
+            }
+            if ((ppu_mem->control ^ value) & 0b00100000) {
+                // Sprite size changed, so every sprite covers a different set of lines now
+                ppu_mem->sprite_index_dirty = true;
+                ppu_mem->r->ppu_tall_sprites = (value & 0b00100000) != 0;
+            }
             ppu_mem->control = value;
             ppu_mem->t &= 0b0111001111111111; // Mask out two bits to copy data into
             ppu_mem->t |= (uint16_t)(value & 0b00000011) << 10;
             dprintf("NMI on VBlank is now: %d\n", vblank_nmi(ppu_mem));
             return;
         case 1:
+            if ((ppu_mem->mask ^ value) & 0b00011000) {
+                mapper_watch_changed(ppu_mem);
+            }
             ppu_mem->mask = value;
+            a12_follow_v(ppu_mem);
             return;
         case 3:
             ppu_mem->oam_address = value;
@@ -743,6 +987,7 @@ void write_ppu_register(ppu_memory* ppu_mem, byte register_num, byte value) {
                 ppu_mem->t |= value;
                 ppu_mem->v = ppu_mem->t;
                 ppu_mem->w = HIGH;
+                a12_follow_v(ppu_mem);
             }
             if (ppu_mem->t > 0x3FFF) {
                 errx(EXIT_FAILURE, "Somehow managed to write an address higher than 0x3FFF (0x%04x) to PPUADDR? WTF?", ppu_mem->t);
@@ -750,12 +995,14 @@ void write_ppu_register(ppu_memory* ppu_mem, byte register_num, byte value) {
             return;
         }
         case 7:
+            ppu_watch_access(ppu_mem->v, value, true);
             vram_write(ppu_mem, ppu_mem->v, value);
             ppu_mem->v += get_addr_increment(ppu_mem);
+            a12_follow_v(ppu_mem);
             return;
         default:
             printf("WARNING: writing 0x%02X to read-only PPU register %x\n", value, register_num);
-            ppu_open_bus = value;
+            ppu_mem->open_bus = value;
 
     }
 }
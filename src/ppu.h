@@ -3,6 +3,16 @@
 #include <stdbool.h>
 #include "util.h"
 #include "mapper/rom.h"
+#include "scheduler.h"
+
+// 0 - 261
+// 0: Pre-render
+// 1-240: Visible
+// 241: Post-render
+// 242-261: VBLANK
+#define NUM_LINES 262
+// 0 - 340
+#define CYCLES_PER_LINE 341
 
 typedef enum high_or_low_t {
     HIGH,
@@ -37,18 +47,25 @@ typedef struct sprite_t {
     sprite_pattern pattern;
 } sprite;
 
+typedef struct sprite_pixel_t {
+    byte color; // Palette RAM index (0x10 - 0x1F), or 0 if no opaque sprite pixel lands here
+    bool priority;
+    bool sprite_zero;
+} sprite_pixel;
+
 typedef struct ppu_memory_t {
     rom* r;
     unsigned long long frame;
     uint16_t scan_line;
     uint16_t cycle;
+    timestamp dot; // Number of steps since power on, on the same clock as the scheduler
     byte control;
     byte mask;
     byte status;
     byte oam_address;
     byte oam_data[0x100];
     byte data;
-    byte name_tables[0x800];
+    byte name_tables[0x1000]; // Only the first 2KB is used unless the cart has four screen VRAM
     byte palette_ram[0x20];
 
     uint16_t v; // Current VRAM address
@@ -61,22 +78,63 @@ typedef struct ppu_memory_t {
     uint32_t temp_attribute_table;
     tiledata tile;
 
-    color screen[240][256];
+    byte screen[240][256]; // NES palette indices (0-63), see frame.h for turning these into pixels
 
     sprite sprites[8];
     byte num_sprites;
 
+    // Which OAM entries fall on each visible line, in OAM order. Only the first 8 are kept, the count saturates at 9
+    // so sprite overflow can still be detected. Rebuilt lazily when OAM or the sprite size changes.
+    byte sprite_line_index[240][8];
+    byte sprite_line_count[240];
+    bool sprite_index_dirty;
+
+    // Sprites for the line being drawn, rasterized once at evaluation time
+    sprite_pixel sprite_line[256];
+
     // For reading from 0x2007
     byte fake_buffer;
+    byte open_bus;
+
+    byte cdl_access; // CDL_CHR_* flag for what pattern fetches are for right now, if there's a code/data log
+
+    // Run-ahead runs frames nobody's going to see, and ones that are going to be thrown away, where SRAM mustn't be
+    // saved from
+    bool present;
+    bool speculative;
 
     volatile long* apu_ring_buffer_write_index;
     volatile long* apu_ring_buffer_read_index;
+    volatile bool* apu_real_time;
+
+    scheduler* scheduler;
+
+    // What the mapper sees of the PPU: A12 of the address bus, and lines starting. Only tracked if the mapper watches
+    // them, and worked out lazily from the registers when something needs it rather than on every dot. See
+    // walk_mapper_watch.
+    bool watch_a12;
+    bool watch_scanlines;
+    timestamp watch_time; // Every dot before this one has been accounted for
+    unsigned long long watch_frame;
+    uint16_t watch_line;
+    uint16_t watch_cycle;
+    bool a12_level;
+    timestamp a12_low_since;
 } ppu_memory;
 
 ppu_memory get_ppu_mem(rom* r);
 void ppu_step(ppu_memory* ppu_mem);
+// Steps dots times, in here so ppu_step can be inlined into the loop
+void ppu_run(ppu_memory* ppu_mem, int dots);
+void mapper_watch_changed(ppu_memory* ppu_mem);
+void mapper_watch_event(ppu_memory* ppu_mem, timestamp time);
+bool rendering_enabled(ppu_memory* ppu_mem);
 byte read_ppu_register(ppu_memory* ppu_mem, byte register_num);
 void write_ppu_register(ppu_memory* ppu_mem, byte register_num, byte value);
 void write_oam_byte(ppu_memory* ppu_mem, byte value);
+// Reads VRAM without it being logged or the read buffer moving, for debuggers. CHR still goes through the mapper, so
+// MMC2 and MMC4 latches can flip just as they would for the PPU.
+byte ppu_peek(ppu_memory* ppu_mem, uint16_t address);
+void write_oam_page(ppu_memory* ppu_mem, const byte* data);
 int get_screen_x(ppu_memory* ppu_mem);
 int get_screen_y(ppu_memory* ppu_mem);
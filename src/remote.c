@@ -0,0 +1,410 @@
+#include <err.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "remote.h"
+#include "cpu.h"
+#include "debugger.h"
+#include "disassembler.h"
+#include "ppu.h"
+
+#define REMOTE_REPLY_LENGTH 2048
+// Plenty for a page of memory or all of OAM
+#define REMOTE_MAX_DUMP 0x100
+#define REMOTE_MAX_DISASSEMBLY 32
+
+// The break handler's only given the memory, so this is the client it reports to
+static remote_debugger* attached = NULL;
+
+static void detach(remote_debugger* remote) {
+    close(remote->client);
+    remote->client = -1;
+    remote->line_length = 0;
+    remote->stopped = false;
+    // Nobody's left to stop for, so leave it running flat out
+    clear_all_breakpoints();
+    debugger_resume();
+    set_debug_break_handler(NULL);
+    attached = NULL;
+}
+
+static void reply(remote_debugger* remote, const char* format, ...) {
+    if (remote->client < 0) {
+        return;
+    }
+    char buf[REMOTE_REPLY_LENGTH];
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(buf, sizeof(buf) - 1, format, args);
+    va_end(args);
+    if (length < 0 || length >= (int)sizeof(buf) - 1) {
+        errx(EXIT_FAILURE, "Remote debugger reply too long");
+    }
+    buf[length++] = '\n';
+
+    int sent = 0;
+    while (sent < length) {
+        ssize_t result = send(remote->client, buf + sent, length - sent, MSG_NOSIGNAL);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            detach(remote);
+            return;
+        }
+        sent += result;
+    }
+}
+
+static void reply_ok(remote_debugger* remote) {
+    reply(remote, "{\"ok\":true}");
+}
+
+static void reply_error(remote_debugger* remote, const char* error) {
+    reply(remote, "{\"error\":\"%s\"}", error);
+}
+
+// Takes the next whole line out of what's been received, reading more if there isn't one yet. Only waits for it if
+// block is set. False if there isn't a line, including when the client's gone.
+static bool next_line(remote_debugger* remote, char* out, bool block) {
+    while (remote->client >= 0) {
+        char* end = memchr(remote->line, '\n', remote->line_length);
+        if (end != NULL) {
+            size_t length = end - remote->line;
+            memcpy(out, remote->line, length);
+            out[length] = '\0';
+            if (length > 0 && out[length - 1] == '\r') {
+                out[length - 1] = '\0';
+            }
+            remote->line_length -= length + 1;
+            memmove(remote->line, end + 1, remote->line_length);
+            return true;
+        }
+        if (remote->line_length == REMOTE_LINE_LENGTH) {
+            remote->line_length = 0;
+            reply_error(remote, "line too long");
+            continue;
+        }
+
+        ssize_t result = recv(remote->client, remote->line + remote->line_length,
+                              REMOTE_LINE_LENGTH - remote->line_length, block ? 0 : MSG_DONTWAIT);
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return false;
+        }
+        if (result <= 0) {
+            detach(remote);
+            return false;
+        }
+        remote->line_length += result;
+    }
+    return false;
+}
+
+static bool parse_hex(const char* text, long max, long* value) {
+    char* end;
+    *value = strtol(text, &end, 16);
+    return end != text && *value >= 0 && *value <= max;
+}
+
+// Splits off the next space separated word, or returns NULL if there isn't one
+static char* next_word(char** text) {
+    return strtok_r(NULL, " ", text);
+}
+
+static void hex_dump(char* out, const byte* data, long length) {
+    for (long i = 0; i < length; i++) {
+        snprintf(out + i * 2, 3, "%02X", data[i]);
+    }
+    out[length * 2] = '\0';
+}
+
+static void reply_registers(remote_debugger* remote, memory* mem) {
+    reply(remote, "{\"pc\":%u,\"a\":%u,\"x\":%u,\"y\":%u,\"sp\":%u,\"p\":%u,\"cycles\":%ld,\"frame\":%llu}",
+          mem->pc, mem->a, mem->x, mem->y, mem->sp, get_p(mem), get_total_cpu_cycles(mem), mem->ppu_mem.frame);
+}
+
+static void set_register(remote_debugger* remote, memory* mem, const char* name, const char* value_text) {
+    long value;
+    if (name == NULL || value_text == NULL || !parse_hex(value_text, 0xFFFF, &value)) {
+        reply_error(remote, "expected setreg <register> <value>");
+        return;
+    }
+    if (strcasecmp(name, "pc") == 0) {
+        mem->pc = value;
+        reply_ok(remote);
+        return;
+    }
+    if (value > 0xFF) {
+        reply_error(remote, "value out of range");
+        return;
+    }
+    if (strcasecmp(name, "a") == 0) {
+        mem->a = value;
+    }
+    else if (strcasecmp(name, "x") == 0) {
+        mem->x = value;
+    }
+    else if (strcasecmp(name, "y") == 0) {
+        mem->y = value;
+    }
+    else if (strcasecmp(name, "sp") == 0) {
+        mem->sp = value;
+    }
+    else if (strcasecmp(name, "p") == 0) {
+        set_p(mem, value);
+    }
+    else {
+        reply_error(remote, "unknown register");
+        return;
+    }
+    reply_ok(remote);
+}
+
+static void read_memory(remote_debugger* remote, memory* mem, const char* address_text, const char* length_text,
+                        bool ppu) {
+    long address, length;
+    if (address_text == NULL || length_text == NULL || !parse_hex(address_text, 0xFFFF, &address)
+        || !parse_hex(length_text, REMOTE_MAX_DUMP, &length)) {
+        reply_error(remote, "expected an address and a length of up to 100");
+        return;
+    }
+    byte data[REMOTE_MAX_DUMP];
+    for (long i = 0; i < length; i++) {
+        uint16_t at = address + i;
+        data[i] = ppu ? ppu_peek(&mem->ppu_mem, at) : peek_byte(mem, at);
+    }
+    char hex[REMOTE_MAX_DUMP * 2 + 1];
+    hex_dump(hex, data, length);
+    reply(remote, "{\"address\":%ld,\"data\":\"%s\"}", address, hex);
+}
+
+static void write_memory(remote_debugger* remote, memory* mem, const char* address_text, const char* data) {
+    long address;
+    size_t length = data == NULL ? 0 : strlen(data);
+    if (address_text == NULL || !parse_hex(address_text, 0xFFFF, &address) || length == 0 || length % 2 != 0) {
+        reply_error(remote, "expected write <address> <bytes>");
+        return;
+    }
+    for (size_t i = 0; i < length; i += 2) {
+        char digits[3] = {data[i], data[i + 1], '\0'};
+        long value;
+        if (!parse_hex(digits, 0xFF, &value)) {
+            reply_error(remote, "bytes should be hex");
+            return;
+        }
+        write_byte(mem, address + i / 2, value);
+    }
+    reply_ok(remote);
+}
+
+static void reply_ppu_registers(remote_debugger* remote, memory* mem) {
+    ppu_memory* ppu_mem = &mem->ppu_mem;
+    reply(remote, "{\"control\":%u,\"mask\":%u,\"status\":%u,\"oam_address\":%u,\"v\":%u,\"t\":%u,\"x\":%u,\"w\":%d,"
+                  "\"scanline\":%u,\"cycle\":%u,\"frame\":%llu}",
+          ppu_mem->control, ppu_mem->mask, ppu_mem->status, ppu_mem->oam_address, ppu_mem->v, ppu_mem->t, ppu_mem->x,
+          ppu_mem->w, ppu_mem->scan_line, ppu_mem->cycle, ppu_mem->frame);
+}
+
+static void reply_disassembly(remote_debugger* remote, memory* mem, const char* address_text, const char* count_text) {
+    long address, count = 1;
+    if (address_text == NULL || !parse_hex(address_text, 0xFFFF, &address)
+        || (count_text != NULL && !parse_hex(count_text, REMOTE_MAX_DISASSEMBLY, &count))) {
+        reply_error(remote, "expected disasm <address> [count of up to 20]");
+        return;
+    }
+    char out[REMOTE_REPLY_LENGTH - 32];
+    size_t used = 0;
+    for (long i = 0; i < count; i++) {
+        byte bytes[3];
+        bytes[0] = peek_byte(mem, address);
+        int size = instruction_size(bytes[0]);
+        for (int j = 1; j < size; j++) {
+            bytes[j] = peek_byte(mem, address + j);
+        }
+        char hex[7];
+        hex_dump(hex, bytes, size);
+        char text[20];
+        format_instruction(text, sizeof(text), address, bytes, false);
+        used += snprintf(out + used, sizeof(out) - used, "%s{\"address\":%ld,\"bytes\":\"%s\",\"text\":\"%s\"}",
+                         i == 0 ? "" : ",", address, hex, text);
+        address = (address + size) & 0xFFFF;
+    }
+    reply(remote, "{\"instructions\":[%s]}", out);
+}
+
+static void run_command(remote_debugger* remote, memory* mem, char* line) {
+    char* rest;
+    char* command = strtok_r(line, " ", &rest);
+    if (command == NULL) {
+        return;
+    }
+
+    if (strcmp(command, "pause") == 0) {
+        debugger_pause();
+        reply_ok(remote);
+    }
+    else if (strcmp(command, "step") == 0) {
+        // Stops again before the next instruction
+        debugger_pause();
+        remote->stopped = false;
+        reply_ok(remote);
+    }
+    else if (strcmp(command, "continue") == 0) {
+        debugger_resume();
+        remote->stopped = false;
+        reply_ok(remote);
+    }
+    else if (strcmp(command, "break") == 0) {
+        if (rest != NULL && add_breakpoint_spec(rest)) {
+            reply_ok(remote);
+        }
+        else {
+            reply_error(remote, "couldn't make sense of breakpoint");
+        }
+    }
+    else if (strcmp(command, "delete") == 0) {
+        long address;
+        char* address_text = next_word(&rest);
+        if (address_text == NULL || !parse_hex(address_text, 0xFFFF, &address)) {
+            reply_error(remote, "expected delete <address>");
+            return;
+        }
+        clear_breakpoint(address);
+        reply_ok(remote);
+    }
+    else if (strcmp(command, "clear") == 0) {
+        clear_all_breakpoints();
+        reply_ok(remote);
+    }
+    else if (strcmp(command, "regs") == 0) {
+        reply_registers(remote, mem);
+    }
+    else if (strcmp(command, "setreg") == 0) {
+        char* name = next_word(&rest);
+        set_register(remote, mem, name, next_word(&rest));
+    }
+    else if (strcmp(command, "read") == 0 || strcmp(command, "ppuread") == 0) {
+        char* address = next_word(&rest);
+        read_memory(remote, mem, address, next_word(&rest), command[0] == 'p');
+    }
+    else if (strcmp(command, "write") == 0) {
+        char* address = next_word(&rest);
+        write_memory(remote, mem, address, next_word(&rest));
+    }
+    else if (strcmp(command, "ppuregs") == 0) {
+        reply_ppu_registers(remote, mem);
+    }
+    else if (strcmp(command, "oam") == 0) {
+        char hex[sizeof(mem->ppu_mem.oam_data) * 2 + 1];
+        hex_dump(hex, mem->ppu_mem.oam_data, sizeof(mem->ppu_mem.oam_data));
+        reply(remote, "{\"data\":\"%s\"}", hex);
+    }
+    else if (strcmp(command, "disasm") == 0) {
+        char* address = next_word(&rest);
+        reply_disassembly(remote, mem, address, next_word(&rest));
+    }
+    else {
+        reply_error(remote, "unknown command");
+    }
+}
+
+static const char* reason_name(debug_break_reason reason) {
+    switch (reason) {
+        case BREAK_STEP:
+            return "step";
+        case BREAK_BREAKPOINT:
+            return "breakpoint";
+        case BREAK_INTERRUPT:
+            return "interrupt";
+        case BREAK_CPU_READ:
+            return "read";
+        case BREAK_CPU_WRITE:
+            return "write";
+        case BREAK_PPU_READ:
+            return "ppuread";
+        case BREAK_PPU_WRITE:
+            return "ppuwrite";
+        default:
+            errx(EXIT_FAILURE, "Unknown break reason %d", reason);
+    }
+}
+
+// Holds the emulator here, taking commands, until the client says to go on or goes away
+static void remote_break(memory* mem, const debug_break* brk) {
+    remote_debugger* remote = attached;
+    if (remote == NULL) {
+        return;
+    }
+    remote->stopped = true;
+    reply(remote, "{\"event\":\"stopped\",\"reason\":\"%s\",\"pc\":%u,\"address\":%u,\"value\":%u}",
+          reason_name(brk->reason), mem->pc, brk->address, brk->value);
+
+    char line[REMOTE_LINE_LENGTH + 1];
+    while (remote->stopped && next_line(remote, line, true)) {
+        run_command(remote, mem, line);
+    }
+}
+
+void remote_open(remote_debugger* remote, const char* path) {
+    remote->client = -1;
+    remote->line_length = 0;
+    remote->stopped = false;
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address.sun_path) || strlen(path) >= sizeof(remote->path)) {
+        errx(EXIT_FAILURE, "Remote debugger socket path %s is too long", path);
+    }
+    strcpy(address.sun_path, path);
+    strcpy(remote->path, path);
+    unlink(path);
+
+    remote->listen_socket = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (remote->listen_socket < 0) {
+        errx(EXIT_FAILURE, "Unable to open a remote debugger socket: %s", strerror(errno));
+    }
+    if (bind(remote->listen_socket, (struct sockaddr*)&address, sizeof(address)) < 0
+        || listen(remote->listen_socket, 1) < 0) {
+        errx(EXIT_FAILURE, "Unable to listen for a remote debugger at %s: %s", path, strerror(errno));
+    }
+    if (fcntl(remote->listen_socket, F_SETFL, fcntl(remote->listen_socket, F_GETFL) | O_NONBLOCK) < 0) {
+        errx(EXIT_FAILURE, "Unable to set up the remote debugger socket: %s", strerror(errno));
+    }
+}
+
+void remote_close(remote_debugger* remote) {
+    if (remote->client >= 0) {
+        detach(remote);
+    }
+    close(remote->listen_socket);
+    remote->listen_socket = -1;
+    unlink(remote->path);
+}
+
+void remote_poll(remote_debugger* remote, memory* mem) {
+    if (remote->client < 0) {
+        remote->client = accept(remote->listen_socket, NULL, NULL);
+        if (remote->client < 0) {
+            return;
+        }
+        attached = remote;
+        set_debug_break_handler(remote_break);
+    }
+
+    char line[REMOTE_LINE_LENGTH + 1];
+    while (next_line(remote, line, false)) {
+        run_command(remote, mem, line);
+    }
+}
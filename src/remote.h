@@ -0,0 +1,50 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "mem.h"
+
+#define REMOTE_LINE_LENGTH 256
+// Long enough for any Unix domain socket path
+#define REMOTE_PATH_LENGTH 108
+
+/*
+ * Lets a debugger on the same machine drive the emulator over a Unix domain socket, instead of the interactive one
+ * reading from the emulator's own terminal. Nothing's stopped or slowed down until a client connects.
+ *
+ * Clients send one command per line and get one line of JSON back for each, plus an unprompted
+ * {"event":"stopped",...} line whenever the emulator stops. While it's stopped, the emulator waits on the client, so
+ * commands are answered straight away. While it's running they're picked up once a frame. Commands are:
+ *
+ *   pause                      stop before the next instruction
+ *   step                       run one instruction, then stop
+ *   continue                   carry on running
+ *   break <spec>               anything a .breakpoints line can be, e.g. "break C5F5 a==00" or "break write 2007"
+ *   delete <address>           clear breakpoints at an address
+ *   clear                      clear every breakpoint and watchpoint
+ *   regs                       the CPU registers, cycle count and frame
+ *   setreg <register> <value>  a, x, y, sp, p or pc
+ *   read <address> <length>    CPU memory, hex. Registers read as open bus.
+ *   write <address> <bytes>    CPU memory, hex, e.g. "write 0300 A9FF"
+ *   ppuread <address> <length> PPU memory, hex
+ *   ppuregs                    the PPU's registers and where it's got to
+ *   oam                        all of OAM, hex
+ *   disasm <address> [count]   instructions, one per array entry
+ *
+ * Addresses, values and lengths are hex. Anything that goes wrong comes back as {"error":"..."}.
+ */
+typedef struct remote_debugger_t {
+    char path[REMOTE_PATH_LENGTH];
+    int listen_socket;
+    int client; // -1 until something connects
+    char line[REMOTE_LINE_LENGTH];
+    size_t line_length;
+    bool stopped;
+} remote_debugger;
+
+// Starts listening at path, replacing anything already there
+void remote_open(remote_debugger* remote, const char* path);
+// Stops listening and removes the socket
+void remote_close(remote_debugger* remote);
+// Picks up a new client and answers anything it's sent. Never blocks, so it can be called every frame.
+void remote_poll(remote_debugger* remote, memory* mem);
@@ -1,10 +1,12 @@
 #include <err.h>
 #include <stdlib.h>
+#include <string.h>
 #include <SDL2/SDL.h>
 #include <stdbool.h>
 
 #include "render.h"
 #include "debugger.h"
+#include "frame.h"
 
 #define SCREEN_WIDTH 256
 #define SCREEN_HEIGHT 240
@@ -15,7 +17,7 @@ SDL_Window* window = NULL;
 SDL_Renderer* renderer = NULL;
 SDL_Texture* buffer = NULL;
 
-button player1_buttons[8];
+bool keyboard_buttons[2][NUM_BUTTONS];
 
 void initialize() {
     initialized = true;
@@ -25,7 +27,7 @@ void initialize() {
     window = SDL_CreateWindow("dgb nes", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, SCREEN_WIDTH * SCREEN_SCALE, SCREEN_HEIGHT * SCREEN_SCALE, SDL_WINDOW_SHOWN);
 
     renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
-    buffer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB32, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
+    buffer = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
 
     if (renderer == NULL) {
         errx(EXIT_FAILURE, "SDL couldn't create a renderer! %s", SDL_GetError());
@@ -33,9 +35,7 @@ void initialize() {
 
     SDL_RenderSetScale(renderer, SCREEN_SCALE, SCREEN_SCALE);
 
-    for (int i = 0; i < 8; i++) {
-        player1_buttons[i] = false;
-    }
+    memset(keyboard_buttons, 0, sizeof(keyboard_buttons));
 
 }
 
@@ -46,42 +46,69 @@ void update_key(SDL_Keycode sdlk, bool state) {
 
         case SDLK_UP:
         case SDLK_w:
-            player1_buttons[UP] = state;
+            keyboard_buttons[one][UP] = state;
             break;
         case SDLK_s:
         case SDLK_DOWN:
-            player1_buttons[DOWN] = state;
+            keyboard_buttons[one][DOWN] = state;
             break;
         case SDLK_a:
         case SDLK_LEFT:
-            player1_buttons[LEFT] = state;
+            keyboard_buttons[one][LEFT] = state;
             break;
         case SDLK_d:
         case SDLK_RIGHT:
-            player1_buttons[RIGHT] = state;
+            keyboard_buttons[one][RIGHT] = state;
             break;
         case SDLK_z:
         case SDLK_q:
         case SDLK_j:
-            player1_buttons[A] = state;
+            keyboard_buttons[one][A] = state;
             break;
         case SDLK_x:
         case SDLK_e:
         case SDLK_k:
-            player1_buttons[B] = state;
+            keyboard_buttons[one][B] = state;
             break;
         case SDLK_RETURN:
-            player1_buttons[START] = state;
+            keyboard_buttons[one][START] = state;
             break;
         case SDLK_RSHIFT:
-            player1_buttons[SELECT] = state;
+            keyboard_buttons[one][SELECT] = state;
             return;
+
+        // Player two's on the numpad
+        case SDLK_KP_8:
+            keyboard_buttons[two][UP] = state;
+            break;
+        case SDLK_KP_5:
+        case SDLK_KP_2:
+            keyboard_buttons[two][DOWN] = state;
+            break;
+        case SDLK_KP_4:
+            keyboard_buttons[two][LEFT] = state;
+            break;
+        case SDLK_KP_6:
+            keyboard_buttons[two][RIGHT] = state;
+            break;
+        case SDLK_KP_0:
+            keyboard_buttons[two][A] = state;
+            break;
+        case SDLK_KP_PERIOD:
+            keyboard_buttons[two][B] = state;
+            break;
+        case SDLK_KP_ENTER:
+            keyboard_buttons[two][START] = state;
+            break;
+        case SDLK_KP_PLUS:
+            keyboard_buttons[two][SELECT] = state;
+            break;
         default:
             break;
     }
 }
 
-void render_screen(color (*screen)[SCREEN_HEIGHT][SCREEN_WIDTH]) {
+void render_screen(byte (*screen)[SCREEN_HEIGHT][SCREEN_WIDTH]) {
     if (!initialized) {
         initialize();
     }
@@ -102,17 +129,39 @@ void render_screen(color (*screen)[SCREEN_HEIGHT][SCREEN_WIDTH]) {
         }
     }
 
-    SDL_UpdateTexture(buffer, NULL, screen, SCREEN_WIDTH * 4);
+    // Convert straight into the texture's memory, SDL handles the scaling on the GPU
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(buffer, NULL, &pixels, &pitch) < 0) {
+        errx(EXIT_FAILURE, "SDL couldn't lock the frame texture! %s", SDL_GetError());
+    }
+    frame_convert_scaled(screen, pixels, pitch / sizeof(uint32_t), 1, PIXEL_RGBA);
+    SDL_UnlockTexture(buffer);
+
     SDL_RenderCopy(renderer, buffer, NULL, NULL);
     dprintf("Updating renderer\n");
     SDL_RenderPresent(renderer);
 }
 
-bool get_button(button btn, player p) {
-    if (p == one) {
-        return player1_buttons[btn];
+void poll_input(input_snapshot* input) {
+    memset(input, 0, sizeof(*input));
+    memcpy(input->buttons, keyboard_buttons, sizeof(keyboard_buttons));
+    input->pointer_x = -1;
+    input->pointer_y = -1;
+    if (!initialized) {
+        return;
     }
-    else {
-        return false;
+
+    // The mouse is the Zapper, and its left and right is the Arkanoid knob
+    int x, y;
+    Uint32 mouse = SDL_GetMouseState(&x, &y);
+    bool clicked = (mouse & SDL_BUTTON(SDL_BUTTON_LEFT)) != 0;
+    if (SDL_GetMouseFocus() == window) {
+        input->pointer_x = x / SCREEN_SCALE;
+        input->pointer_y = y / SCREEN_SCALE;
+        input->trigger = clicked;
+        int paddle = input->pointer_x * 0xFF / (SCREEN_WIDTH - 1);
+        input->paddle = paddle < 0 ? 0 : paddle > 0xFF ? 0xFF : paddle;
+        input->paddle_button = clicked;
     }
 }
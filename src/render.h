@@ -2,5 +2,6 @@
 #include "ppu.h"
 #include "controller.h"
 
-void render_screen(color (*screen)[240][256]);
-bool get_button(button btn, player p);
+void render_screen(byte (*screen)[240][256]);
+// Called once a frame, right after the frame's been drawn, to fill in what the player's doing for the next one
+void poll_input(input_snapshot* input);
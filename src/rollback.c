@@ -0,0 +1,198 @@
+#include <string.h>
+
+#include "rollback.h"
+#include "system.h"
+#include "debugger.h"
+
+// 4 bytes each of first frame, ack, checksum frame and checksum, then the count and that many frames of input
+#define PACKET_HEADER_BYTES 17
+
+static void put_u32(byte* data, uint32_t value) {
+    data[0] = value & 0xFF;
+    data[1] = (value >> 8) & 0xFF;
+    data[2] = (value >> 16) & 0xFF;
+    data[3] = (value >> 24) & 0xFF;
+}
+
+static uint32_t get_u32(const byte* data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+void rollback_init(rollback_session* s, memory* mem, netplay_link* link, player local_player) {
+    s->mem = mem;
+    s->link = link;
+    s->local_player = local_player;
+    s->frame = 0;
+    s->remote_frame = 0;
+    s->peer_ack = 0;
+    s->rollback_from = NO_FRAME;
+    memset(s->local_inputs, 0, sizeof(s->local_inputs));
+    memset(s->remote_inputs, 0, sizeof(s->remote_inputs));
+    memset(s->guessed_inputs, 0, sizeof(s->guessed_inputs));
+    for (int i = 0; i < ROLLBACK_STATES; i++) {
+        savestate_init(&s->states[i], mem->r);
+    }
+    s->checked_frame = 0;
+    s->peer_checksum_frame = NO_FRAME;
+    s->desynced = false;
+    s->desync_frame = NO_FRAME;
+    s->rollbacks = 0;
+    s->frames_rolled_back = 0;
+}
+
+void rollback_free(rollback_session* s) {
+    for (int i = 0; i < ROLLBACK_STATES; i++) {
+        savestate_free(&s->states[i]);
+    }
+}
+
+static void send_inputs(rollback_session* s, uint32_t end) {
+    uint32_t start = s->peer_ack;
+    if (end - start > INPUT_HISTORY) {
+        start = end - INPUT_HISTORY; // Can't happen unless the peer's broken, and then it's not going to work anyway
+    }
+
+    byte packet[PACKET_HEADER_BYTES + INPUT_HISTORY];
+    put_u32(&packet[0], start);
+    put_u32(&packet[4], s->remote_frame);
+    if (s->checked_frame > 0) {
+        put_u32(&packet[8], s->checked_frame - 1);
+        put_u32(&packet[12], s->checksums[(s->checked_frame - 1) % CHECKSUM_HISTORY]);
+    }
+    else {
+        put_u32(&packet[8], NO_FRAME);
+        put_u32(&packet[12], 0);
+    }
+    packet[16] = end - start;
+    for (uint32_t frame = start; frame < end; frame++) {
+        packet[PACKET_HEADER_BYTES + frame - start] = s->local_inputs[frame % INPUT_HISTORY];
+    }
+    netplay_send(s->link, packet, PACKET_HEADER_BYTES + end - start);
+}
+
+static void compare_checksums(rollback_session* s) {
+    uint32_t frame = s->peer_checksum_frame;
+    if (frame == NO_FRAME || frame >= s->checked_frame) {
+        return; // Haven't got that far, it'll be compared when we do
+    }
+    if (s->checked_frame - frame <= CHECKSUM_HISTORY && s->checksums[frame % CHECKSUM_HISTORY] != s->peer_checksum) {
+        if (!s->desynced) {
+            dprintf("Netplay desynced at frame %u\n", frame);
+            s->desynced = true;
+            s->desync_frame = frame;
+        }
+    }
+    s->peer_checksum_frame = NO_FRAME;
+}
+
+static void receive_packets(rollback_session* s) {
+    byte packet[NETPLAY_MAX_PACKET];
+    size_t length;
+    while ((length = netplay_receive(s->link, packet, sizeof(packet))) > 0) {
+        if (length < PACKET_HEADER_BYTES || length < PACKET_HEADER_BYTES + packet[16]) {
+            dprintf("Ignoring a short netplay packet\n");
+            continue;
+        }
+        uint32_t start = get_u32(&packet[0]);
+        uint32_t ack = get_u32(&packet[4]);
+        if (ack > s->peer_ack) {
+            s->peer_ack = ack;
+        }
+        uint32_t checksum_frame = get_u32(&packet[8]);
+        if (checksum_frame != NO_FRAME && (s->peer_checksum_frame == NO_FRAME || checksum_frame > s->peer_checksum_frame)) {
+            s->peer_checksum_frame = checksum_frame;
+            s->peer_checksum = get_u32(&packet[12]);
+        }
+
+        // Packets can turn up out of order or twice, only the next frames we haven't got are any use
+        for (uint32_t frame = start; frame < start + packet[16] && frame <= s->remote_frame; frame++) {
+            if (frame < s->remote_frame) {
+                continue;
+            }
+            byte buttons = packet[PACKET_HEADER_BYTES + frame - start];
+            s->remote_inputs[frame % INPUT_HISTORY] = buttons;
+            if (frame < s->frame && s->guessed_inputs[frame % INPUT_HISTORY] != buttons && frame < s->rollback_from) {
+                s->rollback_from = frame;
+            }
+            s->remote_frame++;
+        }
+    }
+}
+
+// Until they say otherwise, the peer's assumed to be holding down whatever they were last
+static byte remote_buttons(rollback_session* s, uint32_t frame) {
+    if (frame < s->remote_frame) {
+        return s->remote_inputs[frame % INPUT_HISTORY];
+    }
+    return s->remote_frame > 0 ? s->remote_inputs[(s->remote_frame - 1) % INPUT_HISTORY] : 0;
+}
+
+static void run_frame(rollback_session* s) {
+    uint32_t frame = s->frame;
+    save_state(s->mem, &s->states[frame % ROLLBACK_STATES]);
+
+    byte remote = remote_buttons(s, frame);
+    s->guessed_inputs[frame % INPUT_HISTORY] = remote;
+
+    input_snapshot input;
+    memset(&input, 0, sizeof(input));
+    input.pointer_x = -1;
+    input.pointer_y = -1;
+    input_set_buttons(&input, s->local_player, s->local_inputs[frame % INPUT_HISTORY]);
+    input_set_buttons(&input, s->local_player == one ? two : one, remote);
+    advance_frame(s->mem, &input);
+    s->frame++;
+}
+
+static void roll_back(rollback_session* s) {
+    uint32_t target = s->frame;
+    dprintf("Netplay rolling back from frame %u to %u\n", target, s->rollback_from);
+    s->rollbacks++;
+    s->frames_rolled_back += target - s->rollback_from;
+
+    load_state(s->mem, &s->states[s->rollback_from % ROLLBACK_STATES]);
+    s->frame = s->rollback_from;
+    s->rollback_from = NO_FRAME;
+
+    // These frames have been seen and heard once already
+    bool present = s->mem->ppu_mem.present;
+    bool muted = s->mem->apu_mem.muted;
+    s->mem->ppu_mem.present = false;
+    s->mem->apu_mem.muted = true;
+    while (s->frame < target) {
+        run_frame(s);
+    }
+    s->mem->ppu_mem.present = present;
+    s->mem->apu_mem.muted = muted;
+}
+
+// Checksums the states nothing's going to change any more, the ones all the input before them is known for
+static void check_states(rollback_session* s) {
+    while (s->checked_frame < s->frame && s->checked_frame <= s->remote_frame) {
+        s->checksums[s->checked_frame % CHECKSUM_HISTORY] = savestate_checksum(&s->states[s->checked_frame % ROLLBACK_STATES]);
+        s->checked_frame++;
+    }
+    compare_checksums(s);
+}
+
+void rollback_poll(rollback_session* s) {
+    receive_packets(s);
+    if (s->rollback_from != NO_FRAME) {
+        roll_back(s);
+    }
+    check_states(s);
+}
+
+bool rollback_advance(rollback_session* s, byte buttons) {
+    rollback_poll(s);
+    if (s->frame >= s->remote_frame + ROLLBACK_FRAMES) {
+        // Too far ahead to be able to go back, wait for the peer. Say it again in case they missed it.
+        send_inputs(s, s->frame);
+        return false;
+    }
+
+    s->local_inputs[s->frame % INPUT_HISTORY] = buttons;
+    send_inputs(s, s->frame + 1);
+    run_frame(s);
+    return true;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "mem.h"
+#include "savestate.h"
+#include "netplay.h"
+
+// How far ahead of the peer's input a session will guess before it waits for them to catch up
+#define ROLLBACK_FRAMES 8
+#define ROLLBACK_STATES (ROLLBACK_FRAMES + 1)
+// Each peer can be ROLLBACK_FRAMES ahead of what it's heard from the other, so input has to be kept for twice that
+#define INPUT_HISTORY 32
+#define CHECKSUM_HISTORY 16
+#define NO_FRAME UINT32_MAX
+
+/*
+ * Two player netplay where neither player waits on the network. Each frame runs straight away with the local
+ * player's input and a guess at the peer's, which is whatever they were last known to be pressing. When the peer's
+ * real input arrives and it's different, the session loads the state from the first frame that was guessed wrong and
+ * runs everything since again, unseen and unheard.
+ *
+ * Every packet carries all the local input the peer hasn't said it has, so losing some doesn't matter. Peers swap
+ * checksums of the states both have the final input for, to catch them drifting apart.
+ */
+typedef struct rollback_session_t {
+    memory* mem;
+    netplay_link* link;
+    player local_player; // one or two, the peer's the other one
+
+    uint32_t frame; // The next frame to run
+    uint32_t remote_frame; // How many frames of the peer's input have arrived
+    uint32_t peer_ack; // How many frames of local input the peer's said it has
+    uint32_t rollback_from; // First frame that was run with the wrong guess at the peer's input, or NO_FRAME
+
+    byte local_inputs[INPUT_HISTORY]; // Buttons down, bit n for button n, indexed by frame
+    byte remote_inputs[INPUT_HISTORY];
+    byte guessed_inputs[INPUT_HISTORY]; // What the peer was taken to be pressing when each frame was run
+
+    savestate states[ROLLBACK_STATES]; // The state at the start of each frame that might need running again
+
+    uint32_t checked_frame; // States before this one have been checksummed
+    uint32_t checksums[CHECKSUM_HISTORY];
+    uint32_t peer_checksum_frame; // Latest checksum from the peer that hasn't been compared yet, or NO_FRAME
+    uint32_t peer_checksum;
+    bool desynced;
+    uint32_t desync_frame;
+
+    long rollbacks;
+    long frames_rolled_back;
+} rollback_session;
+
+void rollback_init(rollback_session* s, memory* mem, netplay_link* link, player local_player);
+void rollback_free(rollback_session* s);
+// Runs the next frame with the local player's buttons, after going back to fix up any frames the peer's input has
+// turned out different for. Returns false without running it when too far ahead of the peer, call again next frame.
+bool rollback_advance(rollback_session* s, byte buttons);
+// Takes in what's arrived from the peer and fixes up any frames that need it, without running a new one
+void rollback_poll(rollback_session* s);
@@ -0,0 +1,41 @@
+#include <err.h>
+#include <stdlib.h>
+
+#include "runahead.h"
+#include "system.h"
+#include "render.h"
+
+void run_ahead_init(run_ahead* ra, memory* mem, int frames) {
+    if (frames < 1 || frames > MAX_RUN_AHEAD_FRAMES) {
+        errx(EXIT_FAILURE, "Can only run ahead 1 to %d frames, not %d", MAX_RUN_AHEAD_FRAMES, frames);
+    }
+    ra->frames = frames;
+    savestate_init(&ra->state, mem->r);
+}
+
+void run_ahead_free(run_ahead* ra) {
+    savestate_free(&ra->state);
+}
+
+void run_ahead_frame(run_ahead* ra, memory* mem) {
+    // One poll for the real frame and all the ones ahead of it
+    mem->hold_input = true;
+    poll_input(&mem->input);
+
+    mem->ppu_mem.present = false;
+    system_run_frame(mem);
+    save_state(mem, &ra->state);
+
+    mem->ppu_mem.speculative = true;
+    mem->apu_mem.muted = true;
+    for (int i = 1; i <= ra->frames; i++) {
+        mem->ppu_mem.present = i == ra->frames;
+        system_run_frame(mem);
+    }
+    load_state(mem, &ra->state);
+
+    mem->ppu_mem.present = true;
+    mem->ppu_mem.speculative = false;
+    mem->apu_mem.muted = false;
+    mem->hold_input = false;
+}
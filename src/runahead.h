@@ -0,0 +1,20 @@
+#pragma once
+#include "mem.h"
+#include "savestate.h"
+
+#define MAX_RUN_AHEAD_FRAMES 4
+
+/*
+ * Hides the game's own input lag. Each frame is run for real, and heard but not seen, then the state's saved and the
+ * next few frames are run with the same input. The last of those is the one that's shown, then it's all thrown away
+ * and the state goes back to where the real frame left it.
+ */
+typedef struct run_ahead_t {
+    int frames;
+    savestate state;
+} run_ahead;
+
+void run_ahead_init(run_ahead* ra, memory* mem, int frames);
+void run_ahead_free(run_ahead* ra);
+// Polls for input and runs one real frame, plus the ones ahead of it
+void run_ahead_frame(run_ahead* ra, memory* mem);
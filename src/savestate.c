@@ -0,0 +1,209 @@
+#include <err.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "savestate.h"
+#include "mapper/sram.h"
+
+// The audio ring buffer goes to the speakers whatever happens to the console, so it and the sink it's going to are
+// left out of everything
+#define AUDIO_START (offsetof(memory, apu_mem) + offsetof(apu_memory, buffer))
+#define AUDIO_END (offsetof(memory, apu_mem) + offsetof(apu_memory, sink) + sizeof(struct audio_sink_t*))
+
+static void copy_console(memory* to, const memory* from) {
+    memcpy(to, from, AUDIO_START);
+    memcpy((byte*)to + AUDIO_END, (const byte*)from + AUDIO_END, sizeof(memory) - AUDIO_END);
+}
+
+void savestate_init(savestate* state, rom* r) {
+    state->prg_ram_size = get_prg_ram_bytes(r);
+    state->prg_ram = NULL;
+    if (state->prg_ram_size > 0) {
+        state->prg_ram = malloc(state->prg_ram_size);
+    }
+
+    state->chr_ram_size = r->chr_ram ? get_chr_bytes(r) : 0;
+    state->chr_ram = NULL;
+    if (state->chr_ram_size > 0) {
+        state->chr_ram = malloc(state->chr_ram_size);
+    }
+
+    if ((state->prg_ram_size > 0 && state->prg_ram == NULL) || (state->chr_ram_size > 0 && state->chr_ram == NULL)) {
+        errx(EXIT_FAILURE, "Unable to allocate a savestate");
+    }
+}
+
+void savestate_free(savestate* state) {
+    free(state->prg_ram);
+    free(state->chr_ram);
+    state->prg_ram = NULL;
+    state->chr_ram = NULL;
+}
+
+void save_state(memory* mem, savestate* state) {
+    rom* r = mem->r;
+    copy_console(&state->mem, mem);
+    state->mapperdata = r->mapperdata;
+    state->nametable_mirroring_mode = r->nametable_mirroring_mode;
+    memcpy(state->nametable_pages, r->nametable_pages, sizeof(state->nametable_pages));
+    state->ppu_fetching_sprites = r->ppu_fetching_sprites;
+    state->ppu_tall_sprites = r->ppu_tall_sprites;
+    if (state->prg_ram_size > 0) {
+        memcpy(state->prg_ram, r->prg_ram, state->prg_ram_size);
+    }
+    if (state->chr_ram_size > 0) {
+        memcpy(state->chr_ram, r->chr_rom, state->chr_ram_size);
+    }
+}
+
+void load_state(memory* mem, const savestate* state) {
+    // How the frames are being shown and heard, and how closely they're timed, is up to the frontend, not the console
+    cpu_timing timing = mem->timing;
+    const cpu_bus* bus = mem->bus;
+    void* bus_context = mem->bus_context;
+    bool present = mem->ppu_mem.present;
+    bool speculative = mem->ppu_mem.speculative;
+    bool muted = mem->apu_mem.muted;
+    bool hold_input = mem->hold_input;
+
+    copy_console(mem, &state->mem);
+
+    mem->timing = timing;
+    mem->bus = bus;
+    mem->bus_context = bus_context;
+    mem->ppu_mem.present = present;
+    mem->ppu_mem.speculative = speculative;
+    mem->apu_mem.muted = muted;
+    mem->hold_input = hold_input;
+
+    rom* r = mem->r;
+    r->mapperdata = state->mapperdata;
+    r->nametable_mirroring_mode = state->nametable_mirroring_mode;
+    memcpy(r->nametable_pages, state->nametable_pages, sizeof(r->nametable_pages));
+    r->ppu_fetching_sprites = state->ppu_fetching_sprites;
+    r->ppu_tall_sprites = state->ppu_tall_sprites;
+    if (r->sram != NULL) {
+        // The battery backed RAM's going back in time, the .sav file has to follow it
+        for (size_t offset = 0; offset < r->prg_nvram_size; offset += SRAM_PAGE_BYTES) {
+            size_t start = r->prg_ram_size + offset;
+            size_t length = r->prg_nvram_size - offset < SRAM_PAGE_BYTES ? r->prg_nvram_size - offset : SRAM_PAGE_BYTES;
+            if (memcmp(r->prg_ram + start, state->prg_ram + start, length) != 0) {
+                sram_mark_dirty(r->sram, offset);
+            }
+        }
+    }
+    if (state->prg_ram_size > 0) {
+        memcpy(r->prg_ram, state->prg_ram, state->prg_ram_size);
+    }
+    if (state->chr_ram_size > 0) {
+        memcpy(r->chr_rom, state->chr_ram, state->chr_ram_size);
+    }
+}
+
+// FNV-1a
+#define CHECKSUM_START 2166136261u
+
+static uint32_t checksum_bytes(uint32_t hash, const void* data, size_t length) {
+    const byte* bytes = data;
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ bytes[i]) * 16777619u;
+    }
+    return hash;
+}
+
+#define CHECKSUM_FIELD(hash, field) checksum_bytes(hash, &(field), sizeof(field))
+
+// The structs hashed whole are all zeroed when they're made and only ever copied with memcpy or assignment, so even
+// their padding is the same on both sides
+static uint32_t checksum_console(const memory* mem, const mapper_data* mapperdata, const byte* prg_ram, size_t prg_ram_size,
+                                 const byte* chr_ram, size_t chr_ram_size) {
+    uint32_t hash = CHECKSUM_START;
+    hash = CHECKSUM_FIELD(hash, mem->a);
+    hash = CHECKSUM_FIELD(hash, mem->x);
+    hash = CHECKSUM_FIELD(hash, mem->y);
+    hash = CHECKSUM_FIELD(hash, mem->sp);
+    hash = CHECKSUM_FIELD(hash, mem->pc);
+    byte p = get_p(mem);
+    hash = CHECKSUM_FIELD(hash, p);
+    hash = CHECKSUM_FIELD(hash, mem->total_cycles);
+    hash = CHECKSUM_FIELD(hash, mem->stall_cycles);
+    hash = CHECKSUM_FIELD(hash, mem->bus_cycles);
+    hash = CHECKSUM_FIELD(hash, mem->bus_pending);
+    hash = CHECKSUM_FIELD(hash, mem->ram);
+
+    hash = CHECKSUM_FIELD(hash, mem->dma.oam_pending);
+    hash = CHECKSUM_FIELD(hash, mem->dma.oam_page);
+    hash = CHECKSUM_FIELD(hash, mem->dma.oam_start);
+    hash = CHECKSUM_FIELD(hash, mem->dma.oam_end);
+
+    const ppu_memory* ppu = &mem->ppu_mem;
+    hash = CHECKSUM_FIELD(hash, ppu->frame);
+    hash = CHECKSUM_FIELD(hash, ppu->scan_line);
+    hash = CHECKSUM_FIELD(hash, ppu->cycle);
+    hash = CHECKSUM_FIELD(hash, ppu->control);
+    hash = CHECKSUM_FIELD(hash, ppu->mask);
+    hash = CHECKSUM_FIELD(hash, ppu->status);
+    hash = CHECKSUM_FIELD(hash, ppu->oam_address);
+    hash = CHECKSUM_FIELD(hash, ppu->oam_data);
+    hash = CHECKSUM_FIELD(hash, ppu->name_tables);
+    hash = CHECKSUM_FIELD(hash, ppu->palette_ram);
+    hash = CHECKSUM_FIELD(hash, ppu->v);
+    hash = CHECKSUM_FIELD(hash, ppu->t);
+    hash = CHECKSUM_FIELD(hash, ppu->x);
+    hash = CHECKSUM_FIELD(hash, ppu->w);
+    hash = CHECKSUM_FIELD(hash, ppu->data);
+    hash = CHECKSUM_FIELD(hash, ppu->fake_buffer);
+    hash = CHECKSUM_FIELD(hash, ppu->open_bus);
+    // The background fetches in flight. tiledata has padding, so it goes a field at a time.
+    hash = CHECKSUM_FIELD(hash, ppu->temp_bitmap_low);
+    hash = CHECKSUM_FIELD(hash, ppu->temp_bitmap_high);
+    hash = CHECKSUM_FIELD(hash, ppu->temp_attribute_table);
+    hash = CHECKSUM_FIELD(hash, ppu->tile.nametable);
+    hash = CHECKSUM_FIELD(hash, ppu->tile.attribute_table);
+    hash = CHECKSUM_FIELD(hash, ppu->tile.tile_bitmap_low);
+    hash = CHECKSUM_FIELD(hash, ppu->tile.tile_bitmap_high);
+    // And the sprites for this line and the next, which are all bytes
+    hash = CHECKSUM_FIELD(hash, ppu->sprites);
+    hash = CHECKSUM_FIELD(hash, ppu->num_sprites);
+    hash = CHECKSUM_FIELD(hash, ppu->sprite_line);
+
+    const apu_memory* apu = &mem->apu_mem;
+    hash = CHECKSUM_FIELD(hash, apu->cycle);
+    hash = CHECKSUM_FIELD(hash, apu->pulse1);
+    hash = CHECKSUM_FIELD(hash, apu->pulse2);
+    hash = CHECKSUM_FIELD(hash, apu->triangle);
+    hash = CHECKSUM_FIELD(hash, apu->noise);
+    hash = CHECKSUM_FIELD(hash, apu->dmc);
+    hash = CHECKSUM_FIELD(hash, apu->frame_counter_mode);
+    hash = CHECKSUM_FIELD(hash, apu->frame_interrupt);
+    hash = CHECKSUM_FIELD(hash, apu->dmc_interrupt);
+
+    const scheduler* s = &mem->scheduler;
+    hash = CHECKSUM_FIELD(hash, s->now);
+    hash = CHECKSUM_FIELD(hash, s->next);
+    hash = CHECKSUM_FIELD(hash, s->count);
+    // Only the events still to come, what's past the end of the heap is left over
+    for (int i = 0; i < s->count; i++) {
+        hash = CHECKSUM_FIELD(hash, s->heap[i].time);
+        hash = CHECKSUM_FIELD(hash, s->heap[i].type);
+        hash = CHECKSUM_FIELD(hash, s->heap[i].data);
+    }
+    hash = CHECKSUM_FIELD(hash, s->irq_line);
+    hash = CHECKSUM_FIELD(hash, s->nmi_pending);
+
+    hash = CHECKSUM_FIELD(hash, *mapperdata);
+    hash = checksum_bytes(hash, prg_ram, prg_ram_size);
+    hash = checksum_bytes(hash, chr_ram, chr_ram_size);
+    return hash;
+}
+
+uint32_t state_checksum(memory* mem) {
+    rom* r = mem->r;
+    return checksum_console(mem, &r->mapperdata, r->prg_ram, get_prg_ram_bytes(r),
+                            r->chr_ram ? r->chr_rom : NULL, r->chr_ram ? get_chr_bytes(r) : 0);
+}
+
+uint32_t savestate_checksum(const savestate* state) {
+    return checksum_console(&state->mem, &state->mapperdata, state->prg_ram, state->prg_ram_size,
+                            state->chr_ram, state->chr_ram_size);
+}
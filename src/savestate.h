@@ -0,0 +1,32 @@
+#pragma once
+#include <stddef.h>
+#include "mem.h"
+
+/*
+ * A copy of everything the console's made of, to go back to later. The buffers for the cart's RAM are allocated
+ * once by savestate_init, so saving and loading never allocate and only cost a few memcpys.
+ *
+ * A savestate belongs to the memory it was made for, pointers and all. Loading it into another system won't work.
+ */
+typedef struct savestate_t {
+    memory mem; // Everything but the audio ring buffer
+    mapper_data mapperdata;
+    nametable_mirroring nametable_mirroring_mode;
+    uint16_t nametable_pages[4];
+    bool ppu_fetching_sprites;
+    bool ppu_tall_sprites;
+    byte* prg_ram;
+    size_t prg_ram_size;
+    byte* chr_ram; // NULL unless the cart has CHR RAM
+    size_t chr_ram_size;
+} savestate;
+
+void savestate_init(savestate* state, rom* r);
+void savestate_free(savestate* state);
+void save_state(memory* mem, savestate* state);
+void load_state(memory* mem, const savestate* state);
+
+// Hash of the console's state, the same for two systems that have run the same ROM with the same input, for spotting
+// netplay peers that have drifted apart. Pointers, timing bookkeeping and anything the frontend owns are left out.
+uint32_t state_checksum(memory* mem);
+uint32_t savestate_checksum(const savestate* state);
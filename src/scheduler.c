@@ -0,0 +1,91 @@
+#include "scheduler.h"
+
+void scheduler_init(scheduler* s) {
+    s->now = 0;
+    s->next = NEVER;
+    s->count = 0;
+    for (int i = 0; i < NUM_EVENT_TYPES; i++) {
+        s->position[i] = -1;
+    }
+    s->irq_line = 0;
+    s->nmi_pending = false;
+}
+
+void swap_events(scheduler* s, int a, int b) {
+    scheduled_event temp = s->heap[a];
+    s->heap[a] = s->heap[b];
+    s->heap[b] = temp;
+    s->position[s->heap[a].type] = a;
+    s->position[s->heap[b].type] = b;
+}
+
+void sift_up(scheduler* s, int index) {
+    while (index > 0) {
+        int parent = (index - 1) / 2;
+        if (s->heap[parent].time <= s->heap[index].time) {
+            break;
+        }
+        swap_events(s, parent, index);
+        index = parent;
+    }
+}
+
+void sift_down(scheduler* s, int index) {
+    while (true) {
+        int smallest = index;
+        int left = index * 2 + 1;
+        int right = left + 1;
+        if (left < s->count && s->heap[left].time < s->heap[smallest].time) {
+            smallest = left;
+        }
+        if (right < s->count && s->heap[right].time < s->heap[smallest].time) {
+            smallest = right;
+        }
+        if (smallest == index) {
+            break;
+        }
+        swap_events(s, smallest, index);
+        index = smallest;
+    }
+}
+
+void remove_at(scheduler* s, int index) {
+    s->position[s->heap[index].type] = -1;
+    s->count--;
+    if (index != s->count) {
+        s->heap[index] = s->heap[s->count];
+        s->position[s->heap[index].type] = index;
+        sift_down(s, index);
+        sift_up(s, index);
+    }
+    s->next = s->count > 0 ? s->heap[0].time : NEVER;
+}
+
+void schedule_event(scheduler* s, event_type type, timestamp time, int data) {
+    int index = s->position[type];
+    if (index < 0) {
+        index = s->count++;
+        s->heap[index].type = type;
+        s->position[type] = index;
+    }
+    s->heap[index].time = time;
+    s->heap[index].data = data;
+    sift_down(s, index);
+    sift_up(s, s->position[type]);
+    s->next = s->heap[0].time;
+}
+
+void cancel_event(scheduler* s, event_type type) {
+    if (s->position[type] >= 0) {
+        remove_at(s, s->position[type]);
+    }
+}
+
+bool pop_due_event(scheduler* s, scheduled_event* event) {
+    if (s->next > s->now) {
+        return false;
+    }
+    *event = s->heap[0];
+    remove_at(s, 0);
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+#include "util.h"
+
+// Everything that has to happen at a particular time, rather than on every cycle
+typedef enum event_type_t {
+    EVENT_NMI,
+    EVENT_MAPPER_PPU, // Next time A12 rises or a line starts, for mappers that watch the PPU
+    EVENT_MAPPER_TIMER, // Next time a mapper's CPU cycle counter needs looking at
+    EVENT_APU_FRAME_COUNTER,
+    EVENT_DMC_FETCH,
+    NUM_EVENT_TYPES
+} event_type;
+
+// Sources that can hold the CPU's IRQ line low
+#define IRQ_MAPPER    0b001
+#define IRQ_APU_FRAME 0b010
+#define IRQ_DMC       0b100
+
+// In PPU dots since power on, so there are 3 for every CPU cycle
+typedef uint64_t timestamp;
+#define DOTS_PER_CPU_CYCLE 3
+#define NEVER UINT64_MAX
+
+typedef struct scheduled_event_t {
+    timestamp time;
+    event_type type;
+    int data;
+} scheduled_event;
+
+/*
+ * Min-heap of pending events, one instance per emulated system.
+ * Each type is pending at most once, so the heap is fixed size and never allocates.
+ */
+typedef struct scheduler_t {
+    timestamp now; // End of the last CPU cycle that's been run
+    timestamp next; // Time of the earliest event, so checking if anything's due is one compare
+    scheduled_event heap[NUM_EVENT_TYPES];
+    int count;
+    int position[NUM_EVENT_TYPES]; // Index in heap of each type, or -1 if it isn't scheduled
+
+    byte irq_line; // IRQ_* sources currently asserting IRQ
+    bool nmi_pending;
+} scheduler;
+
+void scheduler_init(scheduler* s);
+// Schedules an event, replacing the pending one of the same type if there is one
+void schedule_event(scheduler* s, event_type type, timestamp time, int data);
+void cancel_event(scheduler* s, event_type type);
+// Removes the earliest event if it's due by now
+bool pop_due_event(scheduler* s, scheduled_event* event);
+
+// Inline so the mappers can acknowledge their IRQ without linking against the core
+static inline void assert_irq(scheduler* s, byte source) {
+    s->irq_line |= source;
+}
+
+static inline void release_irq(scheduler* s, byte source) {
+    s->irq_line &= ~source;
+}
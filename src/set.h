@@ -2,17 +2,23 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
-typedef struct address_tree_node_t {
-    uint16_t address;
-    struct address_tree_node_t* lt;
-    struct address_tree_node_t* gt;
-} address_tree_node;
 
-typedef struct address_tree_t {
-    address_tree_node* root;
-} address_tree;
+#define ADDRESS_SET_WORDS (0x10000 / 64)
 
-address_tree* new_address_tree();
-void delete_address_tree(address_tree* root);
-void insert_to_address_tree(address_tree* root, uint16_t address);
-bool address_tree_contains(address_tree* root, uint16_t address);
+// A bit for every 16 bit address, so looking one up is a shift and a mask however many are in there
+typedef struct address_set_t {
+    uint64_t bits[ADDRESS_SET_WORDS];
+    int count;
+} address_set;
+
+void address_set_clear(address_set* set);
+void address_set_add(address_set* set, uint16_t address);
+void address_set_remove(address_set* set, uint16_t address);
+
+static inline bool address_set_contains(const address_set* set, uint16_t address) {
+    return (set->bits[address >> 6] >> (address & 63)) & 1;
+}
+
+static inline bool address_set_empty(const address_set* set) {
+    return set->count == 0;
+}
@@ -2,34 +2,165 @@
 #include "cpu.h"
 #include "ppu.h"
 #include "apu.h"
+#include "render.h"
+#include "cdl.h"
 
-int system_step(memory* mem) {
-    int cpu_steps = cpu_step(mem);
+// The CPU cycle about to be run
+static inline uint64_t cpu_cycle_now(memory* mem) {
+    return mem->scheduler.now / DOTS_PER_CPU_CYCLE;
+}
+
+// The DMC fetch lives here rather than in the APU, since the APU cannot know about the CPU's memory space.
+// Returns the number of cycles the CPU is stalled for.
+int dmc_fetch(memory* mem) {
+    dmc_oscillator* dmc = &mem->apu_mem.dmc;
+    if (!dmc->enable || dmc->sample_length == 0 || dmc->sample_bit != 0) {
+        return 0;
+    }
+
+    int cycles = dmc_dma(&mem->dma, cpu_cycle_now(mem));
+    // This can land in the middle of an instruction fetch, so put back whatever the CPU was up to
+    byte cdl_access = mem->cdl_access;
+    mem->cdl_access = CDL_DATA | CDL_PCM;
+    dmc->output_buffer = read_byte(mem, dmc->sample_address);
+    mem->cdl_access = cdl_access;
+
+    dmc->sample_bit = 8;
+    if (++dmc->sample_address == 0) {
+        dmc->sample_address = 0x8000;
+    }
+    if (--dmc->sample_length == 0) {
+        if (dmc->loop) {
+            dmc->sample_length = dmc->sample_length_register;
+            dmc->sample_address = dmc->sample_address_register;
+        }
+        else if (dmc->irq_enabled) {
+            mem->apu_mem.dmc_interrupt = true;
+            assert_irq(&mem->scheduler, IRQ_DMC);
+        }
+    }
+    return cycles;
+}
+
+// Copies the page over in one go. The timing's worked out separately, and since a DMA can't be interrupted nothing
+// else on the bus can tell.
+void oam_dma(memory* mem) {
+    uint16_t address = (uint16_t)mem->dma.oam_page << 8;
+    if (address < 0x2000) {
+        // Internal RAM, the page can't straddle a mirror
+        write_oam_page(&mem->ppu_mem, &mem->ram[address % 0x800]);
+    }
+    else {
+        byte page[OAM_DMA_BYTES];
+        for (int i = 0; i < OAM_DMA_BYTES; i++) {
+            page[i] = read_byte(mem, address + i);
+        }
+        write_oam_page(&mem->ppu_mem, page);
+    }
+}
+
+// Runs everything that's come due. Returns the number of cycles the CPU is stalled for.
+int run_events(memory* mem) {
+    scheduler* s = &mem->scheduler;
+    scheduled_event event;
+    int stall = 0;
+    while (pop_due_event(s, &event)) {
+        switch (event.type) {
+            case EVENT_NMI:
+                s->nmi_pending = true;
+                break;
+            case EVENT_MAPPER_PPU:
+                mapper_watch_event(&mem->ppu_mem, event.time);
+                break;
+            case EVENT_MAPPER_TIMER:
+                schedule_mapper_timer(mem, event.time);
+                break;
+            case EVENT_APU_FRAME_COUNTER:
+                clock_frame_counter(&mem->apu_mem);
+                break;
+            case EVENT_DMC_FETCH:
+                stall += dmc_fetch(mem);
+                break;
+            default:
+                break;
+        }
+    }
+    return stall;
+}
 
-    for (int i = 0; i < cpu_steps; i++) {
-        // This is a bit of a hack, but this is here to avoid a circular dependency.
-        // The APU cannot know about the CPU's memory space.
-        dmc_oscillator* dmc = &mem->apu_mem.dmc;
-        if (dmc->enable && dmc->sample_length > 0 && dmc->sample_bit == 0) {
-            dmc->output_buffer = read_byte(mem, dmc->sample_address);
-
-            dmc->sample_bit = 8;
-            if (++dmc->sample_address == 0) {
-                dmc->sample_address = 0x8000;
-            }
-            if (--dmc->sample_length == 0 && dmc->loop) {
-                dmc->sample_length = dmc->sample_length_register;
-                dmc->sample_address = dmc->sample_address_register;
-            }
-            cpu_steps += 4; // Simulate time spent reading from memory
+// Runs everything but the CPU for the given number of CPU cycles, plus however many more the CPU's stalled for by DMA
+// along the way. Returns the number of cycles run.
+static int run_cycles(memory* mem, int cycles) {
+    scheduler* s = &mem->scheduler;
+    // Cycles the CPU's stalled for, which get run here too and can bring more DMA due
+    int stall = 0;
+    int i = 0;
+    while (i < cycles + stall) {
+        // Nothing else needs looking at until the next event is due
+        if (s->now >= s->next) {
+            stall += run_events(mem);
         }
         apu_step(&mem->apu_mem);
+        s->now += DOTS_PER_CPU_CYCLE;
+        i++;
     }
 
-    int ppu_steps = cpu_steps * 3; // 3 PPU steps for every CPU step
-    for (int i = 0; i < ppu_steps; i++) {
-        ppu_step(&mem->ppu_mem);
+    ppu_run(&mem->ppu_mem, (cycles + stall) * DOTS_PER_CPU_CYCLE);
+    return cycles + stall;
+}
+
+void bus_catch_up(memory* mem) {
+    int cycles = mem->bus_pending;
+    mem->bus_pending = 0;
+    int run = run_cycles(mem, cycles);
+    mem->bus_cycles += run;
+    // A DMA that came due held the CPU up right here, but it still has to be counted as part of the instruction
+    stall_cpu(mem, run - cycles);
+}
+
+int system_step(memory* mem) {
+    scheduler* s = &mem->scheduler;
+    // When the rest of the system's run during the instruction, a stall left over from the last one comes first
+    mem->bus_cycles = 0;
+    mem->bus_pending = mem->timing == TIMING_INSTRUCTION ? 0 : mem->stall_cycles;
+
+    int cpu_steps = cpu_step(mem);
+    if (mem->dma.oam_pending) {
+        oam_dma(mem);
+        cpu_steps += start_oam_dma(&mem->dma, cpu_cycle_now(mem) + cpu_steps - mem->bus_cycles);
+    }
+
+    // Whatever's left of the instruction, which is all of it unless it's being run a cycle at a time
+    mem->bus_pending = 0;
+    cpu_steps = mem->bus_cycles + run_cycles(mem, cpu_steps - mem->bus_cycles);
+
+    // The frontend's had a chance to see new input once the frame's been drawn. Taking it here rather than on every
+    // read of 0x4016 means the game sees the same thing for the whole frame, and it costs one poll a frame.
+    if (!mem->hold_input && mem->ppu_mem.frame != mem->input_frame) {
+        poll_input(&mem->input);
+        mem->input_frame = mem->ppu_mem.frame;
+    }
+
+    // Pick up anything raised at the very end of the instruction, like NMI, so it's seen before the next one.
+    // The cycles have all been run by now, so any stall goes on to the next instruction.
+    if (s->now >= s->next) {
+        stall_cpu(mem, run_events(mem));
     }
 
     return cpu_steps;
 }
+
+void system_run_frame(memory* mem) {
+    unsigned long long frame = mem->ppu_mem.frame;
+    while (mem->ppu_mem.frame == frame) {
+        system_step(mem);
+    }
+}
+
+void advance_frame(memory* mem, const input_snapshot* input) {
+    bool hold_input = mem->hold_input;
+    mem->hold_input = true;
+    mem->input = *input;
+    system_run_frame(mem);
+    mem->hold_input = hold_input;
+}
@@ -3,3 +3,7 @@
 #include "mem.h"
 
 int system_step(memory* mem);
+// Steps until the PPU's finished the frame it's on
+void system_run_frame(memory* mem);
+// Runs a frame with the given input rather than polling the frontend for it, for netplay and replays
+void advance_frame(memory* mem, const input_snapshot* input);
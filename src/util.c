@@ -1,8 +1,13 @@
 #include <err.h>
+#include <stdbool.h>
 #include <stdlib.h>
 
 #include "util.h"
 
+// Declared in debugger.h. It's here rather than in debugger.c so the mapper library can check it without dragging the
+// debugger, and everything it links to, into whatever uses mappers.
+bool debug = false;
+
 void wait_interactive() {
     printf("press enter\n");
     while (getchar() != '\n');
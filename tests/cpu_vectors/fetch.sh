@@ -0,0 +1,14 @@
+#!/usr/bin/env bash
+# Vendors the first few hundred of SingleStepTests' nes6502 tests for each opcode here, for test_cpu_vectors. The full
+# set's 10000 an opcode, too many to keep in the repo. Needs curl and jq.
+#
+# Usage: fetch.sh [tests per opcode]
+set -eo pipefail
+COUNT=${1:-300}
+URL=https://raw.githubusercontent.com/SingleStepTests/65x02/main/nes6502/v1
+cd "$(dirname "$0")"
+for i in $(seq 0 255); do
+    opcode=$(printf "%02x" $i)
+    curl -sfL "$URL/$opcode.json" | jq -c ".[:$COUNT]" > $opcode.json.part
+    mv $opcode.json.part $opcode.json
+done
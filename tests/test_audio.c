@@ -0,0 +1,189 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "unity.h"
+#include <src/apu.h>
+#include <src/audio.h>
+
+// Long enough to go around the APU's ring buffer a few times, and to fill more than one of the file's blocks
+#define SAMPLES 150000
+
+apu_memory apu_mem;
+scheduler sched;
+char path[64];
+
+void setUp(void) {
+    apu_mem = get_apu_mem();
+    scheduler_init(&sched);
+    apu_mem.scheduler = &sched;
+    strcpy(path, "/tmp/test_audio_XXXXXX");
+    int fd = mkstemp(path);
+    TEST_ASSERT_NOT_EQUAL(-1, fd);
+    close(fd);
+}
+
+void tearDown(void) {
+    unlink(path);
+}
+
+// Moves the DMC's output level around so the samples aren't all the same
+static void make_samples(long samples) {
+    while (apu_mem.buffer_write_index < samples) {
+        write_apu_register(&apu_mem, 0x11, apu_mem.buffer_write_index & 0x7F);
+        apu_step(&apu_mem);
+    }
+}
+
+static float* read_samples(long offset, long* count) {
+    FILE* f = fopen(path, "rb");
+    TEST_ASSERT_NOT_NULL(f);
+    fseek(f, 0, SEEK_END);
+    *count = (ftell(f) - offset) / sizeof(float);
+    fseek(f, offset, SEEK_SET);
+    float* samples = malloc(*count * sizeof(float));
+    TEST_ASSERT_EQUAL_INT(*count, fread(samples, sizeof(float), *count, f));
+    fclose(f);
+    return samples;
+}
+
+void test_raw_file_gets_every_sample(void) {
+    audio_sink sink;
+    audio_open_file(&sink, &apu_mem, path, AUDIO_FILE_RAW);
+    TEST_ASSERT_EQUAL_PTR(&sink, apu_mem.sink);
+    make_samples(SAMPLES);
+    audio_close(&sink);
+    TEST_ASSERT_NULL(apu_mem.sink);
+
+    long count;
+    float* samples = read_samples(0, &count);
+    TEST_ASSERT_EQUAL_INT(SAMPLES, count);
+    // Whatever's still in the ring buffer is the end of the file
+    for (long i = SAMPLES - APU_RING_BUFFER_SIZE; i < SAMPLES; i++) {
+        TEST_ASSERT_EQUAL_FLOAT(apu_mem.buffer.f32[i % APU_RING_BUFFER_SIZE], samples[i]);
+    }
+    free(samples);
+}
+
+void test_wav_header_has_the_length(void) {
+    audio_sink sink;
+    audio_open_file(&sink, &apu_mem, path, AUDIO_FILE_WAV);
+    make_samples(1000);
+    audio_close(&sink);
+
+    byte header[44];
+    FILE* f = fopen(path, "rb");
+    TEST_ASSERT_EQUAL_INT(1, fread(header, sizeof(header), 1, f));
+    fclose(f);
+    TEST_ASSERT_EQUAL_MEMORY("RIFF", header, 4);
+    TEST_ASSERT_EQUAL_MEMORY("WAVEfmt ", header + 8, 8);
+    TEST_ASSERT_EQUAL_MEMORY("data", header + 36, 4);
+    uint32_t riff_size = header[4] | header[5] << 8 | header[6] << 16 | header[7] << 24;
+    uint32_t data_size = header[40] | header[41] << 8 | header[42] << 16 | header[43] << 24;
+    TEST_ASSERT_EQUAL_UINT32(1000 * sizeof(float), data_size);
+    TEST_ASSERT_EQUAL_UINT32(36 + data_size, riff_size);
+
+    long count;
+    float* samples = read_samples(sizeof(header), &count);
+    TEST_ASSERT_EQUAL_INT(1000, count);
+    TEST_ASSERT_EQUAL_FLOAT(apu_mem.buffer.f32[999], samples[999]);
+    free(samples);
+}
+
+// The DMC on its own, so only the tnd side of the mix
+static void step_with_dmc_level(byte level) {
+    write_apu_register(&apu_mem, 0x11, level);
+    long samples = apu_mem.buffer_write_index;
+    while (apu_mem.buffer_write_index == samples) {
+        apu_step(&apu_mem);
+    }
+}
+
+// Holds the DMC where it is until the high-pass has taken the offset back out
+static void settle(void) {
+    for (int i = 0; i < 2000; i++) {
+        step_with_dmc_level(apu_mem.dmc.level);
+    }
+}
+
+// What comes out straight after the DMC jumps from 0 to level, on an APU that's only ever been at 0
+static float jump_from_silence(byte level) {
+    apu_mem = get_apu_mem();
+    scheduler_init(&sched);
+    apu_mem.scheduler = &sched;
+    step_with_dmc_level(0);
+    step_with_dmc_level(level);
+    return apu_mem.buffer.f32[(apu_mem.buffer_write_index - 1) % APU_RING_BUFFER_SIZE];
+}
+
+void test_mixer_is_non_linear(void) {
+    float full = jump_from_silence(127);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 163.67 / (24329.0 / 127 + 100), full);
+    float half = jump_from_silence(64);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6, 163.67 / (24329.0 / 64 + 100), half);
+    // Half the level comes out at more than half the volume
+    TEST_ASSERT_TRUE(half > full / 2);
+}
+
+void test_output_is_centred(void) {
+    step_with_dmc_level(64);
+    TEST_ASSERT_TRUE(apu_mem.buffer.f32[0] > 0.1);
+    settle();
+    TEST_ASSERT_FLOAT_WITHIN(1e-4, 0, apu_mem.buffer.f32[(apu_mem.buffer_write_index - 1) % APU_RING_BUFFER_SIZE]);
+    // And dropping back to 0 swings the other way
+    step_with_dmc_level(0);
+    TEST_ASSERT_TRUE(apu_mem.buffer.f32[(apu_mem.buffer_write_index - 1) % APU_RING_BUFFER_SIZE] < -0.1);
+}
+
+void test_int16_samples(void) {
+    apu_mem.sample_format = SAMPLE_INT16;
+    step_with_dmc_level(0);
+    TEST_ASSERT_EQUAL_INT16(0, apu_mem.buffer.int16[0]);
+    step_with_dmc_level(127);
+    TEST_ASSERT_INT16_WITHIN(1, (163.67 / (24329.0 / 127 + 100)) * INT16_MAX, apu_mem.buffer.int16[1]);
+    // The bottom half of the range gets used too
+    settle();
+    step_with_dmc_level(0);
+    TEST_ASSERT_INT16_WITHIN(1, -(163.67 / (24329.0 / 127 + 100)) * INT16_MAX,
+                             apu_mem.buffer.int16[(apu_mem.buffer_write_index - 1) % APU_RING_BUFFER_SIZE]);
+
+    long start = apu_mem.buffer_write_index;
+    audio_sink sink;
+    audio_open_file(&sink, &apu_mem, path, AUDIO_FILE_WAV);
+    make_samples(start + 1000);
+    audio_close(&sink);
+
+    byte header[44];
+    FILE* f = fopen(path, "rb");
+    TEST_ASSERT_EQUAL_INT(1, fread(header, sizeof(header), 1, f));
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    TEST_ASSERT_EQUAL_INT(1, header[20]); // PCM
+    TEST_ASSERT_EQUAL_INT(16, header[34]);
+    TEST_ASSERT_EQUAL_INT(sizeof(header) + 1000 * sizeof(int16_t), size);
+}
+
+void test_null_sink_leaves_the_ring_buffer_alone(void) {
+    audio_sink sink;
+    TEST_ASSERT_TRUE(audio_open_by_name(&sink, &apu_mem, "none"));
+    TEST_ASSERT_FALSE(apu_mem.real_time); // So frames don't wait on it
+    make_samples(5000);
+    TEST_ASSERT_EQUAL_INT(0, apu_mem.buffer_read_index);
+    audio_close(&sink);
+    TEST_ASSERT_NULL(apu_mem.sink);
+
+    TEST_ASSERT_FALSE(audio_open_by_name(&sink, &apu_mem, "speakers"));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_raw_file_gets_every_sample);
+    RUN_TEST(test_wav_header_has_the_length);
+    RUN_TEST(test_mixer_is_non_linear);
+    RUN_TEST(test_output_is_centred);
+    RUN_TEST(test_int16_samples);
+    RUN_TEST(test_null_sink_leaves_the_ring_buffer_alone);
+    return UNITY_END();
+}
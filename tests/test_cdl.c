@@ -0,0 +1,62 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include <src/system.h>
+#include <src/cdl.h>
+#include <src/mapper/rom.h>
+
+void test_logs_code_data_and_chr(void) {
+    rom* r = read_rom("nestest.nes");
+    cdl_start(r);
+    memory* mem = get_blank_memory(r);
+    for (int i = 0; i < 5; i++) {
+        system_run_frame(mem);
+    }
+
+    // Bits 2-3 are 2 for 0xC000-0xDFFF and 3 for 0xE000-0xFFFF
+    // Reset: SEI, CLD, LDX #$FF
+    TEST_ASSERT_EQUAL_HEX8(CDL_CODE | CDL_OPCODE | 0b1000, r->cdl_prg[0x0004]);
+    TEST_ASSERT_EQUAL_HEX8(CDL_CODE | CDL_OPCODE | 0b1000, r->cdl_prg[0x0005]);
+    TEST_ASSERT_EQUAL_HEX8(CDL_CODE | CDL_OPCODE | 0b1000, r->cdl_prg[0x0006]);
+    TEST_ASSERT_EQUAL_HEX8(CDL_CODE | 0b1000, r->cdl_prg[0x0007]);
+    // The NMI vector's data
+    TEST_ASSERT_EQUAL_HEX8(CDL_DATA | 0b1100, r->cdl_prg[0x3FFA]);
+    // Nothing that isn't ROM ends up in the log
+    TEST_ASSERT_EQUAL_HEX8(0, r->cdl_prg[0x3FF0]);
+
+    // The menu's text has been drawn
+    int rendered = 0;
+    for (size_t i = 0; i < r->chr_rom_size; i++) {
+        TEST_ASSERT_EQUAL_HEX8(0, r->cdl_chr[i] & ~CDL_CHR_RENDERED);
+        rendered += r->cdl_chr[i];
+    }
+    TEST_ASSERT_GREATER_THAN(0, rendered);
+
+    // Writing it out and reading it back into an empty log gets the same thing
+    FILE* f = tmpfile();
+    cdl_write(r, f);
+    TEST_ASSERT_EQUAL_INT(r->prg_rom_size + r->chr_rom_size, ftell(f));
+    byte* prg = malloc(r->prg_rom_size);
+    memcpy(prg, r->cdl_prg, r->prg_rom_size);
+    cdl_start(r);
+    rewind(f);
+    TEST_ASSERT_TRUE(cdl_read(r, f));
+    TEST_ASSERT_EQUAL_HEX8_ARRAY(prg, r->cdl_prg, r->prg_rom_size);
+
+    // A log for something bigger isn't for this ROM
+    fputc(0, f);
+    rewind(f);
+    TEST_ASSERT_FALSE(cdl_read(r, f));
+    fclose(f);
+
+    free(prg);
+    cdl_stop(r);
+    TEST_ASSERT_NULL(r->cdl_prg);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_logs_code_data_and_chr);
+    return UNITY_END();
+}
@@ -1,39 +1,159 @@
 #include <stdlib.h>
+#include <string.h>
 
 #include "unity.h"
 #include <src/cpu.h>
+#include <src/bus.h>
 #include <src/opcode_names.h>
 #include <src/mem.h>
 
-memory mock_memory() {
-    memory mem;
+byte flat_ram[FLAT_BUS_BYTES];
 
-    mem.a = 0x00;
-    mem.x = 0x00;
-    mem.y = 0x00;
-    mem.sp = 0xFD;
-    mem.p = 0x34;
-    mem.pc = 0x0000; // For tests, start reading at 0x0000 so we don't need to load a real ROM
+memory* mock_memory() {
+    // The reset vector's 0x0000, so the code for each test starts there
+    memset(flat_ram, 0, sizeof(flat_ram));
+    return get_cpu_memory(&flat_bus, flat_ram);
+}
+
+void test_brk(void) {
+    memory* mem = mock_memory();
+    flat_ram[0x0000] = BRK;
+    flat_ram[0xFFFE] = 0x34;
+    flat_ram[0xFFFF] = 0x12;
+    cpu_step(mem);
+    TEST_ASSERT_MESSAGE(get_p_interrupt(mem) == 1, "Interrupt flag not set by BRK");
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(0x1234, mem->pc, "BRK didn't go through the IRQ vector");
+    // The return address skips the byte after BRK, and B's set in the flags that were pushed
+    TEST_ASSERT_EQUAL_HEX8(0xFA, mem->sp);
+    TEST_ASSERT_EQUAL_HEX8(0x00, flat_ram[0x1FD]);
+    TEST_ASSERT_EQUAL_HEX8(0x02, flat_ram[0x1FC]);
+    TEST_ASSERT_EQUAL_HEX8(0x34, flat_ram[0x1FB]);
 
-    rom* r = malloc(sizeof(rom));
+    free(mem);
+}
 
-    mem.r = r;
+void test_irq_masked_by_interrupt_flag(void) {
+    memory* mem = mock_memory();
+    flat_ram[0x0000] = NOP;
+    assert_irq(&mem->scheduler, IRQ_MAPPER);
+    cpu_step(mem);
+    TEST_ASSERT_EQUAL_UINT16_MESSAGE(0x0001, mem->pc, "IRQ taken with the interrupt flag set");
 
-    return mem;
+    free(mem);
 }
 
-void test_brk(void) {
-    memory mem = mock_memory();
-    write_byte(&mem, 0x0000, BRK);
-    cpu_step(&mem);
-    TEST_ASSERT_MESSAGE(get_p_interrupt(&mem) == 1, "Interrupt flag not set by BRK");
+void test_catch_up_counts_bus_cycles(void) {
+    memory* mem = mock_memory();
+    mem->timing = TIMING_CATCH_UP;
+    mem->x = 0x01;
+
+    // None of these touch a register, so the cycles are only counted. Opcode, operand, adding x, then the read
+    flat_ram[0x0000] = LDA_Zeropage_X;
+    flat_ram[0x0001] = 0x10;
+    TEST_ASSERT_EQUAL_INT(4, cpu_step(mem));
+    TEST_ASSERT_EQUAL_INT(4, mem->bus_pending);
+    TEST_ASSERT_EQUAL_INT(0, mem->bus_cycles);
+
+    // A write always takes the cycle to fix up the high byte, even when there's nothing to fix
+    mem->bus_pending = 0;
+    flat_ram[0x0002] = STA_Absolute_X;
+    flat_ram[0x0003] = 0x00;
+    flat_ram[0x0004] = 0x03;
+    TEST_ASSERT_EQUAL_INT(5, cpu_step(mem));
+    TEST_ASSERT_EQUAL_INT(5, mem->bus_pending);
+
+    free(mem);
+}
+
+void test_rmw_absolute_x_always_takes_the_index_cycle(void) {
+    memory* mem = mock_memory();
+    mem->timing = TIMING_CATCH_UP;
+    mem->x = 0x01;
+
+    // No page's crossed, but the CPU reads from the unfixed address anyway before it does the read-modify-write
+    flat_ram[0x0000] = INC_Absolute_X;
+    flat_ram[0x0001] = 0x00;
+    flat_ram[0x0002] = 0x02;
+    flat_ram[0x0201] = 0x41;
+    TEST_ASSERT_EQUAL_INT(7, cpu_step(mem));
+    TEST_ASSERT_EQUAL_INT(7, mem->bus_pending);
+    TEST_ASSERT_EQUAL_HEX8(0x42, flat_ram[0x0201]);
+
+    free(mem);
+}
+
+void test_bus_trace(void) {
+    memory* mem = mock_memory();
+    flat_ram[0x0000] = LDA_Zeropage;
+    flat_ram[0x0001] = 0x10;
+    flat_ram[0x0002] = STA_Absolute;
+    flat_ram[0x0003] = 0x00;
+    flat_ram[0x0004] = 0x03;
+    flat_ram[0x0010] = 0xAB;
+
+    FILE* f = tmpfile();
+    bus_trace trace;
+    start_bus_trace(mem, &trace, f);
+    cpu_step(mem);
+    cpu_step(mem);
+    stop_bus_trace(mem);
+    TEST_ASSERT_EQUAL_PTR(&flat_bus, mem->bus);
+    TEST_ASSERT_EQUAL_HEX8(0xAB, flat_ram[0x0300]);
+
+    char expected[] =
+            "         0 R $0000 = $A5\n"
+            "         1 R $0001 = $10\n"
+            "         2 R $0010 = $AB\n"
+            "         3 R $0002 = $8D\n"
+            "         4 R $0003 = $00\n"
+            "         5 R $0004 = $03\n"
+            "         6 W $0300 = $AB\n";
+    char actual[sizeof(expected) + 1] = {0};
+    rewind(f);
+    TEST_ASSERT_EQUAL_INT(sizeof(expected) - 1, fread(actual, 1, sizeof(actual), f));
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    fclose(f);
+
+    free(mem);
+}
+
+// The return address goes on the stack before the high byte of where it's going is read
+void test_jsr_bus_cycles(void) {
+    memory* mem = mock_memory();
+    flat_ram[0x0000] = JSR;
+    flat_ram[0x0001] = 0x00;
+    flat_ram[0x0002] = 0x03;
+
+    FILE* f = tmpfile();
+    bus_trace trace;
+    start_bus_trace(mem, &trace, f);
+    TEST_ASSERT_EQUAL_INT(6, cpu_step(mem));
+    stop_bus_trace(mem);
+    TEST_ASSERT_EQUAL_HEX16(0x0300, mem->pc);
+
+    char expected[] =
+            "         0 R $0000 = $20\n"
+            "         1 R $0001 = $00\n"
+            "         3 W $01FD = $00\n"
+            "         4 W $01FC = $02\n"
+            "         5 R $0002 = $03\n";
+    char actual[sizeof(expected) + 1] = {0};
+    rewind(f);
+    TEST_ASSERT_EQUAL_INT(sizeof(expected) - 1, fread(actual, 1, sizeof(actual), f));
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+    fclose(f);
 
-    free(mem.r);
+    free(mem);
 }
 
 int main(void) {
     UNITY_BEGIN();
     RUN_TEST(test_brk);
+    RUN_TEST(test_irq_masked_by_interrupt_flag);
+    RUN_TEST(test_catch_up_counts_bus_cycles);
+    RUN_TEST(test_rmw_absolute_x_always_takes_the_index_cycle);
+    RUN_TEST(test_bus_trace);
+    RUN_TEST(test_jsr_bus_cycles);
     //RUN_TEST(test_sei);
     return UNITY_END();
 }
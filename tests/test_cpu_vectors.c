@@ -0,0 +1,510 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include <src/cpu.h>
+#include <src/bus.h>
+#include <src/mem.h>
+
+/*
+ * Runs the CPU against tests in the format of https://github.com/SingleStepTests/65x02 (nes6502): one file of JSON per
+ * opcode, named like a9.json, each test a starting state, the state one instruction later, and every bus cycle in
+ * between. The CPU gets a flat 64KB of RAM as its bus, so nothing else of the NES is involved.
+ *
+ * cpu_vectors/fetch.sh vendors the first few hundred tests for each opcode from there. Point NES_CPU_VECTORS at a
+ * checkout of the full set to run those instead. Each opcode's a test of its own. Once any have been fetched, an opcode
+ * the CPU does with no file fails; with none at all, they're all ignored, and the only check left is nestest.log.
+ *
+ * That log's from Nintendulator, and has the registers and cycle count before every instruction nestest.nes runs from
+ * $C000. Unlike test_nestest, this runs it on the flat bus, so it's a check of the CPU alone and doesn't stop at the
+ * first line the PPU's out on.
+ */
+
+#define MAX_RAM_ENTRIES 64
+// Seven's the most an instruction takes, leaving room for anything that's wrong
+#define MAX_CYCLES 16
+#define MAX_NAME 32
+
+// Jams and the unstable unofficial opcodes, which the CPU doesn't do
+static const byte unimplemented[] = {
+        0x02, 0x12, 0x22, 0x32, 0x42, 0x52, 0x62, 0x72, 0x92, 0xB2, 0xD2, 0xF2,
+        0x0B, 0x2B, 0x4B, 0x6B, 0x8B, 0xAB, 0xCB, 0x93, 0x9B, 0x9C, 0x9E, 0x9F, 0xBB
+};
+
+typedef struct cpu_state_t {
+    uint16_t pc;
+    byte s;
+    byte a;
+    byte x;
+    byte y;
+    byte p;
+    int ram_entries;
+    uint16_t ram_address[MAX_RAM_ENTRIES];
+    byte ram_value[MAX_RAM_ENTRIES];
+} cpu_state;
+
+typedef struct bus_access_t {
+    uint16_t address;
+    byte value;
+    bool write;
+    int cycle; // Of the instruction, from 0
+} bus_access;
+
+typedef struct cpu_vector_t {
+    char name[MAX_NAME];
+    cpu_state initial;
+    cpu_state final;
+    int cycles;
+    bus_access bus[MAX_CYCLES]; // One a cycle
+} cpu_vector;
+
+static byte flat_ram[FLAT_BUS_BYTES];
+
+/*
+ * Flat RAM that remembers every access the CPU makes during an instruction, and which cycle of it they land on. The
+ * vectors have an access on every cycle, but where the real CPU does a dummy read of something the instruction
+ * doesn't use, this one mostly idles, so those cycles don't show up here.
+ */
+static bus_access accesses[MAX_CYCLES];
+static int access_count;
+
+static void record(memory* mem, uint16_t address, byte value, bool write) {
+    if (access_count < MAX_CYCLES) {
+        accesses[access_count++] = (bus_access){address, value, write, mem->bus_pending - 1};
+    }
+}
+
+static byte recording_read(memory* mem, uint16_t address) {
+    record(mem, address, flat_ram[address], false);
+    return flat_ram[address];
+}
+
+static void recording_write(memory* mem, uint16_t address, byte value) {
+    record(mem, address, value, true);
+    flat_ram[address] = value;
+}
+
+static const cpu_bus recording_bus = {
+    .read = recording_read,
+    .write = recording_write
+};
+
+// Just enough JSON for these files. Anything that isn't what's expected fails the test.
+typedef struct json_t {
+    const char* at;
+    const char* file;
+} json;
+
+static void skip_space(json* j) {
+    while (isspace((unsigned char)*j->at)) {
+        j->at++;
+    }
+}
+
+static void expect(json* j, char c) {
+    skip_space(j);
+    if (*j->at != c) {
+        char message[320];
+        snprintf(message, sizeof(message), "%s: expected '%c' but found '%.10s'", j->file, c, j->at);
+        TEST_FAIL_MESSAGE(message);
+    }
+    j->at++;
+}
+
+// Eats c if it's next
+static bool accept(json* j, char c) {
+    skip_space(j);
+    if (*j->at == c) {
+        j->at++;
+        return true;
+    }
+    return false;
+}
+
+static long parse_number(json* j) {
+    skip_space(j);
+    char* end;
+    long value = strtol(j->at, &end, 10);
+    if (end == j->at) {
+        TEST_FAIL_MESSAGE("Expected a number");
+    }
+    j->at = end;
+    return value;
+}
+
+static void parse_string(json* j, char* out, size_t size) {
+    expect(j, '"');
+    size_t length = 0;
+    while (*j->at != '"') {
+        if (*j->at == '\0') {
+            TEST_FAIL_MESSAGE("Unterminated string");
+        }
+        if (length + 1 < size) {
+            out[length++] = *j->at;
+        }
+        j->at++;
+    }
+    out[length] = '\0';
+    j->at++;
+}
+
+static void skip_value(json* j) {
+    skip_space(j);
+    if (*j->at == '"') {
+        char ignored[1];
+        parse_string(j, ignored, sizeof(ignored));
+    }
+    else if (accept(j, '[')) {
+        if (!accept(j, ']')) {
+            do {
+                skip_value(j);
+            } while (accept(j, ','));
+            expect(j, ']');
+        }
+    }
+    else if (accept(j, '{')) {
+        if (!accept(j, '}')) {
+            do {
+                char key[MAX_NAME];
+                parse_string(j, key, sizeof(key));
+                expect(j, ':');
+                skip_value(j);
+            } while (accept(j, ','));
+            expect(j, '}');
+        }
+    }
+    else {
+        parse_number(j);
+    }
+}
+
+static void parse_ram(json* j, cpu_state* state) {
+    state->ram_entries = 0;
+    expect(j, '[');
+    if (accept(j, ']')) {
+        return;
+    }
+    do {
+        TEST_ASSERT_LESS_THAN_MESSAGE(MAX_RAM_ENTRIES, state->ram_entries, "Too much RAM in one test");
+        expect(j, '[');
+        state->ram_address[state->ram_entries] = parse_number(j);
+        expect(j, ',');
+        state->ram_value[state->ram_entries] = parse_number(j);
+        expect(j, ']');
+        state->ram_entries++;
+    } while (accept(j, ','));
+    expect(j, ']');
+}
+
+static void parse_state(json* j, cpu_state* state) {
+    expect(j, '{');
+    do {
+        char key[MAX_NAME];
+        parse_string(j, key, sizeof(key));
+        expect(j, ':');
+        if (strcmp(key, "ram") == 0) {
+            parse_ram(j, state);
+        }
+        else if (strcmp(key, "pc") == 0) {
+            state->pc = parse_number(j);
+        }
+        else if (strcmp(key, "s") == 0) {
+            state->s = parse_number(j);
+        }
+        else if (strcmp(key, "a") == 0) {
+            state->a = parse_number(j);
+        }
+        else if (strcmp(key, "x") == 0) {
+            state->x = parse_number(j);
+        }
+        else if (strcmp(key, "y") == 0) {
+            state->y = parse_number(j);
+        }
+        else if (strcmp(key, "p") == 0) {
+            state->p = parse_number(j);
+        }
+        else {
+            skip_value(j);
+        }
+    } while (accept(j, ','));
+    expect(j, '}');
+}
+
+// Each cycle's [address, value, "read" or "write"]
+static void parse_cycles(json* j, cpu_vector* vector) {
+    vector->cycles = 0;
+    expect(j, '[');
+    if (accept(j, ']')) {
+        return;
+    }
+    do {
+        TEST_ASSERT_LESS_THAN_MESSAGE(MAX_CYCLES, vector->cycles, "Too many cycles in one test");
+        bus_access* access = &vector->bus[vector->cycles];
+        char kind[MAX_NAME];
+        expect(j, '[');
+        access->address = parse_number(j);
+        expect(j, ',');
+        access->value = parse_number(j);
+        expect(j, ',');
+        parse_string(j, kind, sizeof(kind));
+        expect(j, ']');
+        if (strcmp(kind, "read") != 0 && strcmp(kind, "write") != 0) {
+            TEST_FAIL_MESSAGE("Expected a read or a write");
+        }
+        access->write = strcmp(kind, "write") == 0;
+        access->cycle = vector->cycles++;
+    } while (accept(j, ','));
+    expect(j, ']');
+}
+
+static void parse_vector(json* j, cpu_vector* vector) {
+    expect(j, '{');
+    do {
+        char key[MAX_NAME];
+        parse_string(j, key, sizeof(key));
+        expect(j, ':');
+        if (strcmp(key, "name") == 0) {
+            parse_string(j, vector->name, sizeof(vector->name));
+        }
+        else if (strcmp(key, "initial") == 0) {
+            parse_state(j, &vector->initial);
+        }
+        else if (strcmp(key, "final") == 0) {
+            parse_state(j, &vector->final);
+        }
+        else if (strcmp(key, "cycles") == 0) {
+            parse_cycles(j, vector);
+        }
+        else {
+            skip_value(j);
+        }
+    } while (accept(j, ','));
+    expect(j, '}');
+}
+
+static char* read_file(const char* path) {
+    FILE* f = fopen(path, "rb");
+    if (f == NULL) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    rewind(f);
+    char* text = malloc(size + 1);
+    TEST_ASSERT_NOT_NULL(text);
+    TEST_ASSERT_EQUAL_INT(size, fread(text, 1, size, f));
+    text[size] = '\0';
+    fclose(f);
+    return text;
+}
+
+// Returns the first thing that's different, or NULL if it all matches
+static const char* compare(memory* mem, const cpu_vector* vector, int cycles, char* message, size_t size) {
+    const cpu_state* expected = &vector->final;
+    if (mem->pc != expected->pc || mem->sp != expected->s || mem->a != expected->a || mem->x != expected->x
+        || mem->y != expected->y || get_p(mem) != expected->p) {
+        snprintf(message, size, "expected pc %04X s %02X a %02X x %02X y %02X p %02X, "
+                                "got pc %04X s %02X a %02X x %02X y %02X p %02X",
+                 expected->pc, expected->s, expected->a, expected->x, expected->y, expected->p,
+                 mem->pc, mem->sp, mem->a, mem->x, mem->y, get_p(mem));
+        return message;
+    }
+    for (int i = 0; i < expected->ram_entries; i++) {
+        if (flat_ram[expected->ram_address[i]] != expected->ram_value[i]) {
+            snprintf(message, size, "expected %02X at %04X, got %02X", expected->ram_value[i],
+                     expected->ram_address[i], flat_ram[expected->ram_address[i]]);
+            return message;
+        }
+    }
+    if (cycles != vector->cycles) {
+        snprintf(message, size, "expected %d cycles, got %d", vector->cycles, cycles);
+        return message;
+    }
+    // Everything the CPU put on the bus has to be what was on it that cycle
+    for (int i = 0; i < access_count; i++) {
+        const bus_access* got = &accesses[i];
+        const bus_access* want = &vector->bus[got->cycle];
+        if (got->cycle >= vector->cycles || got->address != want->address || got->value != want->value
+            || got->write != want->write) {
+            snprintf(message, size, "cycle %d: got %s %02X at %04X", got->cycle, got->write ? "write" : "read",
+                     got->value, got->address);
+            return message;
+        }
+    }
+    // And no write can have been skipped, bar one: read-modify-write instructions write the old value back before
+    // the new one, where this CPU idles. It's left out because the MMC1 doesn't drop back to back writes yet.
+    for (int cycle = 0; cycle < vector->cycles; cycle++) {
+        const bus_access* next = &vector->bus[cycle + 1];
+        if (!vector->bus[cycle].write
+            || (cycle + 1 < vector->cycles && next->write && next->address == vector->bus[cycle].address)) {
+            continue;
+        }
+        bool written = false;
+        for (int i = 0; i < access_count; i++) {
+            written |= accesses[i].cycle == cycle;
+        }
+        if (!written) {
+            snprintf(message, size, "cycle %d: expected write %02X at %04X", cycle, vector->bus[cycle].value,
+                     vector->bus[cycle].address);
+            return message;
+        }
+    }
+    return NULL;
+}
+
+static int run_vector(memory* mem, const cpu_vector* vector) {
+    const cpu_state* initial = &vector->initial;
+    mem->pc = initial->pc;
+    mem->sp = initial->s;
+    mem->a = initial->a;
+    mem->x = initial->x;
+    mem->y = initial->y;
+    set_p(mem, initial->p);
+    for (int i = 0; i < initial->ram_entries; i++) {
+        flat_ram[initial->ram_address[i]] = initial->ram_value[i];
+    }
+    access_count = 0;
+    return cpu_step(mem);
+}
+
+static bool is_implemented(int opcode) {
+    for (size_t i = 0; i < sizeof(unimplemented); i++) {
+        if (unimplemented[i] == opcode) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static const char* directory;
+static bool any_vectors;
+static memory* mem;
+static int opcode;
+
+static bool has_vectors(int op) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%02x.json", directory, op);
+    FILE* f = fopen(path, "rb");
+    if (f != NULL) {
+        fclose(f);
+    }
+    return f != NULL;
+}
+
+void test_opcode(void) {
+    if (!is_implemented(opcode)) {
+        TEST_IGNORE_MESSAGE("A jam or an unstable unofficial opcode, which the CPU doesn't do");
+    }
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%02x.json", directory, opcode);
+    char* text = read_file(path);
+    if (text == NULL && !any_vectors) {
+        TEST_IGNORE_MESSAGE("No vectors fetched, see cpu_vectors/fetch.sh");
+    }
+    if (text == NULL) {
+        TEST_FAIL_MESSAGE("No tests for it, see cpu_vectors/fetch.sh");
+    }
+
+    json j = {text, path};
+    int tests = 0;
+    int failed = 0;
+    char first_failure[256] = "";
+    expect(&j, '[');
+    do {
+        cpu_vector vector;
+        memset(&vector, 0, sizeof(vector));
+        parse_vector(&j, &vector);
+
+        int cycles = run_vector(mem, &vector);
+        char message[160];
+        const char* failure = compare(mem, &vector, cycles, message, sizeof(message));
+        if (failure != NULL && failed++ == 0) {
+            snprintf(first_failure, sizeof(first_failure), "%s: %s", vector.name, failure);
+        }
+        tests++;
+
+        // Back to a blank slate for the next one
+        for (int i = 0; i < vector.final.ram_entries; i++) {
+            flat_ram[vector.final.ram_address[i]] = 0;
+        }
+    } while (accept(&j, ','));
+    expect(&j, ']');
+    free(text);
+
+    if (failed > 0) {
+        char message[320];
+        snprintf(message, sizeof(message), "%d of %d failed, first %s", failed, tests, first_failure);
+        TEST_FAIL_MESSAGE(message);
+    }
+}
+
+// The PRG's 16KB, mirrored into both halves of $8000-$FFFF like NROM does
+void test_nestest_log(void) {
+    FILE* nes = fopen("nestest.nes", "rb");
+    TEST_ASSERT_NOT_NULL(nes);
+    memset(flat_ram, 0, sizeof(flat_ram));
+    fseek(nes, 16, SEEK_SET);
+    TEST_ASSERT_EQUAL_INT(0x4000, fread(&flat_ram[0x8000], 1, 0x4000, nes));
+    memcpy(&flat_ram[0xC000], &flat_ram[0x8000], 0x4000);
+    fclose(nes);
+
+    FILE* log = fopen("nestest.log", "rb");
+    TEST_ASSERT_NOT_NULL(log);
+    mem->pc = 0xC000;
+    mem->sp = 0xFD;
+    mem->a = mem->x = mem->y = 0;
+    set_p(mem, 0x24);
+    long total_cycles = 7; // The log starts at 7, after reset
+
+    char line[128];
+    int lines = 0;
+    while (fgets(line, sizeof(line), log) != NULL) {
+        unsigned pc, a, x, y, p, sp;
+        long cycles;
+        const char* registers = strstr(line, "A:");
+        const char* cyc = strstr(line, "CYC:");
+        TEST_ASSERT_NOT_NULL(registers);
+        TEST_ASSERT_NOT_NULL(cyc);
+        TEST_ASSERT_EQUAL_INT(1, sscanf(line, "%4x", &pc));
+        TEST_ASSERT_EQUAL_INT(5, sscanf(registers, "A:%2x X:%2x Y:%2x P:%2x SP:%2x", &a, &x, &y, &p, &sp));
+        TEST_ASSERT_EQUAL_INT(1, sscanf(cyc, "CYC:%ld", &cycles));
+
+        if (mem->pc != pc || mem->a != a || mem->x != x || mem->y != y || get_p(mem) != p || mem->sp != sp
+            || total_cycles != cycles) {
+            char message[320];
+            snprintf(message, sizeof(message), "line %d: expected pc %04X a %02X x %02X y %02X p %02X sp %02X "
+                                               "cyc %ld, got pc %04X a %02X x %02X y %02X p %02X sp %02X cyc %ld",
+                     lines + 1, pc, a, x, y, p, sp, cycles, mem->pc, mem->a, mem->x, mem->y, get_p(mem), mem->sp,
+                     total_cycles);
+            TEST_FAIL_MESSAGE(message);
+        }
+        access_count = 0;
+        total_cycles += cpu_step(mem);
+        lines++;
+    }
+    fclose(log);
+    TEST_ASSERT_EQUAL_INT(8991, lines);
+}
+
+int main(void) {
+    directory = getenv("NES_CPU_VECTORS");
+    if (directory == NULL) {
+        directory = "cpu_vectors";
+    }
+    mem = get_cpu_memory(&recording_bus, NULL);
+    for (int op = 0; op < 0x100; op++) {
+        any_vectors |= has_vectors(op);
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_nestest_log);
+    for (opcode = 0; opcode < 0x100; opcode++) {
+        char name[MAX_NAME];
+        snprintf(name, sizeof(name), "test_opcode_%02x", opcode);
+        UnityDefaultTestRun(test_opcode, name, __LINE__);
+    }
+    free(mem);
+    return UNITY_END();
+}
@@ -0,0 +1,110 @@
+#include "unity.h"
+#include <src/system.h>
+#include <src/debugger.h>
+#include <src/set.h>
+#include <src/mapper/rom.h>
+
+debug_break last_break;
+uint16_t break_pc;
+int breaks = 0;
+
+void record_break(memory* mem, const debug_break* brk) {
+    last_break = *brk;
+    break_pc = mem->pc;
+    breaks++;
+}
+
+void setUp(void) {
+    clear_all_breakpoints();
+    set_debug_break_handler(record_break);
+    breaks = 0;
+}
+
+void tearDown(void) {
+    clear_all_breakpoints();
+    set_debug_break_handler(NULL);
+}
+
+// Runs until the handler's been called or enough instructions have gone by that it's not going to be
+memory* run_until_break(int max_steps) {
+    memory* mem = get_blank_memory(read_rom("nestest.nes"));
+    for (int i = 0; i < max_steps && breaks == 0; i++) {
+        system_step(mem);
+    }
+    return mem;
+}
+
+void test_address_set(void) {
+    static address_set set;
+    address_set_clear(&set);
+    TEST_ASSERT_TRUE(address_set_empty(&set));
+    address_set_add(&set, 0x0000);
+    address_set_add(&set, 0xFFFF);
+    address_set_add(&set, 0xFFFF);
+    TEST_ASSERT_FALSE(address_set_empty(&set));
+    TEST_ASSERT_TRUE(address_set_contains(&set, 0x0000));
+    TEST_ASSERT_TRUE(address_set_contains(&set, 0xFFFF));
+    TEST_ASSERT_FALSE(address_set_contains(&set, 0xFFFE));
+    address_set_remove(&set, 0x0000);
+    address_set_remove(&set, 0xFFFF);
+    TEST_ASSERT_TRUE(address_set_empty(&set));
+    TEST_ASSERT_FALSE(address_set_contains(&set, 0xFFFF));
+}
+
+void test_breakpoint(void) {
+    // Reset is SEI, CLD, LDX #$FF
+    TEST_ASSERT_TRUE(add_breakpoint_spec("C006\n"));
+    run_until_break(100);
+    TEST_ASSERT_EQUAL_INT(1, breaks);
+    TEST_ASSERT_EQUAL_INT(BREAK_BREAKPOINT, last_break.reason);
+    TEST_ASSERT_EQUAL_HEX16(0xC006, last_break.address);
+    // Stopped before it's run
+    TEST_ASSERT_EQUAL_HEX16(0xC006, break_pc);
+    TEST_ASSERT_FALSE(debug_mode());
+}
+
+void test_conditional_breakpoint(void) {
+    TEST_ASSERT_TRUE(add_breakpoint_spec("C008 x==FF"));
+    TEST_ASSERT_TRUE(add_breakpoint_spec("C006 sp!=FD"));
+    TEST_ASSERT_FALSE(add_breakpoint_spec("C006 q==FF"));
+    TEST_ASSERT_FALSE(add_breakpoint_spec("C006 a=FF"));
+    TEST_ASSERT_FALSE(add_breakpoint_spec("C006 a==100"));
+    run_until_break(100);
+    TEST_ASSERT_EQUAL_INT(1, breaks);
+    TEST_ASSERT_EQUAL_HEX16(0xC008, last_break.address);
+
+    // X is never 0 there
+    clear_all_breakpoints();
+    breaks = 0;
+    TEST_ASSERT_TRUE(set_conditional_breakpoint(0xC008, "x==00"));
+    run_until_break(1000);
+    TEST_ASSERT_EQUAL_INT(0, breaks);
+}
+
+void test_cpu_write_watchpoint(void) {
+    TEST_ASSERT_TRUE(add_breakpoint_spec("write 2007"));
+    run_until_break(100000);
+    TEST_ASSERT_EQUAL_INT(1, breaks);
+    TEST_ASSERT_EQUAL_INT(BREAK_CPU_WRITE, last_break.reason);
+    TEST_ASSERT_EQUAL_HEX16(0x2007, last_break.address);
+}
+
+void test_ppu_write_watchpoint(void) {
+    // The first palette entry gets written while the menu's drawn
+    TEST_ASSERT_TRUE(add_breakpoint_spec("ppuwrite 3F00"));
+    memory* mem = run_until_break(100000);
+    TEST_ASSERT_EQUAL_INT(1, breaks);
+    TEST_ASSERT_EQUAL_INT(BREAK_PPU_WRITE, last_break.reason);
+    TEST_ASSERT_EQUAL_HEX16(0x3F00, last_break.address);
+    TEST_ASSERT_EQUAL_HEX8(mem->ppu_mem.palette_ram[0], last_break.value);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_address_set);
+    RUN_TEST(test_breakpoint);
+    RUN_TEST(test_conditional_breakpoint);
+    RUN_TEST(test_cpu_write_watchpoint);
+    RUN_TEST(test_ppu_write_watchpoint);
+    return UNITY_END();
+}
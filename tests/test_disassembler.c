@@ -0,0 +1,127 @@
+#include <string.h>
+
+#include "unity.h"
+#include <src/disassembler.h>
+
+byte prg[0xC000];
+rom r;
+
+// A rom that's nothing but PRG, filled with 0x02, which isn't an instruction
+void blank_rom(size_t size) {
+    memset(prg, 0x02, sizeof(prg));
+    memset(&r, 0, sizeof(r));
+    r.prg_rom = prg;
+    r.prg_rom_size = size;
+}
+
+void set_vectors(size_t size, uint16_t nmi, uint16_t reset, uint16_t irq) {
+    uint16_t vectors[] = {nmi, reset, irq};
+    for (int i = 0; i < 3; i++) {
+        prg[size - 6 + i * 2] = vectors[i] & 0xFF;
+        prg[size - 6 + i * 2 + 1] = vectors[i] >> 8;
+    }
+}
+
+void test_follows_code_from_vectors(void) {
+    blank_rom(0x4000);
+    byte code[] = {
+        0xA2, 0x00,       // C000: LDX #$00
+        0xE8,             // C002: INX
+        0xD0, 0xFD,       // C003: BNE $C002
+        0x20, 0x10, 0xC0, // C005: JSR $C010
+        0x4C, 0x00, 0xC0, // C008: JMP $C000
+        0xFF, 0xFF,       // C00B: data
+    };
+    memcpy(prg, code, sizeof(code));
+    prg[0x10] = 0x60; // C010: RTS
+    prg[0x20] = 0x40; // C020: RTI
+    set_vectors(0x4000, 0xC020, 0xC000, 0xC020);
+
+    prg_map map;
+    prg_map_init(&map, &r);
+    TEST_ASSERT_EQUAL_HEX16(0xC000, map.reset);
+    prg_map_trace(&map);
+
+    for (int i = 0; i < 0x0B; i++) {
+        TEST_ASSERT_TRUE(prg_map_is_code(&map, i));
+    }
+    TEST_ASSERT_FALSE(prg_map_is_code(&map, 0x0B));
+    TEST_ASSERT_FALSE(prg_map_is_code(&map, 0x0C));
+    TEST_ASSERT_TRUE(prg_map_is_code(&map, 0x10));
+    TEST_ASSERT_TRUE(prg_map_is_code(&map, 0x20));
+    TEST_ASSERT_FALSE(prg_map_is_code(&map, 0x11));
+    TEST_ASSERT_EQUAL_HEX8(PRG_OPCODE | PRG_LABEL, map.flags[0x02]);
+    TEST_ASSERT_EQUAL_HEX8(PRG_OPERAND, map.flags[0x04]);
+    TEST_ASSERT_EQUAL_HEX8(PRG_OPCODE | PRG_LABEL, map.flags[0x10]);
+
+    byte bitmap[0x800];
+    FILE* f = tmpfile();
+    prg_map_write_bitmap(&map, f);
+    rewind(f);
+    TEST_ASSERT_EQUAL_INT(sizeof(bitmap), fread(bitmap, 1, sizeof(bitmap), f));
+    fclose(f);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, bitmap[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x07, bitmap[1]);
+    TEST_ASSERT_EQUAL_HEX8(0x01, bitmap[2]);
+    TEST_ASSERT_EQUAL_HEX8(0x00, bitmap[3]);
+    TEST_ASSERT_EQUAL_HEX8(0x01, bitmap[4]);
+
+    prg_map_free(&map);
+}
+
+void test_follows_calls_into_every_switched_bank(void) {
+    // Three 16KB banks, the last fixed at 0xC000
+    blank_rom(0xC000);
+    byte code[] = {
+        0x20, 0x00, 0x80, // C000: JSR $8000
+        0x4C, 0x00, 0xC0, // C003: JMP $C000
+    };
+    memcpy(&prg[0x8000], code, sizeof(code));
+    set_vectors(0xC000, 0xC000, 0xC000, 0xC000);
+    prg[0x0000] = 0xEA; // Bank 0: NOP
+    prg[0x0001] = 0x60; //         RTS
+    prg[0x4000] = 0x10; // Bank 1: BPL $8004
+    prg[0x4001] = 0x02;
+    prg[0x4002] = 0x60; //         RTS
+
+    prg_map map;
+    prg_map_init(&map, &r);
+    TEST_ASSERT_EQUAL_INT(3, map.banks);
+    prg_map_trace(&map);
+
+    TEST_ASSERT_TRUE(prg_map_is_code(&map, 0x0000));
+    TEST_ASSERT_TRUE(prg_map_is_code(&map, 0x0001));
+    TEST_ASSERT_TRUE(prg_map_is_code(&map, 0x4000));
+    // The branch stays in bank 1, and the 0x02 it lands on isn't an instruction
+    TEST_ASSERT_TRUE(map.flags[0x4004] & PRG_LABEL);
+    TEST_ASSERT_FALSE(prg_map_is_code(&map, 0x4004));
+    TEST_ASSERT_FALSE(prg_map_is_code(&map, 0x0004));
+    TEST_ASSERT_TRUE(prg_map_is_code(&map, 0x4002));
+
+    prg_map_free(&map);
+}
+
+void test_format_instruction(void) {
+    char text[20];
+    byte lda[] = {0xBD, 0x34, 0x12};
+    format_instruction(text, sizeof(text), 0x8000, lda, false);
+    TEST_ASSERT_EQUAL_STRING("LDA $1234,X", text);
+
+    byte bne[] = {0xD0, 0xFD};
+    format_instruction(text, sizeof(text), 0xC003, bne, false);
+    TEST_ASSERT_EQUAL_STRING("BNE $C002", text);
+    format_instruction(text, sizeof(text), 0xC003, bne, true);
+    TEST_ASSERT_EQUAL_STRING("BNE LC002", text);
+
+    byte lax[] = {0xB3, 0x10};
+    format_instruction(text, sizeof(text), 0x8000, lax, false);
+    TEST_ASSERT_EQUAL_STRING("(LAX) ($10),Y", text);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_follows_code_from_vectors);
+    RUN_TEST(test_follows_calls_into_every_switched_bank);
+    RUN_TEST(test_format_instruction);
+    return UNITY_END();
+}
@@ -0,0 +1,49 @@
+#include "unity.h"
+#include <src/dma.h>
+
+void test_oam_dma_alignment(void) {
+    dma_unit dma;
+    dma_init(&dma);
+
+    // Halting on a put leaves the next cycle a get, ready to go
+    request_oam_dma(&dma, 0x02);
+    TEST_ASSERT_TRUE(dma.oam_pending);
+    TEST_ASSERT_EQUAL_INT(513, start_oam_dma(&dma, 101));
+    TEST_ASSERT_FALSE(dma.oam_pending);
+    TEST_ASSERT_EQUAL_UINT64(101 + 513, dma.oam_end);
+
+    // Halting on a get needs another cycle to line up
+    request_oam_dma(&dma, 0x02);
+    TEST_ASSERT_EQUAL_INT(514, start_oam_dma(&dma, 1000));
+}
+
+void test_dmc_dma_alignment(void) {
+    dma_unit dma;
+    dma_init(&dma);
+    TEST_ASSERT_EQUAL_INT(3, dmc_dma(&dma, 100));
+    TEST_ASSERT_EQUAL_INT(4, dmc_dma(&dma, 101));
+}
+
+void test_dmc_dma_during_oam_dma(void) {
+    dma_unit dma;
+    dma_init(&dma);
+    request_oam_dma(&dma, 0x02);
+    start_oam_dma(&dma, 101);
+
+    // Steals a get in the middle, which pushes the end of the OAM DMA back
+    TEST_ASSERT_EQUAL_INT(2, dmc_dma(&dma, 200));
+    TEST_ASSERT_EQUAL_UINT64(101 + 513 + 2, dma.oam_end);
+    // Then the last get and the last put
+    TEST_ASSERT_EQUAL_INT(1, dmc_dma(&dma, dma.oam_end - 2));
+    TEST_ASSERT_EQUAL_INT(3, dmc_dma(&dma, dma.oam_end - 1));
+    // And it's on its own again once the OAM DMA's over
+    TEST_ASSERT_EQUAL_INT(3, dmc_dma(&dma, dma.oam_end + 2));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_oam_dma_alignment);
+    RUN_TEST(test_dmc_dma_alignment);
+    RUN_TEST(test_dmc_dma_during_oam_dma);
+    return UNITY_END();
+}
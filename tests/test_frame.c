@@ -0,0 +1,116 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include <src/frame.h>
+
+byte screen[FRAME_HEIGHT][FRAME_WIDTH];
+uint32_t expected[FRAME_WIDTH * FRAME_HEIGHT * 16];
+uint32_t actual[FRAME_WIDTH * FRAME_HEIGHT * 16];
+
+void fill_screen() {
+    srand(42);
+    for (int y = 0; y < FRAME_HEIGHT; y++) {
+        for (int x = 0; x < FRAME_WIDTH; x++) {
+            // Include out of range values, only the low 6 bits should be used
+            screen[y][x] = (byte)rand();
+        }
+    }
+}
+
+void test_pixel_format(void) {
+    byte index = 0x21;
+    uint32_t rgba, bgra;
+    frame_force_simd_level(SIMD_NONE);
+    frame_to_rgba(&index, &rgba, 1, PIXEL_RGBA);
+    frame_to_rgba(&index, &bgra, 1, PIXEL_BGRA);
+
+    byte* rgba_bytes = (byte*)&rgba;
+    byte* bgra_bytes = (byte*)&bgra;
+    TEST_ASSERT_EQUAL_UINT8(rgba_bytes[0], bgra_bytes[2]);
+    TEST_ASSERT_EQUAL_UINT8(rgba_bytes[1], bgra_bytes[1]);
+    TEST_ASSERT_EQUAL_UINT8(rgba_bytes[2], bgra_bytes[0]);
+    TEST_ASSERT_EQUAL_UINT8(0xFF, rgba_bytes[3]);
+    TEST_ASSERT_EQUAL_UINT8(0xFF, bgra_bytes[3]);
+}
+
+void test_simd_conversion_matches_scalar(void) {
+    fill_screen();
+    size_t count = FRAME_WIDTH * FRAME_HEIGHT;
+
+    frame_force_simd_level(SIMD_NONE);
+    frame_to_rgba(&screen[0][0], expected, count, PIXEL_BGRA);
+
+    for (frame_simd_level level = SIMD_SSE2; level <= SIMD_AVX2; level++) {
+        frame_force_simd_level(level);
+        // Odd length to exercise the scalar tail
+        memset(actual, 0, sizeof(actual));
+        frame_to_rgba(&screen[0][0], actual, count - 3, PIXEL_BGRA);
+        TEST_ASSERT_EQUAL_UINT32_ARRAY(expected, actual, count - 3);
+        TEST_ASSERT_EQUAL_UINT32(0, actual[count - 3]);
+    }
+}
+
+void test_scaling(void) {
+    fill_screen();
+    uint32_t pixels[FRAME_WIDTH * FRAME_HEIGHT];
+    frame_force_simd_level(SIMD_NONE);
+    frame_to_rgba(&screen[0][0], pixels, FRAME_WIDTH * FRAME_HEIGHT, PIXEL_RGBA);
+
+    for (int scale = 1; scale <= 4; scale++) {
+        size_t pitch = FRAME_WIDTH * scale;
+        for (int y = 0; y < FRAME_HEIGHT * scale; y++) {
+            for (int x = 0; x < FRAME_WIDTH * scale; x++) {
+                expected[y * pitch + x] = pixels[(y / scale) * FRAME_WIDTH + x / scale];
+            }
+        }
+
+        for (frame_simd_level level = SIMD_NONE; level <= SIMD_AVX2; level++) {
+            frame_force_simd_level(level);
+            memset(actual, 0, sizeof(actual));
+            frame_convert_scaled(&screen, actual, pitch, scale, PIXEL_RGBA);
+            TEST_ASSERT_EQUAL_UINT32_ARRAY(expected, actual, pitch * FRAME_HEIGHT * scale);
+        }
+    }
+}
+
+void test_yuv(void) {
+    byte white_black[8] = { 255, 255, 255, 255, 0, 0, 0, 255 };
+    uint32_t px[2];
+    memcpy(px, white_black, sizeof(px));
+    byte y[2], u[2], v[2];
+    frame_force_simd_level(SIMD_NONE);
+    frame_rgba_to_yuv444(px, 2, y, u, v);
+    TEST_ASSERT_EQUAL_UINT8(235, y[0]);
+    TEST_ASSERT_EQUAL_UINT8(128, u[0]);
+    TEST_ASSERT_EQUAL_UINT8(128, v[0]);
+    TEST_ASSERT_EQUAL_UINT8(16, y[1]);
+    TEST_ASSERT_EQUAL_UINT8(128, u[1]);
+    TEST_ASSERT_EQUAL_UINT8(128, v[1]);
+
+    // Every SIMD level has to produce exactly the same planes as the scalar code
+    static byte expected_yuv[3][FRAME_WIDTH * FRAME_HEIGHT];
+    static byte actual_yuv[3][FRAME_WIDTH * FRAME_HEIGHT];
+    size_t count = FRAME_WIDTH * FRAME_HEIGHT - 5;
+    srand(7);
+    for (size_t i = 0; i < count; i++) {
+        actual[i] = (uint32_t)rand() ^ ((uint32_t)rand() << 16);
+    }
+    frame_rgba_to_yuv444(actual, count, expected_yuv[0], expected_yuv[1], expected_yuv[2]);
+    for (frame_simd_level level = SIMD_SSE2; level <= SIMD_AVX2; level++) {
+        frame_force_simd_level(level);
+        frame_rgba_to_yuv444(actual, count, actual_yuv[0], actual_yuv[1], actual_yuv[2]);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_yuv[0], actual_yuv[0], count);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_yuv[1], actual_yuv[1], count);
+        TEST_ASSERT_EQUAL_UINT8_ARRAY(expected_yuv[2], actual_yuv[2], count);
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_pixel_format);
+    RUN_TEST(test_simd_conversion_matches_scalar);
+    RUN_TEST(test_scaling);
+    RUN_TEST(test_yuv);
+    return UNITY_END();
+}
@@ -0,0 +1,127 @@
+#include "unity.h"
+#include <string.h>
+#include <src/input.h>
+
+input_snapshot input;
+ppu_memory ppu;
+
+void reset_input(void) {
+    memset(&input, 0, sizeof(input));
+    input.pointer_x = -1;
+    input.pointer_y = -1;
+    memset(&ppu, 0, sizeof(ppu));
+}
+
+byte read_bits(input_port* port, int count) {
+    byte value = 0;
+    for (int i = 0; i < count; i++) {
+        value |= (input_read(port, &input, &ppu) & 1) << i;
+    }
+    return value;
+}
+
+void test_controllers(void) {
+    reset_input();
+    input_port ports[2];
+    TEST_ASSERT_TRUE(input_connect_by_name(ports, "controllers"));
+    input.buttons[one][A] = true;
+    input.buttons[one][START] = true;
+    input.buttons[two][RIGHT] = true;
+
+    // Reads keep returning A while the strobe's high
+    input_write(&ports[0], &input, 1);
+    input_write(&ports[1], &input, 1);
+    TEST_ASSERT_EQUAL_UINT8(1, input_read(&ports[0], &input, &ppu));
+    TEST_ASSERT_EQUAL_UINT8(1, input_read(&ports[0], &input, &ppu));
+
+    input_write(&ports[0], &input, 0);
+    input_write(&ports[1], &input, 0);
+    // Pressing something after the latch doesn't change what's read
+    input.buttons[one][B] = true;
+    TEST_ASSERT_EQUAL_HEX8(0x09, read_bits(&ports[0], 8));
+    TEST_ASSERT_EQUAL_HEX8(0x80, read_bits(&ports[1], 8));
+    // Then 1s once they've all been read
+    TEST_ASSERT_EQUAL_HEX8(0xFF, read_bits(&ports[0], 8));
+}
+
+void test_four_score(void) {
+    reset_input();
+    input_port ports[2];
+    TEST_ASSERT_TRUE(input_connect_by_name(ports, "fourscore"));
+    input.buttons[one][A] = true;
+    input.buttons[two][B] = true;
+    input.buttons[three][UP] = true;
+    input.buttons[four][SELECT] = true;
+    input_write(&ports[0], &input, 1);
+    input_write(&ports[0], &input, 0);
+    input_write(&ports[1], &input, 1);
+    input_write(&ports[1], &input, 0);
+
+    TEST_ASSERT_EQUAL_HEX8(0x01, read_bits(&ports[0], 8));
+    TEST_ASSERT_EQUAL_HEX8(0x10, read_bits(&ports[0], 8));
+    TEST_ASSERT_EQUAL_HEX8(0x08, read_bits(&ports[0], 8));
+
+    TEST_ASSERT_EQUAL_HEX8(0x02, read_bits(&ports[1], 8));
+    TEST_ASSERT_EQUAL_HEX8(0x04, read_bits(&ports[1], 8));
+    TEST_ASSERT_EQUAL_HEX8(0x04, read_bits(&ports[1], 8));
+}
+
+void test_zapper(void) {
+    reset_input();
+    input_port ports[2];
+    TEST_ASSERT_TRUE(input_connect_by_name(ports, "zapper"));
+    ppu.screen[100][50] = 0x30; // White
+    ppu.screen[100][60] = 0x0F; // Black
+
+    // Pointed off the screen it never sees anything
+    ppu.scan_line = 102;
+    ppu.cycle = 10;
+    TEST_ASSERT_EQUAL_HEX8(0x08, input_read(&ports[1], &input, &ppu));
+
+    input.pointer_x = 50;
+    input.pointer_y = 100;
+    input.trigger = true;
+    // Just after the beam's gone past, it sees the white
+    TEST_ASSERT_EQUAL_HEX8(0x10, input_read(&ports[1], &input, &ppu));
+    // But not before it's been drawn, or once it's faded
+    ppu.scan_line = 50;
+    TEST_ASSERT_EQUAL_HEX8(0x18, input_read(&ports[1], &input, &ppu));
+    ppu.scan_line = 101 + ZAPPER_SENSE_LINES;
+    TEST_ASSERT_EQUAL_HEX8(0x18, input_read(&ports[1], &input, &ppu));
+
+    // And black is never seen
+    input.pointer_x = 60;
+    input.trigger = false;
+    ppu.scan_line = 102;
+    TEST_ASSERT_EQUAL_HEX8(0x08, input_read(&ports[1], &input, &ppu));
+}
+
+void test_arkanoid(void) {
+    reset_input();
+    input_port ports[2];
+    TEST_ASSERT_TRUE(input_connect_by_name(ports, "arkanoid"));
+    input.paddle = 0xFF;
+    input.paddle_button = true;
+    input_write(&ports[1], &input, 1);
+    input_write(&ports[1], &input, 0);
+
+    // Inverted, most significant bit first on bit 4, with the button on bit 3
+    byte position = 0;
+    for (int i = 0; i < 8; i++) {
+        byte value = input_read(&ports[1], &input, &ppu);
+        TEST_ASSERT_EQUAL_HEX8(0x08, value & 0x08);
+        position = (position << 1) | ((value >> 4) & 1);
+    }
+    TEST_ASSERT_EQUAL_HEX8(ARKANOID_MAX, (byte)~position);
+
+    TEST_ASSERT_FALSE(input_connect_by_name(ports, "keyboard"));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_controllers);
+    RUN_TEST(test_four_score);
+    RUN_TEST(test_zapper);
+    RUN_TEST(test_arkanoid);
+    return UNITY_END();
+}
@@ -8,8 +8,11 @@ memory mock_memory() {
     mem.x = 0x00;
     mem.y = 0x00;
     mem.sp = 0xFD;
-    mem.p = 0x34;
+    set_p(&mem, 0x34);
     mem.pc = 0x0000; // For tests, start reading at 0x0000 so we don't need to load a real ROM
+    mem.timing = TIMING_INSTRUCTION;
+    mem.bus = &nes_bus;
+    mem.ppu_mem.control = 0x00; // There's no rom, so nothing that'd make the PPU tell the mapper about a change
 
     for (int i = 0; i < 0x800; i++) {
         mem.ram[i] = 0x00;
@@ -25,9 +28,33 @@ void assert_value_at_address(memory* mem, uint16_t address, byte expected) {
 
 void test_pflags() {
     memory mem = mock_memory();
-    mem.p = 0x00;
+    set_p(&mem, 0x00);
     set_p_negative(&mem);
-    TEST_ASSERT_EQUAL_UINT8(0b10000000, mem.p);
+    TEST_ASSERT_EQUAL_UINT8(0b10000000, get_p(&mem));
+
+    // Each flag can still be set on its own, even ones that would never go together from a single result
+    set_p(&mem, 0x00);
+    set_p_zero(&mem);
+    set_p_negative(&mem);
+    set_p_carry(&mem);
+    set_p_interrupt(&mem);
+    TEST_ASSERT_EQUAL_UINT8(0b10000111, get_p(&mem));
+    clear_p_negative(&mem);
+    set_p_overflow(&mem);
+    TEST_ASSERT_EQUAL_UINT8(0b01000111, get_p(&mem));
+
+    set_p_zn_on(&mem, 0x80);
+    TEST_ASSERT_TRUE(get_p_negative(&mem));
+    TEST_ASSERT_FALSE(get_p_zero(&mem));
+    set_p_zn_on(&mem, 0x00);
+    TEST_ASSERT_FALSE(get_p_negative(&mem));
+    TEST_ASSERT_TRUE(get_p_zero(&mem));
+
+    // And everything comes back out the way it went in
+    for (int p = 0; p < 0x100; p++) {
+        set_p(&mem, p);
+        TEST_ASSERT_EQUAL_UINT8(p, get_p(&mem));
+    }
 }
 
 void test_stack() {
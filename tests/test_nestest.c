@@ -31,7 +31,7 @@ void test_load_rom(void) {
     r = read_rom("nestest.nes");
     mem = get_blank_memory(r);
     mem->pc = 0xC000; // nestest: automated tests start at a different address
-    mem->p  = 0x24; // nestest: the irrelevant bits are set differently in the log.
+    set_p(mem, 0x24); // nestest: the irrelevant bits are set differently in the log.
 }
 
 int num_steps = 8991;
@@ -139,13 +139,13 @@ void print_step_info(int index, log_step stepdata) {
         printf("FAIL: Cycles should be %d - but is %d\n", stepdata.cycles, test_total_cycles);
         success = false;
     }
-    if (stepdata.p != mem->p) {
-        printf("FAIL: P should be 0x%02X - but is 0x%02X\n", stepdata.p, mem->p);
+    if (stepdata.p != get_p(mem)) {
+        printf("FAIL: P should be 0x%02X - but is 0x%02X\n", stepdata.p, get_p(mem));
         printf("In binary: NV-BDIZC\n");
         printf("Expected:  ");
         print_byte(stepdata.p);
         printf("\nActual:    ");
-        print_byte(mem->p);
+        print_byte(get_p(mem));
         printf("\n");
         success = false;
     }
@@ -160,7 +160,7 @@ void print_step_info(int index, log_step stepdata) {
     if (success) {
         char *disassembly = disassemble(mem, mem->pc);
         printf("%04d $%04X OPC: 0x%02X | %-20s a: 0x%02X x: 0x%02X y: 0x%02X p: 0x%02X sp: 0x%02X ppu: %03d,%03d cycles: %d\n", index, mem->pc, read_byte(mem, mem->pc), disassembly, mem->a, mem->x,
-               mem->y, mem->p, mem->sp, ppu_x, ppu_y, test_total_cycles);
+               mem->y, get_p(mem), mem->sp, ppu_x, ppu_y, test_total_cycles);
         free(disassembly);
     }
 }
@@ -173,7 +173,7 @@ void test_run_rom(void) {
         TEST_ASSERT_EQUAL_UINT8(stepdata.a, mem->a);
         TEST_ASSERT_EQUAL_UINT8(stepdata.x, mem->x);
         TEST_ASSERT_EQUAL_UINT8(stepdata.y, mem->y);
-        TEST_ASSERT_EQUAL_UINT8(stepdata.p, mem->p);
+        TEST_ASSERT_EQUAL_UINT8(stepdata.p, get_p(mem));
         TEST_ASSERT_EQUAL_UINT8(stepdata.sp, mem->sp);
         TEST_ASSERT_EQUAL_INT(stepdata.cycles, test_total_cycles);
         int ppu_x = get_ppu_x(mem);
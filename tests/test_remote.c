@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "unity.h"
+#include <src/system.h>
+#include <src/debugger.h>
+#include <src/remote.h>
+#include <src/mapper/rom.h>
+
+char socket_path[64];
+
+int connect_client() {
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    int client = socket(AF_UNIX, SOCK_STREAM, 0);
+    TEST_ASSERT_TRUE(client >= 0);
+    TEST_ASSERT_EQUAL_INT(0, connect(client, (struct sockaddr*)&address, sizeof(address)));
+    return client;
+}
+
+void send_text(int client, const char* text) {
+    TEST_ASSERT_EQUAL_INT(strlen(text), send(client, text, strlen(text), 0));
+}
+
+// Everything that's been sent back so far
+void receive_all(int client, char* buf, size_t size) {
+    size_t length = 0;
+    ssize_t result;
+    while ((result = recv(client, buf + length, size - 1 - length, MSG_DONTWAIT)) > 0) {
+        length += result;
+    }
+    buf[length] = '\0';
+}
+
+#define REPLIES_SIZE 4096
+
+// Checks the lines came back in this order, skipping over anything in between
+void assert_replies(const char* replies, const char** expected, int count) {
+    const char* at = replies;
+    for (int i = 0; i < count; i++) {
+        const char* found = strstr(at, expected[i]);
+        if (found == NULL) {
+            char message[REPLIES_SIZE + 256];
+            snprintf(message, sizeof(message), "Expected %s in replies:\n%s", expected[i], replies);
+            TEST_ASSERT_NOT_NULL_MESSAGE(found, message);
+        }
+        at = found + strlen(expected[i]);
+    }
+}
+
+void test_remote_session(void) {
+    snprintf(socket_path, sizeof(socket_path), "/tmp/test_remote_%d.sock", getpid());
+    remote_debugger remote;
+    remote_open(&remote, socket_path);
+    memory* mem = get_blank_memory(read_rom("nestest.nes"));
+
+    // Nothing's connected, so nothing changes
+    remote_poll(&remote, mem);
+    TEST_ASSERT_EQUAL_INT(-1, remote.client);
+
+    int client = connect_client();
+    send_text(client, "break C006\nread C004 3\nbogus\n");
+    remote_poll(&remote, mem);
+
+    // Picked up the next time it stops: reset's SEI, CLD, LDX #$FF
+    send_text(client, "regs\nsetreg a 3F\nstep\nregs\noam\ncontinue\n");
+    for (int i = 0; i < 10; i++) {
+        system_step(mem);
+    }
+
+    char replies[REPLIES_SIZE];
+    receive_all(client, replies, sizeof(replies));
+    const char* expected[] = {
+            "{\"ok\":true}\n",
+            "{\"address\":49156,\"data\":\"78D8A2\"}\n",
+            "{\"error\":\"unknown command\"}\n",
+            "{\"event\":\"stopped\",\"reason\":\"breakpoint\",\"pc\":49158,",
+            "{\"pc\":49158,",
+            "{\"ok\":true}\n",
+            "{\"ok\":true}\n",
+            "{\"event\":\"stopped\",\"reason\":\"step\",\"pc\":49160,",
+            "{\"pc\":49160,\"a\":63,\"x\":255,",
+            "{\"data\":\"",
+            "{\"ok\":true}\n"
+    };
+    assert_replies(replies, expected, sizeof(expected) / sizeof(expected[0]));
+
+    // Going away clears everything it set, so there's nothing left to stop for
+    close(client);
+    remote_poll(&remote, mem);
+    TEST_ASSERT_EQUAL_INT(-1, remote.client);
+    TEST_ASSERT_EQUAL_INT(0, debug_hooks);
+
+    remote_close(&remote);
+    TEST_ASSERT_NOT_EQUAL(0, access(socket_path, F_OK));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_remote_session);
+    return UNITY_END();
+}
@@ -0,0 +1,123 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include <src/system.h>
+#include <src/rollback.h>
+#include <src/mapper/rom.h>
+
+#define TEST_FRAMES 60
+
+byte inputs[2][TEST_FRAMES];
+
+// Buttons that change often enough to make the guesses wrong, and pressing start now and then to get nestest moving
+void make_inputs(void) {
+    srand(1);
+    for (int p = 0; p < 2; p++) {
+        for (int i = 0; i < TEST_FRAMES; i++) {
+            inputs[p][i] = (i / 4) % 2 == p ? (byte)(rand() & 0xFF) : 0;
+        }
+    }
+}
+
+memory* start_nestest() {
+    return get_blank_memory(read_rom("nestest.nes"));
+}
+
+// Runs both peers to the end and lets them hear everything from each other
+void run_peers(rollback_session* a, rollback_session* b, netplay_link* link) {
+    while (a->frame < TEST_FRAMES || b->frame < TEST_FRAMES) {
+        if (a->frame < TEST_FRAMES) {
+            rollback_advance(a, inputs[0][a->frame]);
+        }
+        if (b->frame < TEST_FRAMES) {
+            rollback_advance(b, inputs[1][b->frame]);
+        }
+        loopback_tick(link);
+    }
+    for (int i = 0; i < 20; i++) {
+        rollback_poll(a);
+        rollback_poll(b);
+        loopback_tick(link);
+    }
+}
+
+void test_rollback_matches_local_play(void) {
+    make_inputs();
+    memory* reference = start_nestest();
+    for (int i = 0; i < TEST_FRAMES; i++) {
+        input_snapshot input;
+        memset(&input, 0, sizeof(input));
+        input_set_buttons(&input, one, inputs[0][i]);
+        input_set_buttons(&input, two, inputs[1][i]);
+        advance_frame(reference, &input);
+    }
+
+    netplay_link link_a, link_b;
+    loopback_queue a_to_b, b_to_a;
+    loopback_open(&link_a, &link_b, &a_to_b, &b_to_a, 3);
+    rollback_session a, b;
+    rollback_init(&a, start_nestest(), &link_a, one);
+    rollback_init(&b, start_nestest(), &link_b, two);
+    run_peers(&a, &b, &link_a);
+
+    TEST_ASSERT_EQUAL_UINT32(TEST_FRAMES, a.remote_frame);
+    TEST_ASSERT_EQUAL_UINT32(TEST_FRAMES, b.remote_frame);
+    // With 3 ticks of latency both sides have had to guess, and got it wrong
+    TEST_ASSERT_TRUE(a.rollbacks > 0);
+    TEST_ASSERT_TRUE(b.rollbacks > 0);
+    TEST_ASSERT_FALSE(a.desynced);
+    TEST_ASSERT_FALSE(b.desynced);
+
+    uint32_t expected = state_checksum(reference);
+    TEST_ASSERT_EQUAL_HEX32(expected, state_checksum(a.mem));
+    TEST_ASSERT_EQUAL_HEX32(expected, state_checksum(b.mem));
+
+    rollback_free(&a);
+    rollback_free(&b);
+}
+
+void test_rollback_waits_for_peer(void) {
+    netplay_link link_a, link_b;
+    loopback_queue a_to_b, b_to_a;
+    loopback_open(&link_a, &link_b, &a_to_b, &b_to_a, 0);
+    rollback_session a;
+    rollback_init(&a, start_nestest(), &link_a, one);
+
+    // Nothing's coming back, so it can only guess so far
+    for (int i = 0; i < ROLLBACK_FRAMES; i++) {
+        TEST_ASSERT_TRUE(rollback_advance(&a, 0));
+    }
+    TEST_ASSERT_FALSE(rollback_advance(&a, 0));
+    TEST_ASSERT_EQUAL_UINT32(ROLLBACK_FRAMES, a.frame);
+
+    rollback_free(&a);
+}
+
+void test_desync_is_noticed(void) {
+    make_inputs();
+    netplay_link link_a, link_b;
+    loopback_queue a_to_b, b_to_a;
+    loopback_open(&link_a, &link_b, &a_to_b, &b_to_a, 1);
+    rollback_session a, b;
+    rollback_init(&a, start_nestest(), &link_a, one);
+    rollback_init(&b, start_nestest(), &link_b, two);
+
+    // Somewhere nestest never touches, so it stays different
+    a.mem->ram[0x7FF] ^= 0xFF;
+    run_peers(&a, &b, &link_a);
+
+    TEST_ASSERT_TRUE(a.desynced || b.desynced);
+    TEST_ASSERT_NOT_EQUAL(state_checksum(a.mem), state_checksum(b.mem));
+
+    rollback_free(&a);
+    rollback_free(&b);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_rollback_matches_local_play);
+    RUN_TEST(test_rollback_waits_for_peer);
+    RUN_TEST(test_desync_is_noticed);
+    return UNITY_END();
+}
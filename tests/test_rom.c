@@ -0,0 +1,500 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "unity.h"
+#include <src/mapper/rom.h>
+#include <src/mapper/romdb.h>
+#include <src/mapper/mapper.h>
+#include <src/mapper/sram.h>
+#include <src/mem.h>
+
+#define CHR_RAM_ROM "test_rom_chr_ram.nes"
+#define ROMDB "test_rom.romdb"
+#define TEST_ROM "test_rom.nes"
+#define TEST_SAV "test_rom.sav"
+
+byte nestest[0x10000];
+size_t nestest_size;
+
+void load_nestest_bytes() {
+    FILE* fp = fopen("nestest.nes", "rb");
+    TEST_ASSERT_NOT_NULL(fp);
+    nestest_size = fread(nestest, 1, sizeof(nestest), fp);
+    fclose(fp);
+}
+
+// Every 8KB PRG bank and 1KB CHR bank is filled with its own number, so tests can see which one is mapped where
+rom* read_banked_test_rom(uint16_t mapper, byte prg_rom_blocks, byte chr_rom_blocks) {
+    ines_header header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.nes, "NES\x1A", 4);
+    header.prg_rom_blocks = prg_rom_blocks;
+    header.chr_rom_blocks = chr_rom_blocks;
+    header.flags_6 = (byte)((mapper & 0x0F) << 4);
+    header.flags_7 = (byte)(mapper & 0xF0);
+    FILE* fp = fopen(TEST_ROM, "wb");
+    fwrite(&header, sizeof(ines_header), 1, fp);
+    for (size_t i = 0; i < prg_rom_blocks * BYTES_PER_PRG_ROM_BLOCK; i++) {
+        fputc((int)(i / 0x2000), fp);
+    }
+    for (size_t i = 0; i < chr_rom_blocks * BYTES_PER_CHR_ROM_BLOCK; i++) {
+        fputc((int)(i / 0x400), fp);
+    }
+    fclose(fp);
+    return read_rom(TEST_ROM);
+}
+
+void test_images_are_shared(void) {
+    rom* a = read_rom("nestest.nes");
+    rom* b = read_rom("nestest.nes");
+
+    // Same mapping of the file, but each instance gets its own header to patch
+    TEST_ASSERT_EQUAL_PTR(a->prg_rom, b->prg_rom);
+    TEST_ASSERT_EQUAL_PTR(a->chr_rom, b->chr_rom);
+    TEST_ASSERT_TRUE(a->header != b->header);
+    TEST_ASSERT_FALSE(a->chr_ram);
+
+    load_nestest_bytes();
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(nestest + 16, a->prg_rom, get_prg_rom_bytes(a));
+
+    // CHR ROM can't be written
+    byte before = mapper_chr_read(a, 0x10);
+    mapper_chr_write(a, 0x10, before ^ 0xFF);
+    TEST_ASSERT_EQUAL_UINT8(before, mapper_chr_read(a, 0x10));
+
+    free_rom(a);
+    free_rom(b);
+}
+
+void write_test_rom(const char* path, ines_header* header, size_t prg_rom_bytes) {
+    memcpy(header->nes, "NES\x1A", 4);
+    FILE* fp = fopen(path, "wb");
+    fwrite(header, sizeof(ines_header), 1, fp);
+    for (size_t i = 0; i < prg_rom_bytes; i++) {
+        fputc(0xEA, fp);
+    }
+    fclose(fp);
+}
+
+void test_chr_ram(void) {
+    ines_header header;
+    memset(&header, 0, sizeof(header));
+    header.prg_rom_blocks = 1;
+    header.chr_rom_blocks = 0;
+    write_test_rom(CHR_RAM_ROM, &header, BYTES_PER_PRG_ROM_BLOCK);
+
+    rom* a = read_rom(CHR_RAM_ROM);
+    rom* b = read_rom(CHR_RAM_ROM);
+    TEST_ASSERT_TRUE(a->chr_ram);
+    TEST_ASSERT_EQUAL_PTR(a->prg_rom, b->prg_rom);
+    TEST_ASSERT_TRUE(a->chr_rom != b->chr_rom);
+
+    TEST_ASSERT_EQUAL_UINT8(0, mapper_chr_read(a, 0x1234));
+    mapper_chr_write(a, 0x1234, 0x56);
+    TEST_ASSERT_EQUAL_UINT8(0x56, mapper_chr_read(a, 0x1234));
+    TEST_ASSERT_EQUAL_UINT8(0, mapper_chr_read(b, 0x1234));
+
+    free_rom(a);
+    free_rom(b);
+    unlink(CHR_RAM_ROM);
+}
+
+// NES 2.0 CHR RAM can be as small as 128 bytes, which the whole pattern table space mirrors
+void test_small_chr_ram(void) {
+    ines_header header;
+    memset(&header, 0, sizeof(header));
+    header.prg_rom_blocks = 2;
+    header.chr_rom_blocks = 0;
+    header.flags_7 = 0b00001000; // NES 2.0
+    header.flags_11 = 0x01; // 128 bytes of CHR RAM
+
+    uint16_t mappers[] = {0, 4};
+    for (size_t i = 0; i < sizeof(mappers) / sizeof(mappers[0]); i++) {
+        header.flags_6 = (byte)((mappers[i] & 0x0F) << 4);
+        write_test_rom(CHR_RAM_ROM, &header, 2 * BYTES_PER_PRG_ROM_BLOCK);
+        rom* r = read_rom(CHR_RAM_ROM);
+        TEST_ASSERT_EQUAL_UINT(128, get_chr_bytes(r));
+
+        mapper_chr_write(r, 0x1FFF, 0x56);
+        TEST_ASSERT_EQUAL_UINT8(0x56, mapper_chr_read(r, 0x007F));
+        TEST_ASSERT_EQUAL_UINT8(0x56, mapper_chr_read(r, 0x1FFF));
+        free_rom(r);
+    }
+    unlink(CHR_RAM_ROM);
+}
+
+void test_ines_sizes(void) {
+    ines_header header;
+    memset(&header, 0, sizeof(header));
+    header.prg_rom_blocks = 2;
+    header.chr_rom_blocks = 0;
+    header.flags_6 = 0b00010010; // Mapper 1, battery
+    header.flags_7 = 0b00000000;
+    header.flags_8 = 0; // Means 8KB
+    write_test_rom(TEST_ROM, &header, 2 * BYTES_PER_PRG_ROM_BLOCK);
+
+    rom* r = read_rom(TEST_ROM);
+    TEST_ASSERT_FALSE(r->nes2);
+    TEST_ASSERT_EQUAL_UINT16(1, r->mapper);
+    TEST_ASSERT_EQUAL_UINT(0, r->prg_ram_size);
+    TEST_ASSERT_EQUAL_UINT(0x2000, r->prg_nvram_size);
+    TEST_ASSERT_EQUAL_UINT(0x2000, r->chr_ram_size);
+    free_rom(r);
+
+    // Junk at the end of the header means the mapper's upper nybble can't be trusted either
+    header.flags_7 = 0b01000000;
+    memcpy(&header.flags_8, "DiskDude", 8);
+    header.flags_6 = 0b00010000;
+    write_test_rom(TEST_ROM, &header, 2 * BYTES_PER_PRG_ROM_BLOCK);
+    r = read_rom(TEST_ROM);
+    TEST_ASSERT_EQUAL_UINT16(1, r->mapper);
+    TEST_ASSERT_EQUAL_UINT(0x2000, get_prg_ram_bytes(r));
+    free_rom(r);
+
+    unlink(TEST_ROM);
+}
+
+void test_nes2_sizes(void) {
+    ines_header header;
+    memset(&header, 0, sizeof(header));
+    header.prg_rom_blocks = 2;
+    header.chr_rom_blocks = 0;
+    header.flags_6 = 0b00010010; // Mapper 1, battery
+    header.flags_7 = 0b00001000; // NES 2.0
+    header.flags_8 = 0x30; // Submapper 3
+    header.flags_10 = 0x79; // 8KB of NVRAM, 32KB of work RAM
+    header.flags_11 = 0x08; // 16KB of CHR RAM
+    write_test_rom(TEST_ROM, &header, 2 * BYTES_PER_PRG_ROM_BLOCK);
+
+    rom* r = read_rom(TEST_ROM);
+    TEST_ASSERT_TRUE(r->nes2);
+    TEST_ASSERT_EQUAL_UINT16(1, r->mapper);
+    TEST_ASSERT_EQUAL_UINT8(3, r->submapper);
+    TEST_ASSERT_EQUAL_UINT(2 * BYTES_PER_PRG_ROM_BLOCK, get_prg_rom_bytes(r));
+    TEST_ASSERT_EQUAL_UINT(0x8000, r->prg_ram_size);
+    TEST_ASSERT_EQUAL_UINT(0x2000, r->prg_nvram_size);
+    TEST_ASSERT_EQUAL_UINT(0x4000, get_chr_bytes(r));
+    TEST_ASSERT_TRUE(r->chr_ram);
+    free_rom(r);
+
+    // No PRG RAM at all
+    header.flags_6 = 0b00000000;
+    header.flags_8 = 0x00;
+    header.flags_10 = 0x00;
+    write_test_rom(TEST_ROM, &header, 2 * BYTES_PER_PRG_ROM_BLOCK);
+    r = read_rom(TEST_ROM);
+    TEST_ASSERT_EQUAL_UINT(0, get_prg_ram_bytes(r));
+    TEST_ASSERT_NULL(r->prg_ram);
+    mapper_prg_write(r, 0x6010, 0x55);
+    TEST_ASSERT_EQUAL_UINT8(0, mapper_prg_read(r, 0x6010));
+    free_rom(r);
+    unlink(TEST_ROM);
+
+    // Mapper numbers go up to 4095, and ROM sizes can be given as an exponent and multiplier
+    header.flags_8 = 0x01;
+    header.flags_9 = 0x0F;
+    header.prg_rom_blocks = (14 << 2) | 0b01; // 2^14 * 3 bytes
+    rom fake;
+    fake.header = &header;
+    TEST_ASSERT_EQUAL_UINT16(256, get_mapper_number(&fake));
+    TEST_ASSERT_EQUAL_UINT(3 * 0x4000, nes2_rom_bytes(header.prg_rom_blocks, header.flags_9 & 0x0F, BYTES_PER_PRG_ROM_BLOCK));
+}
+
+void test_mmc1_prg_ram_banking(void) {
+    ines_header header;
+    memset(&header, 0, sizeof(header));
+    header.prg_rom_blocks = 2;
+    header.flags_6 = 0b00010000; // Mapper 1
+    header.flags_7 = 0b00001000; // NES 2.0
+    header.flags_10 = 0x09; // 32KB of work RAM, like SXROM
+    header.flags_11 = 0x07; // 8KB of CHR RAM
+    write_test_rom(TEST_ROM, &header, 2 * BYTES_PER_PRG_ROM_BLOCK);
+
+    rom* r = read_rom(TEST_ROM);
+    for (int bank = 0; bank < 4; bank++) {
+        // CHR bank 0 goes through the serial port at 0xA000, bits 2-3 pick the PRG RAM bank
+        byte value = bank << 2;
+        for (int bit = 0; bit < 5; bit++) {
+            mapper_prg_write(r, 0xA000, (value >> bit) & 1);
+        }
+        mapper_prg_write(r, 0x6000, 0x10 + bank);
+    }
+    for (int bank = 0; bank < 4; bank++) {
+        TEST_ASSERT_EQUAL_UINT8(0x10 + bank, r->prg_ram[bank * 0x2000]);
+    }
+    free_rom(r);
+    unlink(TEST_ROM);
+}
+
+// Turns rendering on with the given PPUCTRL at the start of line 1, and returns how many times the MMC3 counter gets
+// clocked over the rest of the frame
+int mmc3_clocks_in_first_frame(byte control) {
+    ines_header header;
+    memset(&header, 0, sizeof(header));
+    header.prg_rom_blocks = 2;
+    header.flags_6 = 0b01000000; // Mapper 4
+    write_test_rom(TEST_ROM, &header, 2 * BYTES_PER_PRG_ROM_BLOCK);
+
+    rom* r = read_rom(TEST_ROM);
+    memory* mem = get_blank_memory(r);
+    mapper_prg_write(r, 0xC000, 255); // IRQ latch
+    for (int i = 0; i < CYCLES_PER_LINE; i++) {
+        ppu_step(&mem->ppu_mem);
+    }
+    write_ppu_register(&mem->ppu_mem, 0, control);
+    write_ppu_register(&mem->ppu_mem, 1, 0b00011000); // Show background and sprites
+    mapper_watch_event(&mem->ppu_mem, NUM_LINES * CYCLES_PER_LINE - 1);
+
+    // The first clock reloads the counter from the latch, the rest count down
+    int clocks = r->mapperdata.counter == 0 ? 0 : 256 - r->mapperdata.counter;
+    free(mem);
+    free_rom(r);
+    unlink(TEST_ROM);
+    return clocks;
+}
+
+void test_mmc3_a12_counter(void) {
+    // One clock for each line the PPU fetches patterns on, when sprites and background use different tables
+    TEST_ASSERT_EQUAL_INT(240, mmc3_clocks_in_first_frame(0b00001000)); // Sprites at 0x1000
+    // Background at 0x1000 also rises on the very first fetch after rendering is turned on
+    TEST_ASSERT_EQUAL_INT(241, mmc3_clocks_in_first_frame(0b00010000));
+    // A12 never rises
+    TEST_ASSERT_EQUAL_INT(0, mmc3_clocks_in_first_frame(0b00000000));
+    // A12 only falls for a few dots at a time, which the filter ignores, so it only rises once
+    TEST_ASSERT_EQUAL_INT(1, mmc3_clocks_in_first_frame(0b00011000));
+}
+
+void test_mmc2_latches(void) {
+    rom* r = read_banked_test_rom(9, 8, 4);
+    mapper_prg_write(r, 0xA000, 5);
+    TEST_ASSERT_EQUAL_UINT8(5, mapper_prg_read(r, 0x8000));
+    TEST_ASSERT_EQUAL_UINT8(13, mapper_prg_read(r, 0xA000)); // The last three are fixed
+    TEST_ASSERT_EQUAL_UINT8(15, mapper_prg_read(r, 0xFFFF));
+
+    // 4KB CHR banks 1 and 2 for the first pattern table, 3 and 4 for the second
+    mapper_prg_write(r, 0xB000, 1);
+    mapper_prg_write(r, 0xC000, 2);
+    mapper_prg_write(r, 0xD000, 3);
+    mapper_prg_write(r, 0xE000, 4);
+    TEST_ASSERT_EQUAL_UINT8(8, mapper_chr_read(r, 0x0000)); // Starts out on FE
+
+    // Tile FD switches over once it's been fetched
+    TEST_ASSERT_EQUAL_UINT8(11, mapper_chr_read(r, 0x0FD8));
+    TEST_ASSERT_EQUAL_UINT8(4, mapper_chr_read(r, 0x0000));
+    // The MMC2 only looks at the one address in the first table
+    mapper_chr_read(r, 0x0FE9);
+    TEST_ASSERT_EQUAL_UINT8(4, mapper_chr_read(r, 0x0000));
+    mapper_chr_read(r, 0x0FE8);
+    TEST_ASSERT_EQUAL_UINT8(8, mapper_chr_read(r, 0x0000));
+    // But any of the high plane in the second
+    TEST_ASSERT_EQUAL_UINT8(16, mapper_chr_read(r, 0x1000));
+    mapper_chr_read(r, 0x1FDD);
+    TEST_ASSERT_EQUAL_UINT8(12, mapper_chr_read(r, 0x1000));
+    free_rom(r);
+    unlink(TEST_ROM);
+}
+
+void test_vrc4(void) {
+    rom* r = read_banked_test_rom(21, 8, 4);
+    memory* mem = get_blank_memory(r);
+    // VRC4a selects registers with A1 and A2
+    write_byte(mem, 0x8000, 3);
+    write_byte(mem, 0xA000, 4);
+    TEST_ASSERT_EQUAL_UINT8(3, read_byte(mem, 0x8000));
+    TEST_ASSERT_EQUAL_UINT8(4, read_byte(mem, 0xA000));
+    TEST_ASSERT_EQUAL_UINT8(14, read_byte(mem, 0xC000));
+    // Swap 0x8000 and 0xC000, VRC4c style on A6 and A7
+    write_byte(mem, 0x9080, 0b10);
+    TEST_ASSERT_EQUAL_UINT8(14, read_byte(mem, 0x8000));
+    TEST_ASSERT_EQUAL_UINT8(3, read_byte(mem, 0xC000));
+
+    // CHR banks are written a nybble at a time
+    write_byte(mem, 0xB000, 0x3);
+    write_byte(mem, 0xB002, 0x1);
+    TEST_ASSERT_EQUAL_UINT8(0x13, mapper_chr_read(r, 0x0000));
+
+    // Counting CPU cycles, the IRQ goes off when the counter overflows from 0xFF
+    write_byte(mem, 0xF000, 0xE);
+    write_byte(mem, 0xF002, 0xF);
+    write_byte(mem, 0xF004, 0b110);
+    scheduler* s = &mem->scheduler;
+    TEST_ASSERT_EQUAL_UINT64(2 * DOTS_PER_CPU_CYCLE, s->heap[s->position[EVENT_MAPPER_TIMER]].time);
+    s->now = 2 * DOTS_PER_CPU_CYCLE;
+    schedule_mapper_timer(mem, s->now);
+    TEST_ASSERT_EQUAL_UINT8(IRQ_MAPPER, s->irq_line);
+    write_byte(mem, 0xF006, 0);
+    TEST_ASSERT_EQUAL_UINT8(0, s->irq_line);
+
+    // Counting lines, it's the 341 dots the prescaler takes, rounded up to a whole CPU cycle
+    write_byte(mem, 0xF000, 0xF);
+    write_byte(mem, 0xF004, 0b010);
+    TEST_ASSERT_EQUAL_UINT64(s->now + 114 * DOTS_PER_CPU_CYCLE, s->heap[s->position[EVENT_MAPPER_TIMER]].time);
+
+    free(mem);
+    free_rom(r);
+    unlink(TEST_ROM);
+}
+
+void test_fme7_irq(void) {
+    rom* r = read_banked_test_rom(69, 8, 4);
+    memory* mem = get_blank_memory(r);
+    scheduler* s = &mem->scheduler;
+    write_byte(mem, 0x8000, 0x9);
+    write_byte(mem, 0xA000, 6);
+    TEST_ASSERT_EQUAL_UINT8(6, read_byte(mem, 0x8000));
+
+    // The counter goes off when it wraps around from 0
+    write_byte(mem, 0x8000, 0xE);
+    write_byte(mem, 0xA000, 100);
+    write_byte(mem, 0x8000, 0xF);
+    write_byte(mem, 0xA000, 0);
+    write_byte(mem, 0x8000, 0xD);
+    write_byte(mem, 0xA000, 0x81);
+    timestamp due = 101 * DOTS_PER_CPU_CYCLE;
+    TEST_ASSERT_EQUAL_UINT64(due, s->heap[s->position[EVENT_MAPPER_TIMER]].time);
+
+    schedule_mapper_timer(mem, due - DOTS_PER_CPU_CYCLE);
+    TEST_ASSERT_EQUAL_UINT8(0, s->irq_line);
+    schedule_mapper_timer(mem, due);
+    TEST_ASSERT_EQUAL_UINT8(IRQ_MAPPER, s->irq_line);
+    TEST_ASSERT_EQUAL_UINT16(0xFFFF, r->mapperdata.irq_counter);
+
+    // Any write to the control register acknowledges it
+    write_byte(mem, 0xA000, 0x81);
+    TEST_ASSERT_EQUAL_UINT8(0, s->irq_line);
+
+    free(mem);
+    free_rom(r);
+    unlink(TEST_ROM);
+}
+
+void test_mmc5_scanline_irq(void) {
+    rom* r = read_banked_test_rom(5, 8, 4);
+    memory* mem = get_blank_memory(r);
+    ppu_memory* ppu = &mem->ppu_mem;
+    write_byte(mem, 0x5203, 100);
+    write_byte(mem, 0x5204, 0x80);
+    for (int i = 0; i < CYCLES_PER_LINE; i++) {
+        ppu_step(ppu);
+    }
+    write_ppu_register(ppu, 1, 0b00011000);
+
+    // scan_line is one ahead of the line the IRQ is asked for, since 0 is the pre-render line
+    mapper_watch_event(ppu, 101 * CYCLES_PER_LINE + 3);
+    TEST_ASSERT_EQUAL_UINT8(0, mem->scheduler.irq_line);
+    mapper_watch_event(ppu, 101 * CYCLES_PER_LINE + 4);
+    TEST_ASSERT_EQUAL_UINT8(IRQ_MAPPER, mem->scheduler.irq_line);
+
+    // Reading the status acknowledges it
+    TEST_ASSERT_EQUAL_UINT8(0b11000000, read_byte(mem, 0x5204));
+    TEST_ASSERT_EQUAL_UINT8(0, mem->scheduler.irq_line);
+    mapper_watch_event(ppu, 242 * CYCLES_PER_LINE);
+    TEST_ASSERT_EQUAL_UINT8(0, read_byte(mem, 0x5204));
+
+    free(mem);
+    free_rom(r);
+    unlink(TEST_ROM);
+}
+
+void test_sram(void) {
+    ines_header header;
+    memset(&header, 0, sizeof(header));
+    header.prg_rom_blocks = 1;
+    header.flags_6 = 0b00000010; // Mapper 0, battery
+    write_test_rom(TEST_ROM, &header, BYTES_PER_PRG_ROM_BLOCK);
+
+    static byte sav[0x2000];
+    for (int i = 0; i < 0x2000; i++) {
+        sav[i] = i * 7;
+    }
+    FILE* fp = fopen(TEST_SAV, "wb");
+    fwrite(sav, 1, sizeof(sav), fp);
+    fclose(fp);
+
+    rom* r = read_rom(TEST_ROM);
+    sram_open(r, TEST_ROM);
+    TEST_ASSERT_NOT_NULL(r->sram);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(sav, r->prg_ram, sizeof(sav));
+
+    mapper_prg_write(r, 0x6123, 0xAB);
+    mapper_prg_write(r, 0x7FFF, 0xCD);
+
+    // Too soon since the last flush, so nothing gets written yet
+    sram_frame(r);
+    fp = fopen(TEST_SAV, "rb");
+    static byte saved[0x2000];
+    TEST_ASSERT_EQUAL_UINT(sizeof(saved), fread(saved, 1, sizeof(saved), fp));
+    fclose(fp);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(sav, saved, sizeof(sav));
+
+    // Closing flushes whatever's left
+    free_rom(r);
+    sav[0x0123] = 0xAB;
+    sav[0x1FFF] = 0xCD;
+    fp = fopen(TEST_SAV, "rb");
+    TEST_ASSERT_EQUAL_UINT(sizeof(saved), fread(saved, 1, sizeof(saved), fp));
+    fclose(fp);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(sav, saved, sizeof(sav));
+
+    unlink(TEST_SAV);
+    unlink(TEST_ROM);
+}
+
+void test_rom_database(void) {
+    load_nestest_bytes();
+    uint32_t crc = rom_crc32(nestest + 16, nestest_size - 16);
+
+    // Check value for the standard CRC32
+    TEST_ASSERT_EQUAL_HEX32(0xCBF43926, rom_crc32((const byte*)"123456789", 9));
+
+    unlink(ROMDB ".cache");
+    FILE* fp = fopen(ROMDB, "w");
+    fprintf(fp, "# Not a real fixup, nestest is horizontal\n");
+    fprintf(fp, "DEADBEEF mapper=4\n");
+    fprintf(fp, "%08X mirroring=v battery=1 prg_ram=32 # trailing comment\n", crc);
+    fclose(fp);
+
+    for (int pass = 0; pass < 2; pass++) {
+        // The first pass parses and writes the cache, the second one reads it back
+        load_rom_database(ROMDB);
+        TEST_ASSERT_EQUAL_INT(0, access(ROMDB ".cache", R_OK));
+        TEST_ASSERT_NULL(rom_database_lookup(0x12345678));
+        TEST_ASSERT_EQUAL_INT(4, rom_database_lookup(0xDEADBEEF)->mapper);
+
+        rom* r = read_rom("nestest.nes");
+        TEST_ASSERT_EQUAL_INT(VERTICAL, r->nametable_mirroring_mode);
+        TEST_ASSERT_EQUAL_UINT8(0, r->mapper);
+        TEST_ASSERT_TRUE(r->battery);
+        TEST_ASSERT_EQUAL_UINT(0, r->prg_ram_size);
+        TEST_ASSERT_EQUAL_UINT(0x8000, r->prg_nvram_size);
+        free_rom(r);
+    }
+
+    unload_rom_database();
+    rom* r = read_rom("nestest.nes");
+    TEST_ASSERT_EQUAL_INT(HORIZONTAL, r->nametable_mirroring_mode);
+    free_rom(r);
+
+    unlink(ROMDB);
+    unlink(ROMDB ".cache");
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_images_are_shared);
+    RUN_TEST(test_chr_ram);
+    RUN_TEST(test_small_chr_ram);
+    RUN_TEST(test_ines_sizes);
+    RUN_TEST(test_nes2_sizes);
+    RUN_TEST(test_mmc1_prg_ram_banking);
+    RUN_TEST(test_mmc3_a12_counter);
+    RUN_TEST(test_mmc2_latches);
+    RUN_TEST(test_vrc4);
+    RUN_TEST(test_fme7_irq);
+    RUN_TEST(test_mmc5_scanline_irq);
+    RUN_TEST(test_sram);
+    RUN_TEST(test_rom_database);
+    return UNITY_END();
+}
@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "unity.h"
+#include <src/system.h>
+#include <src/savestate.h>
+#include <src/runahead.h>
+#include <src/mapper/rom.h>
+
+// nestest sits on its menu from reset, drawing frames and taking NMIs, which is plenty going on to get wrong
+memory* start_nestest() {
+    memory* mem = get_blank_memory(read_rom("nestest.nes"));
+    for (int i = 0; i < 5; i++) {
+        system_run_frame(mem);
+    }
+    return mem;
+}
+
+void assert_same_console(memory* expected, memory* actual) {
+    TEST_ASSERT_EQUAL_HEX16(expected->pc, actual->pc);
+    TEST_ASSERT_EQUAL_HEX8(expected->a, actual->a);
+    TEST_ASSERT_EQUAL_HEX8(expected->x, actual->x);
+    TEST_ASSERT_EQUAL_HEX8(expected->y, actual->y);
+    TEST_ASSERT_EQUAL_HEX8(get_p(expected), get_p(actual));
+    TEST_ASSERT_EQUAL_HEX8(expected->sp, actual->sp);
+    TEST_ASSERT_EQUAL_INT64(expected->total_cycles, actual->total_cycles);
+    TEST_ASSERT_EQUAL_UINT64(expected->scheduler.now, actual->scheduler.now);
+    TEST_ASSERT_EQUAL_UINT64(expected->ppu_mem.frame, actual->ppu_mem.frame);
+    TEST_ASSERT_EQUAL_UINT16(expected->ppu_mem.scan_line, actual->ppu_mem.scan_line);
+    TEST_ASSERT_EQUAL_UINT16(expected->ppu_mem.cycle, actual->ppu_mem.cycle);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected->ram, actual->ram, sizeof(expected->ram));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected->ppu_mem.name_tables, actual->ppu_mem.name_tables, sizeof(expected->ppu_mem.name_tables));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected->ppu_mem.screen, actual->ppu_mem.screen, sizeof(expected->ppu_mem.screen));
+}
+
+void test_save_and_load(void) {
+    memory* mem = start_nestest();
+    savestate state;
+    savestate_init(&state, mem->r);
+    save_state(mem, &state);
+    byte ram[0x800];
+    memcpy(ram, mem->ram, sizeof(ram));
+    uint64_t now = mem->scheduler.now;
+
+    // Press start so things actually change
+    mem->input.buttons[one][START] = true;
+    for (int i = 0; i < 10; i++) {
+        system_run_frame(mem);
+    }
+    memory* after = malloc(sizeof(memory));
+    memcpy(after, mem, sizeof(memory));
+    long samples = mem->apu_mem.buffer_write_index;
+
+    load_state(mem, &state);
+    TEST_ASSERT_EQUAL_UINT64(now, mem->scheduler.now);
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(ram, mem->ram, sizeof(ram));
+    // The audio that's already been made stays made
+    TEST_ASSERT_EQUAL_INT64(samples, mem->apu_mem.buffer_write_index);
+
+    // And going round again with the same input ends up in the same place
+    TEST_ASSERT_FALSE(mem->input.buttons[one][START]);
+    mem->input.buttons[one][START] = true;
+    for (int i = 0; i < 10; i++) {
+        system_run_frame(mem);
+    }
+    assert_same_console(after, mem);
+
+    free(after);
+    savestate_free(&state);
+}
+
+void test_run_ahead_matches_normal_frames(void) {
+    memory* normal = start_nestest();
+    memory* ahead = start_nestest();
+    run_ahead ra;
+    run_ahead_init(&ra, ahead, 2);
+
+    for (int i = 0; i < 10; i++) {
+        normal->input.buttons[one][START] = i == 3;
+        system_run_frame(normal);
+
+        // poll_input leaves the snapshot alone without a frontend, so this is the input it gets
+        ahead->input.buttons[one][START] = i == 3;
+        long samples = ahead->apu_mem.buffer_write_index;
+        run_ahead_frame(&ra, ahead);
+        // Only the real frame's heard
+        TEST_ASSERT_EQUAL_INT64(normal->apu_mem.buffer_write_index - samples, ahead->apu_mem.buffer_write_index - samples);
+    }
+    assert_same_console(normal, ahead);
+    TEST_ASSERT_TRUE(ahead->ppu_mem.present);
+    TEST_ASSERT_FALSE(ahead->ppu_mem.speculative);
+    TEST_ASSERT_FALSE(ahead->apu_mem.muted);
+
+    run_ahead_free(&ra);
+}
+
+// Things that don't show in the registers or RAM yet, but will, have to change the checksum too
+void test_checksum_covers_pending_work(void) {
+    memory* mem = start_nestest();
+    uint32_t checksum = state_checksum(mem);
+
+    dma_unit dma = mem->dma;
+    request_oam_dma(&mem->dma, 0x02);
+    TEST_ASSERT_NOT_EQUAL(checksum, state_checksum(mem));
+    mem->dma = dma;
+    TEST_ASSERT_EQUAL_HEX32(checksum, state_checksum(mem));
+
+    int stall_cycles = mem->stall_cycles;
+    mem->stall_cycles += 513;
+    TEST_ASSERT_NOT_EQUAL(checksum, state_checksum(mem));
+    mem->stall_cycles = stall_cycles;
+    TEST_ASSERT_EQUAL_HEX32(checksum, state_checksum(mem));
+
+    schedule_event(&mem->scheduler, EVENT_DMC_FETCH, mem->scheduler.now + 100, 0);
+    TEST_ASSERT_NOT_EQUAL(checksum, state_checksum(mem));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_save_and_load);
+    RUN_TEST(test_run_ahead_matches_normal_frames);
+    RUN_TEST(test_checksum_covers_pending_work);
+    return UNITY_END();
+}
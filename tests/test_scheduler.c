@@ -0,0 +1,71 @@
+#include "unity.h"
+#include <src/scheduler.h>
+
+void test_events_come_out_in_order(void) {
+    scheduler s;
+    scheduler_init(&s);
+    schedule_event(&s, EVENT_DMC_FETCH, 300, 0);
+    schedule_event(&s, EVENT_NMI, 100, 0);
+    schedule_event(&s, EVENT_MAPPER_PPU, 200, 7);
+    schedule_event(&s, EVENT_APU_FRAME_COUNTER, 50, 0);
+    TEST_ASSERT_EQUAL_UINT64(50, s.next);
+
+    scheduled_event event;
+    s.now = 99;
+    TEST_ASSERT_TRUE(pop_due_event(&s, &event));
+    TEST_ASSERT_EQUAL_INT(EVENT_APU_FRAME_COUNTER, event.type);
+    TEST_ASSERT_FALSE(pop_due_event(&s, &event));
+
+    s.now = 1000;
+    TEST_ASSERT_TRUE(pop_due_event(&s, &event));
+    TEST_ASSERT_EQUAL_INT(EVENT_NMI, event.type);
+    TEST_ASSERT_TRUE(pop_due_event(&s, &event));
+    TEST_ASSERT_EQUAL_INT(EVENT_MAPPER_PPU, event.type);
+    TEST_ASSERT_EQUAL_INT(7, event.data);
+    TEST_ASSERT_TRUE(pop_due_event(&s, &event));
+    TEST_ASSERT_EQUAL_INT(EVENT_DMC_FETCH, event.type);
+    TEST_ASSERT_FALSE(pop_due_event(&s, &event));
+    TEST_ASSERT_EQUAL_UINT64(NEVER, s.next);
+}
+
+void test_reschedule_and_cancel(void) {
+    scheduler s;
+    scheduler_init(&s);
+    schedule_event(&s, EVENT_NMI, 100, 0);
+    schedule_event(&s, EVENT_DMC_FETCH, 200, 0);
+
+    // Only one of each type is ever pending, scheduling again moves it
+    schedule_event(&s, EVENT_DMC_FETCH, 10, 0);
+    TEST_ASSERT_EQUAL_INT(2, s.count);
+    TEST_ASSERT_EQUAL_UINT64(10, s.next);
+
+    cancel_event(&s, EVENT_DMC_FETCH);
+    cancel_event(&s, EVENT_DMC_FETCH);
+    TEST_ASSERT_EQUAL_INT(1, s.count);
+    TEST_ASSERT_EQUAL_UINT64(100, s.next);
+
+    scheduled_event event;
+    s.now = 100;
+    TEST_ASSERT_TRUE(pop_due_event(&s, &event));
+    TEST_ASSERT_EQUAL_INT(EVENT_NMI, event.type);
+    TEST_ASSERT_EQUAL_INT(0, s.count);
+}
+
+void test_irq_sources(void) {
+    scheduler s;
+    scheduler_init(&s);
+    assert_irq(&s, IRQ_MAPPER);
+    assert_irq(&s, IRQ_APU_FRAME);
+    release_irq(&s, IRQ_MAPPER);
+    TEST_ASSERT_EQUAL_UINT8(IRQ_APU_FRAME, s.irq_line);
+    release_irq(&s, IRQ_APU_FRAME);
+    TEST_ASSERT_EQUAL_UINT8(0, s.irq_line);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_events_come_out_in_order);
+    RUN_TEST(test_reschedule_and_cancel);
+    RUN_TEST(test_irq_sources);
+    return UNITY_END();
+}